@@ -0,0 +1,570 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Microbenchmarks of the hot paths of the Wrapper.
+ *
+ * The Wrapper sources are linked in as they are (main() is left out with
+ *  WRAPPER_BENCH), and initialized the way main() does from a configuration
+ *  file written to a temporary directory, with the log file in the same
+ *  directory and the console disabled.  Each benchmark is calibrated to run
+ *  for about the requested time, then repeated, and the fastest and median
+ *  times per operation are reported.  With -json, each result is printed as
+ *  a JSON object on its own line, so results can be compared across builds.
+ *
+ * This is only built on Linux:  make -f Makefile-linux-x86-64.make bench
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <langinfo.h>
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "wrapper_i18n.h"
+#include "wrapperinfo.h"
+#include "wrapper.h"
+#include "logger.h"
+#include "property.h"
+#include "wrapper_hashmap.h"
+
+#define BENCH_BATCH             64      /* Lines or packets written before the Wrapper reads them. */
+#define BENCH_HASHMAP_KEYS      1000
+#define BENCH_PROPERTY_COUNT    500
+#define BENCH_LIST_COUNT        20
+#define BENCH_CALIBRATE_MS      10.0
+
+typedef struct BenchCase BenchCase;
+struct BenchCase {
+    const char *name;
+    const char *description;
+    void (*run)(long count);
+};
+
+static char benchDir[256];
+static char benchConfPath[300];
+static char benchLogPath[300];
+
+/* A typical line of application output, without its LF. */
+static const char benchLineMB[] = "2025-01-01 12:00:00,000 INFO  [main] com.example.app.Service - Processed request 1234 in 56 ms for client 10.0.0.1";
+static const char benchLineUTF8MB[] = "2025-01-01 12:00:00,000 INFO  [main] com.example.app.Service - R\xc3\xa9sum\xc3\xa9 trait\xc3\xa9 pour le client \xc3\x89lodie (56 ms)";
+static TCHAR benchLine[256];
+static TCHAR benchMessage[256];
+
+static PHashMap benchHashMap;
+static TCHAR benchHashMapKeys[BENCH_HASHMAP_KEYS][16];
+static TCHAR benchPropertyNames[BENCH_PROPERTY_COUNT][32];
+
+static double benchNowNs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void benchFail(const char *what) {
+    fprintf(stderr, "bench: %s failed: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static void benchWriteAll(int fd, const char *buffer, size_t len) {
+    ssize_t rc;
+
+    while (len > 0) {
+        rc = write(fd, buffer, len);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            benchFail("write");
+        }
+        buffer += rc;
+        len -= rc;
+    }
+}
+
+/******************************************************************************
+ * Logging
+ *****************************************************************************/
+static void benchBuildPrintBuffer(long count) {
+    struct tm nowTM;
+    time_t now;
+    int tanukiStep = 0;
+    int threadId = getThreadId();
+    long i;
+
+    now = time(NULL);
+    localtime_r(&now, &nowTM);
+    for (i = 0; i < count; i++) {
+        buildPrintBuffer(1, LEVEL_INFO, threadId, FALSE, &nowTM, 123, 0, &tanukiStep, LOG_FORMAT_LOGFILE_DEFAULT, LOG_FORMAT_LOGFILE_DEFAULT, benchLine);
+    }
+}
+
+static void benchLogPrintfMessage(long count) {
+    int threadId = getThreadId();
+    long i;
+
+    /* log_printf_message must be called while locked, as log_printf does. */
+    if (lockLoggingMutex()) {
+        return;
+    }
+    for (i = 0; i < count; i++) {
+        /* The message is only modified when it contains a LF. */
+        log_printf_message(1, LEVEL_INFO, threadId, FALSE, benchMessage, TRUE);
+    }
+    releaseLoggingMutex();
+}
+
+/******************************************************************************
+ * Filters
+ *****************************************************************************/
+static void benchWildcardMatch(long count) {
+    const TCHAR *pattern = TEXT("*Exception*at ???*line*");
+    size_t minLen = wrapperGetMinimumTextLengthForPattern(pattern);
+    long i;
+
+    for (i = 0; i < count; i++) {
+        wrapperWildcardMatch(benchLine, pattern, minLen);
+    }
+}
+
+static void benchApplyFilters(long count) {
+    long i;
+
+    /* None of the configured triggers match, which is the case for almost every line. */
+    for (i = 0; i < count; i++) {
+        logApplyFilters(benchLine);
+    }
+}
+
+/******************************************************************************
+ * Hash map
+ *****************************************************************************/
+static void benchHashMapPut(long count) {
+    long i;
+
+    for (i = 0; i < count; i++) {
+        hashMapPutKWVW(benchHashMap, benchHashMapKeys[i % BENCH_HASHMAP_KEYS], benchLine);
+    }
+}
+
+static void benchHashMapGet(long count) {
+    long i;
+
+    for (i = 0; i < count; i++) {
+        hashMapGetKWVW(benchHashMap, benchHashMapKeys[i % BENCH_HASHMAP_KEYS]);
+    }
+}
+
+/******************************************************************************
+ * Properties
+ *****************************************************************************/
+static void benchGetStringProperty(long count) {
+    long i;
+
+    /* getStringProperty is the usual way into getInnerProperty. */
+    for (i = 0; i < count; i++) {
+        getStringProperty(properties, benchPropertyNames[i % BENCH_PROPERTY_COUNT], NULL);
+    }
+}
+
+static void benchGetStringProperties(long count) {
+    TCHAR **propertyNames;
+    TCHAR **propertyValues;
+    long unsigned int *propertyIndices;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        if (getStringProperties(properties, TEXT("bench.list."), TEXT(""), TRUE, FALSE, &propertyNames, &propertyValues, &propertyIndices)) {
+            fprintf(stderr, "bench: getStringProperties failed.\n");
+            exit(1);
+        }
+        freeStringProperties(propertyNames, propertyValues, propertyIndices);
+    }
+}
+
+/******************************************************************************
+ * Encoding
+ *****************************************************************************/
+static void benchConvertMB(long count, const char *line) {
+    TCHAR *lineW;
+    long i;
+
+    for (i = 0; i < count; i++) {
+        if (converterMBToWide(line, MB_UTF8, &lineW, FALSE)) {
+            fprintf(stderr, "bench: converterMBToWide failed.\n");
+            exit(1);
+        }
+        free(lineW);
+    }
+}
+
+static void benchConvertMBAscii(long count) {
+    benchConvertMB(count, benchLineMB);
+}
+
+static void benchConvertMBUTF8(long count) {
+    benchConvertMB(count, benchLineUTF8MB);
+}
+
+/******************************************************************************
+ * JVM output and backend
+ *****************************************************************************/
+/**
+ * Feeds lines to wrapperReadChildOutput through a pipe standing in for the
+ *  stdout of the JVM.  Each line goes through the filters and is logged.
+ */
+static void benchReadChildOutput(long count) {
+    int fds[2];
+    char *batch;
+    size_t lineLen = strlen(benchLineMB);
+    size_t len;
+    long done;
+    long n;
+    long i;
+
+    batch = malloc((lineLen + 1) * BENCH_BATCH);
+    if (!batch) {
+        benchFail("malloc");
+    }
+    for (i = 0; i < BENCH_BATCH; i++) {
+        memcpy(batch + i * (lineLen + 1), benchLineMB, lineLen);
+        batch[i * (lineLen + 1) + lineLen] = '\n';
+    }
+    if (pipe(fds) || (fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0)) {
+        benchFail("pipe");
+    }
+    pipedes[0] = fds[0];
+    wrapperData->jvmCallType = WRAPPER_JVM_APP;
+
+    for (done = 0; done < count; done += n) {
+        n = __min(count - done, BENCH_BATCH);
+        len = (lineLen + 1) * n;
+        benchWriteAll(fds[1], batch, len);
+        wrapperReadChildOutput(0);
+    }
+
+    pipedes[0] = -1;
+    wrapperData->jvmCallType = 0;
+    close(fds[0]);
+    close(fds[1]);
+    free(batch);
+}
+
+/**
+ * Feeds packets to wrapperProtocolRead through a Unix socket standing in for
+ *  the backend.  The packets are of a code which the Wrapper reads and then
+ *  ignores, so only the reading, framing and conversion are measured.
+ */
+static void benchProtocolRead(long count, int version) {
+    int fds[2];
+    char *batch;
+    size_t payloadLen = strlen(benchLineMB);
+    size_t packetLen;
+    size_t pos = 0;
+    int backendTypeBit = wrapperData->backendTypeBit;
+    long done;
+    long n;
+    long i;
+
+    batch = malloc((payloadLen + 4) * BENCH_BATCH);
+    if (!batch) {
+        benchFail("malloc");
+    }
+    for (i = 0; i < BENCH_BATCH; i++) {
+        batch[pos++] = WRAPPER_MSG_APPEAR_ORPHAN;
+        if (version >= WRAPPER_PROTOCOL_VERSION_2) {
+            batch[pos++] = (char)((payloadLen & 0x7f) | 0x80);
+            batch[pos++] = (char)(payloadLen >> 7);
+            memcpy(batch + pos, benchLineMB, payloadLen);
+            pos += payloadLen;
+        } else {
+            memcpy(batch + pos, benchLineMB, payloadLen);
+            pos += payloadLen;
+            batch[pos++] = '\0';
+        }
+    }
+    packetLen = pos / BENCH_BATCH;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) || (fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0)) {
+        benchFail("socketpair");
+    }
+    wrapperData->backendTypeBit = WRAPPER_BACKEND_TYPE_SOCKET_UNIX;
+    protocolActiveBackendSD = fds[0];
+    protocolReadVersion = version;
+
+    for (done = 0; done < count; done += n) {
+        n = __min(count - done, BENCH_BATCH);
+        benchWriteAll(fds[1], batch, packetLen * n);
+        wrapperProtocolRead();
+    }
+
+    protocolReadVersion = WRAPPER_PROTOCOL_VERSION_1;
+    protocolActiveBackendSD = -1;
+    wrapperData->backendTypeBit = backendTypeBit;
+    close(fds[0]);
+    close(fds[1]);
+    free(batch);
+}
+
+static void benchProtocolReadV1(long count) {
+    benchProtocolRead(count, WRAPPER_PROTOCOL_VERSION_1);
+}
+
+static void benchProtocolReadV2(long count) {
+    benchProtocolRead(count, WRAPPER_PROTOCOL_VERSION_2);
+}
+
+static BenchCase benchCases[] = {
+    { "log.build_print_buffer",     "buildPrintBuffer() with the default log file format",  benchBuildPrintBuffer },
+    { "log.printf_message_file",    "log_printf_message() of a JVM line to the log file",   benchLogPrintfMessage },
+    { "filter.wildcard_match",      "wrapperWildcardMatch() of a pattern with wildcards",    benchWildcardMatch },
+    { "filter.apply",               "logApplyFilters() of a line against 8 triggers",        benchApplyFilters },
+    { "hashmap.put",                "hashMapPutKWVW() replacing one of 1000 keys",           benchHashMapPut },
+    { "hashmap.get",                "hashMapGetKWVW() of one of 1000 keys",                  benchHashMapGet },
+    { "property.get",               "getStringProperty() of one of 500 properties",          benchGetStringProperty },
+    { "property.get_list",          "getStringProperties() of a list of 20 properties",      benchGetStringProperties },
+    { "i18n.mb_to_wide_ascii",      "converterMBToWide() of an ASCII line",                  benchConvertMBAscii },
+    { "i18n.mb_to_wide_utf8",       "converterMBToWide() of a UTF-8 line",                   benchConvertMBUTF8 },
+    { "child_output.read_pipe",     "wrapperReadChildOutput() per line read from a pipe",    benchReadChildOutput },
+    { "protocol.read_v1",           "wrapperProtocolRead() per version 1 packet",            benchProtocolReadV1 },
+    { "protocol.read_v2",           "wrapperProtocolRead() per version 2 packet",            benchProtocolReadV2 }
+};
+
+#define BENCH_CASE_COUNT (int)(sizeof(benchCases) / sizeof(benchCases[0]))
+
+/**
+ * Writes the configuration, then initializes the Wrapper from it as main() does.
+ */
+static int benchInitialize(char *argv0) {
+    FILE *file;
+    TCHAR *args[3];
+    size_t req;
+    int i;
+
+    snprintf(benchDir, sizeof(benchDir), "%s/wrapper-bench-XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+    if (!mkdtemp(benchDir)) {
+        benchFail("mkdtemp");
+    }
+    snprintf(benchConfPath, sizeof(benchConfPath), "%s/bench.conf", benchDir);
+    snprintf(benchLogPath, sizeof(benchLogPath), "%s/bench.log", benchDir);
+
+    file = fopen(benchConfPath, "w");
+    if (!file) {
+        benchFail("fopen");
+    }
+    fprintf(file, "wrapper.java.mainclass=Bench\n");
+    fprintf(file, "wrapper.logfile=%s\n", benchLogPath);
+    fprintf(file, "wrapper.logfile.loglevel=INFO\n");
+    fprintf(file, "wrapper.logfile.maxsize=0\n");
+    fprintf(file, "wrapper.console.loglevel=NONE\n");
+    fprintf(file, "wrapper.syslog.loglevel=NONE\n");
+    fprintf(file, "wrapper.filter.trigger.1=java.lang.OutOfMemoryError\n");
+    fprintf(file, "wrapper.filter.trigger.2=Deadlock found\n");
+    fprintf(file, "wrapper.filter.trigger.3=Could not reserve enough space\n");
+    fprintf(file, "wrapper.filter.trigger.4=*Exception in thread*main*\n");
+    fprintf(file, "wrapper.filter.allow_wildcards.4=TRUE\n");
+    fprintf(file, "wrapper.filter.trigger.5=FATAL ERROR in native method\n");
+    fprintf(file, "wrapper.filter.trigger.6=Too many open files\n");
+    fprintf(file, "wrapper.filter.trigger.7=*Connection*refused*port ????*\n");
+    fprintf(file, "wrapper.filter.allow_wildcards.7=TRUE\n");
+    fprintf(file, "wrapper.filter.trigger.8=StackOverflowError\n");
+    for (i = 1; i <= 8; i++) {
+        fprintf(file, "wrapper.filter.action.%d=NONE\n", i);
+    }
+    for (i = 1; i <= BENCH_PROPERTY_COUNT; i++) {
+        fprintf(file, "bench.property.%d=value of property %d\n", i, i);
+    }
+    for (i = 1; i <= BENCH_LIST_COUNT; i++) {
+        fprintf(file, "bench.list.%d=value %d\n", i, i);
+    }
+    fclose(file);
+
+    setlocale(LC_ALL, "");
+    if (strcmp(nl_langinfo(CODESET), "UTF-8") != 0) {
+        /* Convert to wide characters the same way on every machine, as long as it has this locale. */
+        setlocale(LC_CTYPE, "C.UTF-8");
+    }
+    if (wrapperInitialize()) {
+        return TRUE;
+    }
+    wrapperData->wrapperPID = getpid();
+    /* Output is logged as coming from the first JVM. */
+    wrapperData->jvmRestarts = 1;
+
+    /* The same arguments as: wrapper -c <conf> */
+    req = mbstowcs(NULL, argv0, 0);
+    args[0] = malloc(sizeof(TCHAR) * (req + 1));
+    args[2] = malloc(sizeof(TCHAR) * (strlen(benchConfPath) + 1));
+    if (!args[0] || !args[2]) {
+        benchFail("malloc");
+    }
+    mbstowcs(args[0], argv0, req + 1);
+    args[1] = TEXT("-c");
+    mbstowcs(args[2], benchConfPath, strlen(benchConfPath) + 1);
+    if (!wrapperParseArguments(3, args) || loadConfigurationSettings(TRUE)) {
+        return TRUE;
+    }
+
+    mbstowcs(benchLine, benchLineMB, 256);
+    _sntprintf(benchMessage, 256, TEXT("%s"), benchLine);
+
+    benchHashMap = newHashMap(64);
+    if (!benchHashMap) {
+        return TRUE;
+    }
+    for (i = 0; i < BENCH_HASHMAP_KEYS; i++) {
+        _sntprintf(benchHashMapKeys[i], 16, TEXT("key.%d"), i);
+        hashMapPutKWVW(benchHashMap, benchHashMapKeys[i], benchLine);
+    }
+    for (i = 0; i < BENCH_PROPERTY_COUNT; i++) {
+        _sntprintf(benchPropertyNames[i], 32, TEXT("bench.property.%d"), i + 1);
+    }
+    return FALSE;
+}
+
+static void benchCleanUp() {
+    freeHashMap(benchHashMap);
+    unlink(benchLogPath);
+    unlink(benchConfPath);
+    rmdir(benchDir);
+}
+
+static int benchCompareDoubles(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return (da < db) ? -1 : (da > db) ? 1 : 0;
+}
+
+/**
+ * Finds a count which runs for about targetMs, then times repeats runs of it.
+ */
+static void benchMeasure(BenchCase *benchCase, double targetMs, int repeats, int json) {
+    double *results;
+    double start;
+    double elapsedNs;
+    long count = 1;
+    int i;
+
+    for (;;) {
+        start = benchNowNs();
+        benchCase->run(count);
+        elapsedNs = benchNowNs() - start;
+        if (elapsedNs >= BENCH_CALIBRATE_MS * 1e6) {
+            break;
+        }
+        count *= (elapsedNs < BENCH_CALIBRATE_MS * 1e5) ? 10 : 2;
+    }
+    count = (long)(count * targetMs * 1e6 / elapsedNs);
+    if (count < 1) {
+        count = 1;
+    }
+
+    results = malloc(sizeof(double) * repeats);
+    if (!results) {
+        benchFail("malloc");
+    }
+    for (i = 0; i < repeats; i++) {
+        start = benchNowNs();
+        benchCase->run(count);
+        results[i] = (benchNowNs() - start) / count;
+    }
+    qsort(results, repeats, sizeof(double), benchCompareDoubles);
+
+    if (json) {
+        printf("{\"benchmark\":\"%s\",\"version\":\"%ls\",\"iterations\":%ld,\"repeats\":%d,\"ns_per_op_min\":%.1f,\"ns_per_op_median\":%.1f,\"ops_per_sec\":%.0f}\n",
+            benchCase->name, wrapperVersionRoot, count, repeats, results[0], results[repeats / 2], 1e9 / results[repeats / 2]);
+    } else {
+        printf("%-26s %12ld %12.1f %12.1f %14.0f\n", benchCase->name, count, results[0], results[repeats / 2], 1e9 / results[repeats / 2]);
+    }
+    fflush(stdout);
+    free(results);
+}
+
+static void benchUsage(const char *argv0) {
+    int i;
+
+    printf("Usage: %s [-json] [-t <milliseconds per run>] [-r <runs>] [-f <name filter>]\n", argv0);
+    printf("\n");
+    printf("Benchmarks:\n");
+    for (i = 0; i < BENCH_CASE_COUNT; i++) {
+        printf("  %-26s %s\n", benchCases[i].name, benchCases[i].description);
+    }
+}
+
+int main(int argc, char **argv) {
+    double targetMs = 200;
+    int repeats = 5;
+    int json = FALSE;
+    const char *filter = NULL;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-json") == 0) {
+            json = TRUE;
+        } else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc)) {
+            targetMs = atof(argv[++i]);
+        } else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+            repeats = atoi(argv[++i]);
+        } else if ((strcmp(argv[i], "-f") == 0) && (i + 1 < argc)) {
+            filter = argv[++i];
+        } else {
+            benchUsage(argv[0]);
+            return 1;
+        }
+    }
+    if ((targetMs <= 0) || (repeats <= 0)) {
+        benchUsage(argv[0]);
+        return 1;
+    }
+
+    if (benchInitialize(argv[0])) {
+        fprintf(stderr, "bench: failed to initialize the Wrapper.\n");
+        return 1;
+    }
+
+    if (!json) {
+        printf("Wrapper %ls, %d runs of about %.0f ms each.\n", wrapperVersionRoot, repeats, targetMs);
+        printf("%-26s %12s %12s %12s %14s\n", "benchmark", "iterations", "min (ns)", "median (ns)", "ops/s");
+    }
+    for (i = 0; i < BENCH_CASE_COUNT; i++) {
+        if (!filter || strstr(benchCases[i].name, filter)) {
+            benchMeasure(&benchCases[i], targetMs, repeats, json);
+        }
+    }
+
+    benchCleanUp();
+    return 0;
+}
+#endif
@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Compares the transports that the JVM can use to send its log packets to
+ *  the Wrapper: the shared memory ring, a Unix-domain socket, a pipe and a
+ *  loopback TCP socket.
+ *
+ * For each transport, a child process plays the JVM and the parent plays
+ *  the Wrapper.
+ *  - Throughput: the child sends count packets of size bytes, each with its
+ *    own write as WrapperManager does.  The parent reads them the way the
+ *    Wrapper reads version 2 packets: the code, the length, then the payload.
+ *  - Latency: one packet at a time is bounced back through a second channel
+ *    of the same type while the receiving side is blocked waiting for it.
+ *
+ * This is only built on Linux:  make -f Makefile-linux-x86-64.make bench_backend
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "wrapper_i18n.h"
+#include "wrapper_ring.h"
+
+#define BENCH_CODE_LOG      (char)120
+#define BENCH_LATENCY_COUNT 20000
+#define BENCH_RING_SIZE     (1024 * 1024)
+
+typedef enum {
+    BENCH_RING = 0,
+    BENCH_SOCKET_UNIX,
+    BENCH_PIPE,
+    BENCH_SOCKET_TCP
+} BenchType;
+
+static const char *benchTypeNames[] = { "ring", "socket_unix", "pipe", "socket_tcp" };
+
+/* One direction of a transport.  Only the members of its type are used. */
+typedef struct BenchChannel BenchChannel;
+struct BenchChannel {
+    WrapperRing ring;
+    char ringPath[64];
+    int readFd;
+    int writeFd;
+};
+
+static double benchNow() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void benchFail(const char *what) {
+    fprintf(stderr, "bench_backend: %s failed: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static void benchWriteAll(int fd, const char *buffer, size_t len) {
+    ssize_t rc;
+
+    while (len > 0) {
+        rc = write(fd, buffer, len);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            benchFail("write");
+        }
+        buffer += rc;
+        len -= rc;
+    }
+}
+
+static void benchReadAll(int fd, char *buffer, size_t len) {
+    ssize_t rc;
+
+    while (len > 0) {
+        rc = read(fd, buffer, len);
+        if (rc <= 0) {
+            if ((rc < 0) && (errno == EINTR)) {
+                continue;
+            }
+            benchFail("read");
+        }
+        buffer += rc;
+        len -= rc;
+    }
+}
+
+/**
+ * Builds a version 2 packet in buffer and returns its length.
+ */
+static size_t benchEncodePacket(char *buffer, char code, const char *data, size_t len) {
+    size_t pos = 1;
+    size_t remaining = len;
+
+    buffer[0] = code;
+    while (remaining >= 0x80) {
+        buffer[pos++] = (char)((remaining & 0x7f) | 0x80);
+        remaining >>= 7;
+    }
+    buffer[pos++] = (char)remaining;
+    memcpy(buffer + pos, data, len);
+    return pos + len;
+}
+
+/**
+ * Reads one version 2 packet like wrapperProtocolRead does, and returns the length of its payload.
+ */
+static size_t benchReadPacket(int fd, char *buffer) {
+    char c;
+    size_t len = 0;
+    int shift = 0;
+
+    benchReadAll(fd, &c, 1);
+    do {
+        benchReadAll(fd, &c, 1);
+        len |= ((size_t)(c & 0x7f)) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    benchReadAll(fd, buffer, len);
+    return len;
+}
+
+static void benchOpenChannel(BenchType type, BenchChannel *channel) {
+    int fds[2];
+    int listenFd;
+    int one = 1;
+    struct sockaddr_in addrInet;
+    socklen_t addrLen;
+
+    memset(channel, 0, sizeof(BenchChannel));
+    switch (type) {
+    case BENCH_RING:
+        snprintf(channel->ringPath, sizeof(channel->ringPath), "/dev/shm/wrapper-bench-XXXXXX");
+        if (wrapperRingCreate(&(channel->ring), channel->ringPath, BENCH_RING_SIZE)) {
+            benchFail("wrapperRingCreate");
+        }
+        unlink(channel->ringPath);
+        break;
+
+    case BENCH_PIPE:
+        if (pipe(fds)) {
+            benchFail("pipe");
+        }
+        channel->readFd = fds[0];
+        channel->writeFd = fds[1];
+        break;
+
+    case BENCH_SOCKET_UNIX:
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+            benchFail("socketpair");
+        }
+        channel->readFd = fds[0];
+        channel->writeFd = fds[1];
+        break;
+
+    case BENCH_SOCKET_TCP:
+        memset(&addrInet, 0, sizeof(addrInet));
+        addrInet.sin_family = AF_INET;
+        addrInet.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addrLen = sizeof(addrInet);
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if ((listenFd < 0) || bind(listenFd, (struct sockaddr *)&addrInet, addrLen) || getsockname(listenFd, (struct sockaddr *)&addrInet, &addrLen) || listen(listenFd, 1)) {
+            benchFail("listen");
+        }
+        channel->writeFd = socket(AF_INET, SOCK_STREAM, 0);
+        if ((channel->writeFd < 0) || connect(channel->writeFd, (struct sockaddr *)&addrInet, addrLen)) {
+            benchFail("connect");
+        }
+        channel->readFd = accept(listenFd, NULL, NULL);
+        if (channel->readFd < 0) {
+            benchFail("accept");
+        }
+        close(listenFd);
+        /* WrapperManager disables Nagle's algorithm on its side of the backend. */
+        setsockopt(channel->readFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        setsockopt(channel->writeFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        break;
+    }
+}
+
+static void benchCloseChannel(BenchType type, BenchChannel *channel) {
+    if (type == BENCH_RING) {
+        wrapperRingDetach(&(channel->ring));
+    } else {
+        close(channel->readFd);
+        if (channel->writeFd != channel->readFd) {
+            close(channel->writeFd);
+        }
+    }
+}
+
+static void benchSend(BenchType type, BenchChannel *channel, char *packet, const char *data, size_t len) {
+    size_t packetLen;
+
+    if (type == BENCH_RING) {
+        /* WrapperManager falls back to the backend when the ring is full.  Here, just wait for space. */
+        while (wrapperRingWrite(&(channel->ring), BENCH_CODE_LOG, data, len)) {
+            sched_yield();
+        }
+    } else {
+        packetLen = benchEncodePacket(packet, BENCH_CODE_LOG, data, len);
+        benchWriteAll(channel->writeFd, packet, packetLen);
+    }
+}
+
+/**
+ * Receives one packet, blocking until it arrives, and returns the length of its payload.
+ */
+static size_t benchReceive(BenchType type, BenchChannel *channel, char *buffer) {
+    char code;
+    const char *data;
+    size_t len;
+    struct pollfd pfd;
+
+    if (type == BENCH_RING) {
+        while (wrapperRingPeek(&(channel->ring), &code, &data, &len)) {
+            wrapperRingWait(&(channel->ring), 1000);
+        }
+        /* The Wrapper converts the payload in place, so copy it to get a comparable amount of work. */
+        memcpy(buffer, data, len);
+        wrapperRingRelease(&(channel->ring));
+        return len;
+    } else {
+        pfd.fd = channel->readFd;
+        pfd.events = POLLIN;
+        while (poll(&pfd, 1, 1000) == 0) {
+        }
+        return benchReadPacket(channel->readFd, buffer);
+    }
+}
+
+static void benchRun(BenchType type, long count, size_t size) {
+    BenchChannel toWrapper;
+    BenchChannel toJVM;
+    char *payload;
+    char *packet;
+    char *buffer;
+    pid_t pid;
+    long i;
+    double start;
+    double throughputSecs;
+    double latencySecs;
+    size_t total = 0;
+
+    payload = malloc(size);
+    packet = malloc(size + 6);
+    buffer = malloc(size + 1);
+    if (!payload || !packet || !buffer) {
+        benchFail("malloc");
+    }
+    memset(payload, 'x', size);
+
+    benchOpenChannel(type, &toWrapper);
+    benchOpenChannel(type, &toJVM);
+
+    pid = fork();
+    if (pid < 0) {
+        benchFail("fork");
+    } else if (pid == 0) {
+        /* The JVM. */
+        for (i = 0; i < count; i++) {
+            benchSend(type, &toWrapper, packet, payload, size);
+        }
+        for (i = 0; i < BENCH_LATENCY_COUNT; i++) {
+            benchReceive(type, &toJVM, buffer);
+            benchSend(type, &toWrapper, packet, payload, size);
+        }
+        _exit(0);
+    }
+
+    /* The Wrapper. */
+    start = benchNow();
+    for (i = 0; i < count; i++) {
+        total += benchReceive(type, &toWrapper, buffer);
+    }
+    throughputSecs = benchNow() - start;
+
+    start = benchNow();
+    for (i = 0; i < BENCH_LATENCY_COUNT; i++) {
+        benchSend(type, &toJVM, packet, payload, size);
+        benchReceive(type, &toWrapper, buffer);
+    }
+    latencySecs = benchNow() - start;
+
+    waitpid(pid, NULL, 0);
+    benchCloseChannel(type, &toWrapper);
+    benchCloseChannel(type, &toJVM);
+    free(payload);
+    free(packet);
+    free(buffer);
+
+    printf("%-12s %12.0f %10.1f %12.2f\n", benchTypeNames[type],
+        count / throughputSecs, total / throughputSecs / (1024 * 1024), latencySecs / BENCH_LATENCY_COUNT * 1e6);
+}
+
+int main(int argc, char **argv) {
+    long count = 1000000;
+    size_t size = 128;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+            count = atol(argv[++i]);
+        } else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc)) {
+            size = (size_t)atol(argv[++i]);
+        } else {
+            printf("Usage: %s [-n <packet count>] [-s <payload size>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((count <= 0) || (size == 0) || (size > BENCH_RING_SIZE / 4)) {
+        printf("Invalid packet count or payload size.\n");
+        return 1;
+    }
+
+    printf("%ld packets of %d bytes, round trip over %d packets.\n", count, (int)size, BENCH_LATENCY_COUNT);
+    printf("%-12s %12s %10s %12s\n", "transport", "packets/s", "MB/s", "RTT (us)");
+    for (i = BENCH_RING; i <= BENCH_SOCKET_TCP; i++) {
+        benchRun((BenchType)i, count, size);
+    }
+    return 0;
+}
+#endif
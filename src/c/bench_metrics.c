@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Measures what the counters of the metrics endpoint cost on the hot paths.
+ *
+ * Each thread plays the thread which reads the output of the JVM: it scans
+ *  lines for their LF, as wrapperReadChildOutput does, and counts the lines
+ *  and bytes.  This is run with the counters disabled, enabled, enabled
+ *  while another thread scrapes them continuously, and finally with the
+ *  counters of all threads packed together rather than on their own cache
+ *  line, to show what the padding saves.
+ *
+ * This is only built on Linux:  make -f Makefile-linux-x86-64.make bench_metrics
+ */
+
+#ifdef LINUX
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wrapper_i18n.h"
+#include "wrapper_metrics.h"
+
+#define BENCH_LINE_SIZE     100
+#define BENCH_LINE_COUNT    64
+
+typedef enum {
+    BENCH_DISABLED = 0,
+    BENCH_ENABLED,
+    BENCH_SCRAPED,
+    BENCH_PACKED
+} BenchMode;
+
+static const char *benchModeNames[] = { "disabled", "enabled", "enabled+scrape", "packed" };
+
+typedef struct BenchThread BenchThread;
+struct BenchThread {
+    pthread_t thread;
+    int threadId;
+    long count;
+    BenchMode mode;
+};
+
+/* The lines and bytes counters of all threads side by side, as they would be without the padding. */
+static volatile double benchPacked[WRAPPER_THREAD_COUNT][2];
+
+static volatile int benchScraping;
+static volatile double benchSink;
+
+static double benchNow() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *benchWorker(void *arg) {
+    BenchThread *bench = (BenchThread *)arg;
+    char lines[BENCH_LINE_COUNT * BENCH_LINE_SIZE];
+    const char *lf;
+    long i;
+    size_t found = 0;
+
+    memset(lines, 'x', sizeof(lines));
+    for (i = 0; i < BENCH_LINE_COUNT; i++) {
+        lines[i * BENCH_LINE_SIZE + BENCH_LINE_SIZE - 1] = '\n';
+    }
+
+    for (i = 0; i < bench->count; i++) {
+        lf = memchr(lines + (i % BENCH_LINE_COUNT) * BENCH_LINE_SIZE, '\n', BENCH_LINE_SIZE);
+        found += (size_t)(lf - lines);
+        if (bench->mode == BENCH_PACKED) {
+            benchPacked[bench->threadId][0] += 1;
+            benchPacked[bench->threadId][1] += BENCH_LINE_SIZE;
+        } else {
+            WRAPPER_METRICS_ADD(bench->threadId, WRAPPER_METRIC_JVM_OUTPUT_LINES, 1);
+            WRAPPER_METRICS_ADD(bench->threadId, WRAPPER_METRIC_JVM_OUTPUT_BYTES, BENCH_LINE_SIZE);
+        }
+    }
+    benchSink += (double)found;
+    return NULL;
+}
+
+static void *benchScraper(void *arg) {
+    int i;
+    double total;
+
+    while (benchScraping) {
+        total = 0;
+        for (i = 0; i < WRAPPER_METRIC_COUNT; i++) {
+            total += wrapperMetricsGet(i);
+        }
+        benchSink = total;
+    }
+    return NULL;
+}
+
+static void benchRun(BenchMode mode, int threads, long count) {
+    BenchThread benches[WRAPPER_THREAD_COUNT];
+    pthread_t scraper;
+    double start;
+    double secs;
+    int i;
+
+    wrapperMetricsSetEnabled((mode == BENCH_ENABLED) || (mode == BENCH_SCRAPED));
+    memset((void *)benchPacked, 0, sizeof(benchPacked));
+    if (mode == BENCH_SCRAPED) {
+        benchScraping = TRUE;
+        pthread_create(&scraper, NULL, benchScraper, NULL);
+    }
+
+    start = benchNow();
+    for (i = 0; i < threads; i++) {
+        benches[i].threadId = i;
+        benches[i].count = count;
+        benches[i].mode = mode;
+        pthread_create(&benches[i].thread, NULL, benchWorker, &benches[i]);
+    }
+    for (i = 0; i < threads; i++) {
+        pthread_join(benches[i].thread, NULL);
+    }
+    secs = benchNow() - start;
+
+    if (mode == BENCH_SCRAPED) {
+        benchScraping = FALSE;
+        pthread_join(scraper, NULL);
+    }
+    if ((mode == BENCH_ENABLED) && (wrapperMetricsGet(WRAPPER_METRIC_JVM_OUTPUT_LINES) != (double)count * threads)) {
+        printf("Lost counts: %.0f\n", wrapperMetricsGet(WRAPPER_METRIC_JVM_OUTPUT_LINES));
+    }
+
+    printf("%-16s %8d %14.0f %10.2f\n", benchModeNames[mode], threads, (double)count * threads / secs, secs / count * 1e9);
+}
+
+int main(int argc, char **argv) {
+    long count = 20000000;
+    int threads;
+    int mode;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+            count = atol(argv[++i]);
+        } else {
+            printf("Usage: %s [-n <lines per thread>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (count <= 0) {
+        printf("Invalid line count.\n");
+        return 1;
+    }
+
+    printf("%ld lines of %d bytes per thread.\n", count, BENCH_LINE_SIZE);
+    printf("%-16s %8s %14s %10s\n", "counters", "threads", "lines/s", "ns/line");
+    for (threads = 1; threads <= 4; threads *= 2) {
+        for (mode = BENCH_DISABLED; mode <= BENCH_PACKED; mode++) {
+            benchRun((BenchMode)mode, threads, count);
+        }
+    }
+    return 0;
+}
+#endif
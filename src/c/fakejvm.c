@@ -0,0 +1,789 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * A native stand-in for the JVM, used to measure the throughput, latency and
+ *  restart cycles of the Wrapper without the noise of a real JVM.
+ *
+ * Point wrapper.java.command at it.  It speaks the Wrapper side of the backend
+ *  protocol as WrapperManager does: it connects to the backend (pipe, Unix
+ *  socket or TCP socket), optionally negotiates version 2 of the protocol,
+ *  sends its KEY, answers START with STARTED, bounces PINGs back and answers
+ *  STOP with STOPPED.  Once started, it generates load as configured with the
+ *  following system properties (wrapper.java.additional.<n>=-D...):
+ *
+ *  fakejvm.stdout.rate           Lines per second written to stdout. (0)
+ *  fakejvm.stdout.burst          Lines written together in a single write. (1)
+ *  fakejvm.log.rate              LOG packets per second sent on the backend. (0)
+ *  fakejvm.log.burst             LOG packets sent together in a single write. (1)
+ *  fakejvm.log.level             Level of the LOG packets. (INFO)
+ *  fakejvm.length.distribution   FIXED, UNIFORM or EXPONENTIAL. (FIXED)
+ *  fakejvm.length.min            Shortest line or LOG payload. (20)
+ *  fakejvm.length.max            Longest line or LOG payload. (200)
+ *  fakejvm.length.mean           Length for FIXED, mean for EXPONENTIAL. (80)
+ *  fakejvm.ping.delay            Milliseconds before a PING is answered. (0)
+ *  fakejvm.ping.jitter           Random milliseconds added to the delay. (0)
+ *  fakejvm.start.delay           Milliseconds between START and STARTED. (0)
+ *  fakejvm.stop.delay            Milliseconds between STOP and STOPPED. (0)
+ *  fakejvm.exit.delay            Milliseconds between STOPPED and the exit. (100)
+ *  fakejvm.run                   Milliseconds after STARTED before the run action. (0 = forever)
+ *  fakejvm.run.action            STOP or RESTART, requested of the Wrapper. (STOP)
+ *  fakejvm.crash                 Milliseconds after START before crashing. (0 = never)
+ *  fakejvm.crash.mode            EXIT, KILL (SIGKILL itself) or HANG (stop reading and answering). (EXIT)
+ *  fakejvm.exit_code             Exit code reported in STOP/STOPPED, or used by a crash. (0, 1 for a crash)
+ *  fakejvm.protocol              Backend protocol version to use, up to the one offered. (offered)
+ *  fakejvm.seed                  Seed of the random numbers, so runs are repeatable. (1)
+ *
+ * It also answers -version and the bootstrap invocation, but the simplest is to
+ *  set wrapper.java.detect_bootstrap=false.  When it exits, it prints a line
+ *  with what it sent and answered.
+ *
+ * This is only built on Linux:  make -f Makefile-linux-x86-64.make fakejvm
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "wrapper_i18n.h"
+#include "wrapperinfo.h"
+
+#define FAKE_MSG_START          (char)100
+#define FAKE_MSG_STOP           (char)101
+#define FAKE_MSG_RESTART        (char)102
+#define FAKE_MSG_PING           (char)103
+#define FAKE_MSG_STARTED        (char)106
+#define FAKE_MSG_STOPPED        (char)107
+#define FAKE_MSG_KEY            (char)110
+#define FAKE_MSG_BADKEY         (char)111
+#define FAKE_MSG_LOG            (char)117
+#define FAKE_MSG_PROTOCOL       (char)148
+
+#define FAKE_PING_QUEUE_SIZE    256
+#define FAKE_PING_MAX_LEN       64
+#define FAKE_MAX_LENGTH         65536
+#define FAKE_MAX_BURST          10000
+/* Bursts sent in one loop before the backend is checked again, so pings are still read when the load can't keep up. */
+#define FAKE_MAX_BURSTS_PER_LOOP 64
+
+#define FAKE_LENGTH_FIXED       0
+#define FAKE_LENGTH_UNIFORM     1
+#define FAKE_LENGTH_EXPONENTIAL 2
+
+#define FAKE_CRASH_EXIT         0
+#define FAKE_CRASH_KILL         1
+#define FAKE_CRASH_HANG         2
+
+typedef struct FakePing FakePing;
+struct FakePing {
+    double dueMs;
+    size_t len;
+    char payload[FAKE_PING_MAX_LEN];
+};
+
+/* A stream of lines or LOG packets, sent in bursts at a steady rate. */
+typedef struct FakeLoad FakeLoad;
+struct FakeLoad {
+    double rate;
+    int burst;
+    double nextMs;
+    double count;
+};
+
+static int fakeArgc;
+static char **fakeArgv;
+
+static int backendReadFd = -1;
+static int backendWriteFd = -1;
+static int readVersion = 1;
+static int writeVersion = 1;
+
+static char *readBuffer;
+static size_t readBufferSize;
+static size_t readBufferLen;
+static char *writeBuffer;
+static size_t writeBufferSize;
+static char *lineBuffer;
+
+static FakePing pingQueue[FAKE_PING_QUEUE_SIZE];
+static int pingQueueCount;
+
+static unsigned long long randomState;
+
+static int lengthDistribution;
+static int lengthMin;
+static int lengthMax;
+static int lengthMean;
+static int pingDelay;
+static int pingJitter;
+static int exitCode;
+
+static double pingsAnswered;
+static double bytesWritten;
+
+static double fakeNowMs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void fakeFail(const char *what) {
+    fprintf(stderr, "fakejvm: %s failed: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+/**
+ * Returns the value of a -D system property on the command line, or NULL.
+ */
+static const char *fakeProperty(const char *name) {
+    size_t len = strlen(name);
+    int i;
+
+    for (i = 1; i < fakeArgc; i++) {
+        if ((strncmp(fakeArgv[i], "-D", 2) == 0) && (strncmp(fakeArgv[i] + 2, name, len) == 0) && (fakeArgv[i][2 + len] == '=')) {
+            return fakeArgv[i] + 2 + len + 1;
+        }
+    }
+    return NULL;
+}
+
+static int fakeIntProperty(const char *name, int defaultValue, int min, int max) {
+    const char *value = fakeProperty(name);
+    int i;
+
+    if (!value) {
+        return defaultValue;
+    }
+    i = atoi(value);
+    if (i < min) {
+        return min;
+    } else if (i > max) {
+        return max;
+    }
+    return i;
+}
+
+static int fakeHasArg(const char *arg) {
+    int i;
+
+    for (i = 1; i < fakeArgc; i++) {
+        if (strcmp(fakeArgv[i], arg) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * xorshift64*, so a given seed always produces the same run.
+ */
+static double fakeRandom() {
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (double)((randomState * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static int fakeNextLength() {
+    double len;
+
+    switch (lengthDistribution) {
+    case FAKE_LENGTH_UNIFORM:
+        return lengthMin + (int)(fakeRandom() * (lengthMax - lengthMin + 1));
+
+    case FAKE_LENGTH_EXPONENTIAL:
+        /* Mostly short lines with a long tail, like real application output. */
+        len = lengthMin - (lengthMean - lengthMin) * log(1.0 - fakeRandom());
+        return (len > lengthMax) ? lengthMax : (int)len;
+
+    default:
+        return lengthMean;
+    }
+}
+
+/**
+ * Fills lineBuffer with len characters numbered with seq, so consecutive lines never repeat.
+ */
+static void fakeFillLine(int len, double seq) {
+    static const char filler[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    int pos;
+
+    pos = snprintf(lineBuffer, len + 1, "fakejvm %.0f ", seq);
+    if (pos > len) {
+        pos = len;
+    }
+    for (; pos < len; pos++) {
+        lineBuffer[pos] = filler[pos % (sizeof(filler) - 1)];
+    }
+}
+
+static void fakeWriteAll(int fd, const char *buffer, size_t len) {
+    ssize_t rc;
+
+    bytesWritten += len;
+    while (len > 0) {
+        rc = write(fd, buffer, len);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* The Wrapper went away.  A real JVM would be killed soon anyway. */
+            exit(1);
+        }
+        buffer += rc;
+        len -= rc;
+    }
+}
+
+/**
+ * Appends a packet with the framing currently used for writing to writeBuffer and returns the new length.
+ */
+static size_t fakeEncodePacket(size_t pos, char code, const char *data, size_t len) {
+    size_t remaining = len;
+
+    writeBuffer[pos++] = code;
+    if (writeVersion == 1) {
+        memcpy(writeBuffer + pos, data, len);
+        pos += len;
+        writeBuffer[pos++] = '\0';
+    } else {
+        while (remaining >= 0x80) {
+            writeBuffer[pos++] = (char)((remaining & 0x7f) | 0x80);
+            remaining >>= 7;
+        }
+        writeBuffer[pos++] = (char)remaining;
+        memcpy(writeBuffer + pos, data, len);
+        pos += len;
+    }
+    return pos;
+}
+
+static void fakeSendPacket(char code, const char *data, size_t len) {
+    fakeWriteAll(backendWriteFd, writeBuffer, fakeEncodePacket(0, code, data, len));
+}
+
+static void fakeSendString(char code, const char *data) {
+    fakeSendPacket(code, data, strlen(data));
+}
+
+static void fakeSendExitCode(char code) {
+    char buffer[16];
+
+    snprintf(buffer, sizeof(buffer), "%d", exitCode);
+    fakeSendString(code, buffer);
+}
+
+static void fakeConnectBackend() {
+    const char *backend = fakeProperty("wrapper.backend");
+    const char *value;
+    const char *address;
+    struct sockaddr_un addrUnix;
+    struct addrinfo hints;
+    struct addrinfo *addrs;
+    int fd;
+
+    if (backend && (strcmp(backend, "pipe") == 0)) {
+        /* The Wrapper passes the inherited ends of its two pipes. */
+        value = fakeProperty("wrapper.pipe.in");
+        backendWriteFd = value ? atoi(value) : -1;
+        value = fakeProperty("wrapper.pipe.out");
+        backendReadFd = value ? atoi(value) : -1;
+        if ((backendReadFd < 0) || (backendWriteFd < 0)) {
+            errno = EINVAL;
+            fakeFail("pipe backend");
+        }
+        return;
+    }
+
+    if (backend && (strcmp(backend, "socket_unix") == 0)) {
+        value = fakeProperty("wrapper.backend.path");
+        if (!value || (strlen(value) >= sizeof(addrUnix.sun_path))) {
+            errno = EINVAL;
+            fakeFail("socket_unix backend");
+        }
+        memset(&addrUnix, 0, sizeof(addrUnix));
+        addrUnix.sun_family = AF_UNIX;
+        strncpy(addrUnix.sun_path, value, sizeof(addrUnix.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ((fd < 0) || connect(fd, (struct sockaddr *)&addrUnix, sizeof(addrUnix))) {
+            fakeFail("connect");
+        }
+    } else {
+        value = fakeProperty("wrapper.port");
+        if (!value) {
+            errno = EINVAL;
+            fakeFail("socket backend");
+        }
+        address = fakeProperty("wrapper.port.address");
+        if (!address) {
+            address = (backend && (strcmp(backend, "socket_ipv6") == 0)) ? "::1" : "127.0.0.1";
+        }
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(address, value, &hints, &addrs)) {
+            errno = EINVAL;
+            fakeFail("getaddrinfo");
+        }
+        fd = socket(addrs->ai_family, SOCK_STREAM, 0);
+        if ((fd < 0) || connect(fd, addrs->ai_addr, addrs->ai_addrlen)) {
+            fakeFail("connect");
+        }
+        freeaddrinfo(addrs);
+    }
+    backendReadFd = fd;
+    backendWriteFd = fd;
+}
+
+/**
+ * Looks for a complete packet at the start of readBuffer.  Returns the length of the whole
+ *  packet, or 0 if more data is needed.  The payload is null terminated in place.
+ */
+static size_t fakeParsePacket(char *code, char **payload) {
+    size_t i;
+    size_t len = 0;
+    int shift = 0;
+
+    if (readBufferLen < 2) {
+        return 0;
+    }
+    *code = readBuffer[0];
+    if (readVersion == 1) {
+        for (i = 1; i < readBufferLen; i++) {
+            if (readBuffer[i] == '\0') {
+                *payload = readBuffer + 1;
+                return i + 1;
+            }
+        }
+        return 0;
+    }
+
+    i = 1;
+    do {
+        if (i >= readBufferLen) {
+            return 0;
+        }
+        len |= ((size_t)(readBuffer[i] & 0x7f)) << shift;
+        shift += 7;
+    } while (readBuffer[i++] & 0x80);
+    if (i + len + 1 > readBufferSize) {
+        readBufferSize = i + len + 1;
+        readBuffer = realloc(readBuffer, readBufferSize);
+        if (!readBuffer) {
+            fakeFail("realloc");
+        }
+    }
+    if (readBufferLen < i + len) {
+        return 0;
+    }
+    *payload = readBuffer + i;
+    return i + len;
+}
+
+static void fakeQueuePing(const char *payload, double nowMs) {
+    FakePing *ping;
+    size_t len = strlen(payload);
+    int delay;
+
+    delay = pingDelay;
+    if (pingJitter > 0) {
+        delay += (int)(fakeRandom() * (pingJitter + 1));
+    }
+    if ((delay <= 0) || (pingQueueCount >= FAKE_PING_QUEUE_SIZE) || (len >= FAKE_PING_MAX_LEN)) {
+        fakeSendPacket(FAKE_MSG_PING, payload, len);
+        pingsAnswered++;
+        return;
+    }
+    ping = &pingQueue[pingQueueCount++];
+    ping->dueMs = nowMs + delay;
+    ping->len = len;
+    memcpy(ping->payload, payload, len);
+}
+
+/**
+ * Answers the queued pings which are due, in the order they were received, and returns when the next one is due.
+ */
+static double fakeAnswerPings(double nowMs) {
+    int i;
+
+    while ((pingQueueCount > 0) && (pingQueue[0].dueMs <= nowMs)) {
+        fakeSendPacket(FAKE_MSG_PING, pingQueue[0].payload, pingQueue[0].len);
+        pingsAnswered++;
+        pingQueueCount--;
+        for (i = 0; i < pingQueueCount; i++) {
+            pingQueue[i] = pingQueue[i + 1];
+        }
+    }
+    return (pingQueueCount > 0) ? pingQueue[0].dueMs : 0;
+}
+
+/**
+ * Writes the lines or packets of a load which are due, and returns when the next burst is due.
+ */
+static double fakeRunLoad(FakeLoad *load, int isLog, char logCode, double nowMs) {
+    int bursts = 0;
+    int i;
+    int len;
+    size_t pos;
+
+    if (load->rate <= 0) {
+        return 0;
+    }
+    if (load->nextMs == 0) {
+        load->nextMs = nowMs;
+    }
+    while ((load->nextMs <= nowMs) && (bursts < FAKE_MAX_BURSTS_PER_LOOP)) {
+        pos = 0;
+        for (i = 0; i < load->burst; i++) {
+            len = fakeNextLength();
+            fakeFillLine(len, load->count++);
+            if (isLog) {
+                pos = fakeEncodePacket(pos, logCode, lineBuffer, len);
+            } else {
+                memcpy(writeBuffer + pos, lineBuffer, len);
+                pos += len;
+                writeBuffer[pos++] = '\n';
+            }
+        }
+        fakeWriteAll(isLog ? backendWriteFd : STDOUT_FILENO, writeBuffer, pos);
+        load->nextMs += 1000.0 * load->burst / load->rate;
+        bursts++;
+    }
+    return load->nextMs;
+}
+
+static double fakeEarliest(double a, double b) {
+    if (a == 0) {
+        return b;
+    } else if ((b == 0) || (a < b)) {
+        return a;
+    }
+    return b;
+}
+
+static void fakeCrash(int mode) {
+    printf("fakejvm: %s.\n", (mode == FAKE_CRASH_HANG) ? "hanging" : "crashing");
+    fflush(stdout);
+    if (mode == FAKE_CRASH_KILL) {
+        kill(getpid(), SIGKILL);
+    } else if (mode == FAKE_CRASH_HANG) {
+        /* Like a frozen JVM: still alive, but silent. */
+        for (;;) {
+            pause();
+        }
+    }
+    _exit(exitCode);
+}
+
+static int fakeLogCode(const char *level) {
+    static const char *levels[] = { "DEBUG", "INFO", "STATUS", "WARN", "ERROR", "FATAL" };
+    int i;
+
+    for (i = 0; i < 6; i++) {
+        if (level && (strcasecmp(level, levels[i]) == 0)) {
+            return FAKE_MSG_LOG + 1 + i;
+        }
+    }
+    return FAKE_MSG_LOG + 2;
+}
+
+int main(int argc, char **argv) {
+    const char *value;
+    const char *key;
+    char code;
+    char next;
+    char *payload;
+    size_t packetLen;
+    ssize_t rc;
+    char logCode;
+    int offered;
+    int protocol;
+    int startDelay;
+    int stopDelay;
+    int exitDelay;
+    int runMs;
+    int runRestart;
+    int crashMs;
+    int crashMode;
+    int maxLength;
+    int maxBurst;
+    int started = FALSE;
+    int stopping = FALSE;
+    double startMs = 0;
+    double startedDueMs = 0;
+    double runDueMs = 0;
+    double crashDueMs = 0;
+    double stoppedDueMs = 0;
+    double launchMs;
+    double nowMs;
+    double nextMs;
+    int timeout;
+    FakeLoad stdoutLoad;
+    FakeLoad logLoad;
+    struct pollfd pfd;
+
+    fakeArgc = argc;
+    fakeArgv = argv;
+    launchMs = fakeNowMs();
+
+    if (fakeHasArg("--dry-run")) {
+        return 0;
+    }
+    if (fakeHasArg("-version")) {
+        fprintf(stderr, "openjdk version \"17.0.2\" 2022-01-18\nOpenJDK 64-Bit Server VM (build 17.0.2+8, mixed mode)\n");
+        return 0;
+    }
+    key = fakeProperty("wrapper.key");
+    if (!key) {
+        /* Launched to run the WrapperBootstrap class. */
+        printf("WrapperBootstrap: wrapper_version: %ls\n", wrapperVersionRoot);
+        printf("WrapperBootstrap: mainclass: found\n");
+        return 0;
+    }
+
+    memset(&stdoutLoad, 0, sizeof(stdoutLoad));
+    memset(&logLoad, 0, sizeof(logLoad));
+    stdoutLoad.rate = fakeIntProperty("fakejvm.stdout.rate", 0, 0, 100000000);
+    stdoutLoad.burst = fakeIntProperty("fakejvm.stdout.burst", 1, 1, FAKE_MAX_BURST);
+    logLoad.rate = fakeIntProperty("fakejvm.log.rate", 0, 0, 100000000);
+    logLoad.burst = fakeIntProperty("fakejvm.log.burst", 1, 1, FAKE_MAX_BURST);
+    logCode = (char)fakeLogCode(fakeProperty("fakejvm.log.level"));
+
+    value = fakeProperty("fakejvm.length.distribution");
+    if (value && (strcasecmp(value, "UNIFORM") == 0)) {
+        lengthDistribution = FAKE_LENGTH_UNIFORM;
+    } else if (value && (strcasecmp(value, "EXPONENTIAL") == 0)) {
+        lengthDistribution = FAKE_LENGTH_EXPONENTIAL;
+    } else {
+        lengthDistribution = FAKE_LENGTH_FIXED;
+    }
+    lengthMin = fakeIntProperty("fakejvm.length.min", 20, 0, FAKE_MAX_LENGTH);
+    lengthMax = fakeIntProperty("fakejvm.length.max", 200, lengthMin, FAKE_MAX_LENGTH);
+    lengthMean = fakeIntProperty("fakejvm.length.mean", 80, 0, FAKE_MAX_LENGTH);
+
+    pingDelay = fakeIntProperty("fakejvm.ping.delay", 0, 0, 3600000);
+    pingJitter = fakeIntProperty("fakejvm.ping.jitter", 0, 0, 3600000);
+    startDelay = fakeIntProperty("fakejvm.start.delay", 0, 0, 3600000);
+    stopDelay = fakeIntProperty("fakejvm.stop.delay", 0, 0, 3600000);
+    exitDelay = fakeIntProperty("fakejvm.exit.delay", 100, 0, 3600000);
+    runMs = fakeIntProperty("fakejvm.run", 0, 0, 2147483647);
+    value = fakeProperty("fakejvm.run.action");
+    runRestart = value && (strcasecmp(value, "RESTART") == 0);
+    crashMs = fakeIntProperty("fakejvm.crash", 0, 0, 2147483647);
+    value = fakeProperty("fakejvm.crash.mode");
+    if (value && (strcasecmp(value, "KILL") == 0)) {
+        crashMode = FAKE_CRASH_KILL;
+    } else if (value && (strcasecmp(value, "HANG") == 0)) {
+        crashMode = FAKE_CRASH_HANG;
+    } else {
+        crashMode = FAKE_CRASH_EXIT;
+    }
+    exitCode = fakeIntProperty("fakejvm.exit_code", (crashMs > 0) ? 1 : 0, 0, 255);
+    randomState = (unsigned long long)fakeIntProperty("fakejvm.seed", 1, 1, 2147483647) * 0x9E3779B97F4A7C15ULL;
+
+    /* The largest write is a burst of the longest payloads, each with its packet header. */
+    maxLength = (lengthDistribution == FAKE_LENGTH_FIXED) ? lengthMean : lengthMax;
+    maxBurst = (stdoutLoad.burst > logLoad.burst) ? stdoutLoad.burst : logLoad.burst;
+    writeBufferSize = (size_t)maxBurst * (maxLength + 6) + FAKE_PING_MAX_LEN + 16;
+    writeBuffer = malloc(writeBufferSize);
+    lineBuffer = malloc(maxLength + 32);
+    readBufferSize = 65536;
+    readBuffer = malloc(readBufferSize);
+    if (!writeBuffer || !lineBuffer || !readBuffer) {
+        fakeFail("malloc");
+    }
+
+    fakeConnectBackend();
+
+    value = fakeProperty("wrapper.backend.protocol");
+    offered = value ? atoi(value) : 1;
+    protocol = fakeIntProperty("fakejvm.protocol", offered, 1, offered);
+    if (protocol >= 2) {
+        /* Sent with the old framing.  Our following packets use the new one, the Wrapper's once it acknowledges. */
+        fakeSendString(FAKE_MSG_PROTOCOL, "2 0");
+        writeVersion = 2;
+    }
+    fakeSendString(FAKE_MSG_KEY, key);
+
+    pfd.fd = backendReadFd;
+    pfd.events = POLLIN;
+    for (;;) {
+        nowMs = fakeNowMs();
+
+        /* Work out what is due, and when the next thing is. */
+        nextMs = fakeAnswerPings(nowMs);
+        if (crashDueMs != 0) {
+            if (crashDueMs <= nowMs) {
+                fakeCrash(crashMode);
+            }
+            nextMs = fakeEarliest(nextMs, crashDueMs);
+        }
+        if (stoppedDueMs != 0) {
+            if (stoppedDueMs <= nowMs) {
+                fakeSendExitCode(FAKE_MSG_STOPPED);
+                /* A real JVM takes a while to exit after STOPPED.  Exiting at once could let the Wrapper
+                 *  see the exit before it reads the packet, and report a crash. */
+                poll(NULL, 0, exitDelay);
+                break;
+            }
+            nextMs = fakeEarliest(nextMs, stoppedDueMs);
+        }
+        if (startedDueMs != 0) {
+            if (startedDueMs <= nowMs) {
+                fakeSendPacket(FAKE_MSG_STARTED, "", 0);
+                startedDueMs = 0;
+                started = TRUE;
+                if (runMs > 0) {
+                    runDueMs = nowMs + runMs;
+                }
+            } else {
+                nextMs = fakeEarliest(nextMs, startedDueMs);
+            }
+        }
+        if (started && !stopping) {
+            if ((runDueMs != 0) && (runDueMs <= nowMs)) {
+                runDueMs = 0;
+                if (runRestart) {
+                    /* The Wrapper will answer with a STOP. */
+                    fakeSendPacket(FAKE_MSG_RESTART, "", 0);
+                } else {
+                    /* As WrapperManager.stop() does, the Wrapper sends nothing more after this. */
+                    fakeSendExitCode(FAKE_MSG_STOP);
+                    stopping = TRUE;
+                    stoppedDueMs = nowMs + stopDelay;
+                    continue;
+                }
+            }
+            nextMs = fakeEarliest(nextMs, runDueMs);
+            nextMs = fakeEarliest(nextMs, fakeRunLoad(&stdoutLoad, FALSE, 0, nowMs));
+            nextMs = fakeEarliest(nextMs, fakeRunLoad(&logLoad, TRUE, logCode, nowMs));
+        }
+
+        if (nextMs == 0) {
+            timeout = -1;
+        } else {
+            nowMs = fakeNowMs();
+            timeout = (nextMs <= nowMs) ? 0 : (int)(nextMs - nowMs + 0.999);
+        }
+        rc = poll(&pfd, 1, timeout);
+        if ((rc < 0) && (errno != EINTR)) {
+            fakeFail("poll");
+        }
+        if ((rc <= 0) || !(pfd.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+
+        /* Always keep a spare byte, for the terminator of the last packet in the buffer. */
+        if (readBufferLen + 1 >= readBufferSize) {
+            readBufferSize *= 2;
+            readBuffer = realloc(readBuffer, readBufferSize);
+            if (!readBuffer) {
+                fakeFail("realloc");
+            }
+        }
+        rc = read(backendReadFd, readBuffer + readBufferLen, readBufferSize - readBufferLen - 1);
+        if (rc <= 0) {
+            if ((rc < 0) && (errno == EINTR)) {
+                continue;
+            }
+            /* The Wrapper closed the backend, so it is gone or about to kill us. */
+            return 1;
+        }
+        readBufferLen += rc;
+
+        nowMs = fakeNowMs();
+        while ((packetLen = fakeParsePacket(&code, &payload)) > 0) {
+            /* Version 2 payloads are not terminated, so borrow the first byte of the next packet. */
+            next = readBuffer[packetLen];
+            readBuffer[packetLen] = '\0';
+
+            switch (code) {
+            case FAKE_MSG_START:
+                if (!started && (startedDueMs == 0)) {
+                    startMs = nowMs;
+                    startedDueMs = nowMs + startDelay;
+                    if (crashMs > 0) {
+                        crashDueMs = nowMs + crashMs;
+                    }
+                }
+                break;
+
+            case FAKE_MSG_PING:
+                if (!stopping) {
+                    fakeQueuePing(payload, nowMs);
+                }
+                break;
+
+            case FAKE_MSG_STOP:
+                if (!stopping) {
+                    stopping = TRUE;
+                    stoppedDueMs = nowMs + stopDelay;
+                }
+                break;
+
+            case FAKE_MSG_BADKEY:
+                fprintf(stderr, "fakejvm: the Wrapper rejected our key.\n");
+                return 1;
+
+            case FAKE_MSG_PROTOCOL:
+                /* The acknowledgement was the last packet with the old framing. */
+                readVersion = atoi(payload);
+                break;
+
+            default:
+                break;
+            }
+
+            readBuffer[packetLen] = next;
+            readBufferLen -= packetLen;
+            memmove(readBuffer, readBuffer + packetLen, readBufferLen);
+        }
+    }
+
+    nowMs = fakeNowMs();
+    printf("fakejvm: %.0f lines, %.0f log packets, %.0f pings answered, %.0f bytes written in %.0f ms (started after %.0f ms).\n",
+        stdoutLoad.count, logLoad.count, pingsAnswered, bytesWritten, nowMs - launchMs, startMs - launchMs);
+    fflush(stdout);
+    close(backendWriteFd);
+    if (backendReadFd != backendWriteFd) {
+        close(backendReadFd);
+    }
+    return exitCode;
+}
+#endif
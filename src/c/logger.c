@@ -85,6 +85,7 @@ typedef long intptr_t;
 
 #include "wrapper_i18n.h"
 #include "logger.h"
+#include "wrapper_metrics.h"
 
 #ifndef TRUE
  #define TRUE 1
@@ -114,6 +115,15 @@ time_t previousLogLag;
 time_t previousNow;
 int    previousNowMillis;
 
+/* Timestamp of a record being logged with log_printf_record.  Only set while the logging mutex is held. */
+int    recordTimeSet = FALSE;
+time_t recordTime;
+int    recordTimeMillis;
+
+/* Local time of a multi-line message whose lines are being logged.  Only set while the logging mutex is held. */
+int    recordTMSet = FALSE;
+struct tm recordTM;
+
 /* Initialize all log levels to unknown until they are set */
 int currentConsoleLevel = LEVEL_UNKNOWN;
 int currentLogfileLevel = LEVEL_UNKNOWN;
@@ -1180,6 +1190,10 @@ void setLogfileUmask( int log_file_umask ) {
     logFileUmask = log_file_umask;
 }
 
+int getLogfileUmask() {
+    return logFileUmask;
+}
+
 #ifndef WIN32
 void setLogfileGroup(gid_t log_file_group) {
     logFileGroup = log_file_group;
@@ -1821,7 +1835,11 @@ TCHAR* buildPrintBuffer( int source_id, int level, int threadId, int queued, str
                 break;
 
             default:
-                temp = _sntprintf( pos, reqSize - len, TEXT("jvm %-4d"), source_id );
+                if (source_id <= WRAPPER_SOURCE_INSTANCE_BASE) {
+                    temp = _sntprintf( pos, reqSize - len, TEXT("inst%-4d"), WRAPPER_SOURCE_INSTANCE_BASE - source_id );
+                } else {
+                    temp = _sntprintf( pos, reqSize - len, TEXT("jvm %-4d"), source_id );
+                }
                 break;
             }
             currentColumn++;
@@ -2697,6 +2715,13 @@ int log_printf_message(int source_id, int level, int threadId, int queued, TCHAR
     int         nowMillis;
     struct tm   *nowTM;
     time_t      durationMillis;
+    int         splitRecord;
+    int         savedRecordTimeSet;
+    time_t      savedRecordTime;
+    int         savedRecordTimeMillis;
+    
+    /* The threadId may be the one of a queue being flushed, but a counter must only be updated by its own thread. */
+    WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_LOG_MESSAGES, 1);
     
 #ifndef WIN32
     if ((_tcsstr(message, LOG_SPECIAL_MARKER) == message) && (_tcslen(message) >= _tcslen(LOG_SPECIAL_MARKER) + 10)) {
@@ -2730,16 +2755,27 @@ int log_printf_message(int source_id, int level, int threadId, int queued, TCHAR
 #endif
     
     /* Build a timestamp */
+    if (recordTimeSet) {
+        /* The record carries the time at which it was created. */
+        now = recordTime;
+        nowMillis = recordTimeMillis;
+    } else {
 #ifdef WIN32
-    _ftime( &timebNow );
-    now = (time_t)timebNow.time;
-    nowMillis = timebNow.millitm;
+        _ftime( &timebNow );
+        now = (time_t)timebNow.time;
+        nowMillis = timebNow.millitm;
 #else
-    gettimeofday( &timevalNow, NULL );
-    now = (time_t)timevalNow.tv_sec;
-    nowMillis = timevalNow.tv_usec / 1000;
+        gettimeofday( &timevalNow, NULL );
+        now = (time_t)timevalNow.tv_sec;
+        nowMillis = timevalNow.tv_usec / 1000;
 #endif
-    nowTM = localtime( &now );
+    }
+    if (recordTMSet) {
+        /* A line of a multi-line message.  localtime() is fairly expensive, so it was only called for the whole message. */
+        nowTM = &recordTM;
+    } else {
+        nowTM = localtime( &now );
+    }
     
     /* Calculate the number of milliseconds which have passed since the previous log entry.
      * We only need to display up to 8 digits, so if the result is going to be larger than
@@ -2758,6 +2794,10 @@ int log_printf_message(int source_id, int level, int threadId, int queued, TCHAR
             durationMillis = 100000000;
         } else {
             durationMillis = (now - previousNow) * 1000 + nowMillis - previousNowMillis;
+            if (durationMillis < 0) {
+                /* A record which was created before the previous entry was logged. */
+                durationMillis = 0;
+            }
         }
         previousNow = now;
         previousNowMillis = nowMillis;
@@ -2788,6 +2828,19 @@ int log_printf_message(int source_id, int level, int threadId, int queued, TCHAR
     subMessage = message;
     nextLF = _tcschr(subMessage, TEXT('\n'));
     if (nextLF) {
+        /* All the lines share the time of the message, as if it was a single record. */
+        splitRecord = !recordTMSet;
+        savedRecordTimeSet = recordTimeSet;
+        savedRecordTime = recordTime;
+        savedRecordTimeMillis = recordTimeMillis;
+        if (splitRecord) {
+            recordTimeSet = TRUE;
+            recordTime = now;
+            recordTimeMillis = nowMillis;
+            memcpy(&recordTM, nowTM, sizeof(struct tm));
+            recordTMSet = TRUE;
+        }
+        
         /* This string contains more than one line.   Loop over the strings.  It is Ok to corrupt this string because it is only used once. */
         while (nextLF) {
             nextLF[0] = TEXT('\0');
@@ -2801,6 +2854,12 @@ int log_printf_message(int source_id, int level, int threadId, int queued, TCHAR
         /* The rest of the buffer will be the final line. */
         logFileChanged |= log_printf_message(source_id, level, threadId, queued, subMessage, FALSE);
         
+        if (splitRecord) {
+            recordTMSet = FALSE;
+            recordTimeSet = savedRecordTimeSet;
+            recordTime = savedRecordTime;
+            recordTimeMillis = savedRecordTimeMillis;
+        }
         return logFileChanged;
     }
     
@@ -2900,6 +2959,36 @@ void pauseThread(int pauseTime) {
     }
 }
 
+/**
+ * Enqueues a notification that the log file name was changed.
+ *  We can NOT directly send the notification when logging as that could cause a deadlock,
+ *  depending on where exactly the log function was called from. (See Wrapper protocol mutex.)
+ *  This must be called while the logging mutex is held.
+ */
+static void queueLogFileChange() {
+    TCHAR *logFileCopy;
+
+    logFileCopy = malloc(sizeof(TCHAR) * (_tcslen(currentLogFileName) + 1));
+    if (!logFileCopy) {
+        _tprintf(TEXT("Out of memory in logging code (%s)\n"), TEXT("P4"));
+    } else {
+        _tcsncpy(logFileCopy, currentLogFileName, _tcslen(currentLogFileName) + 1);
+        /* Now after we have 100% prepared the log file name.  Put into the queue variable
+         *  so the maintainLogging() function can safely grab it at any time.
+         * The reading code is also in a semaphore so we can do a quick test here safely as well. */
+        if (pendingLogFileChange) {
+            /* The previous file was still in the queue.  Free it up to avoid a memory leak.
+             *  This can happen if the log file size is 1k or something like that.  We will always
+             *  keep the most recent file however, so this should not be that big a problem. */
+#ifdef _DEBUG
+            _tprintf(TEXT("Log file name change was overwritten in queue: %s\n"), pendingLogFileChange);
+#endif
+            free(pendingLogFileChange);
+        }
+        pendingLogFileChange = logFileCopy;
+    }
+}
+
 /**
  * General log function
  *
@@ -2914,7 +3003,6 @@ void log_printf( int source_id, int level, const TCHAR *lpszFmt, ... ) {
     int         count;
     int         threadId;
     int         logFileChanged;
-    TCHAR       *logFileCopy;
 #if defined(UNICODE) && !defined(WIN32)
     size_t      len;
     TCHAR       *msg = NULL;
@@ -3075,7 +3163,6 @@ void log_printf( int source_id, int level, const TCHAR *lpszFmt, ... ) {
         free(msg);
     }
 #endif
-    logFileCopy = NULL;
     if (source_id >= 0) {
         /* As this is content from the JVM, the msg or lpszFmt is direct message, not a message format. */
 #if defined(UNICODE) && !defined(WIN32)
@@ -3088,28 +3175,7 @@ void log_printf( int source_id, int level, const TCHAR *lpszFmt, ... ) {
         logFileChanged = log_printf_message(source_id, level, threadId, FALSE, threadMessageBuffer, TRUE);
     }
     if (logFileChanged) {
-        /* We need to enqueue a notification that the log file name was changed.
-         *  We can NOT directly send the notification here as that could cause a deadlock,
-         *  depending on where exactly this function was called from. (See Wrapper protocol mutex.) */
-        logFileCopy = malloc(sizeof(TCHAR) * (_tcslen(currentLogFileName) + 1));
-        if (!logFileCopy) {
-            _tprintf(TEXT("Out of memory in logging code (%s)\n"), TEXT("P4"));
-        } else {
-            _tcsncpy(logFileCopy, currentLogFileName, _tcslen(currentLogFileName) + 1);
-            /* Now after we have 100% prepared the log file name.  Put into the queue variable
-             *  so the maintainLogging() function can safely grab it at any time.
-             * The reading code is also in a semaphore so we can do a quick test here safely as well. */
-            if (pendingLogFileChange) {
-                /* The previous file was still in the queue.  Free it up to avoid a memory leak.
-                 *  This can happen if the log file size is 1k or something like that.  We will always
-                 *  keep the most recent file however, so this should not be that big a problem. */
-#ifdef _DEBUG
-                _tprintf(TEXT("Log file name change was overwritten in queue: %s\n"), pendingLogFileChange);
-#endif
-                free(pendingLogFileChange);
-            }
-            pendingLogFileChange = logFileCopy;
-        }
+        queueLogFileChange();
     }
 
     /* Release the lock we have on this function so that other threads can get in. */
@@ -3136,6 +3202,41 @@ void log_printf( int source_id, int level, const TCHAR *lpszFmt, ... ) {
     }
 }
 
+/**
+ * Logs a record which was created and filtered by the JVM.  Unlike log_printf,
+ *  the record keeps the time at which it was created rather than the time at
+ *  which it reached the Wrapper.
+ *
+ * @param source_id The JVM number.  Must be a positive value.
+ * @param level     Level at which to log the record.
+ * @param when      Time at which the record was created.
+ * @param whenMillis Milliseconds part of the time at which the record was created.
+ * @param message   Message of the record.  It will be modified by this call if
+ *                  it contains line feeds.
+ */
+void log_printf_record( int source_id, int level, time_t when, int whenMillis, TCHAR *message ) {
+    int         logFileChanged;
+
+    if ((level == LEVEL_NONE) || (source_id < 0)) {
+        return;
+    }
+
+    if (lockLoggingMutex()) {
+        return;
+    }
+
+    recordTimeSet = TRUE;
+    recordTime = when;
+    recordTimeMillis = whenMillis;
+    logFileChanged = log_printf_message(source_id, level, getThreadId(), FALSE, message, TRUE);
+    recordTimeSet = FALSE;
+    if (logFileChanged) {
+        queueLogFileChange();
+    }
+
+    releaseLoggingMutex();
+}
+
 /* Internal functions */
 #ifdef WIN32
 static int sysLangId = LANG_NEUTRAL;
@@ -4141,6 +4242,8 @@ void rollLogs(const TCHAR *nowStr) {
     }
 #endif
 
+    WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_LOG_ROLLS, 1);
+
     /* Now limit the number of files using the standard method. */
     if (logFileMaxLogFiles > 0) {
         if (logFilePurgePattern) {
@@ -4382,6 +4485,9 @@ void checkAndRollLogs(const TCHAR *nowDate, size_t printBufferSize) {
         }
         /* Always reset the name so the the log file name will be regenerated correctly. */
         currentLogFileName[0] = TEXT('\0');
+        if (logFileLastNowDate[0] != TEXT('\0')) {
+            WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_LOG_ROLLS, 1);
+        }
 
         /* This will happen just before a new log file is created.
          *  Check the maximum file count. */
@@ -4482,6 +4588,7 @@ void log_printf_queue( int useQueue, int source_id, int level, const TCHAR *lpsz
         
         if ((localWriteIndex == localReadIndex - 1) || ((localWriteIndex == QUEUE_SIZE - 1) && (localReadIndex == 0))) {
             _tprintf(TEXT("WARNING log queue overflow for thread[%d]:%d:%d dropping entry: %s\n"), threadId, localWriteIndex, localReadIndex, lpszFmt);
+            WRAPPER_METRICS_ADD(threadId, WRAPPER_METRIC_LOG_QUEUE_DROPPED, 1);
             return;
         }
         
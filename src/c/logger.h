@@ -76,6 +76,8 @@
 #define WRAPPER_SOURCE_WRAPPER      -1
 #define WRAPPER_SOURCE_PROTOCOL     -2
 #define WRAPPER_SOURCE_JVM_QRY       0  /* The value '0' is important for log_printf to print this output as a direct message (otherwise any '%' in the output will cause memory issues) */
+#define WRAPPER_SOURCE_INSTANCE_BASE -1000 /* Output of the additional instance <n> is logged with the source WRAPPER_SOURCE_INSTANCE(n). */
+#define WRAPPER_SOURCE_INSTANCE(n)  (WRAPPER_SOURCE_INSTANCE_BASE - (n))
 
 /* * * Log thread constants * * */
 /* These are indexes in an array so they must be sequential, start
@@ -255,6 +257,7 @@ extern int getLogfileRollModeForName( const TCHAR *logfileRollName );
 extern void setLogfileRollMode(int log_file_roll_mode);
 extern int getLogfileRollMode();
 extern void setLogfileUmask(int log_file_umask);
+extern int getLogfileUmask();
 #ifndef WIN32
 extern void setLogfileGroup(gid_t log_file_group);
 #endif
@@ -331,6 +334,7 @@ extern int getLogFacilityForName( const TCHAR *logFacilityName );
 extern void generateCurrentLogFileName(TCHAR** pFileName);
 #endif
 extern void logRegisterThread(int thread_id);
+extern int getThreadId();
 extern void logRegisterFormatCallbacks(int (*countCallback)(const TCHAR format, size_t *reqSize), 
                                        int (*printCallback)(const TCHAR format, size_t printSize, TCHAR** pBuffer));
 
@@ -346,6 +350,12 @@ void printToConsoleLn(const TCHAR *printBuffer, FILE *target);
  */
 extern void log_printf( int source_id, int level, const TCHAR *lpszFmt, ... );
 
+/**
+ * The log_printf_record function logs a message from the JVM which carries
+ *  the time at which it was created.  The message is not a format.
+ */
+extern void log_printf_record( int source_id, int level, time_t when, int whenMillis, TCHAR *message );
+
 /**
  * The log_printf_queue function is less efficient than the log_printf
  *  function and will cause logged messages to be logged out of order from
@@ -365,4 +375,12 @@ extern void invalidMultiByteSequence(const TCHAR *context, int id);
 #ifdef WIN32
 extern void setLogSysLangId(int id);
 #endif
+
+#ifdef WRAPPER_BENCH
+/* Internals of the logger, exposed for the microbenchmarks in bench.c. */
+extern int lockLoggingMutex();
+extern int releaseLoggingMutex();
+extern TCHAR* buildPrintBuffer( int source_id, int level, int threadId, int queued, struct tm *nowTM, int nowMillis, time_t durationMillis, int *pTanukiStep, const TCHAR *format, const TCHAR *defaultFormat, const TCHAR *message);
+extern int log_printf_message(int source_id, int level, int threadId, int queued, TCHAR *message, int sysLogEnabled);
+#endif
 #endif
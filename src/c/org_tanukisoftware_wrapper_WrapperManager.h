@@ -313,6 +313,14 @@ JNIEXPORT jboolean JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_native
 JNIEXPORT jint JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetControlEvent
   (JNIEnv *, jclass);
 
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeWaitForControlEvent
+ * Signature: (I)I
+ */
+JNIEXPORT jint JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeWaitForControlEvent
+  (JNIEnv *, jclass, jint);
+
 /*
  * Class:     org_tanukisoftware_wrapper_WrapperManager
  * Method:    nativeRedirectPipes
@@ -329,6 +337,38 @@ JNIEXPORT jint JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeRedi
 JNIEXPORT jobject JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetFileDescriptor
   (JNIEnv *, jclass, jint);
 
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeConnectBackendSocketUnix
+ * Signature: (Ljava/lang/String;)I
+ */
+JNIEXPORT jint JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeConnectBackendSocketUnix
+  (JNIEnv *, jclass, jstring);
+
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeRingOpen
+ * Signature: (Ljava/lang/String;)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeRingOpen
+  (JNIEnv *, jclass, jstring);
+
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeRingWrite
+ * Signature: (B[BI)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeRingWrite
+  (JNIEnv *, jclass, jbyte, jbyteArray, jint);
+
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeRingClose
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_tanukisoftware_wrapper_WrapperManager_nativeRingClose
+  (JNIEnv *, jclass);
+
 /*
  * Class:     org_tanukisoftware_wrapper_WrapperManager
  * Method:    nativeRequestThreadDump
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#ifdef LINUX
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_cgroup.h"
+
+/********************************************************************
+ * Cgroup Tests
+ *******************************************************************/
+static void tsCGRP_readFile(const char *dir, const char *name, char *buffer, size_t size) {
+    char path[600];
+    FILE *file;
+    size_t len = 0;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fopen(path, "r");
+    if (file) {
+        len = fread(buffer, 1, size - 1, file);
+        fclose(file);
+    }
+    buffer[len] = '\0';
+}
+
+static void tsCGRP_writeFile(const char *dir, const char *name, const char *value) {
+    char path[600];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fopen(path, "w");
+    if (file) {
+        fputs(value, file);
+        fclose(file);
+    }
+}
+
+static void tsCGRP_removeFile(const char *dir, const char *name) {
+    char path[600];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+/**
+ * Create a cgroup below a plain directory standing in for a delegated
+ *  cgroup, set its limits and move a process into it.
+ */
+void tsCGRP_testCgroupStandIn() {
+    char root[] = "/tmp/wrapper_cgroup_XXXXXX";
+    WrapperCgroup cgroup;
+    char buffer[256];
+    double someAvg10;
+    double fullAvg10;
+
+    if (!mkdtemp(root)) {
+        CU_FAIL("Unable to create a temporary directory.");
+        return;
+    }
+
+    CU_ASSERT_FALSE(wrapperCgroupEnableController(root, "memory"));
+    tsCGRP_readFile(root, "cgroup.subtree_control", buffer, sizeof(buffer));
+    CU_ASSERT_STRING_EQUAL(buffer, "+memory");
+
+    CU_ASSERT_FALSE(wrapperCgroupCreate(&cgroup, root, "jvm"));
+    /* Reusing an existing cgroup is fine. */
+    CU_ASSERT_FALSE(wrapperCgroupCreate(&cgroup, root, "jvm"));
+
+    CU_ASSERT_FALSE(wrapperCgroupWrite(&cgroup, "memory.max", "512M"));
+    tsCGRP_readFile(cgroup.path, "memory.max", buffer, sizeof(buffer));
+    CU_ASSERT_STRING_EQUAL(buffer, "512M");
+    CU_ASSERT_FALSE(wrapperCgroupWrite(&cgroup, "memory.max", "1G"));
+    tsCGRP_readFile(cgroup.path, "memory.max", buffer, sizeof(buffer));
+    CU_ASSERT_STRING_EQUAL(buffer, "1G");
+
+    CU_ASSERT_FALSE(wrapperCgroupAddProcess(&cgroup, 1234));
+    tsCGRP_readFile(cgroup.path, "cgroup.procs", buffer, sizeof(buffer));
+    CU_ASSERT_STRING_EQUAL(buffer, "1234");
+    CU_ASSERT_FALSE(wrapperCgroupAddProcess(&cgroup, 0));
+    tsCGRP_readFile(cgroup.path, "cgroup.procs", buffer, sizeof(buffer));
+    CU_ASSERT_STRING_EQUAL(buffer, "0");
+
+    /* There is no pressure file to watch until the "kernel" provides one. */
+    CU_ASSERT_TRUE(wrapperCgroupWatchPressure(&cgroup, WRAPPER_CGROUP_MEMORY, 150, 2000));
+    tsCGRP_writeFile(cgroup.path, "memory.pressure",
+        "some avg10=12.50 avg60=3.00 avg300=1.00 total=123456\nfull avg10=4.25 avg60=1.00 avg300=0.00 total=45678\n");
+    CU_ASSERT_FALSE(wrapperCgroupReadPressure(&cgroup, WRAPPER_CGROUP_MEMORY, &someAvg10, &fullAvg10));
+    CU_ASSERT_DOUBLE_EQUAL(someAvg10, 12.5, 0.001);
+    CU_ASSERT_DOUBLE_EQUAL(fullAvg10, 4.25, 0.001);
+
+    /* A regular file accepts the trigger but never signals any pressure. */
+    CU_ASSERT_FALSE(wrapperCgroupWatchPressure(&cgroup, WRAPPER_CGROUP_MEMORY, 150, 2000));
+    CU_ASSERT(cgroup.pressureFds[WRAPPER_CGROUP_MEMORY] >= 0);
+    CU_ASSERT_EQUAL(cgroup.pressureFds[WRAPPER_CGROUP_CPU], -1);
+    CU_ASSERT_EQUAL(wrapperCgroupPollPressure(&cgroup), 0);
+    tsCGRP_readFile(cgroup.path, "memory.pressure", buffer, sizeof(buffer));
+    CU_ASSERT_STRING_EQUAL(buffer, "some 150000 2000000");
+
+    /* Unlike a real cgroup, the directory is not empty. */
+    CU_ASSERT_TRUE(wrapperCgroupRemove(&cgroup));
+    CU_ASSERT_EQUAL(cgroup.pressureFds[WRAPPER_CGROUP_MEMORY], -1);
+
+    tsCGRP_removeFile(cgroup.path, "memory.max");
+    tsCGRP_removeFile(cgroup.path, "cgroup.procs");
+    tsCGRP_removeFile(cgroup.path, "memory.pressure");
+    CU_ASSERT_FALSE(wrapperCgroupRemove(&cgroup));
+    tsCGRP_removeFile(root, "cgroup.subtree_control");
+    rmdir(root);
+}
+
+/**
+ * Parse the content of pressure files.
+ */
+void tsCGRP_testCgroupParsePressure() {
+    double someAvg10;
+    double fullAvg10;
+
+    CU_ASSERT_FALSE(wrapperCgroupParsePressure("some avg10=0.00 avg60=0.00 avg300=0.00 total=0\nfull avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", &someAvg10, &fullAvg10));
+    CU_ASSERT_DOUBLE_EQUAL(someAvg10, 0.0, 0.001);
+    CU_ASSERT_DOUBLE_EQUAL(fullAvg10, 0.0, 0.001);
+
+    /* Older kernels have no "full" line for the CPU. */
+    CU_ASSERT_FALSE(wrapperCgroupParsePressure("some avg10=99.99 avg60=50.00 avg300=10.00 total=1\n", &someAvg10, &fullAvg10));
+    CU_ASSERT_DOUBLE_EQUAL(someAvg10, 99.99, 0.001);
+    CU_ASSERT_DOUBLE_EQUAL(fullAvg10, 0.0, 0.001);
+
+    CU_ASSERT_TRUE(wrapperCgroupParsePressure("", &someAvg10, &fullAvg10));
+    CU_ASSERT_TRUE(wrapperCgroupParsePressure("max\n", &someAvg10, &fullAvg10));
+}
+
+int tsCGRP_suiteCgroup() {
+    CU_pSuite cgroupSuite;
+
+    cgroupSuite = CU_add_suite("Cgroup Suite", NULL, NULL);
+    if (NULL == cgroupSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(cgroupSuite, "plain directory stand-in", tsCGRP_testCgroupStandIn);
+    CU_add_test(cgroupSuite, "parse pressure", tsCGRP_testCgroupParsePressure);
+
+    return FALSE;
+}
+#endif
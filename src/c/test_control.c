@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#ifndef WIN32
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "CUnit/Basic.h"
+#include "logger.h"
+#include "wrapper.h"
+
+/********************************************************************
+ * Control Tests
+ *******************************************************************/
+#define TSCTRL_PATH_LEN 64
+#define TSCTRL_LINE_LEN 80
+char tsCTRL_path[TSCTRL_PATH_LEN];
+TCHAR tsCTRL_pathW[TSCTRL_PATH_LEN];
+static WrapperConfig *tsCTRL_savedWrapperData;
+
+void tsCTRL_dummyLogFileChanged(const TCHAR *logFile) {
+}
+
+int tsCTRL_init_wrapper(void) {
+    initLogging(tsCTRL_dummyLogFileChanged);
+    logRegisterThread(WRAPPER_THREAD_MAIN);
+    setLogfileLevelInt(LEVEL_NONE);
+    setConsoleLogFormat(TEXT("LPM"));
+    setConsoleLogLevelInt(LEVEL_WARN);
+    setConsoleFlush(TRUE);
+    setSyslogLevelInt(LEVEL_NONE);
+
+    /* Only the settings used by the commands under test are needed. */
+    tsCTRL_savedWrapperData = wrapperData;
+    wrapperData = malloc(sizeof(WrapperConfig));
+    if (!wrapperData) {
+        return 1;
+    }
+    memset(wrapperData, 0, sizeof(WrapperConfig));
+
+    snprintf(tsCTRL_path, TSCTRL_PATH_LEN, "/tmp/wrapper-test-control-%d", (int)getpid());
+    mbstowcs(tsCTRL_pathW, tsCTRL_path, TSCTRL_PATH_LEN);
+    wrapperData->controlSocketPath = tsCTRL_pathW;
+    wrapperData->controlSocketUmask = 0077;
+    return 0;
+}
+
+int tsCTRL_clean_wrapper(void) {
+    free(wrapperData);
+    wrapperData = tsCTRL_savedWrapperData;
+    disposeLogging();
+    return 0;
+}
+
+/**
+ * Runs a command through wrapperExecuteCommand, which modifies its line.
+ */
+int tsCTRL_execute(const TCHAR *command) {
+    TCHAR line[TSCTRL_LINE_LEN];
+
+    _tcsncpy(line, command, TSCTRL_LINE_LEN - 1);
+    line[TSCTRL_LINE_LEN - 1] = TEXT('\0');
+    return wrapperExecuteCommand(line, WRAPPER_ACTION_SOURCE_CODE_CONTROL_SOCKET, NULL);
+}
+
+/**
+ * Make sure that commands are extracted from their line the same way for
+ *  the command file and the control socket.
+ */
+void tsCTRL_testExecuteCommand() {
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("")), WRAPPER_COMMAND_EMPTY);
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT(" \t \r\n")), WRAPPER_COMMAND_EMPTY);
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("NOT_A_COMMAND")), WRAPPER_COMMAND_UNKNOWN);
+
+    /* Leading and trailing blanks, the line end and any extra parameter are ignored. */
+    wrapperData->isLoopOutputEnabled = FALSE;
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("\t LOOP_OUTPUT   TRUE \r\n")), WRAPPER_COMMAND_OK);
+    CU_ASSERT_TRUE(wrapperData->isLoopOutputEnabled);
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("loop_output false extra")), WRAPPER_COMMAND_OK);
+    CU_ASSERT_FALSE(wrapperData->isLoopOutputEnabled);
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("SLEEP_OUTPUT")), WRAPPER_COMMAND_OK);
+    CU_ASSERT_FALSE(wrapperData->isSleepOutputEnabled);
+
+    /* Known commands with bad parameters. */
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("CONSOLE_LOGLEVEL")), WRAPPER_COMMAND_INVALID);
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("CONSOLE_LOGLEVEL NOT_A_LEVEL")), WRAPPER_COMMAND_INVALID);
+
+    /* Test commands are disabled unless wrapper.commandfile.enable_tests is set. */
+    wrapperData->commandFileTests = FALSE;
+    CU_ASSERT_EQUAL(tsCTRL_execute(TEXT("PAUSE_LOGGER 1")), WRAPPER_COMMAND_INVALID);
+}
+
+/**
+ * Connects to the control socket of the Wrapper.
+ */
+int tsCTRL_connect() {
+    struct sockaddr_un addr;
+    int sd;
+
+    sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, tsCTRL_path, sizeof(addr.sun_path) - 1);
+    if (connect(sd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+/**
+ * Serves the control socket until the client got all the expected lines or
+ *  the server closed the connection.
+ */
+size_t tsCTRL_exchange(int sd, char *buffer, size_t size, int lines) {
+    size_t len = 0;
+    ssize_t rc;
+    int i;
+    int found;
+
+    for (i = 0; i < 100; i++) {
+        wrapperControlPoll(0);
+        rc = recv(sd, buffer + len, size - len - 1, MSG_DONTWAIT);
+        if (rc == 0) {
+            break;
+        } else if (rc > 0) {
+            len += (size_t)rc;
+            buffer[len] = '\0';
+            found = 0;
+            for (rc = 0; rc < (ssize_t)len; rc++) {
+                if (buffer[rc] == '\n') {
+                    found++;
+                }
+            }
+            if (found >= lines) {
+                break;
+            }
+        } else {
+            usleep(1000);
+        }
+    }
+    buffer[len] = '\0';
+    return len;
+}
+
+/**
+ * Returns the next reply line of a buffer, or an empty string if there is
+ *  none left.
+ */
+char *tsCTRL_nextLine(char **buffer) {
+    char *line = *buffer;
+    char *next;
+
+    next = strchr(line, '\n');
+    if (!next) {
+        *buffer = line + strlen(line);
+        return "";
+    }
+    *next = '\0';
+    *buffer = next + 1;
+    return line;
+}
+
+/**
+ * Send queries and commands through the control socket, one reply line for
+ *  each of them.
+ */
+void tsCTRL_testControlSocket() {
+    const char *request = "STATUS\r\nNOT_A_COMMAND\nLOOP_OUTPUT TRUE\n\nCOUNTERS\n";
+    char buffer[8192];
+    char *replies;
+    char *line;
+    int sd;
+
+    CU_ASSERT_FALSE(wrapperControlStartServer());
+    sd = tsCTRL_connect();
+    if (sd < 0) {
+        CU_FAIL("Unable to connect to the control socket");
+        wrapperControlStopServer();
+        return;
+    }
+
+    wrapperData->isLoopOutputEnabled = FALSE;
+    CU_ASSERT_EQUAL(send(sd, request, strlen(request), 0), (ssize_t)strlen(request));
+    tsCTRL_exchange(sd, buffer, sizeof(buffer), 4);
+
+    replies = buffer;
+    CU_ASSERT_EQUAL(strncmp(tsCTRL_nextLine(&replies), "OK wrapper=", 11), 0);
+    CU_ASSERT_STRING_EQUAL(tsCTRL_nextLine(&replies), "ERROR Unknown command");
+    CU_ASSERT_STRING_EQUAL(tsCTRL_nextLine(&replies), "OK");
+    CU_ASSERT_TRUE(wrapperData->isLoopOutputEnabled);
+    /* The empty line gets no reply. */
+    line = tsCTRL_nextLine(&replies);
+    CU_ASSERT_EQUAL(strncmp(line, "OK wrapper_jvm_launches_total=", 30), 0);
+    CU_ASSERT_PTR_NOT_NULL(strstr(line, " wrapper_pings_pending="));
+    CU_ASSERT_STRING_EQUAL(replies, "");
+
+    /* A last command without a line feed is still executed before the connection is closed. */
+    CU_ASSERT_EQUAL(send(sd, "PIDS", 4, 0), 4);
+    shutdown(sd, SHUT_WR);
+    tsCTRL_exchange(sd, buffer, sizeof(buffer), 2);
+    CU_ASSERT_EQUAL(strncmp(buffer, "OK wrapper=", 11), 0);
+    close(sd);
+
+    wrapperControlStopServer();
+    CU_ASSERT_EQUAL(access(tsCTRL_path, F_OK), -1);
+}
+
+/**
+ * Binds a socket on the path of the control socket, as another Wrapper would.
+ */
+int tsCTRL_bind(int doListen) {
+    struct sockaddr_un addr;
+    int sd;
+
+    sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, tsCTRL_path, sizeof(addr.sun_path) - 1);
+    if (bind(sd, (struct sockaddr *)&addr, sizeof(addr)) || (doListen && listen(sd, 1))) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+/**
+ * Make sure that a file which is not a socket, or a socket still in use, is
+ *  left alone.
+ */
+void tsCTRL_testControlSocketPath() {
+    FILE *file;
+    int sd;
+
+    /* A regular file. */
+    file = fopen(tsCTRL_path, "w");
+    if (!file) {
+        CU_FAIL("Unable to create the file");
+        return;
+    }
+    fclose(file);
+    CU_ASSERT_TRUE(wrapperControlStartServer());
+    CU_ASSERT_EQUAL(access(tsCTRL_path, F_OK), 0);
+    unlink(tsCTRL_path);
+
+    /* A socket some other process is listening on. */
+    sd = tsCTRL_bind(TRUE);
+    if (sd < 0) {
+        CU_FAIL("Unable to bind the socket");
+        return;
+    }
+    CU_ASSERT_TRUE(wrapperControlStartServer());
+    CU_ASSERT_EQUAL(access(tsCTRL_path, F_OK), 0);
+    close(sd);
+    unlink(tsCTRL_path);
+}
+
+/**
+ * Make sure that a socket left behind by a Wrapper which is gone is replaced.
+ */
+void tsCTRL_testControlSocketStale() {
+    int sd;
+
+    sd = tsCTRL_bind(FALSE);
+    if (sd < 0) {
+        CU_FAIL("Unable to bind the socket");
+        return;
+    }
+    close(sd);
+
+    CU_ASSERT_FALSE(wrapperControlStartServer());
+    sd = tsCTRL_connect();
+    CU_ASSERT(sd >= 0);
+    if (sd >= 0) {
+        close(sd);
+    }
+    wrapperControlStopServer();
+    CU_ASSERT_EQUAL(access(tsCTRL_path, F_OK), -1);
+}
+
+int tsCTRL_suiteControl() {
+    CU_pSuite controlSuite;
+
+    controlSuite = CU_add_suite("Control Suite", tsCTRL_init_wrapper, tsCTRL_clean_wrapper);
+    if (NULL == controlSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(controlSuite, "command extraction", tsCTRL_testExecuteCommand);
+    CU_add_test(controlSuite, "queries and commands", tsCTRL_testControlSocket);
+    CU_add_test(controlSuite, "existing path", tsCTRL_testControlSocketPath);
+    CU_add_test(controlSuite, "stale socket", tsCTRL_testControlSocketStale);
+
+    return FALSE;
+}
+#endif
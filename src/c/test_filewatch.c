@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+
+#ifdef LINUX
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_filewatch.h"
+
+/********************************************************************
+ * File Watch Tests
+ *******************************************************************/
+static void tsFWAT_writeFile(const char *dir, const char *name, const char *value) {
+    char path[600];
+    FILE *file;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fopen(path, "w");
+    if (file) {
+        fputs(value, file);
+        fclose(file);
+    }
+}
+
+static void tsFWAT_removeFile(const char *dir, const char *name) {
+    char path[600];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+/**
+ * Watch an anchor and a command file in the same directory.
+ */
+void tsFWAT_testFileWatchEvents() {
+    char dir[] = "/tmp/wrapper_filewatch_XXXXXX";
+    char path[600];
+    WrapperFileWatch watch;
+    int anchor;
+    int command;
+
+    if (!mkdtemp(dir)) {
+        CU_FAIL("Unable to create a temporary directory.");
+        return;
+    }
+    tsFWAT_writeFile(dir, "anchor", "");
+
+    CU_ASSERT_FALSE(wrapperFileWatchOpen(&watch));
+    snprintf(path, sizeof(path), "%s/anchor", dir);
+    anchor = wrapperFileWatchAdd(&watch, path, WRAPPER_FILEWATCH_DELETED);
+    snprintf(path, sizeof(path), "%s/command", dir);
+    command = wrapperFileWatchAdd(&watch, path, WRAPPER_FILEWATCH_CREATED);
+    CU_ASSERT_EQUAL(anchor, 0);
+    CU_ASSERT_EQUAL(command, 1);
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 0);
+
+    /* Other files in the directory and events of no interest are not reported. */
+    tsFWAT_writeFile(dir, "other", "x");
+    tsFWAT_removeFile(dir, "other");
+    tsFWAT_writeFile(dir, "anchor", "x");
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 0);
+
+    tsFWAT_writeFile(dir, "command", "GC\n");
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 1 << command);
+    tsFWAT_removeFile(dir, "command");
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 0);
+
+    tsFWAT_removeFile(dir, "anchor");
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 1 << anchor);
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 0);
+
+    /* Losing the directory is reported once, after which the files are no longer watched. */
+    CU_ASSERT_TRUE(wrapperFileWatchIsWatched(&watch, anchor));
+    rmdir(dir);
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), (1 << anchor) | (1 << command));
+    CU_ASSERT_FALSE(wrapperFileWatchIsWatched(&watch, anchor));
+    CU_ASSERT_FALSE(wrapperFileWatchIsWatched(&watch, command));
+
+    wrapperFileWatchClose(&watch);
+    CU_ASSERT_EQUAL(wrapperFileWatchPoll(&watch), 0);
+}
+
+/**
+ * Files whose directory does not exist can not be watched.
+ */
+void tsFWAT_testFileWatchMissingDir() {
+    WrapperFileWatch watch;
+
+    CU_ASSERT_FALSE(wrapperFileWatchOpen(&watch));
+    CU_ASSERT_EQUAL(wrapperFileWatchAdd(&watch, "/tmp/wrapper_filewatch_missing/anchor", WRAPPER_FILEWATCH_DELETED), -1);
+    CU_ASSERT_EQUAL(wrapperFileWatchAdd(&watch, "/tmp/", WRAPPER_FILEWATCH_DELETED), -1);
+    CU_ASSERT_FALSE(wrapperFileWatchIsWatched(&watch, 0));
+    wrapperFileWatchClose(&watch);
+}
+
+int tsFWAT_suiteFileWatch() {
+    CU_pSuite fileWatchSuite;
+
+    fileWatchSuite = CU_add_suite("File Watch Suite", NULL, NULL);
+    if (NULL == fileWatchSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(fileWatchSuite, "anchor and command file events", tsFWAT_testFileWatchEvents);
+    CU_add_test(fileWatchSuite, "missing directory", tsFWAT_testFileWatchMissingDir);
+
+    return FALSE;
+}
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#include <stdlib.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_histogram.h"
+
+/********************************************************************
+ * Histogram Tests
+ *******************************************************************/
+/**
+ * Make sure that every value falls in a bucket which covers it, and that the
+ *  buckets are in increasing order.
+ */
+void tsHIST_testHistogramBuckets() {
+    unsigned int value;
+    int bucket;
+    int previous = -1;
+
+    for (value = 0; value < 0x7fffffff; value = value + value / 64 + 1) {
+        bucket = wrapperHistogramBucketForValue(value);
+        CU_ASSERT_TRUE((bucket >= 0) && (bucket < WRAPPER_HISTOGRAM_BUCKETS));
+        CU_ASSERT_TRUE(wrapperHistogramBucketHighestValue(bucket) >= value);
+        if (bucket > 0) {
+            CU_ASSERT_TRUE(wrapperHistogramBucketHighestValue(bucket - 1) < value);
+        }
+        CU_ASSERT_TRUE(bucket >= previous);
+        previous = bucket;
+    }
+    CU_ASSERT_EQUAL(wrapperHistogramBucketForValue(0xffffffff), WRAPPER_HISTOGRAM_BUCKETS - 1);
+    CU_ASSERT_EQUAL(wrapperHistogramBucketHighestValue(WRAPPER_HISTOGRAM_BUCKETS - 1), 0xffffffff);
+}
+
+/**
+ * Make sure that the percentiles are within the precision of the buckets.
+ */
+void tsHIST_testHistogramPercentiles() {
+    WrapperHistogram histogram;
+    unsigned int value;
+
+    wrapperHistogramReset(&histogram);
+    CU_ASSERT_EQUAL(wrapperHistogramValueAtPercentile(&histogram, 50.0), 0);
+
+    for (value = 1; value <= 100000; value++) {
+        wrapperHistogramRecord(&histogram, value);
+    }
+    CU_ASSERT_EQUAL(histogram.count, 100000);
+    CU_ASSERT_EQUAL(histogram.min, 1);
+    CU_ASSERT_EQUAL(histogram.max, 100000);
+
+    value = wrapperHistogramValueAtPercentile(&histogram, 50.0);
+    CU_ASSERT_TRUE((value >= 50000) && (value <= 50000 + 50000 / WRAPPER_HISTOGRAM_SUB_BUCKETS));
+    value = wrapperHistogramValueAtPercentile(&histogram, 99.0);
+    CU_ASSERT_TRUE((value >= 99000) && (value <= 99000 + 99000 / WRAPPER_HISTOGRAM_SUB_BUCKETS));
+    CU_ASSERT_EQUAL(wrapperHistogramValueAtPercentile(&histogram, 100.0), 100000);
+    CU_ASSERT_TRUE(abs((int)wrapperHistogramMean(&histogram) - 50000) <= 1);
+}
+
+/**
+ * Make sure that adding a histogram to another one gives the same result as
+ *  recording all the values in a single one.
+ */
+void tsHIST_testHistogramAdd() {
+    WrapperHistogram first;
+    WrapperHistogram second;
+
+    wrapperHistogramReset(&first);
+    wrapperHistogramReset(&second);
+    wrapperHistogramRecord(&first, 10);
+    wrapperHistogramRecord(&first, 20);
+    wrapperHistogramRecord(&second, 5);
+    wrapperHistogramRecord(&second, 1000000);
+
+    wrapperHistogramAdd(&first, &second);
+    CU_ASSERT_EQUAL(first.count, 4);
+    CU_ASSERT_EQUAL(first.min, 5);
+    CU_ASSERT_EQUAL(first.max, 1000000);
+    CU_ASSERT_EQUAL(wrapperHistogramValueAtPercentile(&first, 50.0), 10);
+    CU_ASSERT_EQUAL(wrapperHistogramValueAtPercentile(&first, 75.0), 20);
+}
+
+int tsHIST_suiteHistogram() {
+    CU_pSuite histogramSuite;
+
+    histogramSuite = CU_add_suite("Histogram Suite", NULL, NULL);
+    if (NULL == histogramSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(histogramSuite, "bucket boundaries", tsHIST_testHistogramBuckets);
+    CU_add_test(histogramSuite, "percentiles", tsHIST_testHistogramPercentiles);
+    CU_add_test(histogramSuite, "add", tsHIST_testHistogramAdd);
+
+    return FALSE;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#ifndef WIN32
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+#include "logger.h"
+#include "property.h"
+#include "wrapper.h"
+#include "wrapper_instance.h"
+
+/********************************************************************
+ * Instance Tests
+ *******************************************************************/
+static WrapperConfig *tsINST_savedWrapperData;
+
+void tsINST_dummyLogFileChanged(const TCHAR *logFile) {
+}
+
+int tsINST_init_wrapper(void) {
+    initLogging(tsINST_dummyLogFileChanged);
+    logRegisterThread(WRAPPER_THREAD_MAIN);
+    setLogfileLevelInt(LEVEL_NONE);
+    setConsoleLogFormat(TEXT("PLM"));
+    setConsoleLogLevelInt(LEVEL_WARN);
+    setConsoleFlush(TRUE);
+    setSyslogLevelInt(LEVEL_NONE);
+
+    /* Only the defaults of the instance settings are needed. */
+    tsINST_savedWrapperData = wrapperData;
+    wrapperData = malloc(sizeof(WrapperConfig));
+    if (!wrapperData) {
+        return 1;
+    }
+    memset(wrapperData, 0, sizeof(WrapperConfig));
+    wrapperData->useSystemTime = TRUE;
+    wrapperData->restartDelay = 5;
+    wrapperData->successfulInvocationTime = 300;
+    wrapperData->maxFailedInvocations = 5;
+    wrapperData->jvmExitTimeout = 15;
+    return 0;
+}
+
+int tsINST_clean_wrapper(void) {
+    free(wrapperData);
+    wrapperData = tsINST_savedWrapperData;
+    disposeQuotableMap();
+    disposeLogging();
+    return 0;
+}
+
+/**
+ * Creates properties from a NULL terminated list of "name=value" pairs.
+ */
+static Properties *tsINST_properties(const TCHAR **pairs) {
+    Properties *properties;
+    int i;
+
+    properties = createProperties(FALSE, LEVEL_NONE, FALSE, SECURITY_LEVEL_TRUST);
+    /* Loaded like on the first pass over the configuration, which is also when the map of quotable properties is created. */
+    if (properties && initPropertyLoading(properties, TRUE)) {
+        disposeProperties(properties);
+        properties = NULL;
+    }
+    if (properties) {
+        for (i = 0; pairs[i]; i++) {
+            addPropertyPair(properties, pairs[i], FALSE, FALSE, NULL);
+        }
+    }
+    return properties;
+}
+
+/**
+ * Polls the instances until the first one reaches a state, for up to ten seconds.
+ */
+static int tsINST_pollUntil(int state) {
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        wrapperInstancesPoll(wrapperGetTicks());
+        if (wrapperInstances[0].state == state) {
+            return TRUE;
+        }
+        wrapperSleep(10);
+    }
+    return FALSE;
+}
+
+/**
+ * Instances are found by their main class, with gaps in their numbers, and
+ *  take the settings of the JVM of the Wrapper unless they set their own.
+ */
+void tsINST_testLoad() {
+    const TCHAR *pairs[] = {
+        TEXT("wrapper.java.command=/opt/java/bin/java"),
+        TEXT("wrapper.instance.2.java.mainclass=org.example.Second"),
+        TEXT("wrapper.instance.5.java.mainclass=org.example.Fifth"),
+        TEXT("wrapper.instance.5.java.command=/usr/bin/java"),
+        TEXT("wrapper.instance.5.java.additional.1=-Xmx64m"),
+        TEXT("wrapper.instance.5.java.additional.2=-Dname=a b"),
+        TEXT("wrapper.instance.5.app.parameter.1=start"),
+        TEXT("wrapper.instance.5.restart.delay=1"),
+        TEXT("wrapper.instance.5.max_failed_invocations=0"),
+        NULL
+    };
+    Properties *properties;
+
+    properties = tsINST_properties(pairs);
+    CU_ASSERT_PTR_NOT_NULL(properties);
+    if (!properties) {
+        return;
+    }
+    CU_ASSERT_FALSE(wrapperInstancesLoad(properties));
+    CU_ASSERT_EQUAL(wrapperInstanceCount, 2);
+    if (wrapperInstanceCount == 2) {
+        CU_ASSERT_EQUAL(wrapperInstances[0].id, 2);
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[0].argv[0], "/opt/java/bin/java");
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[0].argv[1], "org.example.Second");
+        CU_ASSERT_PTR_NULL(wrapperInstances[0].argv[2]);
+        CU_ASSERT_EQUAL(wrapperInstances[0].restartDelay, 5);
+        CU_ASSERT_EQUAL(wrapperInstances[0].maxFailedInvocations, 5);
+        CU_ASSERT_EQUAL(wrapperInstances[0].exitTimeout, 15);
+        CU_ASSERT_EQUAL(wrapperInstances[0].state, WRAPPER_INSTANCE_STATE_DOWN);
+        CU_ASSERT_EQUAL(wrapperInstances[0].outputFd, -1);
+
+        CU_ASSERT_EQUAL(wrapperInstances[1].id, 5);
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[1].argv[0], "/usr/bin/java");
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[1].argv[1], "-Xmx64m");
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[1].argv[2], "-Dname=a b");
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[1].argv[3], "org.example.Fifth");
+        CU_ASSERT_STRING_EQUAL(wrapperInstances[1].argv[4], "start");
+        CU_ASSERT_PTR_NULL(wrapperInstances[1].argv[5]);
+        CU_ASSERT_EQUAL(wrapperInstances[1].restartDelay, 1);
+        /* At least one failed invocation is needed to give up. */
+        CU_ASSERT_EQUAL(wrapperInstances[1].maxFailedInvocations, 1);
+    }
+    wrapperInstancesDispose();
+    CU_ASSERT_EQUAL(wrapperInstanceCount, 0);
+    disposeProperties(properties);
+}
+
+/**
+ * An instance which keeps failing is relaunched until it reaches its
+ *  maximum number of failed invocations, and then given up on.
+ */
+void tsINST_testGiveUp() {
+    const TCHAR *pairs[] = {
+        TEXT("wrapper.instance.1.java.command=/bin/sh"),
+        TEXT("wrapper.instance.1.java.additional.1=-c"),
+        TEXT("wrapper.instance.1.java.mainclass=echo started; exit 3"),
+        TEXT("wrapper.instance.1.restart.delay=0"),
+        TEXT("wrapper.instance.1.max_failed_invocations=3"),
+        NULL
+    };
+    Properties *properties;
+
+    properties = tsINST_properties(pairs);
+    CU_ASSERT_PTR_NOT_NULL(properties);
+    if (!properties) {
+        return;
+    }
+    CU_ASSERT_FALSE(wrapperInstancesLoad(properties));
+    CU_ASSERT_EQUAL(wrapperInstanceCount, 1);
+    if (wrapperInstanceCount == 1) {
+        CU_ASSERT_TRUE(tsINST_pollUntil(WRAPPER_INSTANCE_STATE_STOPPED));
+        CU_ASSERT_EQUAL(wrapperInstances[0].invocations, 3);
+        CU_ASSERT_EQUAL(wrapperInstances[0].failedInvocations, 3);
+        CU_ASSERT_EQUAL(wrapperInstances[0].pid, 0);
+        CU_ASSERT_EQUAL(wrapperInstances[0].outputFd, -1);
+        CU_ASSERT_TRUE(wrapperInstancesDown());
+    }
+    wrapperInstancesDispose();
+    disposeProperties(properties);
+}
+
+/**
+ * Stopping asks the instance to exit, and kills it if it ignores the request.
+ */
+void tsINST_testStop() {
+    const TCHAR *pairs[] = {
+        TEXT("wrapper.instance.1.java.command=/bin/sh"),
+        TEXT("wrapper.instance.1.java.additional.1=-c"),
+        TEXT("wrapper.instance.1.java.mainclass=exec sleep 30"),
+        TEXT("wrapper.instance.2.java.command=/bin/sh"),
+        TEXT("wrapper.instance.2.java.additional.1=-c"),
+        TEXT("wrapper.instance.2.java.mainclass=trap '' TERM; while true; do sleep 1; done"),
+        TEXT("wrapper.instance.2.jvm_exit.timeout=1"),
+        NULL
+    };
+    Properties *properties;
+    int i;
+
+    properties = tsINST_properties(pairs);
+    CU_ASSERT_PTR_NOT_NULL(properties);
+    if (!properties) {
+        return;
+    }
+    CU_ASSERT_FALSE(wrapperInstancesLoad(properties));
+    CU_ASSERT_EQUAL(wrapperInstanceCount, 2);
+    if (wrapperInstanceCount == 2) {
+        CU_ASSERT_TRUE(tsINST_pollUntil(WRAPPER_INSTANCE_STATE_UP));
+        CU_ASSERT_EQUAL(wrapperInstances[1].state, WRAPPER_INSTANCE_STATE_UP);
+        CU_ASSERT_FALSE(wrapperInstancesDown());
+
+        /* Give the shell of the second instance the time to set its trap. */
+        wrapperSleep(200);
+        wrapperInstancesStop(wrapperGetTicks());
+        CU_ASSERT_EQUAL(wrapperInstances[0].state, WRAPPER_INSTANCE_STATE_STOPPING);
+        CU_ASSERT_EQUAL(wrapperInstances[1].state, WRAPPER_INSTANCE_STATE_STOPPING);
+        CU_ASSERT_TRUE(tsINST_pollUntil(WRAPPER_INSTANCE_STATE_STOPPED));
+        for (i = 0; (i < 500) && !wrapperInstancesDown(); i++) {
+            wrapperInstancesPoll(wrapperGetTicks());
+            wrapperSleep(10);
+        }
+        CU_ASSERT_TRUE(wrapperInstancesDown());
+        CU_ASSERT_EQUAL(wrapperInstances[1].state, WRAPPER_INSTANCE_STATE_STOPPED);
+        /* Neither is launched again. */
+        CU_ASSERT_EQUAL(wrapperInstances[0].invocations, 1);
+        CU_ASSERT_EQUAL(wrapperInstances[1].invocations, 1);
+    }
+    wrapperInstancesDispose();
+    disposeProperties(properties);
+}
+
+int tsINST_suiteInstance() {
+    CU_pSuite instanceSuite;
+
+    instanceSuite = CU_add_suite("Instance Suite", tsINST_init_wrapper, tsINST_clean_wrapper);
+    if (NULL == instanceSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(instanceSuite, "load", tsINST_testLoad);
+    CU_add_test(instanceSuite, "give up", tsINST_testGiveUp);
+    CU_add_test(instanceSuite, "stop", tsINST_testStop);
+
+    return FALSE;
+}
+#endif
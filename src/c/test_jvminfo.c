@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#include <stdlib.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_jvminfo.h"
+
+/********************************************************************
+ * JVM Info Tests
+ *******************************************************************/
+void tsJVMI_testReleaseJavaVersion() {
+    JavaVersion *version;
+    TCHAR buffer[32];
+
+    /* The value of JAVA_VERSION in the 'release' file is parsed like the output of 'java -version'. */
+    _tcsncpy(buffer, TEXT("\"17.0.9\""), 32);
+    version = parseOutputJavaVersion(buffer);
+    CU_ASSERT_PTR_NOT_NULL(version);
+    if (version) {
+        CU_ASSERT_EQUAL(version->major, 17);
+        CU_ASSERT_EQUAL(version->minor, 0);
+        CU_ASSERT_EQUAL(version->revision, 9);
+        disposeJavaVersion(version);
+    }
+
+    _tcsncpy(buffer, TEXT("\"1.8.0_392\""), 32);
+    version = parseOutputJavaVersion(buffer);
+    CU_ASSERT_PTR_NOT_NULL(version);
+    if (version) {
+        CU_ASSERT_EQUAL(version->major, 8);
+        CU_ASSERT_EQUAL(version->revision, 392);
+        disposeJavaVersion(version);
+    }
+}
+
+void tsJVMI_testReleaseJvmVendor() {
+    CU_ASSERT_EQUAL(parseReleaseJvmVendor(NULL, NULL, NULL), JVM_VENDOR_UNKNOWN);
+    CU_ASSERT_EQUAL(parseReleaseJvmVendor(TEXT("Eclipse Adoptium"), NULL, TEXT("Hotspot")), JVM_VENDOR_OPENJDK);
+    CU_ASSERT_EQUAL(parseReleaseJvmVendor(TEXT("Oracle Corporation"), NULL, NULL), JVM_VENDOR_OPENJDK);
+    CU_ASSERT_EQUAL(parseReleaseJvmVendor(TEXT("Oracle Corporation"), TEXT("commercial"), NULL), JVM_VENDOR_ORACLE);
+    CU_ASSERT_EQUAL(parseReleaseJvmVendor(TEXT("IBM Corporation"), NULL, TEXT("Openj9")), JVM_VENDOR_IBM);
+    CU_ASSERT_EQUAL(parseReleaseJvmVendor(TEXT("Eclipse OpenJ9"), NULL, TEXT("openj9")), JVM_VENDOR_IBM);
+}
+
+void tsJVMI_testReleaseJvmBits() {
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(NULL), JVM_BITS_UNKNOWN);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("x86_64")), JVM_BITS_64);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("amd64")), JVM_BITS_64);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("aarch64")), JVM_BITS_64);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("ppc64le")), JVM_BITS_64);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("s390x")), JVM_BITS_64);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("sparcv9")), JVM_BITS_64);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("x86")), JVM_BITS_32);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("i586")), JVM_BITS_32);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("arm")), JVM_BITS_32);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("mips")), JVM_BITS_UNKNOWN);
+    CU_ASSERT_EQUAL(parseReleaseJvmBits(TEXT("")), JVM_BITS_UNKNOWN);
+}
+
+int tsJVMI_suiteJvmInfo() {
+    CU_pSuite jvmInfoSuite;
+
+    jvmInfoSuite = CU_add_suite("JVM Info Suite", NULL, NULL);
+    if (NULL == jvmInfoSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(jvmInfoSuite, "release java version", tsJVMI_testReleaseJavaVersion);
+    CU_add_test(jvmInfoSuite, "release vendor", tsJVMI_testReleaseJvmVendor);
+    CU_add_test(jvmInfoSuite, "release bits", tsJVMI_testReleaseJvmBits);
+
+    return FALSE;
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+
+#include <stdlib.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_metrics.h"
+
+/********************************************************************
+ * Metrics Tests
+ *******************************************************************/
+/**
+ * Make sure that each slot starts on its own cache line.
+ */
+void tsMTRC_testMetricsSlots() {
+    wrapperMetricsSetEnabled(TRUE);
+    CU_ASSERT_EQUAL(sizeof(WrapperMetricsSlot) % WRAPPER_METRICS_CACHE_LINE, 0);
+    CU_ASSERT_EQUAL((size_t)wrapperMetricsSlots % WRAPPER_METRICS_CACHE_LINE, 0);
+    wrapperMetricsSetEnabled(FALSE);
+}
+
+/**
+ * Make sure that the counters of all threads are summed, that nothing is
+ *  counted while disabled, and that enabling the counters clears them.
+ */
+void tsMTRC_testMetricsCounters() {
+    wrapperMetricsSetEnabled(FALSE);
+    WRAPPER_METRICS_ADD(WRAPPER_THREAD_MAIN, WRAPPER_METRIC_FILTER_HITS, 1);
+    CU_ASSERT_EQUAL(wrapperMetricsGet(WRAPPER_METRIC_FILTER_HITS), 0.0);
+
+    wrapperMetricsSetEnabled(TRUE);
+    WRAPPER_METRICS_ADD(WRAPPER_THREAD_MAIN, WRAPPER_METRIC_JVM_OUTPUT_BYTES, 100);
+    WRAPPER_METRICS_ADD(WRAPPER_THREAD_JAVAIO, WRAPPER_METRIC_JVM_OUTPUT_BYTES, 20);
+    WRAPPER_METRICS_ADD(WRAPPER_THREAD_JAVAIO, WRAPPER_METRIC_JVM_OUTPUT_LINES, 1);
+    CU_ASSERT_EQUAL(wrapperMetricsGet(WRAPPER_METRIC_JVM_OUTPUT_BYTES), 120.0);
+    CU_ASSERT_EQUAL(wrapperMetricsGet(WRAPPER_METRIC_JVM_OUTPUT_LINES), 1.0);
+    CU_ASSERT_EQUAL(wrapperMetricsGet(WRAPPER_METRIC_FILTER_HITS), 0.0);
+
+    wrapperMetricsSetEnabled(TRUE);
+    CU_ASSERT_EQUAL(wrapperMetricsGet(WRAPPER_METRIC_JVM_OUTPUT_BYTES), 0.0);
+    wrapperMetricsSetEnabled(FALSE);
+}
+
+int tsMTRC_suiteMetrics() {
+    CU_pSuite metricsSuite;
+
+    metricsSuite = CU_add_suite("Metrics Suite", NULL, NULL);
+    if (NULL == metricsSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(metricsSuite, "cache line slots", tsMTRC_testMetricsSlots);
+    CU_add_test(metricsSuite, "counters", tsMTRC_testMetricsCounters);
+
+    return FALSE;
+}
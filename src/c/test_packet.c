@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_packet.h"
+
+/********************************************************************
+ * Packet Tests
+ *******************************************************************/
+/**
+ * Make sure that a packet fed one byte at a time is only complete once its
+ *  last byte has been fed, and that only the bytes of the packet are wanted.
+ */
+void tsPKT_testPacketSplit() {
+    WrapperPacketReader reader;
+    /* A code, a length of 130 as a two byte varint, and the payload. */
+    char packet[3 + 130];
+    size_t used;
+    size_t i;
+    int result = WRAPPER_PACKET_INCOMPLETE;
+
+    packet[0] = (char)110;
+    packet[1] = (char)(0x80 | (130 & 0x7f));
+    packet[2] = (char)(130 >> 7);
+    memset(packet + 3, 'x', 130);
+
+    wrapperPacketReaderInit(&reader, WRAPPER_PACKET_MAX_LENGTH);
+    for (i = 0; i < sizeof(packet); i++) {
+        CU_ASSERT_EQUAL(result, WRAPPER_PACKET_INCOMPLETE);
+        if (i >= 3) {
+            CU_ASSERT_EQUAL(wrapperPacketReaderWanted(&reader), sizeof(packet) - i);
+        } else {
+            CU_ASSERT_EQUAL(wrapperPacketReaderWanted(&reader), 1);
+        }
+        result = wrapperPacketReaderFeed(&reader, packet + i, 1, &used);
+        CU_ASSERT_EQUAL(used, 1);
+    }
+    CU_ASSERT_EQUAL(result, WRAPPER_PACKET_COMPLETE);
+    CU_ASSERT_EQUAL(reader.code, (char)110);
+    CU_ASSERT_EQUAL(strlen(reader.buffer), 130);
+
+    wrapperPacketReaderDispose(&reader);
+}
+
+/**
+ * Make sure that packets fed together are returned one at a time, and that
+ *  an empty payload is a complete packet.
+ */
+void tsPKT_testPacketConsecutive() {
+    WrapperPacketReader reader;
+    const char stream[] = { 106, 0, 107, 1, '0', 120, 3, 'a', 'b', 'c' };
+    size_t pos = 0;
+    size_t used;
+
+    wrapperPacketReaderInit(&reader, WRAPPER_PACKET_MAX_LENGTH);
+
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream + pos, sizeof(stream) - pos, &used), WRAPPER_PACKET_COMPLETE);
+    CU_ASSERT_EQUAL(used, 2);
+    CU_ASSERT_EQUAL(reader.code, 106);
+    CU_ASSERT_STRING_EQUAL(reader.buffer, "");
+    pos += used;
+
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream + pos, sizeof(stream) - pos, &used), WRAPPER_PACKET_COMPLETE);
+    CU_ASSERT_EQUAL(used, 3);
+    CU_ASSERT_EQUAL(reader.code, 107);
+    CU_ASSERT_STRING_EQUAL(reader.buffer, "0");
+    pos += used;
+
+    /* Split in the middle of the payload. */
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream + pos, 3, &used), WRAPPER_PACKET_INCOMPLETE);
+    CU_ASSERT_EQUAL(used, 3);
+    pos += used;
+    CU_ASSERT_EQUAL(wrapperPacketReaderWanted(&reader), 2);
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream + pos, sizeof(stream) - pos, &used), WRAPPER_PACKET_COMPLETE);
+    CU_ASSERT_EQUAL(used, 2);
+    CU_ASSERT_EQUAL(reader.code, 120);
+    CU_ASSERT_STRING_EQUAL(reader.buffer, "abc");
+
+    wrapperPacketReaderDispose(&reader);
+}
+
+/**
+ * Make sure that a packet longer than the maximum is rejected as soon as its
+ *  length is known, before any memory is allocated for it.
+ */
+void tsPKT_testPacketMaxLength() {
+    WrapperPacketReader reader;
+    char packet[] = { 120, (char)(0x80 | 0x01), 0x08 };   /* 1025 */
+    char *payload;
+    size_t used;
+
+    wrapperPacketReaderInit(&reader, WRAPPER_PACKET_MAX_UNVERIFIED_LENGTH);
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, packet, sizeof(packet), &used), WRAPPER_PACKET_TOO_LONG);
+    CU_ASSERT_EQUAL(reader.length, 1025);
+    CU_ASSERT_PTR_NULL(reader.buffer);
+
+    /* A payload of exactly the maximum is accepted. */
+    payload = malloc(3 + 1024);
+    if (payload) {
+        wrapperPacketReaderReset(&reader);
+        payload[0] = 120;
+        payload[1] = (char)0x80;
+        payload[2] = 0x08;
+        memset(payload + 3, 'y', 1024);
+        CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, payload, 3 + 1024, &used), WRAPPER_PACKET_COMPLETE);
+        CU_ASSERT_EQUAL(used, 3 + 1024);
+        free(payload);
+    }
+
+    /* A length of 2^32 - 1, which a JVM could use to make the Wrapper allocate 4GB. */
+    wrapperPacketReaderReset(&reader);
+    reader.maxLength = WRAPPER_PACKET_MAX_LENGTH;
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, "\x78\xff\xff\xff\xff\x0f", 6, &used), WRAPPER_PACKET_TOO_LONG);
+
+    wrapperPacketReaderDispose(&reader);
+}
+
+/**
+ * Make sure that a packet longer than the maximum is skipped when the reader
+ *  is set to discard it, and that the following packet is still read.
+ */
+void tsPKT_testPacketDiscard() {
+    WrapperPacketReader reader;
+    char stream[3 + 1025 + 3];
+    size_t pos = 0;
+    size_t used;
+
+    stream[0] = 120;
+    stream[1] = (char)(0x80 | 0x01);
+    stream[2] = 0x08;   /* 1025 */
+    memset(stream + 3, 'z', 1025);
+    stream[3 + 1025] = 107;
+    stream[3 + 1025 + 1] = 1;
+    stream[3 + 1025 + 2] = '0';
+
+    wrapperPacketReaderInit(&reader, WRAPPER_PACKET_MAX_UNVERIFIED_LENGTH);
+    reader.discardTooLong = TRUE;
+
+    /* The payload is skipped in pieces, without being stored. */
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream, 500, &used), WRAPPER_PACKET_INCOMPLETE);
+    CU_ASSERT_EQUAL(used, 500);
+    pos += used;
+    CU_ASSERT_EQUAL(wrapperPacketReaderWanted(&reader), 3 + 1025 - 500);
+    CU_ASSERT_PTR_NULL(reader.buffer);
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream + pos, sizeof(stream) - pos, &used), WRAPPER_PACKET_DISCARDED);
+    CU_ASSERT_EQUAL(used, 3 + 1025 - 500);
+    CU_ASSERT_EQUAL(reader.code, 120);
+    CU_ASSERT_EQUAL(reader.length, 1025);
+    pos += used;
+
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, stream + pos, sizeof(stream) - pos, &used), WRAPPER_PACKET_COMPLETE);
+    CU_ASSERT_EQUAL(used, 3);
+    CU_ASSERT_EQUAL(reader.code, 107);
+    CU_ASSERT_STRING_EQUAL(reader.buffer, "0");
+
+    wrapperPacketReaderDispose(&reader);
+}
+
+/**
+ * Make sure that lengths which do not fit in 32 bits are rejected.
+ */
+void tsPKT_testPacketBadLength() {
+    WrapperPacketReader reader;
+    size_t used;
+
+    wrapperPacketReaderInit(&reader, WRAPPER_PACKET_MAX_LENGTH);
+
+    /* More than 5 bytes. */
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, "\x78\x80\x80\x80\x80\x80\x01", 7, &used), WRAPPER_PACKET_BAD_LENGTH);
+    CU_ASSERT_EQUAL(used, 6);
+
+    /* 5 bytes, but 2^32. */
+    wrapperPacketReaderReset(&reader);
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, "\x78\x80\x80\x80\x80\x10", 6, &used), WRAPPER_PACKET_BAD_LENGTH);
+
+    /* The reader can be used again once reset. */
+    wrapperPacketReaderReset(&reader);
+    CU_ASSERT_EQUAL(wrapperPacketReaderFeed(&reader, "\x6a\x00", 2, &used), WRAPPER_PACKET_COMPLETE);
+
+    wrapperPacketReaderDispose(&reader);
+}
+
+int tsPKT_suitePacket() {
+    CU_pSuite packetSuite;
+
+    packetSuite = CU_add_suite("Packet Suite", NULL, NULL);
+    if (NULL == packetSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(packetSuite, "split packet", tsPKT_testPacketSplit);
+    CU_add_test(packetSuite, "consecutive packets", tsPKT_testPacketConsecutive);
+    CU_add_test(packetSuite, "maximum length", tsPKT_testPacketMaxLength);
+    CU_add_test(packetSuite, "discarded packet", tsPKT_testPacketDiscard);
+    CU_add_test(packetSuite, "bad length", tsPKT_testPacketBadLength);
+
+    return FALSE;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#ifdef LINUX
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_procstat.h"
+
+/********************************************************************
+ * ProcStat Tests
+ *******************************************************************/
+/**
+ * Sample the test process itself.  The first sample gives the sizes, the
+ *  second one also the rates.
+ */
+void tsPSTA_testProcStatSelf() {
+    WrapperProcStat procStat;
+    volatile double sum = 0;
+    int i;
+
+    CU_ASSERT_FALSE(wrapperProcStatOpen(&procStat, "/proc", (int)getpid()));
+    CU_ASSERT_FALSE(wrapperProcStatSample(&procStat));
+    CU_ASSERT(procStat.rssBytes > 0);
+    CU_ASSERT(procStat.threads >= 1);
+    CU_ASSERT(procStat.fds >= 3);
+    CU_ASSERT_EQUAL(procStat.cpuPercent, -1.0);
+    CU_ASSERT_EQUAL(procStat.readBytesPerSec, -1.0);
+
+    for (i = 0; i < 10000000; i++) {
+        sum += i;
+    }
+    CU_ASSERT_FALSE(wrapperProcStatSample(&procStat));
+    CU_ASSERT(procStat.cpuPercent >= 0);
+    if (procStat.ioFd >= 0) {
+        CU_ASSERT(procStat.readBytesPerSec >= 0);
+        CU_ASSERT(procStat.writeBytesPerSec >= 0);
+    } else {
+        /* /proc/self/io is not readable, as for a JVM running as another user. */
+        CU_ASSERT_EQUAL(procStat.readBytesPerSec, -1.0);
+        CU_ASSERT_EQUAL(procStat.writeBytesPerSec, -1.0);
+    }
+    wrapperProcStatClose(&procStat);
+}
+
+/**
+ * A process which does not exist can not be opened.
+ */
+void tsPSTA_testProcStatMissing() {
+    WrapperProcStat procStat;
+
+    CU_ASSERT_TRUE(wrapperProcStatOpen(&procStat, "/nonexistent", (int)getpid()));
+}
+
+int tsPSTA_suiteProcStat() {
+    CU_pSuite procStatSuite;
+
+    procStatSuite = CU_add_suite("ProcStat Suite", NULL, NULL);
+    if (NULL == procStatSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(procStatSuite, "self", tsPSTA_testProcStatSelf);
+    CU_add_test(procStatSuite, "missing", tsPSTA_testProcStatMissing);
+
+    return FALSE;
+}
+#endif
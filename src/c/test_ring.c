@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#ifdef LINUX
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_ring.h"
+
+/********************************************************************
+ * Ring Tests
+ *******************************************************************/
+#define TSRING_PATH_LEN 64
+char tsRING_path[TSRING_PATH_LEN];
+
+/**
+ * Creates a ring of the minimum size and attaches a second mapping to it, as the JVM would.
+ */
+int tsRING_open(WrapperRing *consumer, WrapperRing *producer) {
+    snprintf(tsRING_path, TSRING_PATH_LEN, "/tmp/wrapper-test-ring-XXXXXX");
+    if (wrapperRingCreate(consumer, tsRING_path, 1)) {
+        CU_FAIL("Unable to create the ring");
+        return TRUE;
+    }
+    if (wrapperRingAttach(producer, tsRING_path)) {
+        CU_FAIL("Unable to attach the ring");
+        wrapperRingDetach(consumer);
+        unlink(tsRING_path);
+        return TRUE;
+    }
+    unlink(tsRING_path);
+    return FALSE;
+}
+
+/**
+ * Make sure that records come out in the order they were written, with their code and data.
+ */
+void tsRING_testRingOrder() {
+    WrapperRing consumer;
+    WrapperRing producer;
+    char buffer[32];
+    char code;
+    const char *data;
+    size_t len;
+    int i;
+
+    if (tsRING_open(&consumer, &producer)) {
+        return;
+    }
+    CU_ASSERT_EQUAL(consumer.mask + 1, WRAPPER_RING_MIN_SIZE);
+    CU_ASSERT_TRUE(wrapperRingPeek(&consumer, &code, &data, &len));
+
+    for (i = 0; i < 100; i++) {
+        snprintf(buffer, 32, "message %d", i);
+        CU_ASSERT_FALSE(wrapperRingWrite(&producer, (char)(100 + i), buffer, strlen(buffer)));
+    }
+    for (i = 0; i < 100; i++) {
+        snprintf(buffer, 32, "message %d", i);
+        if (wrapperRingPeek(&consumer, &code, &data, &len)) {
+            CU_FAIL("Ring empty too early");
+            break;
+        }
+        CU_ASSERT_EQUAL(code, (char)(100 + i));
+        CU_ASSERT_EQUAL(len, strlen(buffer));
+        CU_ASSERT_EQUAL(strcmp(data, buffer), 0);
+        wrapperRingRelease(&consumer);
+    }
+    CU_ASSERT_TRUE(wrapperRingPeek(&consumer, &code, &data, &len));
+
+    wrapperRingDetach(&producer);
+    wrapperRingDetach(&consumer);
+}
+
+/**
+ * Make sure that a full ring refuses records, and that records wrapping around its end are intact.
+ */
+void tsRING_testRingFullAndWrap() {
+    WrapperRing consumer;
+    WrapperRing producer;
+    char *buffer;
+    char code;
+    const char *data;
+    size_t len;
+    size_t recordLen = 1000;
+    int written = 0;
+    int i;
+
+    if (tsRING_open(&consumer, &producer)) {
+        return;
+    }
+    buffer = malloc(WRAPPER_RING_MIN_SIZE);
+    if (!buffer) {
+        CU_FAIL("Out of memory RFW1");
+        wrapperRingDetach(&producer);
+        wrapperRingDetach(&consumer);
+        return;
+    }
+
+    /* A record larger than the ring can never be written. */
+    memset(buffer, 'x', WRAPPER_RING_MIN_SIZE);
+    CU_ASSERT_TRUE(wrapperRingWrite(&producer, 'a', buffer, WRAPPER_RING_MIN_SIZE));
+
+    /* Fill the ring. */
+    while (!wrapperRingWrite(&producer, 'a', buffer, recordLen)) {
+        written++;
+    }
+    CU_ASSERT_EQUAL(written, WRAPPER_RING_MIN_SIZE / 1008);
+
+    /* Free half of it and keep going so that records wrap around the end. */
+    for (i = 0; i < written / 2; i++) {
+        CU_ASSERT_FALSE(wrapperRingPeek(&consumer, &code, &data, &len));
+        wrapperRingRelease(&consumer);
+    }
+    for (i = 0; i < written; i++) {
+        memset(buffer, 'a' + (i % 26), recordLen);
+        if (wrapperRingWrite(&producer, 'b', buffer, recordLen)) {
+            /* Full again. Read everything before continuing. */
+            while (!wrapperRingPeek(&consumer, &code, &data, &len)) {
+                CU_ASSERT_EQUAL(len, recordLen);
+                CU_ASSERT_TRUE((data[0] == data[recordLen - 1]) && (data[recordLen] == '\0'));
+                wrapperRingRelease(&consumer);
+            }
+            i--;
+        }
+    }
+    while (!wrapperRingPeek(&consumer, &code, &data, &len)) {
+        CU_ASSERT_EQUAL(code, 'b');
+        CU_ASSERT_TRUE((data[0] == data[recordLen - 1]) && (data[recordLen] == '\0'));
+        wrapperRingRelease(&consumer);
+    }
+
+    free(buffer);
+    wrapperRingDetach(&producer);
+    wrapperRingDetach(&consumer);
+}
+
+/**
+ * Make sure that a file which is not a ring is rejected.
+ */
+void tsRING_testRingAttachInvalid() {
+    WrapperRing ring;
+    FILE *file;
+
+    snprintf(tsRING_path, TSRING_PATH_LEN, "/tmp/wrapper-test-ring-%d", (int)getpid());
+    file = fopen(tsRING_path, "w");
+    if (!file) {
+        CU_FAIL("Unable to create the file");
+        return;
+    }
+    fprintf(file, "This is not a ring, but it is long enough to be mistaken for its header if the magic was not checked.  ");
+    fprintf(file, "This is not a ring, but it is long enough to be mistaken for its header if the magic was not checked.  ");
+    fclose(file);
+
+    CU_ASSERT_TRUE(wrapperRingAttach(&ring, tsRING_path));
+    CU_ASSERT_PTR_NULL(ring.header);
+    unlink(tsRING_path);
+}
+
+/**
+ * Make sure that a record which would end past the data area is never returned, and that nothing is read after it.
+ */
+void tsRING_testRingRecordPastEnd() {
+    WrapperRing consumer;
+    WrapperRing producer;
+    char code;
+    const char *data;
+    size_t len;
+    unsigned int capacity;
+    unsigned int pos;
+
+    if (tsRING_open(&consumer, &producer)) {
+        return;
+    }
+    capacity = consumer.mask + 1;
+
+    CU_ASSERT_FALSE(wrapperRingWrite(&producer, 'a', "01234567890123456789", 20));
+    CU_ASSERT_FALSE(wrapperRingPeek(&consumer, &code, &data, &len));
+    wrapperRingRelease(&consumer);
+    pos = consumer.readPos;
+
+    /* Act as a broken producer: a record claiming the rest of the data area and more. */
+    *((unsigned int *)(producer.data + pos)) = capacity - pos;
+    producer.header->head = pos + capacity;
+    CU_ASSERT_TRUE(wrapperRingPeek(&consumer, &code, &data, &len));
+    CU_ASSERT_TRUE(consumer.corrupt);
+
+    /* A valid record written afterwards is not read either. */
+    producer.header->head = pos;
+    CU_ASSERT_FALSE(wrapperRingWrite(&producer, 'b', "valid", 5));
+    CU_ASSERT_TRUE(wrapperRingPeek(&consumer, &code, &data, &len));
+
+    wrapperRingDetach(&producer);
+    wrapperRingDetach(&consumer);
+}
+
+/**
+ * Make sure that a truncated ring file is detected before the mapping is read.
+ */
+void tsRING_testRingTruncated() {
+    WrapperRing consumer;
+    WrapperRing producer;
+
+    if (tsRING_open(&consumer, &producer)) {
+        return;
+    }
+
+    CU_ASSERT_FALSE(wrapperRingCheck(&consumer));
+    CU_ASSERT_EQUAL(ftruncate(consumer.fd, 0), 0);
+    CU_ASSERT_TRUE(wrapperRingCheck(&consumer));
+
+    wrapperRingDetach(&producer);
+    wrapperRingDetach(&consumer);
+}
+
+/**
+ * Make sure that only the records written before a captured head are reported as such.
+ */
+void tsRING_testRingReadBefore() {
+    WrapperRing consumer;
+    WrapperRing producer;
+    char code;
+    const char *data;
+    size_t len;
+    unsigned int end;
+    int count = 0;
+
+    if (tsRING_open(&consumer, &producer)) {
+        return;
+    }
+
+    CU_ASSERT_FALSE(wrapperRingReadBefore(&consumer, wrapperRingHead(&consumer)));
+    CU_ASSERT_FALSE(wrapperRingWrite(&producer, 'a', "first", 5));
+    CU_ASSERT_FALSE(wrapperRingWrite(&producer, 'b', "second", 6));
+    end = wrapperRingHead(&consumer);
+    CU_ASSERT_FALSE(wrapperRingWrite(&producer, 'c', "third", 5));
+
+    while (wrapperRingReadBefore(&consumer, end) && !wrapperRingPeek(&consumer, &code, &data, &len)) {
+        wrapperRingRelease(&consumer);
+        count++;
+    }
+    CU_ASSERT_EQUAL(count, 2);
+    CU_ASSERT_FALSE(wrapperRingPeek(&consumer, &code, &data, &len));
+    CU_ASSERT_EQUAL(code, 'c');
+
+    wrapperRingDetach(&producer);
+    wrapperRingDetach(&consumer);
+}
+
+int tsRING_suiteRing() {
+    CU_pSuite ringSuite;
+
+    ringSuite = CU_add_suite("Ring Suite", NULL, NULL);
+    if (NULL == ringSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(ringSuite, "record order", tsRING_testRingOrder);
+    CU_add_test(ringSuite, "full and wrapped ring", tsRING_testRingFullAndWrap);
+    CU_add_test(ringSuite, "invalid ring file", tsRING_testRingAttachInvalid);
+    CU_add_test(ringSuite, "record past the end", tsRING_testRingRecordPastEnd);
+    CU_add_test(ringSuite, "truncated ring file", tsRING_testRingTruncated);
+    CU_add_test(ringSuite, "records before a position", tsRING_testRingReadBefore);
+
+    return FALSE;
+}
+#endif
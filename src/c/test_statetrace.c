@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper.h"
+#include "wrapper_statetrace.h"
+
+/********************************************************************
+ * State Trace Tests
+ *******************************************************************/
+/**
+ * Make sure that the ring keeps the last transitions, oldest first, once it
+ *  has wrapped.
+ */
+void tsSTRC_testStateTraceRing() {
+    WrapperStateTrace trace;
+    int i;
+
+    CU_ASSERT_FALSE(wrapperStateTraceInit(&trace, 4, 0.0));
+    CU_ASSERT_EQUAL(wrapperStateTraceSize(&trace), 0);
+
+    for (i = 0; i < 6; i++) {
+        wrapperStateTraceAdd(&trace, 1000.0 * i, WRAPPER_STATE_TRACE_WRAPPER, WRAPPER_WSTATE_STARTING, WRAPPER_WSTATE_STARTED, WRAPPER_STATE_TRACE_CAUSE_NONE, i);
+    }
+    CU_ASSERT_EQUAL(trace.count, 6);
+    CU_ASSERT_EQUAL(wrapperStateTraceSize(&trace), 4);
+    for (i = 0; i < 4; i++) {
+        CU_ASSERT_EQUAL(wrapperStateTraceGet(&trace, i)->jvmId, i + 2);
+    }
+
+    wrapperStateTraceDispose(&trace);
+}
+
+/**
+ * Make sure that the time spent in each state of a JVM is added to the right
+ *  phase, and that the phases are recorded once the JVM is cleaned up.
+ */
+void tsSTRC_testStateTraceLifecycle() {
+    WrapperStateTrace trace;
+    int jStates[] = { WRAPPER_JSTATE_DOWN_CLEAN, WRAPPER_JSTATE_LAUNCH, WRAPPER_JSTATE_LAUNCHING, WRAPPER_JSTATE_LAUNCHED,
+                      WRAPPER_JSTATE_STARTING, WRAPPER_JSTATE_STARTED, WRAPPER_JSTATE_STOP, WRAPPER_JSTATE_STOPPING,
+                      WRAPPER_JSTATE_STOPPED, WRAPPER_JSTATE_KILLING, WRAPPER_JSTATE_KILL, WRAPPER_JSTATE_KILLED,
+                      WRAPPER_JSTATE_DOWN_CHECK, WRAPPER_JSTATE_DOWN_CLEAN };
+    double millis[] = { 0, 100, 1000, 3000, 4000, 9000, 20000, 20500, 30000, 31000, 33000, 33100, 34000, 35000 };
+    int i;
+    int ended = FALSE;
+
+    CU_ASSERT_FALSE(wrapperStateTraceInit(&trace, 64, 0.0));
+
+    for (i = 1; i < (int)(sizeof(jStates) / sizeof(int)); i++) {
+        CU_ASSERT_FALSE(ended);
+        ended = wrapperStateTraceAdd(&trace, millis[i] * 1000.0, WRAPPER_STATE_TRACE_JAVA, jStates[i - 1], jStates[i], WRAPPER_STATE_TRACE_CAUSE_NONE, 1);
+    }
+    CU_ASSERT_TRUE(ended);
+    CU_ASSERT_EQUAL(trace.lifecycleJvmId, 1);
+    CU_ASSERT_DOUBLE_EQUAL(trace.lifecycleMicros[WRAPPER_STATE_TRACE_LAUNCHING], 3900000.0, 0.5);
+    CU_ASSERT_DOUBLE_EQUAL(trace.lifecycleMicros[WRAPPER_STATE_TRACE_STARTING], 5000000.0, 0.5);
+    CU_ASSERT_DOUBLE_EQUAL(trace.lifecycleMicros[WRAPPER_STATE_TRACE_STOPPING], 11000000.0, 0.5);
+    CU_ASSERT_DOUBLE_EQUAL(trace.lifecycleMicros[WRAPPER_STATE_TRACE_KILLING], 3000000.0, 0.5);
+
+    CU_ASSERT_EQUAL(trace.phaseMillis[WRAPPER_STATE_TRACE_STARTING].count, 1);
+    CU_ASSERT_EQUAL(trace.phaseMillis[WRAPPER_STATE_TRACE_STARTING].max, 5000);
+    CU_ASSERT_EQUAL(trace.phaseMillis[WRAPPER_STATE_TRACE_KILLING].max, 3000);
+
+    /* Transitions of the Wrapper do not count towards the JVM phases. */
+    CU_ASSERT_FALSE(wrapperStateTraceAdd(&trace, 40000000.0, WRAPPER_STATE_TRACE_WRAPPER, WRAPPER_WSTATE_STOPPING, WRAPPER_WSTATE_STOPPED, WRAPPER_STATE_TRACE_CAUSE_STOP, 1));
+    CU_ASSERT_EQUAL(trace.phaseMillis[WRAPPER_STATE_TRACE_STARTING].count, 1);
+
+    wrapperStateTraceDispose(&trace);
+}
+
+/**
+ * Make sure that only the transitions with a cause are given a name.
+ */
+void tsSTRC_testStateTraceCauseNames() {
+    CU_ASSERT_PTR_NULL(wrapperStateTraceGetCauseName(WRAPPER_STATE_TRACE_CAUSE_NONE));
+    CU_ASSERT_TRUE(_tcscmp(wrapperStateTraceGetCauseName(WRAPPER_STATE_TRACE_CAUSE_TIMEOUT), TEXT("timeout")) == 0);
+    CU_ASSERT_TRUE(_tcscmp(wrapperStateTraceGetCauseName(WRAPPER_STATE_TRACE_CAUSE_RESTART), TEXT("restart")) == 0);
+    CU_ASSERT_TRUE(_tcscmp(wrapperStateTraceGetCauseName(WRAPPER_STATE_TRACE_CAUSE_STOP), TEXT("stop")) == 0);
+    CU_ASSERT_TRUE(_tcscmp(wrapperStateTraceGetPhaseName(WRAPPER_STATE_TRACE_KILLING), TEXT("killing")) == 0);
+}
+
+int tsSTRC_suiteStateTrace() {
+    CU_pSuite stateTraceSuite;
+
+    stateTraceSuite = CU_add_suite("State Trace Suite", NULL, NULL);
+    if (NULL == stateTraceSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(stateTraceSuite, "ring", tsSTRC_testStateTraceRing);
+    CU_add_test(stateTraceSuite, "lifecycle", tsSTRC_testStateTraceLifecycle);
+    CU_add_test(stateTraceSuite, "cause names", tsSTRC_testStateTraceCauseNames);
+
+    return FALSE;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CUnit/Basic.h"
+#include "wrapper_i18n.h"
+#include "wrapper_zip.h"
+
+/********************************************************************
+ * Zip Tests
+ *******************************************************************/
+#define TSZIP_JAR_FILE  "test_zip.jar"
+
+/**
+ * A jar with a deflated manifest and a stored class, as written by Python's
+ *  zipfile module.  The manifest is compressed with dynamic Huffman codes.
+ */
+static const unsigned char tsZIP_jar[] = {
+    0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x5a, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4d, 0x45,
+    0x54, 0x41, 0x2d, 0x49, 0x4e, 0x46, 0x2f, 0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x08,
+    0x00, 0x00, 0x00, 0x21, 0x5a, 0x4c, 0xb2, 0x23, 0x29, 0x97, 0x00, 0x00, 0x00, 0xd7, 0x00, 0x00,
+    0x00, 0x14, 0x00, 0x00, 0x00, 0x4d, 0x45, 0x54, 0x41, 0x2d, 0x49, 0x4e, 0x46, 0x2f, 0x4d, 0x41,
+    0x4e, 0x49, 0x46, 0x45, 0x53, 0x54, 0x2e, 0x4d, 0x46, 0x5d, 0x8e, 0xbb, 0x0e, 0xc2, 0x30, 0x0c,
+    0x45, 0x77, 0x4b, 0xfe, 0x87, 0xfc, 0x80, 0x53, 0x1e, 0x12, 0x43, 0x56, 0xe6, 0x22, 0x24, 0x24,
+    0x76, 0x43, 0xdd, 0x36, 0x28, 0x4d, 0x50, 0x12, 0x5e, 0x7f, 0x4f, 0x1a, 0xc1, 0x00, 0x9b, 0x75,
+    0x7d, 0x74, 0xef, 0x69, 0xd9, 0xdb, 0x5e, 0x52, 0xa6, 0xa3, 0xc4, 0x64, 0x83, 0x37, 0x6a, 0xa9,
+    0x17, 0x08, 0x2d, 0x5b, 0x4f, 0x5b, 0xc7, 0x29, 0x19, 0x15, 0xe2, 0xa0, 0xe5, 0xc9, 0xd3, 0xd5,
+    0x89, 0x9e, 0x73, 0x84, 0xfa, 0xa0, 0x3d, 0xe7, 0xd1, 0x28, 0x67, 0x4f, 0x4d, 0x6f, 0x63, 0x69,
+    0x28, 0x57, 0xe4, 0xf8, 0xa2, 0x87, 0xcd, 0x23, 0x31, 0xb9, 0xe0, 0x07, 0xf2, 0x3c, 0x89, 0xbe,
+    0x70, 0xac, 0x58, 0x92, 0x73, 0xf0, 0xdd, 0x1f, 0x87, 0xa0, 0x7e, 0x51, 0x04, 0x3b, 0x4f, 0x4d,
+    0xe2, 0x33, 0xe7, 0x62, 0x44, 0xf7, 0xaf, 0xd9, 0x5a, 0x6f, 0xf4, 0x0a, 0x01, 0x61, 0x57, 0xd0,
+    0xea, 0xd5, 0x7c, 0xbc, 0x1a, 0x84, 0x83, 0xb0, 0x93, 0xce, 0xa8, 0x1c, 0x6f, 0x82, 0xf0, 0x06,
+    0x50, 0x4b, 0x03, 0x04, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x5a, 0x1d, 0x57,
+    0x1d, 0xb5, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00, 0x6f, 0x72,
+    0x67, 0x2f, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2f, 0x4d, 0x61, 0x69, 0x6e, 0x2e, 0x63,
+    0x6c, 0x61, 0x73, 0x73, 0xca, 0xfe, 0xba, 0xbe, 0x50, 0x4b, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x5a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x80, 0x01, 0x00, 0x00, 0x00, 0x00, 0x4d, 0x45, 0x54, 0x41, 0x2d, 0x49, 0x4e, 0x46, 0x2f, 0x50,
+    0x4b, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x21, 0x5a, 0x4c,
+    0xb2, 0x23, 0x29, 0x97, 0x00, 0x00, 0x00, 0xd7, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0x27, 0x00, 0x00, 0x00, 0x4d, 0x45, 0x54,
+    0x41, 0x2d, 0x49, 0x4e, 0x46, 0x2f, 0x4d, 0x41, 0x4e, 0x49, 0x46, 0x45, 0x53, 0x54, 0x2e, 0x4d,
+    0x46, 0x50, 0x4b, 0x01, 0x02, 0x14, 0x03, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21,
+    0x5a, 0x1d, 0x57, 0x1d, 0xb5, 0x04, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x01, 0xf0, 0x00, 0x00, 0x00, 0x6f,
+    0x72, 0x67, 0x2f, 0x65, 0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2f, 0x4d, 0x61, 0x69, 0x6e, 0x2e,
+    0x63, 0x6c, 0x61, 0x73, 0x73, 0x50, 0x4b, 0x05, 0x06, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x03,
+    0x00, 0xbd, 0x00, 0x00, 0x00, 0x28, 0x01, 0x00, 0x00, 0x00, 0x00
+};
+
+static const char *tsZIP_manifest =
+    "Manifest-Version: 1.0\r\n"
+    "Main-Class: org.example.Main\r\n"
+    "Class-Path: lib/first-library-with-a-long-name.jar lib/second-library-with-a\r\n"
+    " -long-name.jar\r\n"
+    "implementation-version: 3.6.2\r\n"
+    "\r\n"
+    "Name: org/example/\r\n"
+    "Sealed: true\r\n";
+
+static int tsZIP_writeJar(const unsigned char *data, size_t size) {
+    FILE *file;
+    size_t written;
+
+    file = fopen(TSZIP_JAR_FILE, "wb");
+    if (!file) {
+        return TRUE;
+    }
+    written = fwrite(data, 1, size, file);
+    fclose(file);
+    return (written != size) ? TRUE : FALSE;
+}
+
+void tsZIP_testCrc32() {
+    CU_ASSERT_EQUAL(wrapperZipCrc32((const unsigned char *)"", 0), 0);
+    CU_ASSERT_EQUAL(wrapperZipCrc32((const unsigned char *)"123456789", 9), 0xcbf43926);
+}
+
+void tsZIP_testInflate() {
+    /* "abcabcabcabcabcabcabc" with fixed Huffman codes. */
+    static const unsigned char fixed[] = { 0x4b, 0x4c, 0x4a, 0x4e, 0xc4, 0x40, 0x00 };
+    /* "stored" in a stored block. */
+    static const unsigned char stored[] = { 0x01, 0x06, 0x00, 0xf9, 0xff, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64 };
+    /* A stored block whose length is not followed by its complement. */
+    static const unsigned char corrupt[] = { 0x01, 0x06, 0x00, 0xf9, 0xfe, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64 };
+    unsigned char out[64];
+
+    CU_ASSERT_EQUAL(wrapperZipInflate(fixed, sizeof(fixed), out, sizeof(out)), 21);
+    CU_ASSERT_EQUAL(memcmp(out, "abcabcabcabcabcabcabc", 21), 0);
+
+    CU_ASSERT_EQUAL(wrapperZipInflate(stored, sizeof(stored), out, sizeof(out)), 6);
+    CU_ASSERT_EQUAL(memcmp(out, "stored", 6), 0);
+
+    /* The output does not fit. */
+    CU_ASSERT_EQUAL(wrapperZipInflate(fixed, sizeof(fixed), out, 20), -1);
+    CU_ASSERT_EQUAL(wrapperZipInflate(stored, sizeof(stored), out, 5), -1);
+
+    /* Truncated or corrupt input. */
+    CU_ASSERT_EQUAL(wrapperZipInflate(fixed, sizeof(fixed) - 2, out, sizeof(out)), -1);
+    CU_ASSERT_EQUAL(wrapperZipInflate(corrupt, sizeof(corrupt), out, sizeof(out)), -1);
+    CU_ASSERT_EQUAL(wrapperZipInflate(fixed, 0, out, sizeof(out)), -1);
+}
+
+void tsZIP_testEntries() {
+    WrapperZip zip;
+    char *data;
+    size_t size = 0;
+
+    CU_ASSERT_FALSE(tsZIP_writeJar(tsZIP_jar, sizeof(tsZIP_jar)));
+    CU_ASSERT_FALSE(wrapperZipOpen(&zip, TEXT("test_zip.jar")));
+    CU_ASSERT_EQUAL(zip.entryCount, 3);
+
+    CU_ASSERT_TRUE(wrapperZipHasEntry(&zip, "META-INF/MANIFEST.MF"));
+    CU_ASSERT_TRUE(wrapperZipHasEntry(&zip, "org/example/Main.class"));
+    CU_ASSERT_FALSE(wrapperZipHasEntry(&zip, "org/example/Main"));
+    CU_ASSERT_FALSE(wrapperZipHasEntry(&zip, "org/example/main.class"));
+
+    data = wrapperZipReadEntry(&zip, "META-INF/MANIFEST.MF", 4096, &size);
+    CU_ASSERT_PTR_NOT_NULL(data);
+    if (data) {
+        CU_ASSERT_EQUAL(size, strlen(tsZIP_manifest));
+        CU_ASSERT_STRING_EQUAL(data, tsZIP_manifest);
+        free(data);
+    }
+
+    data = wrapperZipReadEntry(&zip, "org/example/Main.class", 4096, &size);
+    CU_ASSERT_PTR_NOT_NULL(data);
+    if (data) {
+        CU_ASSERT_EQUAL(size, 4);
+        CU_ASSERT_EQUAL(memcmp(data, "\xca\xfe\xba\xbe", 4), 0);
+        free(data);
+    }
+
+    /* Larger than allowed. */
+    CU_ASSERT_PTR_NULL(wrapperZipReadEntry(&zip, "META-INF/MANIFEST.MF", 100, NULL));
+    CU_ASSERT_PTR_NULL(wrapperZipReadEntry(&zip, "org/example/Other.class", 4096, NULL));
+
+    wrapperZipClose(&zip);
+
+    /* Not a ZIP file: the end of central directory is missing. */
+    CU_ASSERT_FALSE(tsZIP_writeJar(tsZIP_jar, sizeof(tsZIP_jar) - 1));
+    CU_ASSERT_TRUE(wrapperZipOpen(&zip, TEXT("test_zip.jar")));
+
+    remove(TSZIP_JAR_FILE);
+    CU_ASSERT_TRUE(wrapperZipOpen(&zip, TEXT("test_zip.jar")));
+}
+
+/**
+ * Make sure that the sizes in a corrupt central directory are checked
+ *  against the file before anything is allocated.
+ */
+void tsZIP_testCorruptSizes() {
+    unsigned char jar[sizeof(tsZIP_jar)];
+    WrapperZip zip;
+
+    memcpy(jar, tsZIP_jar, sizeof(jar));
+    /* The compressed size of the manifest, at the offset of its central directory header + 20. */
+    jar[371] = 0xf0;
+    jar[372] = 0xff;
+    jar[373] = 0xff;
+    jar[374] = 0x7f;
+    /* The compressed size of the stored class, which must be equal to its size. */
+    jar[437] = 0x05;
+
+    CU_ASSERT_FALSE(tsZIP_writeJar(jar, sizeof(jar)));
+    CU_ASSERT_FALSE(wrapperZipOpen(&zip, TEXT("test_zip.jar")));
+    CU_ASSERT_EQUAL(zip.fileSize, sizeof(jar));
+    CU_ASSERT_PTR_NULL(wrapperZipReadEntry(&zip, "META-INF/MANIFEST.MF", 4096, NULL));
+    CU_ASSERT_PTR_NULL(wrapperZipReadEntry(&zip, "org/example/Main.class", 4096, NULL));
+    wrapperZipClose(&zip);
+    remove(TSZIP_JAR_FILE);
+}
+
+void tsZIP_testManifest() {
+    char *value;
+
+    value = wrapperManifestGetAttribute(tsZIP_manifest, "Main-Class");
+    CU_ASSERT_PTR_NOT_NULL(value);
+    if (value) {
+        CU_ASSERT_STRING_EQUAL(value, "org.example.Main");
+        free(value);
+    }
+
+    /* Continuation line. */
+    value = wrapperManifestGetAttribute(tsZIP_manifest, "Class-Path");
+    CU_ASSERT_PTR_NOT_NULL(value);
+    if (value) {
+        CU_ASSERT_STRING_EQUAL(value, "lib/first-library-with-a-long-name.jar lib/second-library-with-a-long-name.jar");
+        free(value);
+    }
+
+    /* Names are not case sensitive. */
+    value = wrapperManifestGetAttribute(tsZIP_manifest, "Implementation-Version");
+    CU_ASSERT_PTR_NOT_NULL(value);
+    if (value) {
+        CU_ASSERT_STRING_EQUAL(value, "3.6.2");
+        free(value);
+    }
+
+    /* Only the main section is searched. */
+    CU_ASSERT_PTR_NULL(wrapperManifestGetAttribute(tsZIP_manifest, "Sealed"));
+    CU_ASSERT_PTR_NULL(wrapperManifestGetAttribute(tsZIP_manifest, "Main"));
+    CU_ASSERT_PTR_NULL(wrapperManifestGetAttribute("Main-Class:org.example.Main\n", "Main-Class"));
+
+    value = wrapperManifestGetAttribute("Main-Class: a.B\n", "Main-Class");
+    CU_ASSERT_PTR_NOT_NULL(value);
+    if (value) {
+        CU_ASSERT_STRING_EQUAL(value, "a.B");
+        free(value);
+    }
+}
+
+int tsZIP_suiteZip() {
+    CU_pSuite zipSuite;
+
+    zipSuite = CU_add_suite("Zip Suite", NULL, NULL);
+    if (NULL == zipSuite) {
+        return CU_get_error();
+    }
+
+    CU_add_test(zipSuite, "crc32", tsZIP_testCrc32);
+    CU_add_test(zipSuite, "inflate", tsZIP_testInflate);
+    CU_add_test(zipSuite, "entries", tsZIP_testEntries);
+    CU_add_test(zipSuite, "corrupt sizes", tsZIP_testCorruptSizes);
+    CU_add_test(zipSuite, "manifest", tsZIP_testManifest);
+
+    return FALSE;
+}
@@ -113,6 +113,82 @@ int main(int argc, char **cargv) {
         goto error;
     }
 
+    if (tsHIST_suiteHistogram()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsPKT_suitePacket()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsMTRC_suiteMetrics()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsZIP_suiteZip()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsJVMI_suiteJvmInfo()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsSTRC_suiteStateTrace()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+#ifndef WIN32
+    if (tsCTRL_suiteControl()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsINST_suiteInstance()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+#endif
+
+#ifdef LINUX
+    if (tsRING_suiteRing()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsPSTA_suiteProcStat()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsCGRP_suiteCgroup()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+
+    if (tsFWAT_suiteFileWatch()) {
+        CU_cleanup_registry();
+        errorCode = CU_get_error();
+        goto error;
+    }
+#endif
+
     if (argc < 2) {
         showHelp(argv[0]);
         errorCode = 1;
@@ -19,5 +19,21 @@ extern int tsEX_suiteExample();
 extern int tsFLTR_suiteFilter();
 extern int tsJAP_suiteJavaAdditionalParam();
 extern int tsHASH_suiteHashMap();
+extern int tsHIST_suiteHistogram();
+extern int tsPKT_suitePacket();
+extern int tsMTRC_suiteMetrics();
+extern int tsZIP_suiteZip();
+extern int tsJVMI_suiteJvmInfo();
+extern int tsSTRC_suiteStateTrace();
+#ifndef WIN32
+extern int tsCTRL_suiteControl();
+extern int tsINST_suiteInstance();
+#endif
+#ifdef LINUX
+extern int tsRING_suiteRing();
+extern int tsPSTA_suiteProcStat();
+extern int tsCGRP_suiteCgroup();
+extern int tsFWAT_suiteFileWatch();
+#endif
 
 #endif
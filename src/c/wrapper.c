@@ -42,6 +42,7 @@
 
 #include <errno.h>
 #include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -61,9 +62,19 @@
 #include "wrapper_file.h"
 #ifndef WIN32
  #include "wrapper_ulimit.h"
+ #include "wrapper_instance.h"
 #endif
 #include "wrapper_secure_file.h"
 #include "wrapper_cipher.h"
+#include "wrapper_histogram.h"
+#include "wrapper_packet.h"
+#include "wrapper_metrics.h"
+#include "wrapper_profile.h"
+#ifdef LINUX
+ #include "wrapper_ring.h"
+ #include "wrapper_procstat.h"
+ #include "wrapper_cgroup.h"
+#endif
 
 #ifdef WIN32
  #include <direct.h>
@@ -107,6 +118,7 @@
  #include <pthread.h>
  #include <grp.h>
  #include <sys/socket.h>
+ #include <sys/un.h>
  #include <sys/time.h>
  #include <netinet/in.h>
  #include <arpa/inet.h>
@@ -157,6 +169,20 @@ HANDLE tickMutexHandle = NULL;
 pthread_mutex_t tickMutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
+/* Handoff of the held back JVM output to the javaio thread when the JVM exits.
+ *  The state is protected by the mutex, and the condition or event is signaled once the flush is done. */
+#define JAVAIO_FLUSH_NONE       0
+#define JAVAIO_FLUSH_REQUESTED  1
+#define JAVAIO_FLUSH_DONE       2
+int javaIOFlushState = JAVAIO_FLUSH_NONE;
+#ifdef WIN32
+HANDLE javaIOFlushMutexHandle = NULL;
+HANDLE javaIOFlushEventHandle = NULL;
+#else
+pthread_mutex_t javaIOFlushMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t javaIOFlushCond = PTHREAD_COND_INITIALIZER;
+#endif
+
 /* Server Pipe Handles. */
 HANDLE protocolActiveServerPipeIn = INVALID_HANDLE_VALUE;
 HANDLE protocolActiveServerPipeOut = INVALID_HANDLE_VALUE;
@@ -172,6 +198,47 @@ int protocolActiveServerPipeConnected = FALSE;
 SOCKET protocolActiveServerSD = INVALID_SOCKET;
 /* Client Socket (it accept an incoming connection from the JVM). */
 SOCKET protocolActiveBackendSD = INVALID_SOCKET;
+/* TRUE if the credentials of the process connected to the backend socket were verified when accepting it. */
+int protocolActiveBackendPeerVerified = FALSE;
+
+/* Framing of the packets read from and written to the JVM (WRAPPER_PROTOCOL_VERSION_*).  The read version switches
+ *  as soon as the JVM's PROTOCOL packet is read, the write version once the acknowledgement has been sent. */
+int protocolReadVersion = WRAPPER_PROTOCOL_VERSION_1;
+int protocolWriteVersion = WRAPPER_PROTOCOL_VERSION_1;
+int protocolNegotiatedVersion = WRAPPER_PROTOCOL_VERSION_1;
+int protocolCapabilities = 0;
+int protocolAckPending = FALSE;     /* Set while the PROTOCOL acknowledgement is sent, before the key of the JVM is verified. */
+/* Reassembly of the version 2 packets.  Its buffer grows as needed, up to WRAPPER_PACKET_MAX_LENGTH. */
+WrapperPacketReader protocolPacketReader;
+
+/* Round trip times of the pings, in microseconds.  The window is reset each time a summary is logged. */
+WrapperHistogram pingWindowHistogram;
+WrapperHistogram pingTotalHistogram;
+TICKS pingWindowStartTicks;
+int pingWindowStarted = FALSE;
+unsigned int pingLastRoundTrip;
+double pingJitter = 0.0;            /* Smoothed variation between consecutive round trips, as for RTP (RFC 3550). */
+
+#ifdef LINUX
+/* Ring through which the JVM sends its log packets when wrapper.backend.ring is set.
+ *  The file backing it is removed once the JVM has registered its key. */
+WrapperRing protocolRing;
+char *protocolRingPath = NULL;
+TCHAR *protocolRingPathW = NULL;
+
+/* Maximum number of records read from the ring each time it is checked between backend packets. */
+#define PROTOCOL_RING_MAX_RECORDS 1024
+/* Copy of the record being handled.  The mapping can be changed by the JVM at any time. */
+char *protocolRingRecord = NULL;
+size_t protocolRingRecordSize = 0;
+#endif
+
+#ifndef WIN32
+/* Private directory and path of the Unix-domain server socket (multibyte and wide versions). */
+char *protocolServerUnixDir = NULL;
+char *protocolServerUnixPath = NULL;
+TCHAR *protocolServerUnixPathW = NULL;
+#endif
 
 #ifndef IN6ADDR_LOOPBACK_INIT
  /* even if I include ws2ipdef.h, it doesn't define IN6ADDR_LOOPBACK_INIT,
@@ -233,6 +300,39 @@ static time_t wrapperChildWorkLastDataTime = 0;
 static int wrapperChildWorkLastDataTimeMillis = 0;
 static int wrapperChildWorkIsNewLine = TRUE;
 
+/* Multi-line record of JVM output being aggregated when wrapper.log.multiline is set. */
+static char *wrapperChildRecordBuffer = NULL;
+static size_t wrapperChildRecordBufferSize = 0;
+static size_t wrapperChildRecordLen = 0;
+static int wrapperChildRecordLines = 0;
+static time_t wrapperChildRecordLastTime = 0;
+static int wrapperChildRecordLastTimeMillis = 0;
+
+/* Last line of JVM output, used to collapse repeated lines when wrapper.log.collapse_repeats is set. */
+static char *wrapperChildLastLine = NULL;
+static size_t wrapperChildLastLineSize = 0;
+static size_t wrapperChildLastLineLen = 0;
+static unsigned int wrapperChildLastLineHash = 0;
+static int wrapperChildLastLineSet = FALSE;
+static int wrapperChildRepeatCount = 0;
+static int wrapperChildRepeatFilter = -1;
+static time_t wrapperChildRepeatTime = 0;
+static int wrapperChildRepeatTimeMillis = 0;
+
+/* Token buckets limiting the rate of JVM output when wrapper.log.rate_limit.lines or .bytes is set.  Reset for each JVM. */
+static int wrapperChildRateStarted = FALSE;
+static double wrapperChildRateLineTokens = 0;
+static double wrapperChildRateByteTokens = 0;
+static time_t wrapperChildRateTime = 0;
+static int wrapperChildRateTimeMillis = 0;
+static time_t wrapperChildRateSummaryTime = 0;
+static unsigned int wrapperChildRateExcessLines = 0;
+static double wrapperChildRateExcessBytes = 0;
+static unsigned int wrapperChildRateSampled = 0;
+static int wrapperChildRateSampleCount = 0;
+static FILE *wrapperChildRateOverflowFP = NULL;
+static int wrapperChildRateOverflowFailed = FALSE;
+
 /**
  * Constructs a tm structure from a pair of Strings like "20091116" and "1514".
  *  The time returned will be in the local time zone.  This is not 100% accurate
@@ -749,6 +849,7 @@ int wrapperLoadLoggingProperties(int preload) {
 #endif
     int isPurgePatternGenerated = FALSE;
     const TCHAR* confPurgePattern;
+    const TCHAR* logRateMode;
     
     setLoggingIsPreload(preload);
     
@@ -764,6 +865,31 @@ int wrapperLoadLoggingProperties(int preload) {
 
     setLogWarningThreshold(getIntProperty(properties, TEXT("wrapper.log.warning.threshold"), 0));
     wrapperData->logLFDelayThreshold = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.log.lf_delay.threshold"), 500), 3600000), 0);
+    wrapperData->logMultiline = getBooleanProperty(properties, TEXT("wrapper.log.multiline"), FALSE);
+    wrapperData->logMultilineMaxLines = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.log.multiline.max_lines"), 500), 10000), 1);
+    wrapperData->logCollapseRepeats = getBooleanProperty(properties, TEXT("wrapper.log.collapse_repeats"), FALSE);
+    wrapperData->logCollapseRepeatsInterval = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.log.collapse_repeats.interval"), 10), 3600), 1);
+    wrapperData->logRateLines = propIntMax(getIntProperty(properties, TEXT("wrapper.log.rate_limit.lines"), 0), 0);
+    wrapperData->logRateBytes = propIntMax(getIntProperty(properties, TEXT("wrapper.log.rate_limit.bytes"), 0), 0);
+    wrapperData->logRateBurst = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.log.rate_limit.burst"), 2), 3600), 1);
+    wrapperData->logRateSample = propIntMax(getIntProperty(properties, TEXT("wrapper.log.rate_limit.sample"), 100), 1);
+    wrapperData->logRateSummaryInterval = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.log.rate_limit.summary_interval"), 60), 3600), 1);
+    updateStringValue(&wrapperData->logRateOverflowFile, getFileSafeStringProperty(properties, TEXT("wrapper.log.rate_limit.overflow_file"), NULL));
+    logRateMode = getStringProperty(properties, TEXT("wrapper.log.rate_limit.mode"), TEXT("DROP"));
+    if (strcmpIgnoreCase(logRateMode, TEXT("SAMPLE")) == 0) {
+        wrapperData->logRateMode = WRAPPER_LOG_RATE_MODE_SAMPLE;
+    } else if (strcmpIgnoreCase(logRateMode, TEXT("OVERFLOW")) == 0) {
+        if (wrapperData->logRateOverflowFile && (wrapperData->logRateOverflowFile[0] != TEXT('\0'))) {
+            wrapperData->logRateMode = WRAPPER_LOG_RATE_MODE_OVERFLOW;
+        } else {
+            if (!preload) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("%s is not set.  Lines of JVM output exceeding the rate limit will be dropped."), TEXT("wrapper.log.rate_limit.overflow_file"));
+            }
+            wrapperData->logRateMode = WRAPPER_LOG_RATE_MODE_DROP;
+        }
+    } else {
+        wrapperData->logRateMode = WRAPPER_LOG_RATE_MODE_DROP;
+    }
 
     if (resolveDefaultLogFilePath()) {
         /* The error has already been logged. This is not fatal, we will continue with the relative path. */
@@ -2057,7 +2183,9 @@ int loadConfigurationSettings(int doPreload) {
     }
 
     if (doPreload) {
+        wrapperProfileBegin(TEXT("preload configuration"));
         wrapperLoadConfigurationProperties(TRUE);
+        wrapperProfileEnd(TEXT("preload configuration"));
 
 #ifdef WIN32
         /* Collect user info that will be used for logging and to resolve the Log On account when running
@@ -2068,6 +2196,7 @@ int loadConfigurationSettings(int doPreload) {
 #endif
     }
 
+    wrapperProfileBegin(TEXT("load configuration file"));
     if (wrapperLoadConfigurationProperties(FALSE)) {
         if (!wrapperData->argCommandValid) {
             /* Let it fail later to report an unrecognized command rather than a problem with the configuration file. */
@@ -2078,17 +2207,23 @@ int loadConfigurationSettings(int doPreload) {
         }
     }
 
+    wrapperProfileEnd(TEXT("load configuration file"));
+
+    wrapperProfileBegin(TEXT("load parameter files"));
     if (wrapperLoadParameterFiles()) {
         result = TRUE;
     }
+    wrapperProfileEnd(TEXT("load parameter files"));
 
     /* Now go through and log any security issues. Stop if critical, but only after all errors have been logged. */
+    wrapperProfileBegin(TEXT("check secure files"));
     if (checkAndReportInsecureFiles()) {
         result = TRUE;
     } else if (wrapperData->insecure) {
         /* An invalid cipher was found or a security check failed. */
         result = TRUE;
     }
+    wrapperProfileEnd(TEXT("check secure files"));
 
     return result;
 }
@@ -2133,8 +2268,35 @@ void protocolStopServerPipe() {
     }
 }
 
+#ifndef WIN32
+/**
+ * Removes the Unix-domain server socket file and its private directory if they exist.
+ */
+void protocolCleanupServerSocketUnix() {
+    if (protocolServerUnixPath) {
+        if ((unlink(protocolServerUnixPath) != 0) && (errno != ENOENT) && wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Failed to remove the backend socket file. (%s)"), getLastErrorText());
+        }
+        free(protocolServerUnixPath);
+        protocolServerUnixPath = NULL;
+    }
+    if (protocolServerUnixPathW) {
+        free(protocolServerUnixPathW);
+        protocolServerUnixPathW = NULL;
+    }
+    if (protocolServerUnixDir) {
+        if ((rmdir(protocolServerUnixDir) != 0) && (errno != ENOENT) && wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Failed to remove the backend socket directory. (%s)"), getLastErrorText());
+        }
+        free(protocolServerUnixDir);
+        protocolServerUnixDir = NULL;
+    }
+}
+#endif
+
 /**
- * There is no difference between closing a socket IPv4 vs a socket IPv6
+ * There is no difference between closing a socket IPv4 vs a socket IPv6.
+ *  For a Unix-domain socket, the socket file and its directory are also removed.
  */
 void protocolStopServerSocket() {
     int rc;
@@ -2156,6 +2318,9 @@ void protocolStopServerSocket() {
         }
         protocolActiveServerSD = INVALID_SOCKET;
     }
+#ifndef WIN32
+    protocolCleanupServerSocketUnix();
+#endif
 
     wrapperData->actualPort = 0;
 }
@@ -2559,7 +2724,118 @@ int protocolStartServerSocket(int IPv4) {
     return FALSE;
 }
 
+#ifndef WIN32
+/**
+ * Start server using a Unix-domain socket.  The socket is created in a new
+ *  directory which only the user running the Wrapper can access, so the
+ *  connection can only come from a process of that user.
+ *
+ * @return FALSE if the socket is created successfully, TRUE otherwise.
+ */
+int protocolStartServerSocketUnix() {
+    struct sockaddr_un addr_srv;
+    const char *tmpDir;
+    size_t len;
+    size_t req;
+    int rc;
+
+    tmpDir = getenv("TMPDIR");
+    if (!tmpDir || (tmpDir[0] == '\0')) {
+        tmpDir = "/tmp";
+    }
+
+    /* mkdtemp() creates the directory with a 0700 mode. */
+    len = strlen(tmpDir) + 15 + 1; /* "/wrapper-XXXXXX" */
+    protocolServerUnixDir = malloc(len);
+    if (!protocolServerUnixDir) {
+        outOfMemory(TEXT("PSSSU"), 1);
+        return TRUE;
+    }
+    snprintf(protocolServerUnixDir, len, "%s/wrapper-XXXXXX", tmpDir);
+    if (!mkdtemp(protocolServerUnixDir)) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("Unable to create the directory of the backend socket: %s"), getLastErrorText());
+        free(protocolServerUnixDir);
+        protocolServerUnixDir = NULL;
+        return TRUE;
+    }
+
+    len = strlen(protocolServerUnixDir) + 13 + 1; /* "/backend.sock" */
+    if (len > sizeof(addr_srv.sun_path)) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("Unable to create the backend socket: the path of the temporary directory is too long."));
+        protocolCleanupServerSocketUnix();
+        return TRUE;
+    }
+    protocolServerUnixPath = malloc(len);
+    if (!protocolServerUnixPath) {
+        outOfMemory(TEXT("PSSSU"), 2);
+        protocolCleanupServerSocketUnix();
+        return TRUE;
+    }
+    snprintf(protocolServerUnixPath, len, "%s/backend.sock", protocolServerUnixDir);
+
+    /* The JVM receives the path as a system property. */
+    req = mbstowcs(NULL, protocolServerUnixPath, MBSTOWCS_QUERY_LENGTH);
+    if (req == (size_t)-1) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR,
+            TEXT("Invalid multibyte sequence in %s: %s"), TEXT("backend socket path"), getLastErrorText());
+        protocolCleanupServerSocketUnix();
+        return TRUE;
+    }
+    protocolServerUnixPathW = malloc(sizeof(TCHAR) * (req + 1));
+    if (!protocolServerUnixPathW) {
+        outOfMemory(TEXT("PSSSU"), 3);
+        protocolCleanupServerSocketUnix();
+        return TRUE;
+    }
+    mbstowcs(protocolServerUnixPathW, protocolServerUnixPath, req + 1);
+    protocolServerUnixPathW[req] = TEXT('\0');
+
+    protocolActiveServerSD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (protocolActiveServerSD == INVALID_SOCKET) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR,
+            TEXT("Server socket creation failed. (%s)"), getLastErrorText());
+        protocolCleanupServerSocketUnix();
+        return TRUE;
+    }
+
+    /* Make the socket non-blocking */
+    rc = fcntl(protocolActiveServerSD, F_SETFL, O_NONBLOCK);
+    if (rc == SOCKET_ERROR) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR,
+            TEXT("Server socket ioctlsocket failed. (%s)"), getLastErrorText());
+        protocolStopServerSocket();
+        return TRUE;
+    }
+
+    memset(&addr_srv, 0, sizeof(addr_srv));
+    addr_srv.sun_family = AF_UNIX;
+    memcpy(addr_srv.sun_path, protocolServerUnixPath, len);
+    rc = bind(protocolActiveServerSD, (struct sockaddr *)&addr_srv, sizeof(addr_srv));
+    if (rc == SOCKET_ERROR) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR,
+            TEXT("Server socket bind failed. (%s)"), getLastErrorText());
+        protocolStopServerSocket();
+        return TRUE;
+    }
+
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Server listening on %s."), protocolServerUnixPathW);
+    }
+
+    /* Tell the socket to start listening. */
+    rc = listen(protocolActiveServerSD, 1);
+    if (rc == SOCKET_ERROR) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("Server socket listen failed. (%d)"), wrapperGetSocketLastError());
+        protocolStopServerSocket();
+        return TRUE;
+    }
+
+    return FALSE;
+}
+#endif
+
 /**
+ * if backendTypeConfiguredBits is 'socket_unix', then only a Unix-domain socket is tried.
  * if backendTypeConfiguredBits is 'auto', then it will try in this order:
  *   - socket IPv4
  *   - socket IPv6
@@ -2581,6 +2857,18 @@ void protocolStartServer() {
         useFallbackSocket = TRUE;
     }
 
+#ifndef WIN32
+    if (wrapperData->backendTypeConfiguredBits == WRAPPER_BACKEND_TYPE_SOCKET_UNIX) {
+        if (protocolStartServerSocketUnix() == FALSE) {
+            /* success */
+            wrapperData->backendTypeBit = WRAPPER_BACKEND_TYPE_SOCKET_UNIX;
+            return;
+        }
+        /* error message should have already be printed in protocolStartServerSocketUnix */
+        goto error;
+    }
+#endif
+
     if (wrapperData->backendTypeConfiguredBits & WRAPPER_BACKEND_TYPE_SOCKET_V4) {
         result = protocolStartServerSocket(TRUE);
         if (result == WRAPPER_BACKEND_ERROR_NEXT && (useFallbackAuto || useFallbackSocket)) {
@@ -2663,6 +2951,7 @@ void protocolOpenPipe() {
 #endif
 
     protocolActiveServerPipeConnected = TRUE;
+    wrapperProfileMark(TEXT("backend connected"));
 }
 
 /**
@@ -2792,6 +3081,7 @@ void protocolOpenSocket(int IPv4) {
 
     /* New connection, so continue. */
     protocolActiveBackendSD = newBackendSD;
+    wrapperProfileMark(TEXT("backend connected"));
 
     /* Collect information about the remote end of the socket. */
     if (wrapperData->isDebugging) {
@@ -2824,12 +3114,110 @@ void protocolOpenSocket(int IPv4) {
     protocolStopServer();
 }
 
+#ifndef WIN32
+/**
+ * Accepts a connection on the Unix-domain server socket.
+ *
+ * The credentials of the connecting process are checked in place of the key:
+ *  a process of another user is rejected, and a process of the same user is
+ *  trusted without a key when it is the Java process itself.  When the
+ *  platform can't tell the pid of the peer, or the pid is another one (the
+ *  JVM was launched through a script for example), the key is still required.
+ */
+void protocolOpenSocketUnix() {
+    SOCKET newBackendSD;
+    int rc;
+    int verified = FALSE;
+ #if defined(LINUX)
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
+ #elif defined(MACOSX) || defined(FREEBSD)
+    uid_t peerUid;
+    gid_t peerGid;
+ #endif
+
+    /* Is the server socket open? */
+    if (protocolActiveServerSD == INVALID_SOCKET) {
+        /* can't do anything yet. */
+        return;
+    }
+
+    newBackendSD = accept(protocolActiveServerSD, NULL, NULL);
+    if (newBackendSD == INVALID_SOCKET) {
+        rc = wrapperGetSocketLastError();
+        /* EWOULDBLOCK != EAGAIN on some platforms. */
+        if ((rc != WRAPPER_EWOULDBLOCK) && (rc != EAGAIN) && wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG,
+                TEXT("Socket creation failed. (%s)"), getLastErrorText());
+        }
+        return;
+    }
+
+    /* Is it already open? */
+    if (protocolActiveBackendSD != INVALID_SOCKET) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Ignoring unexpected backend socket connection on %s"), protocolServerUnixPathW);
+        close(newBackendSD);
+        return;
+    }
+
+ #if defined(LINUX)
+    if (getsockopt(newBackendSD, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == 0) {
+        if (cred.uid != geteuid()) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Rejecting backend socket connection from pid %d running as uid %d."), (int)cred.pid, (int)cred.uid);
+            close(newBackendSD);
+            return;
+        }
+        verified = (cred.pid == wrapperData->javaPID);
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Accepted a socket on %s from pid %d (%s)."),
+                protocolServerUnixPathW, (int)cred.pid, verified ? TEXT("Java process") : TEXT("key required"));
+        }
+    } else if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Unable to get the credentials of the backend socket peer. (%s)"), getLastErrorText());
+    }
+ #elif defined(MACOSX) || defined(FREEBSD)
+    if (getpeereid(newBackendSD, &peerUid, &peerGid) == 0) {
+        if (peerUid != geteuid()) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Rejecting backend socket connection from uid %d."), (int)peerUid);
+            close(newBackendSD);
+            return;
+        }
+    } else if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Unable to get the credentials of the backend socket peer. (%s)"), getLastErrorText());
+    }
+ #endif
+
+    /* New connection, so continue. */
+    protocolActiveBackendSD = newBackendSD;
+    protocolActiveBackendPeerVerified = verified;
+    wrapperProfileMark(TEXT("backend connected"));
+
+    /* Make the socket non-blocking */
+    rc = fcntl(protocolActiveBackendSD, F_SETFL, O_NONBLOCK);
+    if (rc == SOCKET_ERROR) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG,
+                TEXT("Socket ioctlsocket failed. (%s)"), getLastErrorText());
+        }
+        wrapperProtocolClose();
+        return;
+    }
+
+    /* We got an incoming connection, so close down the listener (and remove the socket file) to prevent further connections. */
+    protocolStopServer();
+}
+#endif
+
 /**
  * Attempt to accept a connection from a JVM client.
  */
 void protocolOpen() {
     if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) {
         protocolOpenPipe();
+#ifndef WIN32
+    } else if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_SOCKET_UNIX) {
+        protocolOpenSocketUnix();
+#endif
     } else if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_SOCKET_V6) {
         protocolOpenSocket(FALSE);
     } else {
@@ -2885,19 +3273,12 @@ void protocolCloseSocket() {
         }
         protocolActiveBackendSD = INVALID_SOCKET;
     }
+    protocolActiveBackendPeerVerified = FALSE;
 }
 
 /**
  * Close the backend socket.
  */
-void wrapperProtocolClose() {
-    if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) {
-        protocolClosePipe();
-    } else {
-        protocolCloseSocket();
-    }
-}
-
 /**
  * Returns the name of a given function code for debug purposes.
  */
@@ -2978,6 +3359,14 @@ TCHAR *wrapperProtocolGetCodeName(char code) {
         name = TEXT("APP_PARAMETERS");
         break;
 
+    case WRAPPER_MSG_PROTOCOL:
+        name = TEXT("PROTOCOL");
+        break;
+
+    case WRAPPER_MSG_LOG_BATCH:
+        name = TEXT("LOG_BATCH");
+        break;
+
     case WRAPPER_MSG_LOG + LEVEL_DEBUG:
         name = TEXT("LOG(DEBUG)");
         break;
@@ -3043,90 +3432,311 @@ TCHAR *wrapperProtocolGetCodeName(char code) {
     return name;
 }
 
-/* Mutex for synchronization of the wrapperProtocolFunction function. */
-#ifdef WIN32
-HANDLE protocolMutexHandle = NULL;
-#else
-pthread_mutex_t protocolMutex = PTHREAD_MUTEX_INITIALIZER;
-#endif
-
-
-/** Obtains a lock on the protocol mutex. */
-int lockProtocolMutex() {
-#ifdef WIN32
-    switch (WaitForSingleObject(protocolMutexHandle, INFINITE)) {
-    case WAIT_ABANDONED:
-        _tprintf(TEXT("Protocol mutex was abandoned.\n"));
-        fflush(NULL);
-        return -1;
-    case WAIT_FAILED:
-        _tprintf(TEXT("Protocol mutex wait failed.\n"));
-        fflush(NULL);
-        return -1;
-    case WAIT_TIMEOUT:
-        _tprintf(TEXT("Protocol mutex wait timed out.\n"));
-        fflush(NULL);
-        return -1;
-    default:
-        /* Ok */
-        break;
+#ifdef LINUX
+/**
+ * Removes the file backing the ring.  The mapping stays valid.
+ */
+static void protocolUnlinkRing() {
+    if (protocolRingPath) {
+        if ((unlink(protocolRingPath) != 0) && (errno != ENOENT) && wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Failed to remove %s: %s"), protocolRingPathW, getLastErrorText());
+        }
+        free(protocolRingPath);
+        protocolRingPath = NULL;
     }
-#else
-    if (pthread_mutex_lock(&protocolMutex)) {
-        _tprintf(TEXT("Failed to lock the Protocol mutex. %s\n"), getLastErrorText());
-        return -1;
+    if (protocolRingPathW) {
+        free(protocolRingPathW);
+        protocolRingPathW = NULL;
     }
-#endif
-
-    return 0;
 }
 
-/** Releases a lock on the protocol mutex. */
-int releaseProtocolMutex() {
-#ifdef WIN32
-    if (!ReleaseMutex(protocolMutexHandle)) {
-        _tprintf(TEXT("Failed to release Protocol mutex. %s\n"), getLastErrorText());
-        fflush(NULL);
-        return -1;
+static void protocolDestroyRing() {
+    protocolUnlinkRing();
+    if (protocolRing.header) {
+        wrapperRingDetach(&protocolRing);
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Backend ring closed."));
+        }
     }
-#else
-    if (pthread_mutex_unlock(&protocolMutex)) {
-        _tprintf(TEXT("Failed to unlock the Protocol mutex. %s\n"), getLastErrorText());
-        return -1;
+    if (protocolRingRecord) {
+        free(protocolRingRecord);
+        protocolRingRecord = NULL;
+        protocolRingRecordSize = 0;
     }
-#endif
-    return 0;
 }
 
-/**
- * Return TRUE when the JVM's state is between LAUNCHING and STOPPING (and the
- *  stopped packed is not received yet), FALSE otherwise.
- */
-int jvmStateExpectsBackendData() {
-    if ((wrapperData->jState == WRAPPER_JSTATE_LAUNCHING) ||
-        (wrapperData->jState == WRAPPER_JSTATE_LAUNCHED) ||
-        (wrapperData->jState == WRAPPER_JSTATE_STARTING) ||
-        (wrapperData->jState == WRAPPER_JSTATE_STARTED) ||
-        (wrapperData->jState == WRAPPER_JSTATE_STOP) ||
-        (wrapperData->jState == WRAPPER_JSTATE_STOPPING)) {
+void wrapperProtocolCreateRing() {
+    const char *dir;
+    size_t len;
+    size_t req;
 
-        /* Note: it is important that the stopped state, which is entered in the event of a backend failure, never tries to reopen the connection. */
-        if (!wrapperData->stoppedPacketReceived) {
-            return TRUE;
+    protocolDestroyRing();
+
+    if (!wrapperData->useBackendRing) {
+        return;
+    }
+
+    /* Prefer tmpfs so that the pages of the ring are never written back to a disk. */
+    if (access("/dev/shm", W_OK | X_OK) == 0) {
+        dir = "/dev/shm";
+    } else {
+        dir = getenv("TMPDIR");
+        if (!dir || (dir[0] == '\0')) {
+            dir = "/tmp";
         }
     }
-    return FALSE;
-}
 
-int wrapperGetProtocolState() {
-    int result = 0;
+    len = strlen(dir) + 20 + 1; /* "/wrapper-ring-XXXXXX" */
+    protocolRingPath = malloc(len);
+    if (!protocolRingPath) {
+        outOfMemory(TEXT("PCR"), 1);
+        return;
+    }
+    snprintf(protocolRingPath, len, "%s/wrapper-ring-XXXXXX", dir);
+    if (wrapperRingCreate(&protocolRing, protocolRingPath, (size_t)wrapperData->backendRingSize)) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Unable to create the backend ring: %s  Log packets will be sent through the backend."), getLastErrorText());
+        free(protocolRingPath);
+        protocolRingPath = NULL;
+        return;
+    }
 
-    if (jvmStateExpectsBackendData()) {
-        result |= WRAPPER_BACKEND_READ_ALLOWED;
+    req = mbstowcs(NULL, protocolRingPath, MBSTOWCS_QUERY_LENGTH);
+    if (req == (size_t)-1) {
+        protocolDestroyRing();
+        return;
+    }
+    protocolRingPathW = malloc(sizeof(TCHAR) * (req + 1));
+    if (!protocolRingPathW) {
+        outOfMemory(TEXT("PCR"), 2);
+        protocolDestroyRing();
+        return;
     }
+    mbstowcs(protocolRingPathW, protocolRingPath, req + 1);
+    protocolRingPathW[req] = TEXT('\0');
 
-    if (((wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_SOCKET) && (protocolActiveBackendSD != INVALID_SOCKET)) ||
-        ((wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) && (protocolActiveServerPipeConnected))) {
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Backend ring created: %s (%d bytes)"), protocolRingPathW, (int)(protocolRing.mask + 1));
+    }
+}
+
+/**
+ * Handles the packets that the JVM placed in the ring.  The JVM only uses
+ *  the ring for log packets.  When the ring is full, it sends them through
+ *  the backend instead.  To keep the messages in order, the ring is drained
+ *  of everything written so far each time a packet is read from the backend,
+ *  before that packet is handled.  As the JVM writes to the ring before
+ *  sending the packet, this includes every record written before it.
+ *
+ * The JVM can write to the ring at any time, so each record is copied
+ *  before being used.  If the JVM truncates the file backing the ring or
+ *  writes an invalid record, the ring is no longer used.
+ *
+ * @param drain TRUE to read every record written so far, FALSE to stop
+ *              after PROTOCOL_RING_MAX_RECORDS so other work is not held up.
+ */
+static void protocolReadRing(int drain) {
+    char code;
+    const char *data;
+    size_t len;
+    char *newRecord;
+    TCHAR *msgW;
+    const char *encoding;
+    unsigned int end;
+    int count = 0;
+
+    if (wrapperRingCheck(&protocolRing)) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("The file backing the backend ring was truncated.  The ring will no longer be used."));
+        protocolDestroyRing();
+        return;
+    }
+
+    encoding = (protocolCapabilities & WRAPPER_PROTOCOL_CAP_UTF8) ? MB_UTF8 : getJvmOutputEncodingMB();
+    end = wrapperRingHead(&protocolRing);
+    while ((drain || (count < PROTOCOL_RING_MAX_RECORDS)) && wrapperRingReadBefore(&protocolRing, end) && !wrapperRingPeek(&protocolRing, &code, &data, &len)) {
+        if (len + 1 > protocolRingRecordSize) {
+            newRecord = realloc(protocolRingRecord, len + 1);
+            if (!newRecord) {
+                outOfMemory(TEXT("PRR"), 2);
+                wrapperRingRelease(&protocolRing);
+                continue;
+            }
+            protocolRingRecord = newRecord;
+            protocolRingRecordSize = len + 1;
+        }
+        memcpy(protocolRingRecord, data, len);
+        protocolRingRecord[len] = '\0';
+        wrapperRingRelease(&protocolRing);
+        count++;
+
+        if (converterMBToWide(protocolRingRecord, encoding, &msgW, TRUE)) {
+            if (msgW) {
+                log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, msgW);
+                free(msgW);
+            } else {
+                outOfMemory(TEXT("PRR"), 1);
+            }
+        } else {
+            if (wrapperData->isDebugging) {
+                log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("read a packet %s from the ring : %s"),
+                    wrapperProtocolGetCodeName(code), msgW);
+            }
+            WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_BACKEND_PACKETS, 1);
+            switch (code) {
+            case WRAPPER_MSG_LOG + LEVEL_DEBUG:
+            case WRAPPER_MSG_LOG + LEVEL_INFO:
+            case WRAPPER_MSG_LOG + LEVEL_STATUS:
+            case WRAPPER_MSG_LOG + LEVEL_WARN:
+            case WRAPPER_MSG_LOG + LEVEL_ERROR:
+            case WRAPPER_MSG_LOG + LEVEL_FATAL:
+                wrapperLogSignaled(code - WRAPPER_MSG_LOG, msgW);
+                break;
+
+            case WRAPPER_MSG_LOG_BATCH:
+                wrapperLogBatchSignaled(msgW);
+                break;
+
+            default:
+                if (wrapperData->isDebugging) {
+                    log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("received unknown packet from the ring (%d:%s)"), code, msgW);
+                }
+                break;
+            }
+            free(msgW);
+        }
+    }
+
+    if (protocolRing.corrupt) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("Found an invalid record in the backend ring.  The ring will no longer be used."));
+        protocolDestroyRing();
+    }
+}
+#endif
+
+void wrapperProtocolSleep(int ms) {
+#ifdef LINUX
+    if (protocolRing.header && wrapperRingCheck(&protocolRing)) {
+        /* Let protocolReadRing report it. */
+        protocolReadRing(FALSE);
+    }
+    if (protocolRing.header) {
+        if (wrapperData->isSleepOutputEnabled) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Sleep: ring %dms"), ms);
+        }
+        wrapperRingWait(&protocolRing, ms);
+        return;
+    }
+#endif
+    wrapperSleep(ms);
+}
+
+void wrapperProtocolClose() {
+#ifdef LINUX
+    if (protocolRing.header) {
+        /* Log anything the JVM managed to write before it went away. */
+        protocolReadRing(TRUE);
+    }
+#endif
+    if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) {
+        protocolClosePipe();
+    } else {
+        protocolCloseSocket();
+    }
+#ifdef LINUX
+    protocolDestroyRing();
+#endif
+
+    /* The next JVM will negotiate again. */
+    wrapperPacketReaderReset(&protocolPacketReader);
+    protocolReadVersion = WRAPPER_PROTOCOL_VERSION_1;
+    protocolWriteVersion = WRAPPER_PROTOCOL_VERSION_1;
+    protocolNegotiatedVersion = WRAPPER_PROTOCOL_VERSION_1;
+    protocolCapabilities = 0;
+}
+
+/* Mutex for synchronization of the wrapperProtocolFunction function. */
+#ifdef WIN32
+HANDLE protocolMutexHandle = NULL;
+#else
+pthread_mutex_t protocolMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+/** Obtains a lock on the protocol mutex. */
+int lockProtocolMutex() {
+#ifdef WIN32
+    switch (WaitForSingleObject(protocolMutexHandle, INFINITE)) {
+    case WAIT_ABANDONED:
+        _tprintf(TEXT("Protocol mutex was abandoned.\n"));
+        fflush(NULL);
+        return -1;
+    case WAIT_FAILED:
+        _tprintf(TEXT("Protocol mutex wait failed.\n"));
+        fflush(NULL);
+        return -1;
+    case WAIT_TIMEOUT:
+        _tprintf(TEXT("Protocol mutex wait timed out.\n"));
+        fflush(NULL);
+        return -1;
+    default:
+        /* Ok */
+        break;
+    }
+#else
+    if (pthread_mutex_lock(&protocolMutex)) {
+        _tprintf(TEXT("Failed to lock the Protocol mutex. %s\n"), getLastErrorText());
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+/** Releases a lock on the protocol mutex. */
+int releaseProtocolMutex() {
+#ifdef WIN32
+    if (!ReleaseMutex(protocolMutexHandle)) {
+        _tprintf(TEXT("Failed to release Protocol mutex. %s\n"), getLastErrorText());
+        fflush(NULL);
+        return -1;
+    }
+#else
+    if (pthread_mutex_unlock(&protocolMutex)) {
+        _tprintf(TEXT("Failed to unlock the Protocol mutex. %s\n"), getLastErrorText());
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Return TRUE when the JVM's state is between LAUNCHING and STOPPING (and the
+ *  stopped packed is not received yet), FALSE otherwise.
+ */
+int jvmStateExpectsBackendData() {
+    if ((wrapperData->jState == WRAPPER_JSTATE_LAUNCHING) ||
+        (wrapperData->jState == WRAPPER_JSTATE_LAUNCHED) ||
+        (wrapperData->jState == WRAPPER_JSTATE_STARTING) ||
+        (wrapperData->jState == WRAPPER_JSTATE_STARTED) ||
+        (wrapperData->jState == WRAPPER_JSTATE_STOP) ||
+        (wrapperData->jState == WRAPPER_JSTATE_STOPPING)) {
+
+        /* Note: it is important that the stopped state, which is entered in the event of a backend failure, never tries to reopen the connection. */
+        if (!wrapperData->stoppedPacketReceived) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+int wrapperGetProtocolState() {
+    int result = 0;
+
+    if (jvmStateExpectsBackendData()) {
+        result |= WRAPPER_BACKEND_READ_ALLOWED;
+    }
+
+    if (((wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_ANY_SOCKET) && (protocolActiveBackendSD != INVALID_SOCKET)) ||
+        ((wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) && (protocolActiveServerPipeConnected))) {
 
         result |= WRAPPER_BACKEND_OPENED;
 
@@ -3143,7 +3753,7 @@ int wrapperGetProtocolState() {
                 result |= WRAPPER_BACKEND_WRITE_ALLOWED;
             }
         } else if (wrapperData->jState == WRAPPER_JSTATE_LAUNCHING) {
-            if (wrapperData->wrongKeyPacketReceived) {
+            if (wrapperData->wrongKeyPacketReceived || protocolAckPending) {
                 result |= WRAPPER_BACKEND_WRITE_ALLOWED;
             }
         }
@@ -3240,6 +3850,25 @@ static TCHAR* linearizeStringArray(TCHAR** array, int arrayLen, TCHAR separator,
 
 #define PROTOCOL_MAX_WRITE_MS   2000
 
+/**
+ * Encodes the length of a version 2 packet as an unsigned LEB128 varint.
+ *
+ * @param buffer Buffer of at least 5 bytes.
+ * @param value The length to encode.
+ *
+ * @return The number of bytes written.
+ */
+static size_t protocolEncodeLength(char *buffer, size_t value) {
+    size_t pos = 0;
+
+    while (value >= 0x80) {
+        buffer[pos++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer[pos++] = (char)value;
+    return pos;
+}
+
 /**
  * Sends a command to the JVM process.
  *
@@ -3264,6 +3893,7 @@ int wrapperProtocolFunction(char function, const TCHAR *messageW) {
     int sendCnt;
     int inWritten;
     size_t len;
+    size_t messageLen;
     TCHAR *temp;
     TCHAR *logMsgW = NULL;
     const TCHAR *messageTemplate;
@@ -3436,10 +4066,12 @@ int wrapperProtocolFunction(char function, const TCHAR *messageW) {
             returnVal = TRUE;
         } else {
             /* We need to construct a single string that will be used to transmit the command + message. */
-            if (messageMB) {
-                len = 1 + strlen(messageMB) + 1;
+            messageLen = (messageMB ? strlen(messageMB) : 0);
+            if (protocolWriteVersion >= WRAPPER_PROTOCOL_VERSION_2) {
+                /* Code, up to 5 bytes of length, and the message without terminator. */
+                len = 1 + 5 + messageLen;
             } else {
-                len = 2;
+                len = 1 + messageLen + 1;
             }
             protocolSendBuffer = malloc(sizeof(char) * len);
             if (!protocolSendBuffer) {
@@ -3449,7 +4081,13 @@ int wrapperProtocolFunction(char function, const TCHAR *messageW) {
             } else {
                 /* Build the packet */
                 protocolSendBuffer[0] = function;
-                if (messageMB) {
+                if (protocolWriteVersion >= WRAPPER_PROTOCOL_VERSION_2) {
+                    len = 1 + protocolEncodeLength(&(protocolSendBuffer[1]), messageLen);
+                    if (messageLen > 0) {
+                        memcpy(&(protocolSendBuffer[len]), messageMB, messageLen);
+                    }
+                    len += messageLen;
+                } else if (messageMB) {
                     strncpy(&(protocolSendBuffer[1]), messageMB, len - 1);
                 } else {
                     protocolSendBuffer[1] = 0;
@@ -3606,6 +4244,10 @@ int wrapperProtocolFunction(char function, const TCHAR *messageW) {
                         returnVal = TRUE;
                     }
                 }
+                if ((function == WRAPPER_MSG_PROTOCOL) && !returnVal) {
+                    /* The JVM switches its reads as soon as it gets the acknowledgement. */
+                    protocolWriteVersion = protocolNegotiatedVersion;
+                }
                 if (stop) {
                     if (wrapperData->wrongKeyPacketReceived) {
                         /* This message was not so important. We should keep waiting for the real connection, so stay in this state. */
@@ -3654,7 +4296,7 @@ int wrapperProtocolFunction(char function, const TCHAR *messageW) {
  */
 int wrapperCheckServerBackend(int forceOpen) {
     if ((wrapperData->backendTypeBit == 0) ||
-        ((wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_SOCKET) && (protocolActiveServerSD == INVALID_SOCKET)) ||
+        ((wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_ANY_SOCKET) && (protocolActiveServerSD == INVALID_SOCKET)) ||
         ((wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) && (protocolActiveServerPipeStarted == FALSE))) {
         /* The backend is not currently open and needs to be started,
          *  unless the JVM is DOWN or in a state where it is not needed. */
@@ -3675,7 +4317,7 @@ int wrapperCheckServerBackend(int forceOpen) {
             /* The backend should be open, try doing so. */
             protocolStartServer();
             if ((wrapperData->backendTypeBit == 0) ||
-                ((wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_SOCKET) && (protocolActiveServerSD == INVALID_SOCKET)) ||
+                ((wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_ANY_SOCKET) && (protocolActiveServerSD == INVALID_SOCKET)) ||
                 ((wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) && (protocolActiveServerPipeStarted == FALSE))) {
                 /* Failed. */
                 return FALSE;
@@ -3716,6 +4358,163 @@ TICKS hexToTICKS(TCHAR *buffer) {
     }
 }
 
+/**
+ * Reads whatever is available from the backend, without waiting.
+ *
+ * @return The number of bytes read, 0 if nothing is available, -1 if the
+ *         read failed, or -2 if the socket was closed by the JVM.
+ */
+static int protocolReadAvailable(char *buffer, size_t len) {
+    int rc;
+    int err;
+#ifdef WIN32
+    DWORD available;
+    DWORD inRead;
+#endif
+
+    if (wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_ANY_SOCKET) {
+        rc = recv(protocolActiveBackendSD, buffer, (int)len, 0);
+        if (rc == 0) {
+            if (wrapperData->isDebugging) {
+                log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Socket read no code (eof)."));
+            }
+            return -2;
+        } else if (rc == SOCKET_ERROR) {
+            err = wrapperGetSocketLastError();
+            /* EWOULDBLOCK != EAGAIN on some Unix platforms. */
+            if ((err != WRAPPER_EWOULDBLOCK)
+#ifndef WIN32
+                && (err != EAGAIN)
+#endif
+            ) {
+                if (wrapperData->isDebugging) {
+                    log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Socket read failed. %s"), getLastErrorText());
+                }
+                return -1;
+            }
+            return 0;
+        }
+        return rc;
+    } else {
+#ifdef WIN32
+        if (!PeekNamedPipe(protocolActiveServerPipeIn, NULL, 0, NULL, &available, NULL)) {
+            if (GetLastError() == ERROR_BROKEN_PIPE) {
+                /* ERROR_BROKEN_PIPE - the client has closed the pipe. So most likely it just exited */
+                protocolActiveServerPipeIn = INVALID_HANDLE_VALUE;
+            }
+            return 0;
+        }
+        if (available == 0) {
+            return 0;
+        }
+        if (available < len) {
+            len = available;
+        }
+        if (ReadFile(protocolActiveServerPipeIn, buffer, (DWORD)len, &inRead, NULL) || (GetLastError() == ERROR_MORE_DATA)) {
+            return (int)inRead;
+        } else if (GetLastError() == ERROR_INVALID_HANDLE) {
+            return 0;
+        }
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Pipe read failed. (%s)"), getLastErrorText());
+        }
+        return -1;
+#else
+        rc = read(protocolActiveServerPipeIn, buffer, len);
+        if (rc == -1) {
+            if ((errno != WRAPPER_EWOULDBLOCK) && (errno != EAGAIN)) {
+                if (wrapperData->isDebugging) {
+                    log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Pipe read failed. (%s)"), getLastErrorText());
+                }
+                return -1;
+            }
+            return 0;
+        }
+        /* Nothing read: eof? */
+        return rc;
+#endif
+    }
+}
+
+/**
+ * Reads a version 2 packet from the backend into protocolPacketReader.  Only
+ *  the bytes which are already available are read.  If the packet is not
+ *  complete yet, what was read is kept and the rest is read on a later call,
+ *  so a JVM sending a packet in several pieces does not hold up the loop.
+ *
+ * @param status Set to the WRAPPER_PROTOCOLE_* status to return when no
+ *               packet is complete.
+ *
+ * @return TRUE if a packet is complete.
+ */
+static int protocolReadPacket(int *status) {
+    char buffer[4096];
+    size_t wanted;
+    size_t used;
+    size_t bufferSize = protocolPacketReader.bufferSize;
+    int rc;
+    int result;
+
+    /* Until the key of the JVM has been verified, the other end could be any local process. */
+    if (wrapperData->jState <= WRAPPER_JSTATE_LAUNCHING) {
+        protocolPacketReader.maxLength = WRAPPER_PACKET_MAX_UNVERIFIED_LENGTH;
+        protocolPacketReader.discardTooLong = FALSE;
+    } else {
+        /* A verified JVM is only warned about a packet which is too long.  Closing the backend would restart it. */
+        protocolPacketReader.maxLength = WRAPPER_PACKET_MAX_LENGTH;
+        protocolPacketReader.discardTooLong = TRUE;
+    }
+
+    do {
+        wanted = wrapperPacketReaderWanted(&protocolPacketReader);
+        if (wanted > sizeof(buffer)) {
+            wanted = sizeof(buffer);
+        }
+        rc = protocolReadAvailable(buffer, wanted);
+        if (rc <= 0) {
+            if (rc == 0) {
+                *status = WRAPPER_PROTOCOLE_READ_COMPLETE;
+            } else if (rc == -2) {
+                *status = WRAPPER_PROTOCOLE_READ_SOCKET_EOF;
+            } else {
+                *status = WRAPPER_PROTOCOLE_READ_FAILED;
+            }
+            return FALSE;
+        }
+        /* No more than the wanted bytes were read, so they are all used. */
+        result = wrapperPacketReaderFeed(&protocolPacketReader, buffer, (size_t)rc, &used);
+        if (result == WRAPPER_PACKET_DISCARDED) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Discarded a packet (code %d) of %u bytes from the JVM, longer than the maximum of %u bytes."),
+                (unsigned char)protocolPacketReader.code, (unsigned int)protocolPacketReader.length, (unsigned int)protocolPacketReader.maxLength);
+            result = WRAPPER_PACKET_INCOMPLETE;
+        }
+    } while (result == WRAPPER_PACKET_INCOMPLETE);
+
+    switch (result) {
+    case WRAPPER_PACKET_COMPLETE:
+        if (wrapperData->logBufferGrowth && (protocolPacketReader.bufferSize > bufferSize)) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Protocol read buffer size increased to %d."), (int)protocolPacketReader.bufferSize);
+        }
+        return TRUE;
+
+    case WRAPPER_PACKET_TOO_LONG:
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("Received a packet of %u bytes, longer than the maximum of %u bytes.  Closing the backend connection."),
+            (unsigned int)protocolPacketReader.length, (unsigned int)protocolPacketReader.maxLength);
+        break;
+
+    case WRAPPER_PACKET_BAD_LENGTH:
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("Received a packet with an invalid length.  Closing the backend connection."));
+        break;
+
+    default:
+        outOfMemory(TEXT("PRP"), 1);
+        break;
+    }
+    wrapperPacketReaderReset(&protocolPacketReader);
+    *status = WRAPPER_PROTOCOLE_READ_FAILED;
+    return FALSE;
+}
+
 /**
  * Read any data sent from the JVM.  This function will loop and read as many
  *  packets are available.  The loop will only be allowed to go for 250ms to
@@ -3746,17 +4545,27 @@ int wrapperProtocolRead() {
     time_t now;
     int nowMillis;
     time_t durr;
+    char *packetMB;
+    TCHAR *packetMsgW;
 #ifdef WIN32
     size_t req;
+    UINT cp;
 #else
     TCHAR* packetW;
+    const char* encoding;
 #endif
+    int metricsThreadId = 0;
+    int readStatus;
 
     if (!(wrapperGetProtocolState() & WRAPPER_BACKEND_READ_ALLOWED)) {
         /* Skip this read. */
         return WRAPPER_PROTOCOLE_READ_COMPLETE;
     }
 
+    if (wrapperMetricsEnabled) {
+        metricsThreadId = getThreadId();
+    }
+
     wrapperGetCurrentTime(&timeBuffer);
     startTime = now = timeBuffer.time;
     startTimeMillis = nowMillis = timeBuffer.millitm;
@@ -3785,7 +4594,21 @@ int wrapperProtocolRead() {
             }
         }
 
-        if (wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_SOCKET) {
+#ifdef LINUX
+        if (protocolRing.header) {
+            /* Handle what the JVM wrote to the ring even if it does not send anything through the backend. */
+            protocolReadRing(FALSE);
+        }
+#endif
+
+        if (protocolReadVersion >= WRAPPER_PROTOCOL_VERSION_2) {
+            if (!protocolReadPacket(&readStatus)) {
+                /* No packet, or only part of one, is available yet. */
+                return readStatus;
+            }
+            code = protocolPacketReader.code;
+            packetMB = protocolPacketReader.buffer;
+        } else if (wrapperData->backendTypeBit & WRAPPER_BACKEND_TYPE_ANY_SOCKET) {
             /* Try receiving a packet code */
             
             len = recv(protocolActiveBackendSD, (void*) &c, 1, 0);
@@ -3831,6 +4654,7 @@ int wrapperProtocolRead() {
 
             /* terminate the string; */
             packetBufferMB[pos] = '\0';
+            packetMB = packetBufferMB;
         } else if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) {
 #ifdef WIN32
             err = PeekNamedPipe(protocolActiveServerPipeIn, NULL, 0, NULL, &maxlen, NULL);
@@ -3909,24 +4733,56 @@ int wrapperProtocolRead() {
             /* terminate the string; */
             packetBufferMB[pos] = '\0';
 #endif
+            packetMB = packetBufferMB;
         } else {
             /* Should not reach this part because wrapperData->backendTypeBit should always have a valid value */
             return WRAPPER_PROTOCOLE_READ_COMPLETE;
         }
 
-        /* Convert the multi-byte packetBufferMB buffer into a wide-character string. */
-        /* Source message is always smaller than the MAX_LOG_SIZE so the output will be as well. */
+#ifdef LINUX
+        if (protocolRing.header) {
+            /* Everything the JVM wrote to the ring before sending this packet must be handled first. */
+            protocolReadRing(TRUE);
+        }
+#endif
+
+        /* Convert the multi-byte packetMB buffer into a wide-character string. */
+        /* With the version 1 protocol, the source message is always smaller than the MAX_LOG_SIZE so the output will be as well.
+         *  Version 2 packets are not limited in size, so the wide-character string is allocated and freed after the packet is handled. */
         /* While the packets sent to the JVM are UTF-8 encoded, it is better to handle the communication
-         *  from the JVM to the native Wrapper in the same encoding as stdout (by default the locale encoding). */
+         *  from the JVM to the native Wrapper in the same encoding as stdout (by default the locale encoding),
+         *  unless the JVM negotiated to send UTF-8. */
+        packetMsgW = packetBufferW;
 #ifdef WIN32
-        req = MultiByteToWideChar(getJvmOutputCodePage(), 0, packetBufferMB, -1, packetBufferW, MAX_LOG_SIZE + 1);
+        cp = (protocolCapabilities & WRAPPER_PROTOCOL_CAP_UTF8) ? CP_UTF8 : getJvmOutputCodePage();
+        if (packetMB == protocolPacketReader.buffer) {
+            req = MultiByteToWideChar(cp, 0, packetMB, -1, NULL, 0);
+            if (req > 0) {
+                packetMsgW = malloc(sizeof(TCHAR) * req);
+                if (!packetMsgW) {
+                    outOfMemory(TEXT("WPR"), 2);
+                    packetMsgW = packetBufferW;
+                    req = 0;
+                }
+            }
+        } else {
+            req = MAX_LOG_SIZE + 1;
+        }
+        if (req > 0) {
+            req = MultiByteToWideChar(cp, 0, packetMB, -1, packetMsgW, (int)req);
+        }
         if (req <= 0) {
             log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN,
                     TEXT("Invalid multibyte sequence in %s: %s"), TEXT("protocol message"), getLastErrorText());
+            if (packetMsgW != packetBufferW) {
+                free(packetMsgW);
+                packetMsgW = packetBufferW;
+            }
             packetBufferW[0] = TEXT('\0');
         }
 #else
-        if (converterMBToWide(packetBufferMB, getJvmOutputEncodingMB(), &packetW, TRUE)) {
+        encoding = (protocolCapabilities & WRAPPER_PROTOCOL_CAP_UTF8) ? MB_UTF8 : getJvmOutputEncodingMB();
+        if (converterMBToWide(packetMB, encoding, &packetW, TRUE)) {
             if (packetW) {
                 log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, packetW);
                 free(packetW);
@@ -3934,6 +4790,9 @@ int wrapperProtocolRead() {
                 outOfMemory(TEXT("WPR"), 1);
             }
             packetBufferW[0] = TEXT('\0');
+        } else if (packetMB == protocolPacketReader.buffer) {
+            /* Keep the converted string as is. */
+            packetMsgW = packetW;
         } else {
             _sntprintf(packetBufferW, MAX_LOG_SIZE + 1, TEXT("%s"), packetW);
             packetBufferW[MAX_LOG_SIZE] = TEXT('\0');
@@ -3942,20 +4801,22 @@ int wrapperProtocolRead() {
 #endif
 
         if (wrapperData->isDebugging) {
-            if ((code == WRAPPER_MSG_PING) && (_tcsstr(packetBufferW, TEXT("silent")) == packetBufferW)) {
+            if ((code == WRAPPER_MSG_PING) && (_tcsstr(packetMsgW, TEXT("silent")) == packetMsgW)) {
                 /*
                 log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("read a silent ping packet %s : %s"),
-                    wrapperProtocolGetCodeName(code), packetBufferW);
+                    wrapperProtocolGetCodeName(code), packetMsgW);
                 */
             } else {
                 log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("read a packet %s : %s"),
-                    wrapperProtocolGetCodeName(code), packetBufferW);
+                    wrapperProtocolGetCodeName(code), packetMsgW);
             }
         }
 
+        WRAPPER_METRICS_ADD(metricsThreadId, WRAPPER_METRIC_BACKEND_PACKETS, 1);
+
         switch (code) {
         case WRAPPER_MSG_STOP:
-            wrapperStopRequested(_ttoi(packetBufferW));
+            wrapperStopRequested(_ttoi(packetMsgW));
             break;
 
         case WRAPPER_MSG_RESTART:
@@ -3972,19 +4833,22 @@ int wrapperProtocolRead() {
                 wrapperCheckAndUpdateProcessStatus(wrapperGetTicks(), TRUE);
             }
 #endif
-            /* Because all versions of the wrapper.jar simply bounce back the ping message, the pingSendTicks should always exist. */
-            tc = _tcschr(packetBufferW, TEXT(' '));
+            /* Because all versions of the wrapper.jar simply bounce back the ping message, the sequence number should always exist.
+             *  The message is in the format "ping ffffffff ffffffff", with the send ticks followed by the sequence number. */
+            tc = _tcschr(packetMsgW, TEXT(' '));
+            if (tc) {
+                tc = _tcschr(tc + 1, TEXT(' '));
+            }
             if (tc) {
-                /* A pingSendTicks should exist. Parse the id following the space. It will be in the format 0xffffffff. */
-                wrapperPingResponded(hexToTICKS(&tc[1]), TRUE);
+                wrapperPingResponded((unsigned int)hexToTICKS(&tc[1]), TRUE);
             } else {
-                /* Should not happen, but just in case use the current ticks. */
-                wrapperPingResponded(wrapperGetTicks(), FALSE);
+                /* Should not happen. */
+                wrapperPingResponded(0, FALSE);
             }
             break;
 
         case WRAPPER_MSG_STOP_PENDING:
-            wrapperStopPendingSignaled(_ttoi(packetBufferW));
+            wrapperStopPendingSignaled(_ttoi(packetMsgW));
             break;
 
         case WRAPPER_MSG_STOPPED:
@@ -3992,7 +4856,7 @@ int wrapperProtocolRead() {
             break;
 
         case WRAPPER_MSG_START_PENDING:
-            wrapperStartPendingSignaled(_ttoi(packetBufferW));
+            wrapperStartPendingSignaled(_ttoi(packetMsgW));
             break;
 
         case WRAPPER_MSG_STARTED:
@@ -4000,22 +4864,33 @@ int wrapperProtocolRead() {
             break;
 
         case WRAPPER_MSG_JAVA_PID:
-            wrapperCheckMonitoredProcess(_ttoi(packetBufferW));
+            wrapperCheckMonitoredProcess(_ttoi(packetMsgW));
             break;
 
         case WRAPPER_MSG_KEY:
-            if (wrapperKeyRegistered(packetBufferW)) {
+            if (wrapperKeyRegistered(packetMsgW)) {
+                if (packetMsgW != packetBufferW) {
+                    free(packetMsgW);
+                }
                 return WRAPPER_PROTOCOLE_READ_COMPLETE;
             }
             break;
 
+        case WRAPPER_MSG_PROTOCOL:
+            wrapperProtocolNegotiated(packetMsgW);
+            break;
+
         case WRAPPER_MSG_LOG + LEVEL_DEBUG:
         case WRAPPER_MSG_LOG + LEVEL_INFO:
         case WRAPPER_MSG_LOG + LEVEL_STATUS:
         case WRAPPER_MSG_LOG + LEVEL_WARN:
         case WRAPPER_MSG_LOG + LEVEL_ERROR:
         case WRAPPER_MSG_LOG + LEVEL_FATAL:
-            wrapperLogSignaled(code - WRAPPER_MSG_LOG, packetBufferW);
+            wrapperLogSignaled(code - WRAPPER_MSG_LOG, packetMsgW);
+            break;
+
+        case WRAPPER_MSG_LOG_BATCH:
+            wrapperLogBatchSignaled(packetMsgW);
             break;
 
         case WRAPPER_MSG_APPEAR_ORPHAN:
@@ -4024,11 +4899,15 @@ int wrapperProtocolRead() {
 
         default:
             if (wrapperData->isDebugging) {
-                log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("received unknown packet (%d:%s)"), code, packetBufferW);
+                log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("received unknown packet (%d:%s)"), code, packetMsgW);
             }
             break;
         }
 
+        if (packetMsgW != packetBufferW) {
+            free(packetMsgW);
+        }
+
         /* Get the time again */
         wrapperGetCurrentTime(&timeBuffer);
         now = timeBuffer.time;
@@ -4195,6 +5074,14 @@ int wrapperInitialize() {
         printf("Failed to create tick mutex. %s\n", getLastErrorText());
         return 1;
     }
+    if (!(javaIOFlushMutexHandle = CreateMutex(NULL, FALSE, NULL))) {
+        printf("Failed to create JavaIO flush mutex. %s\n", getLastErrorText());
+        return 1;
+    }
+    if (!(javaIOFlushEventHandle = CreateEvent(NULL, TRUE, FALSE, NULL))) {
+        printf("Failed to create JavaIO flush event. %s\n", getLastErrorText());
+        return 1;
+    }
 
     /* Initialize control code queue. */
     wrapperData->ctrlCodeQueue = malloc(sizeof(int) * CTRL_CODE_QUEUE_SIZE);
@@ -4276,8 +5163,46 @@ int wrapperInitialize() {
 void wrapperDataDispose() {
     int i;
     
-    if (wrapperData->pingActionList) {
-        free(wrapperData->pingActionList);
+#ifdef LINUX
+    if (wrapperData->javaCgroupRoot) {
+        free(wrapperData->javaCgroupRoot);
+        wrapperData->javaCgroupRoot = NULL;
+    }
+    if (wrapperData->javaCgroupName) {
+        free(wrapperData->javaCgroupName);
+        wrapperData->javaCgroupName = NULL;
+    }
+    if (wrapperData->javaCgroupMemoryMax) {
+        free(wrapperData->javaCgroupMemoryMax);
+        wrapperData->javaCgroupMemoryMax = NULL;
+    }
+    if (wrapperData->javaCgroupCpuMax) {
+        free(wrapperData->javaCgroupCpuMax);
+        wrapperData->javaCgroupCpuMax = NULL;
+    }
+    if (wrapperData->javaCgroupPidsMax) {
+        free(wrapperData->javaCgroupPidsMax);
+        wrapperData->javaCgroupPidsMax = NULL;
+    }
+    if (wrapperData->javaCgroupMemoryPressureActionList) {
+        free(wrapperData->javaCgroupMemoryPressureActionList);
+        wrapperData->javaCgroupMemoryPressureActionList = NULL;
+    }
+    if (wrapperData->javaCgroupCpuPressureActionList) {
+        free(wrapperData->javaCgroupCpuPressureActionList);
+        wrapperData->javaCgroupCpuPressureActionList = NULL;
+    }
+    if (wrapperData->javaMonitorRssActionList) {
+        free(wrapperData->javaMonitorRssActionList);
+        wrapperData->javaMonitorRssActionList = NULL;
+    }
+    if (wrapperData->javaMonitorCpuActionList) {
+        free(wrapperData->javaMonitorCpuActionList);
+        wrapperData->javaMonitorCpuActionList = NULL;
+    }
+#endif
+    if (wrapperData->pingActionList) {
+        free(wrapperData->pingActionList);
         wrapperData->pingActionList = NULL;
     }
     if (wrapperData->workingDir) {
@@ -4448,6 +5373,28 @@ void wrapperDataDispose() {
         free(wrapperData->javaStatusFilename);
         wrapperData->javaStatusFilename = NULL;
     }
+    if (wrapperData->logRateOverflowFile) {
+        free(wrapperData->logRateOverflowFile);
+        wrapperData->logRateOverflowFile = NULL;
+    }
+    if (wrapperData->stateTraceFile) {
+        free(wrapperData->stateTraceFile);
+        wrapperData->stateTraceFile = NULL;
+    }
+    if (wrapperData->startupProfileFile) {
+        free(wrapperData->startupProfileFile);
+        wrapperData->startupProfileFile = NULL;
+    }
+#ifndef WIN32
+    if (wrapperData->metricsSocketPath) {
+        free(wrapperData->metricsSocketPath);
+        wrapperData->metricsSocketPath = NULL;
+    }
+    if (wrapperData->controlSocketPath) {
+        free(wrapperData->controlSocketPath);
+        wrapperData->controlSocketPath = NULL;
+    }
+#endif
     if (wrapperData->commandFilename) {
         free(wrapperData->commandFilename);
         wrapperData->commandFilename = NULL;
@@ -4563,12 +5510,26 @@ void wrapperDispose(int exitCode) {
         free(wrapperChildWorkBuffer);
         wrapperChildWorkBuffer = NULL;
     }
+    if (wrapperChildRecordBuffer) {
+        free(wrapperChildRecordBuffer);
+        wrapperChildRecordBuffer = NULL;
+    }
+    if (wrapperChildLastLine) {
+        free(wrapperChildLastLine);
+        wrapperChildLastLine = NULL;
+    }
 
     /* Note: It is important that all other threads completed at that point, as we are going to dispose the logging. */
     
     /* We will dispose the logging, so wrapperSleep should not be allowed to log anymore. */
     wrapperData->isSleepOutputEnabled = FALSE;
 
+    /* Report the startup profile if the Wrapper is stopping before the JVM was started. */
+    wrapperProfileReport(FALSE);
+
+    wrapperDumpStateTrace(wrapperData->stateTraceLogLevel);
+    wrapperDisposeStateTrace();
+
     /* Always call maintain logger once to make sure that all queued messages are logged before we exit. */
     maintainLogger();
 
@@ -4960,6 +5921,14 @@ void wrapperProcessActionList(int *actionList, const TCHAR *triggerMsg, int acti
                     case WRAPPER_ACTION_SOURCE_CODE_PING_TIMEOUT:
                         _sntprintf(propertyName, 52, TEXT("wrapper.ping.timeout.action"));
                         break;
+                    case WRAPPER_ACTION_SOURCE_CODE_JVM_MONITOR:
+                        _sntprintf(propertyName, 52, TEXT("wrapper.java.monitor.%s.action"), actionPropertyIndex == WRAPPER_JVM_MONITOR_LIMIT_RSS ? TEXT("rss") : TEXT("cpu"));
+                        break;
+#ifdef LINUX
+                    case WRAPPER_ACTION_SOURCE_CODE_CGROUP_PRESSURE:
+                        _sntprintf(propertyName, 52, TEXT("wrapper.java.cgroup.%s.pressure.action"), actionPropertyIndex == WRAPPER_CGROUP_MEMORY ? TEXT("memory") : TEXT("cpu"));
+                        break;
+#endif
                     default:
                         _sntprintf(propertyName, 52, TEXT(""));
                     }
@@ -5680,10 +6649,14 @@ void logParseJavaBootstrapOutput(TCHAR* log) {
     }
 }
 
-void logApplyFilters(const TCHAR *log) {
+/**
+ * Looks for the first output filter matching a line of output.
+ *
+ * @return The index of the filter, or -1 if none matched.
+ */
+static int logFindFilter(const TCHAR *log) {
     int i;
     const TCHAR *filter;
-    const TCHAR *filterMessage;
     int matched;
 
     /* Look for output filters in the output.  Only match the first. */
@@ -5707,17 +6680,34 @@ void logApplyFilters(const TCHAR *log) {
             }
 
             if (matched) {
-                filterMessage = wrapperData->outputFilterMessages[i];
-                if ((!filterMessage) || (_tcslen(filterMessage) <= 0)) {
-                    filterMessage = TEXT("Filter trigger matched.");
-                }
-                wrapperProcessActionList(wrapperData->outputFilterActionLists[i], filterMessage, WRAPPER_ACTION_SOURCE_CODE_FILTER, i, FALSE, wrapperData->errorExitCode);
-
-                /* break out of the loop */
-                break;
+                return i;
             }
         }
     }
+    return -1;
+}
+
+/**
+ * Fires the actions of an output filter which matched.
+ */
+static void logFireFilter(int i) {
+    const TCHAR *filterMessage;
+
+    WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_FILTER_HITS, 1);
+    filterMessage = wrapperData->outputFilterMessages[i];
+    if ((!filterMessage) || (_tcslen(filterMessage) <= 0)) {
+        filterMessage = TEXT("Filter trigger matched.");
+    }
+    wrapperProcessActionList(wrapperData->outputFilterActionLists[i], filterMessage, WRAPPER_ACTION_SOURCE_CODE_FILTER, i, FALSE, wrapperData->errorExitCode);
+}
+
+void logApplyFilters(const TCHAR *log) {
+    int i;
+
+    i = logFindFilter(log);
+    if (i >= 0) {
+        logFireFilter(i);
+    }
 }
 
 #ifdef _DEBUG
@@ -5739,36 +6729,31 @@ void printBytes(const char * s) {
 #endif
 
 /**
- * Logs a single line of child output allowing any filtering
- *  to be done in a common location.
+ * Converts child output to TCHARs using the encoding of the JVM output.
+ *
+ * @return The converted string, which must be released with
+ *         freeChildOutputTChar(), or NULL if it could not be converted.
+ *         The problem has been logged.
  */
-void logChildOutput(const char* log) {
+static TCHAR* childOutputToTChar(const char* log) {
     TCHAR* tlog = NULL;
 #ifdef UNICODE
  #ifdef WIN32
     int size;
     UINT cp;
- #endif
-#endif
-
-#ifdef _DEBUG
-    printBytes(log);
-#endif
 
-#ifdef UNICODE
- #ifdef WIN32
     cp = getJvmOutputCodePage();
     size = MultiByteToWideChar(cp, 0, log, -1 , NULL, 0);
     if (size <= 0) {
         log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN,
                     TEXT("Invalid multibyte sequence in %s: %s"), TEXT("JVM console output"), getLastErrorText());
-        return;
+        return NULL;
     }
 
     tlog = (TCHAR*)malloc((size + 1) * sizeof(TCHAR));
     if (!tlog) {
         outOfMemory(TEXT("WLCO"), 1);
-        return;
+        return NULL;
     }
     MultiByteToWideChar(cp, 0, log, -1, tlog, size + 1);
  #else
@@ -5779,12 +6764,37 @@ void logChildOutput(const char* log) {
         } else {
             outOfMemory(TEXT("WLCO"), 1);
         }
-        return;
+        return NULL;
     }
  #endif
 #else
     tlog = (TCHAR*)log;
 #endif
+    return tlog;
+}
+
+static void freeChildOutputTChar(TCHAR* tlog) {
+#ifdef UNICODE
+    free(tlog);
+#endif
+}
+
+/**
+ * Logs a single line of child output allowing any filtering
+ *  to be done in a common location.
+ */
+void logChildOutput(const char* log) {
+    TCHAR* tlog;
+    TCHAR* tcopy = NULL;
+
+#ifdef _DEBUG
+    printBytes(log);
+#endif
+
+    tlog = childOutputToTChar(log);
+    if (!tlog) {
+        return;
+    }
     
     /* NOTE: Don't use 'TEXT("%s")' here! log_printf operates in a different (& faster) mode when the source is WRAPPER_SOURCE_JVM_QRY
      *       or a positive integer (jvm restart count). It prints the output as a direct message without processing format specifiers. */
@@ -5827,10 +6837,24 @@ void logChildOutput(const char* log) {
 
     case WRAPPER_JVM_APP:
         /* Normal JVM output. */
+        if ((wrapperData->outputFilterCount > 0) && _tcschr(tlog, TEXT('\n'))) {
+            /* A multi-line record.  log_printf breaks it up in place, but the filters are evaluated once against the whole record. */
+            tcopy = malloc(sizeof(TCHAR) * (_tcslen(tlog) + 1));
+            if (!tcopy) {
+                outOfMemory(TEXT("WLCO"), 2);
+            } else {
+                _tcsncpy(tcopy, tlog, _tcslen(tlog) + 1);
+            }
+        }
         log_printf(wrapperData->jvmRestarts, wrapperData->jvmDefaultLogLevel, tlog);
 
         /* Look for output filters in the output.  Only match the first. */
-        logApplyFilters(tlog);
+        if (tcopy) {
+            logApplyFilters(tcopy);
+            free(tcopy);
+        } else {
+            logApplyFilters(tlog);
+        }
         break;
 
     default:
@@ -5838,138 +6862,550 @@ void logChildOutput(const char* log) {
         break;
     }
 
-#ifdef UNICODE
-    free(tlog);
-#endif
+    freeChildOutputTChar(tlog);
 }
 
 /**
- * This function is for moving a buffer inside itself.
- *
- * This implementation exists because the standard memcpy is not reliable on
- *  some platforms when the source and target buffer are the same.  Most likely the
- *  problem was caused by internal optimizations, but it was leading to crashes.
+ * Tells whether a line of JVM output continues the record started by the
+ *  previous lines, as is the case for the lines of a stack trace.
  */
-void safeMemCpy(char *buffer, size_t target, size_t src, size_t nbyte) {
-    size_t i;
-    for (i = 0; i < nbyte; i++) {
-        buffer[target + i] = buffer[src + i];
+static int isChildOutputContinuation(const char *line) {
+    const char *c;
+
+    if ((line[0] == ' ') || (line[0] == '\t')) {
+        /* Frames ("\tat "), "\t... N more" and "\tSuppressed: " all start with a tab. */
+        return TRUE;
     }
+    if ((strncmp(line, "at ", 3) == 0) || (strncmp(line, "Caused by:", 10) == 0)) {
+        return TRUE;
+    }
+    if (strncmp(line, "... ", 4) == 0) {
+        c = line + 4;
+        if ((*c >= '0') && (*c <= '9')) {
+            while ((*c >= '0') && (*c <= '9')) {
+                c++;
+            }
+            return (strcmp(c, " more") == 0);
+        }
+    }
+    return FALSE;
 }
 
-#define CHAR_LF 0x0a
+/**
+ * Logs the pending multi-line record, if any.
+ */
+static void flushChildOutputRecord() {
+    if (wrapperChildRecordLen > 0) {
+        logChildOutput(wrapperChildRecordBuffer);
+        if (wrapperChildRecordLines > 1) {
+            WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_JVM_OUTPUT_RECORDS, 1);
+        }
+        wrapperChildRecordLen = 0;
+        wrapperChildRecordLines = 0;
+    }
+}
 
 /**
- * Read and process any output from the child JVM Process.
- *
- * When maxTimeMS is non-zero this function will only be allowed to run for that maximum
- *  amount of time.  This is done to make sure the calling function is allowed CPU for
- *  other activities.   When timing out for this reason when there is more data in the
- *  pipe, this function will return TRUE to let the calling code know that it should
- *  not do any unnecessary sleeps.  Otherwise FALSE will be returned.
+ * Computes the FNV-1a hash of a line.
+ */
+static unsigned int childOutputHash(const char *line, size_t len) {
+    unsigned int hash = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (unsigned char)line[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/**
+ * Logs how many times the last line was repeated since it, or the previous
+ *  summary, was logged.  Unless force is TRUE, the summary is only logged once
+ *  wrapper.log.collapse_repeats.interval has passed.
  *
- * @param maxTimeMS The maximum number of milliseconds that this function will be allowed
- *                  to run without returning.  In reality no new reads will happen after
- *                  this time, but actual processing may take longer.
+ * @param force TRUE if the run of repeated lines ended.  The next line will
+ *              not be compared with the last line.
+ */
+static void flushChildOutputRepeats(time_t now, int nowMillis, int force) {
+    TCHAR buffer[64];
+
+    if ((wrapperChildRepeatCount > 0) &&
+            (force || (((now - wrapperChildRepeatTime) * 1000 + (nowMillis - wrapperChildRepeatTimeMillis)) >= wrapperData->logCollapseRepeatsInterval * 1000))) {
+        /* Not using a format with log_printf as it prints the output of the JVM as is. */
+        if (wrapperChildRepeatCount == 1) {
+            _sntprintf(buffer, 64, TEXT("Previous line repeated %d time."), wrapperChildRepeatCount);
+        } else {
+            _sntprintf(buffer, 64, TEXT("Previous line repeated %d times."), wrapperChildRepeatCount);
+        }
+        log_printf(wrapperData->jvmRestarts, wrapperData->jvmDefaultLogLevel, buffer);
+        wrapperChildRepeatCount = 0;
+    }
+    if (force) {
+        wrapperChildLastLineSet = FALSE;
+    }
+}
+
+/**
+ * Collapses a line of JVM output which is the same as the previous one.  The
+ *  first repeat evaluates the filters against the line, and the filter which
+ *  matched, if any, is then fired for every repeat as if it had been logged.
  *
- * @return TRUE if the calling code should call this function again as soon as possible.
+ * @return TRUE if the line was a repeat and must not be logged.
  */
-int wrapperReadChildOutput(int maxTimeMS) {
-    struct timeb timeBuffer;
-    time_t startTime;
-    int startTimeMillis;
-    time_t now;
-    int nowMillis;
-    time_t durr;
+static int collapseChildOutputLine(const char *line, time_t now, int nowMillis) {
+    size_t len;
+    unsigned int hash;
     char *tempBuffer;
-    char *cLF;
-    int currentBlockRead;
-    size_t loggedOffset;
-    int defer = FALSE;
-    int readThisPass = FALSE;
-    size_t i;
+    TCHAR *tline;
+
+    len = strlen(line);
+    hash = childOutputHash(line, len);
+    if (wrapperChildLastLineSet && (hash == wrapperChildLastLineHash) && (len == wrapperChildLastLineLen) && (memcmp(line, wrapperChildLastLine, len) == 0)) {
+        /* The first occurrence may still be held back in a multi-line record.  It must be logged before the summary. */
+        flushChildOutputRecord();
+        if (wrapperChildRepeatCount == 0) {
+            wrapperChildRepeatTime = now;
+            wrapperChildRepeatTimeMillis = nowMillis;
+            wrapperChildRepeatFilter = -1;
+            if (wrapperData->outputFilterCount > 0) {
+                tline = childOutputToTChar(line);
+                if (tline) {
+                    wrapperChildRepeatFilter = logFindFilter(tline);
+                    freeChildOutputTChar(tline);
+                }
+            }
+        }
+        wrapperChildRepeatCount++;
+        WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_JVM_OUTPUT_REPEATS, 1);
+        if (wrapperChildRepeatFilter >= 0) {
+            logFireFilter(wrapperChildRepeatFilter);
+        }
+        if (((now - wrapperChildRepeatTime) * 1000 + (nowMillis - wrapperChildRepeatTimeMillis)) >= wrapperData->logCollapseRepeatsInterval * 1000) {
+            /* A long run.  Let the log show that it is still going on. */
+            flushChildOutputRepeats(now, nowMillis, FALSE);
+        }
+        return TRUE;
+    }
 
-    if (!wrapperChildWorkBuffer) {
-        /* Initialize the wrapperChildWorkBuffer.  Set its initial size to the block size + 1.
-         *  This is so that we can always add a \0 to the end of it. */
-        wrapperChildWorkBuffer = malloc(sizeof(char) * ((READ_BUFFER_BLOCK_SIZE * 2) + 1));
-        if (!wrapperChildWorkBuffer) {
-            outOfMemory(TEXT("WRCO"), 1);
+    flushChildOutputRepeats(now, nowMillis, TRUE);
+
+    /* Remember the line to compare it with the next one. */
+    if (len + 1 > wrapperChildLastLineSize) {
+        tempBuffer = malloc(len + 1);
+        if (!tempBuffer) {
+            outOfMemory(TEXT("CCOL"), 1);
             return FALSE;
         }
-        wrapperChildWorkBufferSize = READ_BUFFER_BLOCK_SIZE * 2;
-        wrapperChildWorkBufferLen = 0;
+        if (wrapperChildLastLine) {
+            free(wrapperChildLastLine);
+        }
+        wrapperChildLastLine = tempBuffer;
+        wrapperChildLastLineSize = len + 1;
     }
+    memcpy(wrapperChildLastLine, line, len + 1);
+    wrapperChildLastLineLen = len;
+    wrapperChildLastLineHash = hash;
+    wrapperChildLastLineSet = TRUE;
+    return FALSE;
+}
 
-    wrapperGetCurrentTime(&timeBuffer);
-    startTime = now = timeBuffer.time;
-    startTimeMillis = nowMillis = timeBuffer.millitm;
+static int isAsciiAlnum(char c) {
+    return ((c >= '0') && (c <= '9')) || ((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z'));
+}
 
-#ifdef DEBUG_CHILD_OUTPUT
-    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("wrapperReadChildOutput() BEGIN"));
-    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("now=%ld, nowMillis=%d"), now, nowMillis);
-#endif
+/**
+ * Tells whether a line of JVM output must be logged even when it exceeds the
+ *  rate limit: the output is logged at the ERROR or FATAL level, the line
+ *  contains an ERROR, FATAL or SEVERE level word, or it matches a filter.
+ */
+static int isChildOutputLineImportant(const char *line) {
+    const char *c;
+    size_t len;
+    TCHAR *tline;
+    int matched;
 
-    /* Loop and read in CHILD_BLOCK_SIZE characters at a time.
-     *
-     * To keep a JVM outputting lots of content from freezing the Wrapper, we force a return every 250ms. */
-    while ((maxTimeMS <= 0) || ((durr = (now - startTime) * 1000 + (nowMillis - startTimeMillis)) < maxTimeMS)) {
-#ifdef DEBUG_CHILD_OUTPUT
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("durr=%ld"), durr);
-#endif
+    if ((wrapperData->jvmDefaultLogLevel == LEVEL_ERROR) || (wrapperData->jvmDefaultLogLevel == LEVEL_FATAL)) {
+        return TRUE;
+    }
 
-        /* If there is not enough space in the work buffer to read in a full block then it needs to be extended. */
-        if (wrapperChildWorkBufferLen + READ_BUFFER_BLOCK_SIZE > wrapperChildWorkBufferSize) {
-#ifdef DEBUG_CHILD_OUTPUT
-            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Expand buffer."));
-#endif
-            /* Increase the buffer quickly, but try not to get too big.  Increase to a size that is the
-             *  greater of size + 1024 or size * 1.1.
-             * Also make sure the new buffer is larger than the buffer len.  This should not be necessary
-             *  but is safer. */
-            wrapperChildWorkBufferSize = __max(wrapperChildWorkBufferLen + 1, __max(wrapperChildWorkBufferSize + READ_BUFFER_BLOCK_SIZE, wrapperChildWorkBufferSize + wrapperChildWorkBufferSize / 10));
-            
-            tempBuffer = malloc(wrapperChildWorkBufferSize + 1);
-            if (!tempBuffer) {
-                outOfMemory(TEXT("WRCO"), 2);
-                return FALSE;
+    for (c = line; *c; c++) {
+        if ((*c == 'E') || (*c == 'F') || (*c == 'S')) {
+            if ((c > line) && isAsciiAlnum(c[-1])) {
+                continue;
+            }
+            if ((strncmp(c, "ERROR", 5) == 0) || (strncmp(c, "FATAL", 5) == 0)) {
+                len = 5;
+            } else if (strncmp(c, "SEVERE", 6) == 0) {
+                len = 6;
+            } else {
+                continue;
+            }
+            if (!isAsciiAlnum(c[len])) {
+                return TRUE;
             }
-            memcpy(tempBuffer, wrapperChildWorkBuffer, wrapperChildWorkBufferLen);
-            tempBuffer[wrapperChildWorkBufferLen] = '\0';
-            free(wrapperChildWorkBuffer);
-            wrapperChildWorkBuffer = tempBuffer;
-#ifdef DEBUG_CHILD_OUTPUT
-            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("buffer now %d bytes"), wrapperChildWorkBufferSize);
-#endif
-        }
-
-#ifdef DEBUG_CHILD_OUTPUT
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Try reading from pipe.  totalBuffLen=%d, buffSize=%d"), wrapperChildWorkBufferLen, wrapperChildWorkBufferSize);
-#endif
-        if (wrapperReadChildOutputBlock(wrapperChildWorkBuffer + (wrapperChildWorkBufferLen), (int)(wrapperChildWorkBufferSize - wrapperChildWorkBufferLen), &currentBlockRead)) {
-            /* Error already reported. */
-            return FALSE;
         }
+    }
 
-        if (currentBlockRead > 0) {
-            /* We read in a block, so increase the length. */
-            wrapperChildWorkBufferLen += currentBlockRead;
-            if (wrapperChildWorkIsNewLine) {
-                wrapperChildWorkLastDataTime = now;
-                wrapperChildWorkLastDataTimeMillis = nowMillis;
-                wrapperChildWorkIsNewLine = FALSE;
+    if (wrapperData->outputFilterCount > 0) {
+        tline = childOutputToTChar(line);
+        if (tline) {
+            matched = (logFindFilter(tline) >= 0);
+            freeChildOutputTChar(tline);
+            if (matched) {
+                return TRUE;
             }
-            readThisPass = TRUE;
-#ifdef DEBUG_CHILD_OUTPUT
-            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("  Read %d bytes of new output.  totalBuffLen=%d, buffSize=%d"), currentBlockRead, wrapperChildWorkBufferLen, wrapperChildWorkBufferSize);
-#endif
         }
+    }
+    return FALSE;
+}
 
-        /* Terminate the string just to avoid errors.  The buffer has an extra character to handle this. */
-        wrapperChildWorkBuffer[wrapperChildWorkBufferLen] = '\0';
-        
-        /* Loop over the contents of the buffer and try and extract as many lines as possible.
-         *  Keep track of where we are to avoid unnecessary memory copies.
+/**
+ * Logs a summary of the lines which exceeded the rate limit since the
+ *  previous summary.  Unless force is TRUE, this is only done once
+ *  wrapper.log.rate_limit.summary_interval has passed.
+ */
+static void flushChildOutputRateSummary(time_t now, int force) {
+    int seconds;
+
+    if (!wrapperChildRateStarted) {
+        return;
+    }
+    seconds = (int)(now - wrapperChildRateSummaryTime);
+    if ((wrapperChildRateExcessLines > 0) && (force || (seconds >= wrapperData->logRateSummaryInterval))) {
+        if (wrapperData->logRateMode == WRAPPER_LOG_RATE_MODE_OVERFLOW && !wrapperChildRateOverflowFailed) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Wrote %u lines (%.0f bytes) of JVM output exceeding the rate limit to %s in the last %d seconds."),
+                wrapperChildRateExcessLines, wrapperChildRateExcessBytes, wrapperData->logRateOverflowFile, seconds);
+        } else if (wrapperData->logRateMode == WRAPPER_LOG_RATE_MODE_SAMPLE) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Dropped %u lines (%.0f bytes) of JVM output exceeding the rate limit in the last %d seconds, and logged %u samples."),
+                wrapperChildRateExcessLines, wrapperChildRateExcessBytes, seconds, wrapperChildRateSampled);
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Dropped %u lines (%.0f bytes) of JVM output exceeding the rate limit in the last %d seconds."),
+                wrapperChildRateExcessLines, wrapperChildRateExcessBytes, seconds);
+        }
+        wrapperChildRateExcessLines = 0;
+        wrapperChildRateExcessBytes = 0;
+        wrapperChildRateSampled = 0;
+        wrapperChildRateSummaryTime = now;
+    }
+}
+
+/**
+ * Writes a line exceeding the rate limit to the overflow file.
+ *
+ * @return TRUE if the file could not be written.
+ */
+static int writeChildOutputOverflow(const char *line, size_t len) {
+    if (wrapperChildRateOverflowFailed) {
+        return TRUE;
+    }
+    if (!wrapperChildRateOverflowFP) {
+        wrapperChildRateOverflowFP = _tfopen(wrapperData->logRateOverflowFile, TEXT("ab"));
+        if (!wrapperChildRateOverflowFP) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to open the overflow file %s: %s  Lines of JVM output exceeding the rate limit will be dropped."),
+                wrapperData->logRateOverflowFile, getLastErrorText());
+            wrapperChildRateOverflowFailed = TRUE;
+            return TRUE;
+        }
+    }
+    fwrite(line, 1, len, wrapperChildRateOverflowFP);
+    fputc('\n', wrapperChildRateOverflowFP);
+    return FALSE;
+}
+
+/**
+ * Applies wrapper.log.rate_limit.* to a line of JVM output.  The buckets hold
+ *  up to wrapper.log.rate_limit.burst seconds worth of lines and bytes, and
+ *  are refilled at the configured rates.  A line is allowed while both
+ *  buckets are positive, and may leave them in debt.
+ *
+ * @return TRUE if the line must be logged, FALSE if it was dropped or
+ *         written to the overflow file.
+ */
+static int rateLimitChildOutputLine(const char *line, time_t now, int nowMillis) {
+    size_t len;
+    double elapsedMs;
+
+    len = strlen(line);
+    if (!wrapperChildRateStarted) {
+        wrapperChildRateLineTokens = (double)wrapperData->logRateLines * wrapperData->logRateBurst;
+        wrapperChildRateByteTokens = (double)wrapperData->logRateBytes * wrapperData->logRateBurst;
+        wrapperChildRateTime = now;
+        wrapperChildRateTimeMillis = nowMillis;
+        wrapperChildRateSummaryTime = now;
+        wrapperChildRateStarted = TRUE;
+    } else {
+        elapsedMs = (double)(now - wrapperChildRateTime) * 1000 + (nowMillis - wrapperChildRateTimeMillis);
+        if (elapsedMs > 0) {
+            wrapperChildRateLineTokens = __min((double)wrapperData->logRateLines * wrapperData->logRateBurst, wrapperChildRateLineTokens + elapsedMs * wrapperData->logRateLines / 1000);
+            wrapperChildRateByteTokens = __min((double)wrapperData->logRateBytes * wrapperData->logRateBurst, wrapperChildRateByteTokens + elapsedMs * wrapperData->logRateBytes / 1000);
+            wrapperChildRateTime = now;
+            wrapperChildRateTimeMillis = nowMillis;
+        }
+    }
+
+    if (((wrapperData->logRateLines == 0) || (wrapperChildRateLineTokens >= 1)) &&
+            ((wrapperData->logRateBytes == 0) || (wrapperChildRateByteTokens > 0))) {
+        wrapperChildRateLineTokens -= 1;
+        wrapperChildRateByteTokens -= (double)len;
+        return TRUE;
+    }
+
+    if (isChildOutputLineImportant(line)) {
+        /* Still counted, so that it delays the following lines. */
+        wrapperChildRateLineTokens -= 1;
+        wrapperChildRateByteTokens -= (double)len;
+        return TRUE;
+    }
+
+    if ((wrapperChildRateExcessLines == 0) && (wrapperChildRateSampled == 0)) {
+        /* The interval of the summary starts with its first excess line. */
+        wrapperChildRateSummaryTime = now;
+    }
+
+    if (wrapperData->logRateMode == WRAPPER_LOG_RATE_MODE_SAMPLE) {
+        if (++wrapperChildRateSampleCount >= wrapperData->logRateSample) {
+            wrapperChildRateSampleCount = 0;
+            wrapperChildRateSampled++;
+            return TRUE;
+        }
+    } else if (wrapperData->logRateMode == WRAPPER_LOG_RATE_MODE_OVERFLOW) {
+        writeChildOutputOverflow(line, len);
+    }
+    wrapperChildRateExcessLines++;
+    wrapperChildRateExcessBytes += (double)len;
+    WRAPPER_METRICS_ADD(getThreadId(), WRAPPER_METRIC_JVM_OUTPUT_DROPPED, 1);
+    flushChildOutputRateSummary(now, FALSE);
+    return FALSE;
+}
+
+/**
+ * Ends the rate limiting of the output of a JVM: logs the last summary and
+ *  closes the overflow file.  The next JVM starts with full buckets.
+ */
+static void resetChildOutputRate(time_t now) {
+    flushChildOutputRateSummary(now, TRUE);
+    if (wrapperChildRateOverflowFP) {
+        fclose(wrapperChildRateOverflowFP);
+        wrapperChildRateOverflowFP = NULL;
+    }
+    wrapperChildRateOverflowFailed = FALSE;
+    wrapperChildRateSampleCount = 0;
+    wrapperChildRateStarted = FALSE;
+}
+
+/**
+ * Logs a complete line of JVM output.  When wrapper.log.multiline is set, the
+ *  line is held back until it is known whether the following lines continue
+ *  it, so that a stack trace is logged, filtered and sent to the syslog as a
+ *  single record.
+ */
+static void logChildOutputLine(const char *line, time_t now, int nowMillis) {
+    size_t len;
+    size_t size;
+    char *tempBuffer;
+
+    if (wrapperData->jvmCallType != WRAPPER_JVM_APP) {
+        /* The output of the Java queries is parsed line by line. */
+        flushChildOutputRecord();
+        flushChildOutputRepeats(now, nowMillis, TRUE);
+        logChildOutput(line);
+        return;
+    }
+
+    if (wrapperData->logCollapseRepeats && collapseChildOutputLine(line, now, nowMillis)) {
+        return;
+    }
+
+    if (((wrapperData->logRateLines > 0) || (wrapperData->logRateBytes > 0)) && !rateLimitChildOutputLine(line, now, nowMillis)) {
+        return;
+    }
+
+    if (!wrapperData->logMultiline) {
+        logChildOutput(line);
+        return;
+    }
+
+    if ((wrapperChildRecordLen > 0) && ((wrapperChildRecordLines >= wrapperData->logMultilineMaxLines) || !isChildOutputContinuation(line))) {
+        flushChildOutputRecord();
+    }
+
+    len = strlen(line);
+    size = wrapperChildRecordLen + 1 + len + 1;
+    if (size > wrapperChildRecordBufferSize) {
+        size = __max(size, wrapperChildRecordBufferSize * 2);
+        tempBuffer = malloc(size);
+        if (!tempBuffer) {
+            outOfMemory(TEXT("LCOL"), 1);
+            flushChildOutputRecord();
+            logChildOutput(line);
+            return;
+        }
+        if (wrapperChildRecordBuffer) {
+            memcpy(tempBuffer, wrapperChildRecordBuffer, wrapperChildRecordLen);
+            free(wrapperChildRecordBuffer);
+        }
+        wrapperChildRecordBuffer = tempBuffer;
+        wrapperChildRecordBufferSize = size;
+    }
+    if (wrapperChildRecordLen > 0) {
+        wrapperChildRecordBuffer[wrapperChildRecordLen++] = '\n';
+    }
+    memcpy(wrapperChildRecordBuffer + wrapperChildRecordLen, line, len + 1);
+    wrapperChildRecordLen += len;
+    wrapperChildRecordLines++;
+    wrapperChildRecordLastTime = now;
+    wrapperChildRecordLastTimeMillis = nowMillis;
+}
+
+/**
+ * Logs the pending multi-line record once no continuation line arrived within
+ *  the LF delay threshold, or right away if force is TRUE.
+ */
+static void maintainChildOutputRecord(time_t now, int nowMillis, int force) {
+    if ((wrapperChildRecordLen > 0) && (force || (wrapperData->logLFDelayThreshold == 0) ||
+            (((now - wrapperChildRecordLastTime) * 1000 + (nowMillis - wrapperChildRecordLastTimeMillis)) >= wrapperData->logLFDelayThreshold))) {
+        flushChildOutputRecord();
+    }
+    /* A run of repeated lines which went quiet is summarized after the interval. */
+    flushChildOutputRepeats(now, nowMillis, force);
+    flushChildOutputRateSummary(now, force);
+}
+
+/**
+ * This function is for moving a buffer inside itself.
+ *
+ * This implementation exists because the standard memcpy is not reliable on
+ *  some platforms when the source and target buffer are the same.  Most likely the
+ *  problem was caused by internal optimizations, but it was leading to crashes.
+ */
+void safeMemCpy(char *buffer, size_t target, size_t src, size_t nbyte) {
+    size_t i;
+    for (i = 0; i < nbyte; i++) {
+        buffer[target + i] = buffer[src + i];
+    }
+}
+
+#define CHAR_LF 0x0a
+
+/**
+ * Read and process any output from the child JVM Process.
+ *
+ * When maxTimeMS is non-zero this function will only be allowed to run for that maximum
+ *  amount of time.  This is done to make sure the calling function is allowed CPU for
+ *  other activities.   When timing out for this reason when there is more data in the
+ *  pipe, this function will return TRUE to let the calling code know that it should
+ *  not do any unnecessary sleeps.  Otherwise FALSE will be returned.
+ *
+ * @param maxTimeMS The maximum number of milliseconds that this function will be allowed
+ *                  to run without returning.  In reality no new reads will happen after
+ *                  this time, but actual processing may take longer.
+ *
+ * @return TRUE if the calling code should call this function again as soon as possible.
+ */
+int wrapperReadChildOutput(int maxTimeMS) {
+    struct timeb timeBuffer;
+    time_t startTime;
+    int startTimeMillis;
+    time_t now;
+    int nowMillis;
+    time_t durr;
+    char *tempBuffer;
+    char *cLF;
+    int currentBlockRead;
+    size_t loggedOffset;
+    int defer = FALSE;
+    int readThisPass = FALSE;
+    size_t i;
+    int metricsThreadId = 0;
+
+    if (!wrapperChildWorkBuffer) {
+        /* Initialize the wrapperChildWorkBuffer.  Set its initial size to the block size + 1.
+         *  This is so that we can always add a \0 to the end of it. */
+        wrapperChildWorkBuffer = malloc(sizeof(char) * ((READ_BUFFER_BLOCK_SIZE * 2) + 1));
+        if (!wrapperChildWorkBuffer) {
+            outOfMemory(TEXT("WRCO"), 1);
+            return FALSE;
+        }
+        wrapperChildWorkBufferSize = READ_BUFFER_BLOCK_SIZE * 2;
+        wrapperChildWorkBufferLen = 0;
+    }
+
+    wrapperGetCurrentTime(&timeBuffer);
+    startTime = now = timeBuffer.time;
+    startTimeMillis = nowMillis = timeBuffer.millitm;
+
+    if (wrapperMetricsEnabled) {
+        /* This is called either by the main thread or by the Java IO thread.  Only look it up once per call. */
+        metricsThreadId = getThreadId();
+    }
+
+#ifdef DEBUG_CHILD_OUTPUT
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("wrapperReadChildOutput() BEGIN"));
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("now=%ld, nowMillis=%d"), now, nowMillis);
+#endif
+
+    /* Loop and read in CHILD_BLOCK_SIZE characters at a time.
+     *
+     * To keep a JVM outputting lots of content from freezing the Wrapper, we force a return every 250ms. */
+    while ((maxTimeMS <= 0) || ((durr = (now - startTime) * 1000 + (nowMillis - startTimeMillis)) < maxTimeMS)) {
+#ifdef DEBUG_CHILD_OUTPUT
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("durr=%ld"), durr);
+#endif
+
+        /* If there is not enough space in the work buffer to read in a full block then it needs to be extended. */
+        if (wrapperChildWorkBufferLen + READ_BUFFER_BLOCK_SIZE > wrapperChildWorkBufferSize) {
+#ifdef DEBUG_CHILD_OUTPUT
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Expand buffer."));
+#endif
+            /* Increase the buffer quickly, but try not to get too big.  Increase to a size that is the
+             *  greater of size + 1024 or size * 1.1.
+             * Also make sure the new buffer is larger than the buffer len.  This should not be necessary
+             *  but is safer. */
+            wrapperChildWorkBufferSize = __max(wrapperChildWorkBufferLen + 1, __max(wrapperChildWorkBufferSize + READ_BUFFER_BLOCK_SIZE, wrapperChildWorkBufferSize + wrapperChildWorkBufferSize / 10));
+            
+            tempBuffer = malloc(wrapperChildWorkBufferSize + 1);
+            if (!tempBuffer) {
+                outOfMemory(TEXT("WRCO"), 2);
+                return FALSE;
+            }
+            memcpy(tempBuffer, wrapperChildWorkBuffer, wrapperChildWorkBufferLen);
+            tempBuffer[wrapperChildWorkBufferLen] = '\0';
+            free(wrapperChildWorkBuffer);
+            wrapperChildWorkBuffer = tempBuffer;
+#ifdef DEBUG_CHILD_OUTPUT
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("buffer now %d bytes"), wrapperChildWorkBufferSize);
+#endif
+        }
+
+#ifdef DEBUG_CHILD_OUTPUT
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Try reading from pipe.  totalBuffLen=%d, buffSize=%d"), wrapperChildWorkBufferLen, wrapperChildWorkBufferSize);
+#endif
+        if (wrapperReadChildOutputBlock(wrapperChildWorkBuffer + (wrapperChildWorkBufferLen), (int)(wrapperChildWorkBufferSize - wrapperChildWorkBufferLen), &currentBlockRead)) {
+            /* Error already reported. */
+            return FALSE;
+        }
+
+        if (currentBlockRead > 0) {
+            /* We read in a block, so increase the length. */
+            wrapperChildWorkBufferLen += currentBlockRead;
+            WRAPPER_METRICS_ADD(metricsThreadId, WRAPPER_METRIC_JVM_OUTPUT_BYTES, currentBlockRead);
+            if (wrapperChildWorkIsNewLine) {
+                wrapperChildWorkLastDataTime = now;
+                wrapperChildWorkLastDataTimeMillis = nowMillis;
+                wrapperChildWorkIsNewLine = FALSE;
+            }
+            readThisPass = TRUE;
+#ifdef DEBUG_CHILD_OUTPUT
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("  Read %d bytes of new output.  totalBuffLen=%d, buffSize=%d"), currentBlockRead, wrapperChildWorkBufferLen, wrapperChildWorkBufferSize);
+#endif
+        }
+
+        /* Terminate the string just to avoid errors.  The buffer has an extra character to handle this. */
+        wrapperChildWorkBuffer[wrapperChildWorkBufferLen] = '\0';
+        
+        /* Loop over the contents of the buffer and try and extract as many lines as possible.
+         *  Keep track of where we are to avoid unnecessary memory copies.
          *  At this point, the entire buffer will always be unlogged. */
         loggedOffset = 0;
         defer = FALSE;
@@ -6025,7 +7461,8 @@ int wrapperReadChildOutput(int maxTimeMS) {
  #endif
 #endif
                 /* Actually log the individual line of output. */
-                logChildOutput(wrapperChildWorkBuffer + loggedOffset);
+                logChildOutputLine(wrapperChildWorkBuffer + loggedOffset, now, nowMillis);
+                WRAPPER_METRICS_ADD(metricsThreadId, WRAPPER_METRIC_JVM_OUTPUT_LINES, 1);
                 
                 /* Update the offset so we know how far we've logged. */
                 loggedOffset = cLF - wrapperChildWorkBuffer + 1;
@@ -6078,7 +7515,11 @@ int wrapperReadChildOutput(int maxTimeMS) {
                         (now - wrapperChildWorkLastDataTime) * 1000 + (nowMillis - wrapperChildWorkLastDataTimeMillis));
  #endif
 #endif
+                    /* A prompt never continues a record, nor is collapsed. */
+                    flushChildOutputRecord();
+                    flushChildOutputRepeats(now, nowMillis, TRUE);
                     logChildOutput(wrapperChildWorkBuffer + loggedOffset);
+                    WRAPPER_METRICS_ADD(metricsThreadId, WRAPPER_METRIC_JVM_OUTPUT_LINES, 1);
                     
                     /* We know we read everything so we can safely reset the loggedOffset and clear the buffer. */
                     wrapperChildWorkBuffer[0] = '\0';
@@ -6116,7 +7557,8 @@ int wrapperReadChildOutput(int maxTimeMS) {
         }
 
         if (currentBlockRead <= 0) {
-            /* All done for now. */
+            /* All done for now.  Unless the next line may still come, log the pending record. */
+            maintainChildOutputRecord(now, nowMillis, FALSE);
             if (wrapperChildWorkBufferLen > 0) {
 #ifdef DEBUG_CHILD_OUTPUT
                 log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("wrapperReadChildOutput() END (Incomplete)"));
@@ -6142,42 +7584,191 @@ int wrapperReadChildOutput(int maxTimeMS) {
     return TRUE;
 }
 
-void wrapperReadAllChildOutputAfterFailure() {
-    /* Set a flag so that there will be no attempt to parse the output. */
-    wrapperData->jvmQuerySkipParse = TRUE;
-    wrapperData->jvmDefaultLogLevel = LEVEL_ERROR;
-    
-    /* Read all messages of the output as it may give us a clue of what the problem is. */
-    while (wrapperReadChildOutput(250)) { }
+/**
+ * Logs any multi-line record, repeat summary or rate limit summary of JVM
+ *  output which is still held back, and resets the rate limit for the next
+ *  JVM.  Must be called by the thread reading the output of the JVM.
+ */
+void wrapperFlushChildOutputRecord() {
+    struct timeb timeBuffer;
 
-    wrapperData->jvmQuerySkipParse = FALSE;
+    wrapperGetCurrentTime(&timeBuffer);
+    maintainChildOutputRecord(timeBuffer.time, timeBuffer.millitm, TRUE);
+    resetChildOutputRate(timeBuffer.time);
 }
 
 /**
- * Immediately after a JVM is launched and whenever the log file name changes,
- *  the log file name is sent to the JVM where it can be referenced by applications.
+ * Requests a lock on the JavaIO flush mutex.
+ *
+ * @return TRUE if there were any problems, FALSE if successful.
  */
-int sendLogFileName() {
-    TCHAR *currentLogFilePath;
-    int result = FALSE;
-
-    currentLogFilePath = getCurrentLogfilePath();
-
-    if (!currentLogFilePath) {
-        /* try to continue without sending the log file? */
-    } else {
-        result = wrapperProtocolFunction(WRAPPER_MSG_LOGFILE, currentLogFilePath);
-        free(currentLogFilePath);
+static int lockJavaIOFlushMutex() {
+#ifdef WIN32
+    switch (WaitForSingleObject(javaIOFlushMutexHandle, INFINITE)) {
+    case WAIT_ABANDONED:
+        _tprintf(TEXT("JavaIO flush mutex was abandoned.\n"));
+        return TRUE;
+    case WAIT_FAILED:
+        _tprintf(TEXT("JavaIO flush mutex wait failed.\n"));
+        return TRUE;
+    case WAIT_TIMEOUT:
+        _tprintf(TEXT("JavaIO flush mutex wait timed out.\n"));
+        return TRUE;
+    default:
+        /* Ok */
+        break;
     }
-    return result;
+#else
+    if (pthread_mutex_lock(&javaIOFlushMutex)) {
+        _tprintf(TEXT("Failed to lock the JavaIO flush mutex. %s\n"), getLastErrorText());
+        return TRUE;
+    }
+#endif
+    return FALSE;
 }
 
-#define JVM_TARGET_NONE         0
-#define JVM_TARGET_BOOTSTRAP    1
-#define JVM_TARGET_DRYRUN       2
-#define JVM_TARGET_APP          4
-#define JVM_TARGET_DRYRUN_APP   (JVM_TARGET_DRYRUN | JVM_TARGET_APP)
-#define JVM_TARGET_ALL          (JVM_TARGET_BOOTSTRAP | JVM_TARGET_DRYRUN | JVM_TARGET_APP)
+/**
+ * Releases a lock on the JavaIO flush mutex.
+ *
+ * @return TRUE if there were any problems, FALSE if successful.
+ */
+static int releaseJavaIOFlushMutex() {
+#ifdef WIN32
+    if (!ReleaseMutex(javaIOFlushMutexHandle)) {
+        _tprintf(TEXT("Failed to release the JavaIO flush mutex. %s\n"), getLastErrorText());
+        return TRUE;
+    }
+#else
+    if (pthread_mutex_unlock(&javaIOFlushMutex)) {
+        _tprintf(TEXT("Failed to unlock the JavaIO flush mutex. %s\n"), getLastErrorText());
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
+/**
+ * Called on each loop of the javaio thread.  Once the JVM exited, reads what
+ *  is left of its output and flushes it as wrapperJVMProcessExited() does
+ *  when the output is read by the main thread.
+ */
+void wrapperJavaIOFlushChildOutputRecord() {
+    int requested;
+
+    if (lockJavaIOFlushMutex()) {
+        return;
+    }
+    requested = (javaIOFlushState == JAVAIO_FLUSH_REQUESTED);
+    releaseJavaIOFlushMutex();
+    if (!requested) {
+        return;
+    }
+
+    /* Reading the rest of the output can take a while, so do it without holding the mutex. */
+    while (wrapperReadChildOutput(250)) {};
+
+    if (lockJavaIOFlushMutex()) {
+        return;
+    }
+    /* The main thread withdraws the request if it gave up waiting.  The next JVM may then
+     *  already be running, and its rate limit must not be reset. */
+    if (javaIOFlushState == JAVAIO_FLUSH_REQUESTED) {
+        wrapperFlushChildOutputRecord();
+        javaIOFlushState = JAVAIO_FLUSH_DONE;
+#ifdef WIN32
+        SetEvent(javaIOFlushEventHandle);
+#else
+        pthread_cond_signal(&javaIOFlushCond);
+#endif
+    }
+    releaseJavaIOFlushMutex();
+}
+
+/**
+ * Asks the javaio thread to flush the output of the JVM which just exited,
+ *  and waits until it has done so.  If the wait times out, the request is
+ *  withdrawn so that the flush is not done later against the next JVM.
+ *
+ * @param timeoutMS Maximum time to wait in milliseconds.
+ *
+ * @return TRUE if the javaio thread did not flush the output in time, FALSE if it did.
+ */
+static int wrapperWaitForJavaIOFlush(int timeoutMS) {
+    int timedOut;
+#ifndef WIN32
+    struct timeval now;
+    struct timespec deadline;
+#endif
+
+    if (lockJavaIOFlushMutex()) {
+        return TRUE;
+    }
+    javaIOFlushState = JAVAIO_FLUSH_REQUESTED;
+#ifdef WIN32
+    ResetEvent(javaIOFlushEventHandle);
+    releaseJavaIOFlushMutex();
+    WaitForSingleObject(javaIOFlushEventHandle, timeoutMS);
+    if (lockJavaIOFlushMutex()) {
+        return TRUE;
+    }
+#else
+    gettimeofday(&now, NULL);
+    deadline.tv_sec = now.tv_sec + timeoutMS / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000 + (timeoutMS % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    while (javaIOFlushState == JAVAIO_FLUSH_REQUESTED) {
+        if (pthread_cond_timedwait(&javaIOFlushCond, &javaIOFlushMutex, &deadline)) {
+            /* Timed out.  The mutex is locked again. */
+            break;
+        }
+    }
+#endif
+    /* Once we hold the mutex, the javaio thread has either completed the flush or will skip it. */
+    timedOut = (javaIOFlushState != JAVAIO_FLUSH_DONE);
+    javaIOFlushState = JAVAIO_FLUSH_NONE;
+    releaseJavaIOFlushMutex();
+    return timedOut;
+}
+
+void wrapperReadAllChildOutputAfterFailure() {
+    /* Set a flag so that there will be no attempt to parse the output. */
+    wrapperData->jvmQuerySkipParse = TRUE;
+    wrapperData->jvmDefaultLogLevel = LEVEL_ERROR;
+    
+    /* Read all messages of the output as it may give us a clue of what the problem is. */
+    while (wrapperReadChildOutput(250)) { }
+
+    wrapperData->jvmQuerySkipParse = FALSE;
+}
+
+/**
+ * Immediately after a JVM is launched and whenever the log file name changes,
+ *  the log file name is sent to the JVM where it can be referenced by applications.
+ */
+int sendLogFileName() {
+    TCHAR *currentLogFilePath;
+    int result = FALSE;
+
+    currentLogFilePath = getCurrentLogfilePath();
+
+    if (!currentLogFilePath) {
+        /* try to continue without sending the log file? */
+    } else {
+        result = wrapperProtocolFunction(WRAPPER_MSG_LOGFILE, currentLogFilePath);
+        free(currentLogFilePath);
+    }
+    return result;
+}
+
+#define JVM_TARGET_NONE         0
+#define JVM_TARGET_BOOTSTRAP    1
+#define JVM_TARGET_DRYRUN       2
+#define JVM_TARGET_APP          4
+#define JVM_TARGET_DRYRUN_APP   (JVM_TARGET_DRYRUN | JVM_TARGET_APP)
+#define JVM_TARGET_ALL          (JVM_TARGET_BOOTSTRAP | JVM_TARGET_DRYRUN | JVM_TARGET_APP)
 
 static int addAppOnlyAdditional(int index) {
     static int appOnlyArrayLen;
@@ -7329,6 +8920,10 @@ int wrapperRunCommonInner() {
 #endif
                 if (wrapperData->useSystemTime) {
                     log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Using system timer."));
+#ifndef WIN32
+                } else if (wrapperData->useMonotonicTime) {
+                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Using monotonic clock."));
+#endif
                 } else {
                     log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Using tick timer."));
                 }
@@ -7434,6 +9029,11 @@ int wrapperRunCommon(const TCHAR *runMode) {
             /* Clean up any open sockets. */
             wrapperProtocolClose();
             protocolStopServer();
+            wrapperMetricsStopServer();
+#ifndef WIN32
+            wrapperControlStopServer();
+            wrapperInstancesDispose();
+#endif
             
             exitCode = wrapperData->exitCode;
         } else {
@@ -10247,6 +11847,7 @@ static int wrapperBuildJavaCommandArrayInner(TCHAR **strings, const TCHAR *class
     int passEncoding = FALSE;
 #ifndef WIN32
     TCHAR localeEncodingBuff[ENCODING_BUFFER_SIZE];
+    size_t backendPathLen;
 #endif
 #ifdef HPUX
     const TCHAR* fix_iconv_hpux;
@@ -10447,6 +12048,30 @@ static int wrapperBuildJavaCommandArrayInner(TCHAR **strings, const TCHAR *class
             _sntprintf(strings[index], 22 + 1, TEXT("-Dwrapper.backend=pipe"));
         }
         index++;
+#ifndef WIN32
+    } else if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_SOCKET_UNIX) {
+        if (strings) {
+            strings[index] = malloc(sizeof(TCHAR) * (29 + 1));
+            if (!strings[index]) {
+                outOfMemory(TEXT("WBJCAI"), 263);
+                return -1;
+            }
+            _sntprintf(strings[index], 29 + 1, TEXT("-Dwrapper.backend=socket_unix"));
+        }
+        index++;
+
+        /* Store the path of the Wrapper server socket */
+        if (strings) {
+            backendPathLen = 23 + (protocolServerUnixPathW ? _tcslen(protocolServerUnixPathW) : 0);
+            strings[index] = malloc(sizeof(TCHAR) * (backendPathLen + 1));
+            if (!strings[index]) {
+                outOfMemory(TEXT("WBJCAI"), 264);
+                return -1;
+            }
+            _sntprintf(strings[index], backendPathLen + 1, TEXT("-Dwrapper.backend.path=%s"), protocolServerUnixPathW ? protocolServerUnixPathW : TEXT(""));
+        }
+        index++;
+#endif
     } else {
 
         /* default is socket ipv4, so we have to specify ipv6 if it's the case */
@@ -10485,6 +12110,34 @@ static int wrapperBuildJavaCommandArrayInner(TCHAR **strings, const TCHAR *class
         index++;
     }
 
+    /* Offer a newer backend protocol.  The JVM will negotiate it when connecting. */
+    if (wrapperData->backendProtocolMax >= WRAPPER_PROTOCOL_VERSION_2) {
+        if (strings) {
+            strings[index] = malloc(sizeof(TCHAR) * (27 + 10 + 1));
+            if (!strings[index]) {
+                outOfMemory(TEXT("WBJCAI"), 265);
+                return -1;
+            }
+            _sntprintf(strings[index], 27 + 10 + 1, TEXT("-Dwrapper.backend.protocol=%d"), wrapperData->backendProtocolMax);
+        }
+        index++;
+    }
+
+#ifdef LINUX
+    /* Tell the JVM where to find the ring.  Old Wrapper jars simply ignore it. */
+    if (protocolRingPathW) {
+        if (strings) {
+            strings[index] = malloc(sizeof(TCHAR) * (23 + _tcslen(protocolRingPathW) + 1));
+            if (!strings[index]) {
+                outOfMemory(TEXT("WBJCAI"), 266);
+                return -1;
+            }
+            _sntprintf(strings[index], 23 + _tcslen(protocolRingPathW) + 1, TEXT("-Dwrapper.backend.ring=%s"), protocolRingPathW);
+        }
+        index++;
+    }
+#endif
+
     /* Store the Wrapper jvm min and max ports. */
     if ((wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_SOCKET_V4) || (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_SOCKET_V6)) {
         if (wrapperData->portAddress != NULL) {
@@ -11184,6 +12837,13 @@ void wrapperJVMProcessExited(TICKS nowTicks, int exitCode) {
         /* Make sure there is no JVM output left in the pipe.  This must be done before
          *  resetting the java PID for the 'J' format of these messages to be correct. */
         while (wrapperReadChildOutput(250)) {};
+        wrapperFlushChildOutputRecord();
+    } else {
+        /* Let the javaio thread log the output it still holds back before the next JVM is launched.
+         *  Wait for it so that it is still logged with the PID of this JVM. */
+        if (wrapperWaitForJavaIOFlush(1000)) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Timed out waiting for the %s thread to flush the JVM output."), TEXT("JavaIO"));
+        }
     }
 
     /* Reset the Java PID.
@@ -12117,6 +13777,10 @@ int getBackendTypeForName(const TCHAR *typeName) {
         return WRAPPER_BACKEND_TYPE_SOCKET_V4;
     } else if (strcmpIgnoreCase(typeName, TEXT("SOCKET_IPv6")) == 0) {
         return WRAPPER_BACKEND_TYPE_SOCKET_V6;
+#ifndef WIN32
+    } else if (strcmpIgnoreCase(typeName, TEXT("SOCKET_UNIX")) == 0) {
+        return WRAPPER_BACKEND_TYPE_SOCKET_UNIX;
+#endif
     } else if (strcmpIgnoreCase(typeName, TEXT("PIPE")) == 0) {
         return WRAPPER_BACKEND_TYPE_PIPE;
     } else if (strcmpIgnoreCase(typeName, TEXT("AUTO")) == 0) {
@@ -12430,6 +14094,15 @@ int loadConfiguration() {
         wrapperData->backendTypeConfiguredBits = WRAPPER_BACKEND_TYPE_AUTO;
     }
 
+    /* Decide on the highest version of the backend protocol offered to the JVM.  Older Wrapper jars ignore the offer. */
+    wrapperData->backendProtocolMax = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.backend.protocol"), WRAPPER_PROTOCOL_VERSION_2), WRAPPER_PROTOCOL_VERSION_2), WRAPPER_PROTOCOL_VERSION_1);
+
+#ifdef LINUX
+    /* Decide whether the JVM should send its log packets through a shared memory ring.  The size is in KB. */
+    wrapperData->useBackendRing = getBooleanProperty(properties, TEXT("wrapper.backend.ring"), FALSE);
+    wrapperData->backendRingSize = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.backend.ring.size"), 1024), WRAPPER_RING_MAX_SIZE / 1024), WRAPPER_RING_MIN_SIZE / 1024) * 1024;
+#endif
+
     /* Decide whether the parameters should be passed via the backend or command line. */
     wrapperData->useBackendParameters = getBooleanProperty(properties, TEXT("wrapper.app.parameter.backend"), FALSE);
 
@@ -12594,6 +14267,13 @@ int loadConfiguration() {
     /* Get the use system time flag. */
     if (!wrapperData->configured) {
         wrapperData->useSystemTime = getBooleanProperty(properties, TEXT("wrapper.use_system_time"), FALSE);
+#ifndef WIN32
+ #ifdef CLOCK_MONOTONIC
+        wrapperData->useMonotonicTime = getBooleanProperty(properties, TEXT("wrapper.use_monotonic_time"), TRUE);
+ #else
+        wrapperData->useMonotonicTime = FALSE;
+ #endif
+#endif
 
         wrapperData->logBufferGrowth = getBooleanProperty(properties, TEXT("wrapper.log_buffer_growth"), FALSE);
         setLogBufferGrowth(wrapperData->logBufferGrowth);
@@ -12702,7 +14382,13 @@ int loadConfiguration() {
     /* Event loop sleep rule configuration. */
     wrapperData->mainLoopStepCycles = __max(1, __min(100, getIntProperty(properties, TEXT("wrapper.javaio.idle.sleep_step_cycles"), 5)));
     wrapperData->mainLoopSleepStepMs = __max(1, __min(1000, getIntProperty(properties, TEXT("wrapper.javaio.idle.sleep_step_ms"), 1)));
-    wrapperData->mainLoopMaxSleepMs = __max(10, __min(1000, getIntProperty(properties, TEXT("wrapper.javaio.idle.sleep_max_ms"), 10)));
+#ifdef WIN32
+    wrapperData->mainLoopWaitEvents = FALSE;
+#else
+    wrapperData->mainLoopWaitEvents = getBooleanProperty(properties, TEXT("wrapper.javaio.idle.wait_events"), TRUE);
+#endif
+    /* When waiting on events, the loop is woken up as soon as there is input, so the sleep only bounds how late timeouts are handled. */
+    wrapperData->mainLoopMaxSleepMs = __max(10, __min(1000, getIntProperty(properties, TEXT("wrapper.javaio.idle.sleep_max_ms"), wrapperData->mainLoopWaitEvents ? 100 : 10)));
 
     /* Get the timeout settings */
     wrapperData->cpuTimeout = getIntProperty(properties, TEXT("wrapper.cpu.timeout"), 10);
@@ -12714,6 +14400,60 @@ int loadConfiguration() {
     wrapperData->pingActionList = wrapperGetActionListForNames(getStringProperty(properties, TEXT("wrapper.ping.timeout.action"), TEXT("RESTART")), TEXT("wrapper.ping.timeout.action"));
     wrapperData->pingAlertThreshold = getIntProperty(properties, TEXT("wrapper.ping.alert.threshold"), __max(1, wrapperData->pingTimeout / 4));
     wrapperData->pingAlertLogLevel = getLogLevelForName(getStringProperty(properties, TEXT("wrapper.ping.alert.loglevel"), TEXT("STATUS")));
+    wrapperData->pingStatsInterval = __max(0, getIntProperty(properties, TEXT("wrapper.ping.stats.interval"), 0));
+    wrapperData->pingStatsLogLevel = getLogLevelForName(getStringProperty(properties, TEXT("wrapper.ping.stats.loglevel"), TEXT("INFO")));
+#ifdef LINUX
+    wrapperData->javaMonitorInterval = __max(0, getIntProperty(properties, TEXT("wrapper.java.monitor.interval"), 0));
+    wrapperData->javaMonitorLogLevel = getLogLevelForName(getStringProperty(properties, TEXT("wrapper.java.monitor.loglevel"), TEXT("DEBUG")));
+    wrapperData->javaMonitorRssLimit = __max(0, getIntProperty(properties, TEXT("wrapper.java.monitor.rss.limit"), 0));
+    if (wrapperData->javaMonitorRssActionList) {
+        free(wrapperData->javaMonitorRssActionList);
+    }
+    wrapperData->javaMonitorRssActionList = wrapperGetActionListForNames(getStringProperty(properties, TEXT("wrapper.java.monitor.rss.action"), TEXT("RESTART")), TEXT("wrapper.java.monitor.rss.action"));
+    wrapperData->javaMonitorCpuLimit = __max(0, getIntProperty(properties, TEXT("wrapper.java.monitor.cpu.limit"), 0));
+    wrapperData->javaMonitorCpuDuration = __max(0, getIntProperty(properties, TEXT("wrapper.java.monitor.cpu.duration"), 60));
+    if (wrapperData->javaMonitorCpuActionList) {
+        free(wrapperData->javaMonitorCpuActionList);
+    }
+    wrapperData->javaMonitorCpuActionList = wrapperGetActionListForNames(getStringProperty(properties, TEXT("wrapper.java.monitor.cpu.action"), TEXT("DUMP")), TEXT("wrapper.java.monitor.cpu.action"));
+#endif
+    /* The metrics endpoint is opened when the event loop starts, so changes to these are only applied when the Wrapper is restarted. */
+    wrapperData->metricsPort = getIntProperty(properties, TEXT("wrapper.metrics.port"), 0);
+    if ((wrapperData->metricsPort < 0) || (wrapperData->metricsPort > 65535)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN,
+            TEXT("%s must be in the range %d to %d.  Changing to %d."), TEXT("wrapper.metrics.port"), 0, 65535, 0);
+        wrapperData->metricsPort = 0;
+    }
+    /* The size of the state trace is only applied when the trace is created, on the first transition. */
+    wrapperData->stateTraceSize = propIntMax(propIntMin(getIntProperty(properties, TEXT("wrapper.state_trace.size"), 256), 1000000), 0);
+    updateStringValue(&wrapperData->stateTraceFile, getFileSafeStringProperty(properties, TEXT("wrapper.state_trace.file"), NULL));
+    if (wrapperData->stateTraceFile && (wrapperData->stateTraceFile[0] == TEXT('\0'))) {
+        free(wrapperData->stateTraceFile);
+        wrapperData->stateTraceFile = NULL;
+    }
+    wrapperData->stateTraceLogLevel = getLogLevelForName(getStringProperty(properties, TEXT("wrapper.state_trace.loglevel"), TEXT("DEBUG")));
+    /* The startup is only profiled once, so changes to these are only applied when the Wrapper is restarted. */
+    wrapperData->startupProfile = getBooleanProperty(properties, TEXT("wrapper.startup.profile"), FALSE);
+    updateStringValue(&wrapperData->startupProfileFile, getFileSafeStringProperty(properties, TEXT("wrapper.startup.profile.file"), NULL));
+    if (wrapperData->startupProfileFile && (wrapperData->startupProfileFile[0] == TEXT('\0'))) {
+        free(wrapperData->startupProfileFile);
+        wrapperData->startupProfileFile = NULL;
+    }
+#ifndef WIN32
+    updateStringValue(&wrapperData->metricsSocketPath, getStringProperty(properties, TEXT("wrapper.metrics.socket"), NULL));
+    if (wrapperData->metricsSocketPath && (wrapperData->metricsSocketPath[0] == TEXT('\0'))) {
+        free(wrapperData->metricsSocketPath);
+        wrapperData->metricsSocketPath = NULL;
+    }
+    updateStringValue(&wrapperData->controlSocketPath, getFileSafeStringProperty(properties, TEXT("wrapper.control.socket"), NULL));
+    if (wrapperData->controlSocketPath && (wrapperData->controlSocketPath[0] == TEXT('\0'))) {
+        free(wrapperData->controlSocketPath);
+        wrapperData->controlSocketPath = NULL;
+    }
+    wrapperData->metricsSocketUmask = getIntProperty(properties, TEXT("wrapper.metrics.socket.umask"), wrapperData->umask);
+    /* Only the user of the Wrapper may send it commands unless told otherwise. */
+    wrapperData->controlSocketUmask = getIntProperty(properties, TEXT("wrapper.control.socket.umask"), 0077);
+#endif
     wrapperData->pingInterval = getIntProperty(properties, TEXT("wrapper.ping.interval"), 5);
     wrapperData->pingIntervalLogged = getIntProperty(properties, TEXT("wrapper.ping.interval.logged"), 1);
     wrapperData->shutdownTimeout = getIntProperty(properties, TEXT("wrapper.shutdown.timeout"), 30);
@@ -12930,6 +14670,37 @@ int loadConfiguration() {
     /* Not documented */
     wrapperData->javaNewProcessGroup = getBooleanProperty(properties, TEXT("wrapper.java.new_process_group"), TRUE);
 
+    /* posix_spawn only reports exec failures synchronously on some platforms.  Elsewhere, keep fork by default so that
+     *  the child side can log why the JVM could not be launched. */
+ #if defined(LINUX) || defined(MACOSX)
+    wrapperData->javaUsePosixSpawn = getBooleanProperty(properties, TEXT("wrapper.java.use_posix_spawn"), TRUE);
+ #else
+    wrapperData->javaUsePosixSpawn = getBooleanProperty(properties, TEXT("wrapper.java.use_posix_spawn"), FALSE);
+ #endif
+
+ #ifdef LINUX
+    /* An empty value leaves the corresponding setting unchanged. */
+    updateStringValue(&wrapperData->javaCgroupRoot, getStringProperty(properties, TEXT("wrapper.java.cgroup.root"), NULL));
+    /* Without a name, the cgroup is named after the pid of the Wrapper so that several Wrappers can share a root. */
+    updateStringValue(&wrapperData->javaCgroupName, getStringProperty(properties, TEXT("wrapper.java.cgroup.name"), NULL));
+    updateStringValue(&wrapperData->javaCgroupMemoryMax, getStringProperty(properties, TEXT("wrapper.java.cgroup.memory.max"), NULL));
+    updateStringValue(&wrapperData->javaCgroupCpuMax, getStringProperty(properties, TEXT("wrapper.java.cgroup.cpu.max"), NULL));
+    updateStringValue(&wrapperData->javaCgroupPidsMax, getStringProperty(properties, TEXT("wrapper.java.cgroup.pids.max"), NULL));
+    wrapperData->javaCgroupMemoryPressureStall = __max(0, getIntProperty(properties, TEXT("wrapper.java.cgroup.memory.pressure.stall"), 0));
+    if (wrapperData->javaCgroupMemoryPressureActionList) {
+        free(wrapperData->javaCgroupMemoryPressureActionList);
+    }
+    wrapperData->javaCgroupMemoryPressureActionList = wrapperGetActionListForNames(getStringProperty(properties, TEXT("wrapper.java.cgroup.memory.pressure.action"), TEXT("NONE")), TEXT("wrapper.java.cgroup.memory.pressure.action"));
+    wrapperData->javaCgroupCpuPressureStall = __max(0, getIntProperty(properties, TEXT("wrapper.java.cgroup.cpu.pressure.stall"), 0));
+    if (wrapperData->javaCgroupCpuPressureActionList) {
+        free(wrapperData->javaCgroupCpuPressureActionList);
+    }
+    wrapperData->javaCgroupCpuPressureActionList = wrapperGetActionListForNames(getStringProperty(properties, TEXT("wrapper.java.cgroup.cpu.pressure.action"), TEXT("NONE")), TEXT("wrapper.java.cgroup.cpu.pressure.action"));
+    /* The kernel only accepts windows of 500ms to 10s, and multiples of 2s for unprivileged users. */
+    wrapperData->javaCgroupPressureWindow = __min(__max(getIntProperty(properties, TEXT("wrapper.java.cgroup.pressure.window"), 2000), 500), 10000);
+    wrapperData->javaCgroupPressureCooldown = __max(0, getIntProperty(properties, TEXT("wrapper.java.cgroup.pressure.cooldown"), 60));
+ #endif
+
     if (wrapperData->disableConsoleInputPermanent && wrapperData->javaNewProcessGroup) {
         /* Broken thread and no way to handle stdin. Force disabling. */
         log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Defective %s thread. %s"), TEXT("JavaIN"), TEXT("Disabling the ability to read stdin."));
@@ -13174,6 +14945,51 @@ TICKS wrapperGetSystemTicks() {
     return (sum - initialTicks);
 }
 
+/**
+ * Returns the current value of a microsecond clock based on a monotonic
+ *  clock when one is available.  A double holds whole microseconds exactly
+ *  for far longer than any process runs, so the value does not wrap and can
+ *  be used to measure long durations.  This is the only place the clock is
+ *  read.
+ */
+double wrapperGetMonotonicMicros() {
+#ifdef WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (double)(counter.QuadPart / frequency.QuadPart) * 1000000.0 + (double)((counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000000.0 + (double)(ts.tv_nsec / 1000);
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec * 1000000.0 + (double)tv.tv_usec;
+#endif
+}
+
+/**
+ * Returns the current value of a microsecond counter based on a monotonic
+ *  clock when one is available.  The counter wraps about every 71 minutes,
+ *  so it should only be used to measure short intervals by subtracting two
+ *  values.
+ *
+ * It is the value of wrapperGetMonotonicMicros() truncated to 32 bits.
+ */
+unsigned int wrapperGetMicros() {
+    double micros = wrapperGetMonotonicMicros();
+
+    /* Keep the low 32 bits.  Casting a double larger than UINT_MAX directly is undefined. */
+    return (unsigned int)(micros - (double)(unsigned int)(micros / 4294967296.0) * 4294967296.0);
+}
+
 /**
  * Returns difference in seconds between the start and end ticks.  This function
  *  handles cases where the tick counter has wrapped between when the start
@@ -13364,6 +15180,40 @@ int wrapperTickAssertions() {
         result = TRUE;
     }
 
+    /* A timeout set shortly after startup expires after the first rollover. */
+    ticks1 = WRAPPER_TICK_INITIAL;
+    value1 = 60;
+    ticksE = 0x00000058;
+    ticksR = wrapperAddToTicks(ticks1, value1);
+    if (ticksR != ticksE) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Assert Failed: wrapperAddToTicks(%08x, %d) == %08x != %08x"), ticks1, value1, ticksR, ticksE);
+        result = TRUE;
+    }
+    valueE = FALSE;
+    valueR = wrapperTickExpired(0xffffffff, ticksR);
+    if (valueR != valueE) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Assert Failed: wrapperTickExpired(%08x, %08x) == %0d != %0d"), 0xffffffff, ticksR, valueR, valueE);
+        result = TRUE;
+    }
+
+    /** wrapperGetTicks test.  The tick source must start close to WRAPPER_TICK_INITIAL and never go backwards. */
+    ticks1 = wrapperGetTicks();
+    ticks2 = wrapperGetTicks();
+    valueR = wrapperGetTickAgeTicks(ticks1, ticks2);
+    if ((valueR < 0) || (valueR > 1000 / WRAPPER_TICK_MS)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Assert Failed: wrapperGetTicks() went from %08x to %08x"), ticks1, ticks2);
+        result = TRUE;
+    }
+#ifndef WIN32
+    if (wrapperData->useMonotonicTime && !wrapperData->useSystemTime) {
+        valueR = wrapperGetTickAgeTicks(WRAPPER_TICK_INITIAL, ticks2);
+        if ((valueR < 0) || (valueR > 1000 / WRAPPER_TICK_MS)) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Assert Failed: wrapperGetTicks() started at %08x rather than %08x"), ticks2, WRAPPER_TICK_INITIAL);
+            result = TRUE;
+        }
+    }
+#endif
+
     return result;
 }
 
@@ -13388,309 +15238,1695 @@ void wrapperSetUptime(TICKS nowTicks, int *pSecs) {
 }
 
 /**
- * Sets the working directory of the Wrapper to the specified directory.
- *  The directory can be relative or absolute.
- * If there are any problems then a non-zero value will be returned.
- *
- * @param dir Directory to change to.
+ * Sets the working directory of the Wrapper to the specified directory.
+ *  The directory can be relative or absolute.
+ * If there are any problems then a non-zero value will be returned.
+ *
+ * @param dir Directory to change to.
+ *
+ * @return TRUE if the directory failed to be set, FALSE otherwise.
+ */
+int wrapperSetWorkingDir(const TCHAR* dir) {
+    int showOutput = wrapperData->configured;
+
+    if (_tchdir(dir)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL,
+            TEXT("Unable to set working directory to: %s (%s)"), dir, getLastErrorText());
+        return TRUE;
+    }
+
+    /* This function is sometimes called before the configuration is loaded. */
+#ifdef _DEBUG
+    showOutput = TRUE;
+#endif
+
+    if (showOutput) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Working directory set to: %s"), dir);
+    }
+
+    /* Set a variable to the location of the binary. */
+    setEnv(TEXT("WRAPPER_WORKING_DIR"), dir, ENV_SOURCE_APPLICATION);
+
+    return FALSE;
+}
+
+/******************************************************************************
+ * Protocol callback functions
+ *****************************************************************************/
+void wrapperLogSignaled(int logLevel, TCHAR *msg) {
+    /* */
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Got a log message from JVM: %s"), msg);
+    }
+    /* */
+
+    log_printf(wrapperData->jvmRestarts, logLevel, msg);
+}
+
+/**
+ * Logs a line of a record sent in a batch, with the source it was given in
+ *  the JVM in front of it.
+ */
+static void logBatchRecord(int level, time_t when, int whenMillis, const TCHAR *source, TCHAR *message) {
+    TCHAR *prefixed;
+    size_t len;
+
+    if (source[0]) {
+        len = _tcslen(source) + 3 + _tcslen(message) + 1;
+        prefixed = malloc(sizeof(TCHAR) * len);
+        if (prefixed) {
+            _sntprintf(prefixed, len, TEXT("[%s] %s"), source, message);
+            log_printf_record(wrapperData->jvmRestarts, level, when, whenMillis, prefixed);
+            free(prefixed);
+            return;
+        }
+        outOfMemory(TEXT("LBR"), 1);
+    }
+    log_printf_record(wrapperData->jvmRestarts, level, when, whenMillis, message);
+}
+
+/**
+ * Called when the JVM sends a batch of log records.  Each record keeps the level,
+ *  time and source it was given in the JVM, and is logged as is.  Records which
+ *  were not already filtered by the JVM are broken into lines and run through the
+ *  output filters like console output.
+ *
+ * @param batch The payload of the packet.  It will be modified by this call.
+ */
+void wrapperLogBatchSignaled(TCHAR *batch) {
+    TCHAR *record;
+    TCHAR *end;
+    TCHAR *fields[5];
+    TCHAR *line;
+    TCHAR *nextLF;
+    TCHAR *tc;
+    int level;
+    int flags;
+    time_t when;
+    int whenMillis;
+    int i;
+    int count = 0;
+
+    record = batch;
+    while (*record) {
+        end = _tcschr(record, WRAPPER_LOG_BATCH_RECORD_SEPARATOR);
+        if (end) {
+            *end = TEXT('\0');
+        }
+
+        fields[0] = record;
+        for (i = 1; i < 5; i++) {
+            tc = _tcschr(fields[i - 1], WRAPPER_LOG_BATCH_UNIT_SEPARATOR);
+            if (!tc) {
+                break;
+            }
+            *tc = TEXT('\0');
+            fields[i] = tc + 1;
+        }
+
+        if (i < 5) {
+            log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Ignoring an invalid log record from the JVM."));
+        } else {
+            level = _ttoi(fields[0]);
+            if ((level < LEVEL_DEBUG) || (level > LEVEL_NOTICE)) {
+                level = LEVEL_INFO;
+            }
+            when = (time_t)_tcstoul(fields[1], &tc, 10);
+            whenMillis = (*tc == TEXT('.')) ? _ttoi(tc + 1) % 1000 : 0;
+            flags = (int)_tcstol(fields[2], NULL, 16);
+
+            if (flags & WRAPPER_LOG_BATCH_FLAG_FILTERED) {
+                logBatchRecord(level, when, whenMillis, fields[3], fields[4]);
+            } else {
+                line = fields[4];
+                do {
+                    nextLF = _tcschr(line, TEXT('\n'));
+                    if (nextLF) {
+                        *nextLF = TEXT('\0');
+                    }
+                    /* Only the first line is prefixed, and the filters never see the prefix. */
+                    logBatchRecord(level, when, whenMillis, (line == fields[4]) ? fields[3] : TEXT(""), line);
+                    logApplyFilters(line);
+                    line = nextLF + 1;
+                } while (nextLF);
+            }
+
+            count++;
+        }
+
+        if (!end) {
+            break;
+        }
+        record = end + 1;
+    }
+
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Got a batch of %d log records from JVM."), count);
+    }
+}
+
+/**
+ * Called when the JVM sends the PROTOCOL packet, before its key.  The JVM picked a
+ *  version up to the one offered on its command line, along with the capabilities
+ *  it wants to use, and its following packets already use that version.  The
+ *  acknowledgement is sent with the old framing, then the Wrapper switches its
+ *  own packets to the new version.
+ */
+void wrapperProtocolNegotiated(TCHAR *request) {
+    int version;
+    int capabilities = 0;
+    TCHAR *tc;
+    TCHAR buffer[32];
+
+    if (wrapperData->jState >= WRAPPER_JSTATE_LAUNCHED) {
+        /* The version is only negotiated during the handshake, before the key of the JVM is accepted. */
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_WARN, TEXT("Ignoring a backend protocol request received after the handshake."));
+        return;
+    }
+
+    version = _ttoi(request);
+    tc = _tcschr(request, TEXT(' '));
+    if (tc) {
+        capabilities = (int)_tcstol(tc + 1, NULL, 16);
+    }
+
+    if ((version < WRAPPER_PROTOCOL_VERSION_1) || (version > wrapperData->backendProtocolMax)) {
+        /* The JVM is already writing in a framing we can't read. */
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_ERROR, TEXT("The JVM requested an unsupported backend protocol version (%d)."), version);
+        wrapperProtocolClose();
+        return;
+    }
+
+    protocolReadVersion = version;
+    protocolNegotiatedVersion = version;
+    protocolCapabilities = capabilities & WRAPPER_PROTOCOL_CAPS;
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_PROTOCOL, LEVEL_DEBUG, TEXT("Backend protocol version %d negotiated (capabilities: 0x%x)."), version, protocolCapabilities);
+    }
+
+    _sntprintf(buffer, 32, TEXT("%d %x"), version, protocolCapabilities);
+    protocolAckPending = TRUE;
+    wrapperProtocolFunction(WRAPPER_MSG_PROTOCOL, buffer);
+    protocolAckPending = FALSE;
+}
+
+/**
+ * Return TRUE if the correct key was received but the Wrapper failed to respond, FALSE otherwise.
+ */
+int wrapperKeyRegistered(TCHAR *key) {
+    /* Allow for a large integer + \0 */
+    int ret = FALSE;
+    TCHAR buffer[11];
+
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Got key from JVM: %s"), key);
+    }
+    switch (wrapperData->jState) {
+    case WRAPPER_JSTATE_LAUNCHING:
+        /* We now know that the Java side wrapper code has started and
+         *  registered with a key.  We still need to verify that it is
+         *  the correct key however, unless the credentials of the
+         *  connected process were already verified by the backend. */
+        if (protocolActiveBackendPeerVerified || (_tcscmp(key, wrapperData->key) == 0)) {
+            /* This is the correct key. */
+            wrapperSetJavaState(WRAPPER_JSTATE_LAUNCHED, 0, -1);
+            wrapperProfileMark(TEXT("key received"));
+
+#ifdef LINUX
+            /* The JVM opens the ring before sending its key, so nothing else needs its file. */
+            protocolUnlinkRing();
+#endif
+
+            /* Send the low log level to the JVM so that it can control output via the log method. */
+            _sntprintf(buffer, 11, TEXT("%d"), getLowLogLevel());
+            ret = ret || wrapperProtocolFunction(WRAPPER_MSG_LOW_LOG_LEVEL, buffer);
+
+            /* Send the log file name. */
+            ret = ret || sendLogFileName();
+
+            /* Send the Wrapper Properties. */
+            ret = ret || sendProperties();
+
+            /* Send the System Properties. */
+            ret = ret || sendAppProperties();
+            wrapperFreeAppPropertyArray();
+
+            /* Send Application Parameters. */
+            if (wrapperData->useBackendParameters) {
+                ret = ret || sendAppParameters();
+                wrapperFreeAppParameterArray();
+            } else {
+                ret = ret || wrapperProtocolFunction(WRAPPER_MSG_APP_PARAMETERS, TEXT(""));
+            }
+
+            /* All information sent, inform the WrapperManager class that we are ready to start. */
+            ret = ret || wrapperProtocolFunction(WRAPPER_MSG_PRESTART, TEXT("prestart"));
+
+            if (ret) {
+                /* Make sure to close the backend (if not already done). */
+                wrapperProtocolClose();
+                return TRUE;
+            }
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Received a connection request with an incorrect key.  Waiting for another connection."));
+
+            /* Set a flag to allow the response. */
+            wrapperData->wrongKeyPacketReceived = TRUE;
+
+            /* This was the wrong key.  Send a response. */
+            wrapperProtocolFunction(WRAPPER_MSG_BADKEY, TEXT("Incorrect key.  Connection rejected."));
+
+            /* No longer allow to write in this state. */
+            wrapperData->wrongKeyPacketReceived = FALSE;
+
+            /* Close the current connection but return FALSE.  Assume that the real JVM
+             *  is still out there trying to connect.  So don't change
+             *  the state.  If for some reason, this was the correct
+             *  JVM, but the key was wrong.  then this state will time
+             *  out and recover. */
+            wrapperProtocolClose();
+        }
+        break;
+
+    case WRAPPER_JSTATE_STOP:
+        /* We got a key registration.  This means that the JVM thinks it was
+         *  being launched but the Wrapper is trying to stop.  This state
+         *  will clean up correctly. */
+        break;
+
+    case WRAPPER_JSTATE_STOPPING:
+        /* We got a key registration.  This means that the JVM thinks it was
+         *  being launched but the Wrapper is trying to stop.  Now that the
+         *  connection to the JVM has been opened, tell it to stop cleanly. */
+        wrapperSetJavaState(WRAPPER_JSTATE_STOP, 0, -1);
+        break;
+
+    default:
+        /* We got a key registration that we were not expecting.  Ignore it. */
+        break;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Called when a ping is first determined to be slower than the wrapper.ping.alert.threshold.
+ *  This will happen before it has actually been responded to.
+ *  The 'jvm_ping_slow' event will be raised for each ping that was detected slow, so if the
+ *  JVM is hung for a long period of time, it may be raised several times. This can be used
+ *  for analytics and to take actions like warning before the ping timeout occurs.
+ */
+void wrapperPingSlow() {
+}
+
+/**
+ * Called when a ping is responded to, but was slower than the wrapper.ping.alert.threshold.
+ *
+ * @param tickAge The number of seconds it took to respond.
+ */
+void wrapperPingRespondedSlow(int tickAge) {
+    log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->pingAlertLogLevel, TEXT("Pinging the JVM took %d seconds to respond."), tickAge);
+}
+
+/**
+ * Called when a ping was sent to the JVM.  Records it in the ring of pending pings.
+ *
+ * @param nowTicks The tick count when the ping was sent.
+ * @param sentMicros The value of wrapperGetMicros() when the ping was sent.
+ */
+void wrapperPingSent(TICKS nowTicks, unsigned int sentMicros) {
+    PPendingPing pendingPing;
+
+    pendingPing = &(wrapperData->pendingPings[wrapperData->pingSeqNext & (WRAPPER_PENDING_PING_SLOTS - 1)]);
+    pendingPing->seq = wrapperData->pingSeqNext;
+    pendingPing->state = PENDING_PING_WAITING;
+    pendingPing->sentTicks = nowTicks;
+    pendingPing->slowTicks = wrapperAddToTicks(nowTicks, wrapperData->pingAlertThreshold);
+    pendingPing->sentMicros = sentMicros;
+    wrapperData->pingSeqNext++;
+    wrapperData->pingsSent++;
+#ifdef DEBUG_PING_QUEUE
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("+++ PING QUEUE Size: %d"), wrapperPingPendingCount());
+#endif
+}
+
+/**
+ * Returns the number of pings which are waiting for a response.
+ */
+int wrapperPingPendingCount() {
+    /* The sequence numbers are free running, so this also works when they wrap. */
+    return (int)(wrapperData->pingSeqNext - wrapperData->pingSeqOldest);
+}
+
+/**
+ * Clears the ring of pending pings when the JVM exits.
+ */
+void wrapperPingQueueReset() {
+    memset(wrapperData->pendingPings, 0, sizeof(wrapperData->pendingPings));
+    wrapperData->pingSeqOldest = wrapperData->pingSeqNext;
+    wrapperData->pingSeqUnwarned = wrapperData->pingSeqNext;
+    wrapperData->pingsSent = 0;
+    wrapperData->pingsAnswered = 0;
+    wrapperData->pingsLost = 0;
+    wrapperData->pingsOutOfOrder = 0;
+    wrapperData->pingsUnexpected = 0;
+}
+
+/**
+ * Called when a ping response is received.
+ *
+ * The pings are matched with their response by their sequence number, so this is done
+ *  in constant time.  A response which arrives before the responses of older pings
+ *  means that these were lost.  If one of them arrives later anyway, it is counted
+ *  as out of order rather than lost.
+ *
+ * @param pingSeq Sequence number of the ping, echoed back by the JVM.
+ * @param seqKnown FALSE if the ping response did not contain a sequence number.
+ */
+void wrapperPingResponded(unsigned int pingSeq, int seqKnown) {
+    TICKS nowTicks;
+    int tickAge;
+    PPendingPing pendingPing;
+    unsigned int seq;
+    
+    if (!seqKnown) {
+        /* Should not happen as all versions of the wrapper.jar simply bounce back the ping message.  Assume it is the oldest one. */
+        pingSeq = wrapperData->pingSeqOldest;
+    }
+#ifdef DEBUG_PING_QUEUE
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Ping Response (#%u)"), pingSeq);
+#endif
+    
+    pendingPing = &(wrapperData->pendingPings[pingSeq & (WRAPPER_PENDING_PING_SLOTS - 1)]);
+    if ((pendingPing->seq != pingSeq) || (pendingPing->state == PENDING_PING_FREE) || (pendingPing->state == PENDING_PING_ANSWERED)) {
+        /* The ping was never sent, its slot has since been reused, or it was already answered. */
+        wrapperData->pingsUnexpected++;
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Received an unexpected ping response (#%u)."), pingSeq);
+        return;
+    }
+    
+    if (pendingPing->state == PENDING_PING_LOST) {
+        /* A later ping was answered first.  It was counted as lost, but it was only late. */
+        pendingPing->state = PENDING_PING_ANSWERED;
+        wrapperData->pingsLost--;
+        wrapperData->pingsOutOfOrder++;
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Received a ping response out of order, sent at tick %08x."), pendingPing->sentTicks);
+        return;
+    }
+    
+    /* Any older ping still waiting will not be answered in order. */
+    for (seq = wrapperData->pingSeqOldest; seq != pingSeq; seq++) {
+        if (wrapperData->pendingPings[seq & (WRAPPER_PENDING_PING_SLOTS - 1)].state == PENDING_PING_WAITING) {
+            wrapperData->pendingPings[seq & (WRAPPER_PENDING_PING_SLOTS - 1)].state = PENDING_PING_LOST;
+            wrapperData->pingsLost++;
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Lost a ping response, sent at tick %08x."), wrapperData->pendingPings[seq & (WRAPPER_PENDING_PING_SLOTS - 1)].sentTicks);
+        }
+    }
+    pendingPing->state = PENDING_PING_ANSWERED;
+    wrapperData->pingsAnswered++;
+    wrapperData->pingSeqOldest = pingSeq + 1;
+    if ((int)(wrapperData->pingSeqUnwarned - wrapperData->pingSeqOldest) < 0) {
+        wrapperData->pingSeqUnwarned = wrapperData->pingSeqOldest;
+    }
+#ifdef DEBUG_PING_QUEUE
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Size: %d"), wrapperPingPendingCount());
+#endif
+    
+    /* Depending on the current JVM state, do something. */
+    switch (wrapperData->jState) {
+    case WRAPPER_JSTATE_STARTED:
+        /* We got a response to a ping. */
+        nowTicks = wrapperGetTicks();
+        
+        /* Figure out how long it took for us to get this ping response in seconds. */
+        tickAge = wrapperGetTickAgeSeconds(pendingPing->sentTicks, nowTicks);
+        
+        /* If we took longer than the threshold then we want to log a message. */
+        if ((wrapperData->pingAlertThreshold > 0) && (tickAge >= wrapperData->pingAlertThreshold)) {
+            wrapperPingRespondedSlow(tickAge);
+        }
+        
+        wrapperPingRecordRoundTrip(nowTicks, wrapperGetMicros() - pendingPing->sentMicros);
+        
+        /* Allow 5 + <pingTimeout> more seconds before the JVM is considered to be dead. */
+        if (wrapperData->pingTimeout > 0) {
+            wrapperUpdateJavaStateTimeout(nowTicks, 5 + wrapperData->pingTimeout);
+        } else {
+            wrapperUpdateJavaStateTimeout(nowTicks, -1);
+        }
+
+        break;
+
+    default:
+        /* We got a ping response that we were not expecting.  Ignore it. */
+        break;
+    }
+}
+
+/**
+ * Formats a number of microseconds as milliseconds.
+ */
+static void formatPingMicros(TCHAR *buffer, size_t size, unsigned int micros) {
+    _sntprintf(buffer, size, TEXT("%u.%03ums"), micros / 1000, micros % 1000);
+    buffer[size - 1] = TEXT('\0');
+}
+
+/**
+ * Logs a one line summary of the round trip times in a histogram.
+ */
+static void logPingSummary(int level, const TCHAR *label, PWrapperHistogram histogram) {
+    TCHAR minBuffer[16];
+    TCHAR p50Buffer[16];
+    TCHAR p99Buffer[16];
+    TCHAR p999Buffer[16];
+    TCHAR maxBuffer[16];
+    TCHAR meanBuffer[16];
+    TCHAR jitterBuffer[16];
+
+    if (histogram->count == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, level, TEXT("%s: no pings."), label);
+        return;
+    }
+
+    formatPingMicros(minBuffer, 16, histogram->min);
+    formatPingMicros(p50Buffer, 16, wrapperHistogramValueAtPercentile(histogram, 50.0));
+    formatPingMicros(p99Buffer, 16, wrapperHistogramValueAtPercentile(histogram, 99.0));
+    formatPingMicros(p999Buffer, 16, wrapperHistogramValueAtPercentile(histogram, 99.9));
+    formatPingMicros(maxBuffer, 16, histogram->max);
+    formatPingMicros(meanBuffer, 16, (unsigned int)wrapperHistogramMean(histogram));
+    formatPingMicros(jitterBuffer, 16, (unsigned int)pingJitter);
+    log_printf(WRAPPER_SOURCE_WRAPPER, level, TEXT("%s: %u pings, min %s, p50 %s, p99 %s, p99.9 %s, max %s, mean %s, jitter %s."),
+        label, histogram->count, minBuffer, p50Buffer, p99Buffer, p999Buffer, maxBuffer, meanBuffer, jitterBuffer);
+}
+
+/**
+ * Records the round trip time of a ping, and logs a summary of the current
+ *  window if wrapper.ping.stats.interval seconds have passed since it started.
+ *
+ * @param nowTicks The current tick count.
+ * @param roundTrip The round trip time of the ping in microseconds.
+ */
+void wrapperPingRecordRoundTrip(TICKS nowTicks, unsigned int roundTrip) {
+    TCHAR label[64];
+    int diff;
+
+    if (!pingWindowStarted) {
+        pingWindowStartTicks = nowTicks;
+        pingWindowStarted = TRUE;
+    } else if (pingTotalHistogram.count > 0) {
+        diff = (int)(roundTrip - pingLastRoundTrip);
+        if (diff < 0) {
+            diff = -diff;
+        }
+        pingJitter += (diff - pingJitter) / 16.0;
+    }
+    pingLastRoundTrip = roundTrip;
+
+    wrapperHistogramRecord(&pingWindowHistogram, roundTrip);
+    wrapperHistogramRecord(&pingTotalHistogram, roundTrip);
+
+    if ((wrapperData->pingStatsInterval > 0) && (wrapperGetTickAgeSeconds(pingWindowStartTicks, nowTicks) >= wrapperData->pingStatsInterval)) {
+        _sntprintf(label, 64, TEXT("Ping round trips over the last %d seconds"), wrapperGetTickAgeSeconds(pingWindowStartTicks, nowTicks));
+        label[63] = TEXT('\0');
+        logPingSummary(wrapperData->pingStatsLogLevel, label, &pingWindowHistogram);
+        wrapperHistogramReset(&pingWindowHistogram);
+        pingWindowStartTicks = nowTicks;
+    }
+}
+
+/**
+ * Logs the summary of the round trip times of all the pings of the current
+ *  JVM, followed by their distribution.  Called by the PING_STATS command.
+ */
+void wrapperPingStatsDump() {
+    TCHAR lowBuffer[16];
+    TCHAR highBuffer[16];
+    unsigned int count;
+    int magnitude;
+    int i;
+
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Pings since the JVM was launched: %u sent, %u answered, %u lost, %u out of order, %u unexpected, %d pending."),
+        wrapperData->pingsSent, wrapperData->pingsAnswered, wrapperData->pingsLost, wrapperData->pingsOutOfOrder, wrapperData->pingsUnexpected, wrapperPingPendingCount());
+    logPingSummary(LEVEL_STATUS, TEXT("Ping round trips since the JVM was launched"), &pingTotalHistogram);
+    if (pingTotalHistogram.count == 0) {
+        return;
+    }
+
+    /* Group the buckets by power of two to keep the output short. */
+    for (magnitude = 0; magnitude < WRAPPER_HISTOGRAM_BUCKETS / WRAPPER_HISTOGRAM_SUB_BUCKETS; magnitude++) {
+        count = 0;
+        for (i = 0; i < WRAPPER_HISTOGRAM_SUB_BUCKETS; i++) {
+            count += pingTotalHistogram.counts[magnitude * WRAPPER_HISTOGRAM_SUB_BUCKETS + i];
+        }
+        if (count > 0) {
+            formatPingMicros(lowBuffer, 16, (magnitude == 0) ? 0 : (unsigned int)WRAPPER_HISTOGRAM_SUB_BUCKETS << (magnitude - 1));
+            formatPingMicros(highBuffer, 16, wrapperHistogramBucketHighestValue((magnitude + 1) * WRAPPER_HISTOGRAM_SUB_BUCKETS - 1));
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("  %s - %s: %u"), lowBuffer, highBuffer, count);
+        }
+    }
+}
+
+/**
+ * Clears the round trip times when a JVM exits, after logging a summary of
+ *  the last window if summaries are enabled.
+ */
+void wrapperPingStatsReset() {
+    if ((wrapperData->pingStatsInterval > 0) && (pingWindowHistogram.count > 0)) {
+        logPingSummary(wrapperData->pingStatsLogLevel, TEXT("Ping round trips until the JVM exited"), &pingWindowHistogram);
+    }
+    wrapperHistogramReset(&pingWindowHistogram);
+    wrapperHistogramReset(&pingTotalHistogram);
+    pingWindowStarted = FALSE;
+    pingJitter = 0.0;
+}
+
+#ifdef LINUX
+/**
+ * The JVM resource monitor.
+ *
+ * Every wrapper.java.monitor.interval seconds, the resources used by the JVM
+ *  are read from /proc.  The files are opened once per JVM, so a sample is
+ *  only a few preads.  The results are logged, exposed on the metrics
+ *  endpoint, and checked against the configured limits.
+ */
+static WrapperProcStat javaMonitorStat;
+static int javaMonitorOpen = FALSE;         /* TRUE when javaMonitorStat holds the files of the current JVM. */
+static int javaMonitorPid = 0;
+static TICKS javaMonitorLastTicks;
+static int javaMonitorRssTriggered = FALSE; /* TRUE once the RSS action fired, until the RSS goes back below the limit. */
+static int javaMonitorCpuHigh = FALSE;      /* TRUE while the CPU usage is above the limit. */
+static TICKS javaMonitorCpuHighTicks;       /* When the CPU usage went above the limit. */
+static int javaMonitorCpuTriggered = FALSE; /* TRUE once the CPU action fired, until the CPU usage goes back below the limit. */
+
+static void javaMonitorClose() {
+    if (javaMonitorOpen) {
+        wrapperProcStatClose(&javaMonitorStat);
+        javaMonitorOpen = FALSE;
+    }
+    javaMonitorPid = 0;
+    javaMonitorRssTriggered = FALSE;
+    javaMonitorCpuHigh = FALSE;
+    javaMonitorCpuTriggered = FALSE;
+}
+
+static void javaMonitorCheckLimits(TICKS nowTicks) {
+    TCHAR message[128];
+
+    if (wrapperData->javaMonitorRssLimit > 0) {
+        if (javaMonitorStat.rssBytes > (double)wrapperData->javaMonitorRssLimit * 1024 * 1024) {
+            if (!javaMonitorRssTriggered) {
+                javaMonitorRssTriggered = TRUE;
+                _sntprintf(message, 128, TEXT("JVM resident memory of %.1fMB exceeded the limit of %dMB."),
+                    javaMonitorStat.rssBytes / (1024 * 1024), wrapperData->javaMonitorRssLimit);
+                wrapperProcessActionList(wrapperData->javaMonitorRssActionList, message, WRAPPER_ACTION_SOURCE_CODE_JVM_MONITOR, WRAPPER_JVM_MONITOR_LIMIT_RSS, TRUE, wrapperData->errorExitCode);
+            }
+        } else {
+            javaMonitorRssTriggered = FALSE;
+        }
+    }
+
+    if ((wrapperData->javaMonitorCpuLimit > 0) && (javaMonitorStat.cpuPercent >= 0)) {
+        if (javaMonitorStat.cpuPercent >= wrapperData->javaMonitorCpuLimit) {
+            if (!javaMonitorCpuHigh) {
+                javaMonitorCpuHigh = TRUE;
+                javaMonitorCpuHighTicks = nowTicks;
+            } else if ((!javaMonitorCpuTriggered) && (wrapperGetTickAgeSeconds(javaMonitorCpuHighTicks, nowTicks) >= wrapperData->javaMonitorCpuDuration)) {
+                javaMonitorCpuTriggered = TRUE;
+                _sntprintf(message, 128, TEXT("JVM CPU usage has been above %d%% for %d seconds (%.1f%%)."),
+                    wrapperData->javaMonitorCpuLimit, wrapperGetTickAgeSeconds(javaMonitorCpuHighTicks, nowTicks), javaMonitorStat.cpuPercent);
+                wrapperProcessActionList(wrapperData->javaMonitorCpuActionList, message, WRAPPER_ACTION_SOURCE_CODE_JVM_MONITOR, WRAPPER_JVM_MONITOR_LIMIT_CPU, TRUE, wrapperData->errorExitCode);
+            }
+        } else {
+            javaMonitorCpuHigh = FALSE;
+            javaMonitorCpuTriggered = FALSE;
+        }
+    }
+}
+
+void wrapperJavaMonitorPoll(TICKS nowTicks) {
+    TCHAR cpuBuffer[16];
+    TCHAR fdsBuffer[16];
+    TCHAR ioBuffer[48];
+
+    if ((wrapperData->javaMonitorInterval <= 0) || (wrapperData->javaPID <= 0) ||
+            (wrapperData->jState < WRAPPER_JSTATE_LAUNCHING) || (wrapperData->jState > WRAPPER_JSTATE_STOPPED)) {
+        javaMonitorClose();
+        return;
+    }
+
+    if (javaMonitorPid != (int)wrapperData->javaPID) {
+        /* A new JVM.  Take a first sample right away so the rates are known at the next one. */
+        javaMonitorClose();
+        if (wrapperProcStatOpen(&javaMonitorStat, "/proc", (int)wrapperData->javaPID)) {
+            if (wrapperData->isDebugging) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Unable to monitor the resources of the JVM: %s"), getLastErrorText());
+            }
+            /* Don't try again for this JVM. */
+            javaMonitorPid = (int)wrapperData->javaPID;
+            return;
+        }
+        javaMonitorOpen = TRUE;
+        javaMonitorPid = (int)wrapperData->javaPID;
+        javaMonitorLastTicks = nowTicks;
+        wrapperProcStatSample(&javaMonitorStat);
+        return;
+    }
+
+    if ((!javaMonitorOpen) || (wrapperGetTickAgeSeconds(javaMonitorLastTicks, nowTicks) < wrapperData->javaMonitorInterval)) {
+        return;
+    }
+    javaMonitorLastTicks = nowTicks;
+
+    if (wrapperProcStatSample(&javaMonitorStat)) {
+        /* The JVM is exiting.  This will be noticed by the event loop. */
+        wrapperProcStatClose(&javaMonitorStat);
+        javaMonitorOpen = FALSE;
+        return;
+    }
+
+    _sntprintf(cpuBuffer, 16, TEXT("%.1f%%"), javaMonitorStat.cpuPercent);
+    if (javaMonitorStat.fds >= 0) {
+        _sntprintf(fdsBuffer, 16, TEXT("%d"), javaMonitorStat.fds);
+    } else {
+        _sntprintf(fdsBuffer, 16, TEXT("?"));
+    }
+    if (javaMonitorStat.readBytesPerSec >= 0) {
+        _sntprintf(ioBuffer, 48, TEXT("%.1fKB/s read, %.1fKB/s written"), javaMonitorStat.readBytesPerSec / 1024, javaMonitorStat.writeBytesPerSec / 1024);
+    } else {
+        _sntprintf(ioBuffer, 48, TEXT("I/O unknown"));
+    }
+    log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->javaMonitorLogLevel,
+        TEXT("JVM resources: CPU %s, RSS %.1fMB (peak %.1fMB, swap %.1fMB), %d threads, %s fds, %s.  Sampled in %uus."),
+        cpuBuffer, javaMonitorStat.rssBytes / (1024 * 1024), javaMonitorStat.peakRssBytes / (1024 * 1024), javaMonitorStat.swapBytes / (1024 * 1024),
+        javaMonitorStat.threads, fdsBuffer, ioBuffer, javaMonitorStat.sampleMicros);
+
+    if (wrapperData->jState == WRAPPER_JSTATE_STARTED) {
+        /* Don't restart a JVM which is still starting or already stopping. */
+        javaMonitorCheckLimits(nowTicks);
+    }
+}
+#endif
+
+/**
+ * The metrics endpoint.
+ *
+ * A small HTTP server which answers GET /metrics with the state and counters
+ *  of the Wrapper in the Prometheus text exposition format.  It listens on a
+ *  loopback port or, on UNIX, on a Unix-domain socket.  Everything is done
+ *  with non-blocking sockets from the event loop, so a slow or stuck scraper
+ *  can never hold up the Wrapper.
+ */
+#define METRICS_MAX_CLIENTS     4
+#define METRICS_REQUEST_MAX     1024
+#define METRICS_CLIENT_TIMEOUT  5     /* Seconds a client is given to send its request and read the response. */
+
+typedef struct MetricsClient MetricsClient, *PMetricsClient;
+struct MetricsClient {
+    SOCKET  sd;                             /* Socket of the client, INVALID_SOCKET if the slot is free. */
+    TICKS   acceptTicks;                    /* When the client was accepted. */
+    char    request[METRICS_REQUEST_MAX + 1]; /* Request received so far. */
+    size_t  requestLen;
+    char    *response;                      /* Response being sent, NULL until the request is complete. */
+    size_t  responseLen;
+    size_t  responsePos;                    /* Number of bytes of the response already sent. */
+};
+
+typedef struct MetricsBuffer MetricsBuffer, *PMetricsBuffer;
+struct MetricsBuffer {
+    char    *data;
+    size_t  size;
+    size_t  len;
+};
+
+static SOCKET metricsServerSD = INVALID_SOCKET;
+static MetricsClient metricsClients[METRICS_MAX_CLIENTS];
+#ifndef WIN32
+static char *metricsServerUnixPath = NULL;
+#endif
+
+#ifdef MSG_NOSIGNAL
+ #define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+ #define METRICS_SEND_FLAGS 0
+#endif
+
+/**
+ * Appends formatted text to a buffer, growing it as needed.
+ *
+ * @return TRUE if there was not enough memory.
+ */
+static int metricsAppend(PMetricsBuffer buffer, const char *format, ...) {
+    va_list vargs;
+    int count;
+    char *newData;
+
+    while (TRUE) {
+        if (buffer->data) {
+            va_start(vargs, format);
+            count = vsnprintf(buffer->data + buffer->len, buffer->size - buffer->len, format, vargs);
+            va_end(vargs);
+            if ((count >= 0) && ((size_t)count < buffer->size - buffer->len)) {
+                buffer->len += count;
+                return FALSE;
+            }
+        }
+        /* Some old C runtimes return -1 rather than the required size, so simply double it. */
+        newData = realloc(buffer->data, buffer->size ? buffer->size * 2 : 4096);
+        if (!newData) {
+            outOfMemory(TEXT("MA"), 1);
+            return TRUE;
+        }
+        buffer->data = newData;
+        buffer->size = buffer->size ? buffer->size * 2 : 4096;
+    }
+}
+
+/**
+ * Appends a label value.  The values we expose are short ASCII names, so
+ *  anything else is replaced rather than encoded.
+ */
+static int metricsAppendLabelValue(PMetricsBuffer buffer, const TCHAR *value) {
+    char ascii[64];
+    size_t i;
+
+    for (i = 0; (i < sizeof(ascii) - 1) && value[i]; i++) {
+        if ((value[i] < 0x20) || (value[i] > 0x7e) || (value[i] == TEXT('"')) || (value[i] == TEXT('\\'))) {
+            ascii[i] = '_';
+        } else {
+            ascii[i] = (char)value[i];
+        }
+    }
+    ascii[i] = '\0';
+    return metricsAppend(buffer, "%s", ascii);
+}
+
+static int metricsAppendHeader(PMetricsBuffer buffer, const char *name, const char *type, const char *help) {
+    return metricsAppend(buffer, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/**
+ * Builds the body of a response to a scrape.
+ *
+ * @return TRUE if there was not enough memory.
+ */
+static int metricsRender(PMetricsBuffer buffer) {
+    int i;
+    static const double quantiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+    if (metricsAppendHeader(buffer, "wrapper_info", "gauge", "Version of the Wrapper.") ||
+        metricsAppend(buffer, "wrapper_info{version=\"") || metricsAppendLabelValue(buffer, wrapperVersionRoot) || metricsAppend(buffer, "\"} 1\n") ||
+        metricsAppendHeader(buffer, "wrapper_state", "gauge", "State of the Wrapper process.  Only the current state is exposed.") ||
+        metricsAppend(buffer, "wrapper_state{state=\"") || metricsAppendLabelValue(buffer, wrapperGetWState(wrapperData->wState)) || metricsAppend(buffer, "\"} 1\n") ||
+        metricsAppendHeader(buffer, "wrapper_java_state", "gauge", "State of the JVM.  Only the current state is exposed.") ||
+        metricsAppend(buffer, "wrapper_java_state{state=\"") || metricsAppendLabelValue(buffer, wrapperGetJState(wrapperData->jState)) || metricsAppend(buffer, "\"} 1\n") ||
+        metricsAppendHeader(buffer, "wrapper_jvm_pid", "gauge", "Process id of the JVM, 0 if it is not running.") ||
+        metricsAppend(buffer, "wrapper_jvm_pid %d\n", (int)wrapperData->javaPID) ||
+        metricsAppendHeader(buffer, "wrapper_jvm_launches_total", "counter", "Number of times a JVM was launched.") ||
+        metricsAppend(buffer, "wrapper_jvm_launches_total %d\n", wrapperData->jvmRestarts) ||
+        metricsAppendHeader(buffer, "wrapper_pings_sent_total", "counter", "Number of pings sent to the current JVM.") ||
+        metricsAppend(buffer, "wrapper_pings_sent_total %u\n", wrapperData->pingsSent) ||
+        metricsAppendHeader(buffer, "wrapper_ping_responses_total", "counter", "Number of ping responses from the current JVM, by outcome.") ||
+        metricsAppend(buffer, "wrapper_ping_responses_total{result=\"answered\"} %u\n", wrapperData->pingsAnswered) ||
+        metricsAppend(buffer, "wrapper_ping_responses_total{result=\"lost\"} %u\n", wrapperData->pingsLost) ||
+        metricsAppend(buffer, "wrapper_ping_responses_total{result=\"out_of_order\"} %u\n", wrapperData->pingsOutOfOrder) ||
+        metricsAppend(buffer, "wrapper_ping_responses_total{result=\"unexpected\"} %u\n", wrapperData->pingsUnexpected) ||
+        metricsAppendHeader(buffer, "wrapper_pings_pending", "gauge", "Number of pings waiting for a response.") ||
+        metricsAppend(buffer, "wrapper_pings_pending %d\n", wrapperPingPendingCount()) ||
+        metricsAppendHeader(buffer, "wrapper_ping_round_trip_seconds", "summary", "Round trip time of the pings to the current JVM.")) {
+        return TRUE;
+    }
+    for (i = 0; i < (int)(sizeof(quantiles) / sizeof(quantiles[0])); i++) {
+        if (metricsAppend(buffer, "wrapper_ping_round_trip_seconds{quantile=\"%g\"} %.6f\n", quantiles[i] / 100.0,
+                wrapperHistogramValueAtPercentile(&pingTotalHistogram, quantiles[i]) / 1000000.0)) {
+            return TRUE;
+        }
+    }
+    if (metricsAppend(buffer, "wrapper_ping_round_trip_seconds_sum %.6f\n", pingTotalHistogram.sum / 1000000.0) ||
+        metricsAppend(buffer, "wrapper_ping_round_trip_seconds_count %u\n", pingTotalHistogram.count)) {
+        return TRUE;
+    }
+#ifdef LINUX
+    if (javaMonitorOpen && javaMonitorStat.sampled) {
+        if (metricsAppendHeader(buffer, "wrapper_jvm_cpu_percent", "gauge", "CPU usage of the JVM in percent of one CPU, over the last monitor interval.") ||
+            metricsAppend(buffer, "wrapper_jvm_cpu_percent %.1f\n", __max(javaMonitorStat.cpuPercent, 0.0)) ||
+            metricsAppendHeader(buffer, "wrapper_jvm_resident_memory_bytes", "gauge", "Resident memory of the JVM.") ||
+            metricsAppend(buffer, "wrapper_jvm_resident_memory_bytes %.0f\n", javaMonitorStat.rssBytes) ||
+            metricsAppendHeader(buffer, "wrapper_jvm_threads", "gauge", "Number of threads of the JVM.") ||
+            metricsAppend(buffer, "wrapper_jvm_threads %d\n", javaMonitorStat.threads) ||
+            ((javaMonitorStat.fds >= 0) && (
+                metricsAppendHeader(buffer, "wrapper_jvm_open_fds", "gauge", "Number of file descriptors open in the JVM.") ||
+                metricsAppend(buffer, "wrapper_jvm_open_fds %d\n", javaMonitorStat.fds))) ||
+            ((javaMonitorStat.readBytesPerSec >= 0) && (
+                metricsAppendHeader(buffer, "wrapper_jvm_io_bytes_per_second", "gauge", "Bytes read from and written to storage by the JVM per second, over the last monitor interval.") ||
+                metricsAppend(buffer, "wrapper_jvm_io_bytes_per_second{direction=\"read\"} %.0f\n", javaMonitorStat.readBytesPerSec) ||
+                metricsAppend(buffer, "wrapper_jvm_io_bytes_per_second{direction=\"write\"} %.0f\n", javaMonitorStat.writeBytesPerSec))) ||
+            metricsAppendHeader(buffer, "wrapper_jvm_monitor_sample_seconds", "gauge", "Time it took the Wrapper to take the last sample of the JVM resources.") ||
+            metricsAppend(buffer, "wrapper_jvm_monitor_sample_seconds %.6f\n", javaMonitorStat.sampleMicros / 1000000.0)) {
+            return TRUE;
+        }
+    }
+#endif
+    for (i = 0; i < WRAPPER_METRIC_COUNT; i++) {
+        if (metricsAppendHeader(buffer, wrapperMetricsGetName(i), "counter", wrapperMetricsGetHelp(i)) ||
+            metricsAppend(buffer, "%s %.0f\n", wrapperMetricsGetName(i), wrapperMetricsGet(i))) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void metricsCloseSocket(SOCKET sd) {
+#ifdef WIN32
+    closesocket(sd);
+#else /* UNIX */
+    close(sd);
+#endif
+}
+
+static void metricsCloseClient(PMetricsClient client) {
+    metricsCloseSocket(client->sd);
+    client->sd = INVALID_SOCKET;
+    client->requestLen = 0;
+    if (client->response) {
+        free(client->response);
+        client->response = NULL;
+    }
+    client->responseLen = 0;
+    client->responsePos = 0;
+}
+
+/**
+ * Prepares the response once the request line and headers were received.
+ */
+static void metricsPrepareResponse(PMetricsClient client) {
+    MetricsBuffer body;
+    MetricsBuffer response;
+    const char *status;
+
+    memset(&body, 0, sizeof(body));
+    memset(&response, 0, sizeof(response));
+
+    if ((strncmp(client->request, "GET /metrics", 12) == 0) && ((client->request[12] == ' ') || (client->request[12] == '?'))) {
+        status = "200 OK";
+        if (metricsRender(&body)) {
+            status = "500 Internal Server Error";
+            body.len = 0;
+        }
+    } else {
+        status = "404 Not Found";
+    }
+
+    if (metricsAppend(&response, "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %d\r\nConnection: close\r\n\r\n", status, (int)body.len) ||
+        ((body.len > 0) && metricsAppend(&response, "%s", body.data))) {
+        if (response.data) {
+            free(response.data);
+        }
+        response.data = NULL;
+        response.len = 0;
+    }
+    if (body.data) {
+        free(body.data);
+    }
+
+    if (!response.data) {
+        metricsCloseClient(client);
+        return;
+    }
+    client->response = response.data;
+    client->responseLen = response.len;
+    client->responsePos = 0;
+}
+
+/**
+ * Reads what a client sent and sends what it can of the response, without blocking.
+ */
+static void metricsServiceClient(PMetricsClient client, TICKS nowTicks) {
+    int rc;
+    int err;
+
+    if (wrapperGetTickAgeSeconds(client->acceptTicks, nowTicks) >= METRICS_CLIENT_TIMEOUT) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Metrics client timed out."));
+        }
+        metricsCloseClient(client);
+        return;
+    }
+
+    if (!client->response) {
+        rc = recv(client->sd, client->request + client->requestLen, (int)(METRICS_REQUEST_MAX - client->requestLen), 0);
+        if (rc == SOCKET_ERROR) {
+            err = wrapperGetSocketLastError();
+            if ((err != WRAPPER_EWOULDBLOCK) && (err != EAGAIN)) {
+                metricsCloseClient(client);
+            }
+            return;
+        } else if (rc == 0) {
+            /* Closed before the request was complete. */
+            metricsCloseClient(client);
+            return;
+        }
+        client->requestLen += rc;
+        client->request[client->requestLen] = '\0';
+        if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n") || (client->requestLen >= METRICS_REQUEST_MAX)) {
+            metricsPrepareResponse(client);
+            if (client->sd == INVALID_SOCKET) {
+                return;
+            }
+        } else {
+            return;
+        }
+    }
+
+    rc = send(client->sd, client->response + client->responsePos, (int)(client->responseLen - client->responsePos), METRICS_SEND_FLAGS);
+    if (rc == SOCKET_ERROR) {
+        err = wrapperGetSocketLastError();
+        if ((err != WRAPPER_EWOULDBLOCK) && (err != EAGAIN)) {
+            metricsCloseClient(client);
+        }
+        return;
+    }
+    client->responsePos += rc;
+    if (client->responsePos >= client->responseLen) {
+        metricsCloseClient(client);
+    }
+}
+
+#ifndef WIN32
+/**
+ * Makes sure that the path of a Unix-domain socket can be bound.  A socket
+ *  file left behind by a previous Wrapper is removed, but nothing else is.
+ *
+ * @param name Name of the socket in the messages.
+ * @param path Path of the socket, as configured.
+ * @param addr Address of the socket.
+ *
+ * @return TRUE if the path can not be used.
+ */
+static int removeStaleSocket(const TCHAR *name, const TCHAR *path, struct sockaddr_un *addr) {
+    struct stat fileStat;
+    SOCKET sd;
+    int rc;
+
+    if (lstat(addr->sun_path, &fileStat)) {
+        if (errno == ENOENT) {
+            return FALSE;
+        }
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to access the %s socket %s. (%s)"), name, path, getLastErrorText());
+        return TRUE;
+    }
+    if (!S_ISSOCK(fileStat.st_mode)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to create the %s socket because %s already exists and is not a socket."), name, path);
+        return TRUE;
+    }
+
+    /* Only a socket which nobody listens on anymore is stale. */
+    sd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sd != INVALID_SOCKET) {
+        rc = connect(sd, (struct sockaddr *)addr, sizeof(struct sockaddr_un));
+        close(sd);
+        if (rc == 0) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("The %s socket %s is already in use by another process."), name, path);
+            return TRUE;
+        }
+    }
+    if (unlink(addr->sun_path) && (errno != ENOENT)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to remove the stale %s socket %s. (%s)"), name, path, getLastErrorText());
+        return TRUE;
+    }
+    return FALSE;
+}
+#endif
+
+/**
+ * Opens the metrics endpoint if wrapper.metrics.port or wrapper.metrics.socket
+ *  is set, and starts updating the counters.
+ *
+ * @return TRUE if the endpoint was configured but could not be opened.
+ */
+int wrapperMetricsStartServer() {
+    struct sockaddr_in addr_srv4;
+#ifdef WIN32
+    u_long dwNoBlock = TRUE;
+#else
+    struct sockaddr_un addr_srvUnix;
+    size_t len;
+    char *path;
+    mode_t oldUmask;
+    int optVal;
+#endif
+    int i;
+    int rc;
+
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        memset(&metricsClients[i], 0, sizeof(MetricsClient));
+        metricsClients[i].sd = INVALID_SOCKET;
+    }
+
+#ifndef WIN32
+    if (wrapperData->metricsSocketPath) {
+        len = wcstombs(NULL, wrapperData->metricsSocketPath, 0);
+        if ((len == (size_t)-1) || (len + 1 > sizeof(addr_srvUnix.sun_path))) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("The value of %s is not a valid socket path: %s"), TEXT("wrapper.metrics.socket"), wrapperData->metricsSocketPath);
+            return TRUE;
+        }
+        path = malloc(len + 1);
+        if (!path) {
+            outOfMemory(TEXT("WMSS"), 1);
+            return TRUE;
+        }
+        wcstombs(path, wrapperData->metricsSocketPath, len + 1);
+        memset(&addr_srvUnix, 0, sizeof(addr_srvUnix));
+        addr_srvUnix.sun_family = AF_UNIX;
+        memcpy(addr_srvUnix.sun_path, path, len + 1);
+
+        /* A socket file left behind by a previous Wrapper would make the bind fail. */
+        if (removeStaleSocket(TEXT("metrics"), wrapperData->metricsSocketPath, &addr_srvUnix)) {
+            free(path);
+            return TRUE;
+        }
+
+        metricsServerSD = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (metricsServerSD == INVALID_SOCKET) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to create the metrics socket. (%s)"), getLastErrorText());
+            free(path);
+            return TRUE;
+        }
+        /* A JVM outliving the Wrapper must not keep the socket open. */
+        fcntl(metricsServerSD, F_SETFD, FD_CLOEXEC);
+        /* Only the umask of the socket file matters, so set it for the bind alone. */
+        oldUmask = umask(wrapperData->metricsSocketUmask);
+        rc = bind(metricsServerSD, (struct sockaddr *)&addr_srvUnix, sizeof(addr_srvUnix));
+        umask(oldUmask);
+        if (rc == SOCKET_ERROR) {
+            /* Nothing was created, so nothing must be removed. */
+            free(path);
+        } else {
+            metricsServerUnixPath = path;
+        }
+    } else
+#endif
+    if (wrapperData->metricsPort > 0) {
+        metricsServerSD = socket(AF_INET, SOCK_STREAM, 0);
+        if (metricsServerSD == INVALID_SOCKET) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to create the metrics socket. (%s)"), getLastErrorText());
+            return TRUE;
+        }
+#ifndef WIN32
+        fcntl(metricsServerSD, F_SETFD, FD_CLOEXEC);
+        /* Scrapers leave our side of each connection in TIME_WAIT, which would prevent a restarted Wrapper from binding
+         *  the port for a while.  Unlike on Windows, this does not let a second process bind the same port. */
+        optVal = 1;
+        setsockopt(metricsServerSD, SOL_SOCKET, SO_REUSEADDR, &optVal, sizeof(optVal));
+#endif
+        /* Only ever listen on the loopback interface.  Anything else should go through a proxy. */
+        memset(&addr_srv4, 0, sizeof(addr_srv4));
+        addr_srv4.sin_family = AF_INET;
+        addr_srv4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr_srv4.sin_port = htons((u_short)wrapperData->metricsPort);
+        rc = bind(metricsServerSD, (struct sockaddr *)&addr_srv4, sizeof(addr_srv4));
+    } else {
+        /* Not configured. */
+        return FALSE;
+    }
+
+    if (rc == SOCKET_ERROR) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to bind the metrics socket. (%s)"), getLastErrorText());
+        wrapperMetricsStopServer();
+        return TRUE;
+    }
+
+#ifdef WIN32
+    rc = ioctlsocket(metricsServerSD, FIONBIO, &dwNoBlock);
+#else
+    rc = fcntl(metricsServerSD, F_SETFL, O_NONBLOCK);
+#endif
+    if ((rc == SOCKET_ERROR) || (listen(metricsServerSD, METRICS_MAX_CLIENTS) == SOCKET_ERROR)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to listen on the metrics socket. (%s)"), getLastErrorText());
+        wrapperMetricsStopServer();
+        return TRUE;
+    }
+
+#ifndef WIN32
+    if (wrapperData->metricsSocketPath) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Serving metrics on %s."), wrapperData->metricsSocketPath);
+    } else
+#endif
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Serving metrics on http://127.0.0.1:%d/metrics."), wrapperData->metricsPort);
+
+    wrapperMetricsSetEnabled(TRUE);
+    return FALSE;
+}
+
+/**
+ * Closes the metrics endpoint and any client still connected.
+ */
+void wrapperMetricsStopServer() {
+    int i;
+
+    wrapperMetricsSetEnabled(FALSE);
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metricsClients[i].sd != INVALID_SOCKET) {
+            metricsCloseClient(&metricsClients[i]);
+        }
+    }
+    if (metricsServerSD != INVALID_SOCKET) {
+        metricsCloseSocket(metricsServerSD);
+        metricsServerSD = INVALID_SOCKET;
+    }
+#ifndef WIN32
+    /* Only set once this process bound the socket. */
+    if (metricsServerUnixPath) {
+        unlink(metricsServerUnixPath);
+        free(metricsServerUnixPath);
+        metricsServerUnixPath = NULL;
+    }
+#endif
+}
+
+/**
+ * Accepts new scrapers and makes progress with the connected ones.  Called
+ *  once per cycle of the event loop.  Never blocks.
+ */
+void wrapperMetricsPoll(TICKS nowTicks) {
+    SOCKET sd;
+    int i;
+#ifdef WIN32
+    u_long dwNoBlock = TRUE;
+#endif
+
+    if (metricsServerSD == INVALID_SOCKET) {
+        return;
+    }
+
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metricsClients[i].sd == INVALID_SOCKET) {
+            sd = accept(metricsServerSD, NULL, NULL);
+            if (sd == INVALID_SOCKET) {
+                /* Nobody waiting, or a client which gave up before we got to it. */
+                break;
+            }
+#ifdef WIN32
+            ioctlsocket(sd, FIONBIO, &dwNoBlock);
+#else
+            fcntl(sd, F_SETFL, O_NONBLOCK);
+            fcntl(sd, F_SETFD, FD_CLOEXEC);
+#endif
+            metricsClients[i].sd = sd;
+            metricsClients[i].acceptTicks = nowTicks;
+        }
+    }
+
+    for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        if (metricsClients[i].sd != INVALID_SOCKET) {
+            metricsServiceClient(&metricsClients[i], nowTicks);
+        }
+    }
+}
+
+#ifndef WIN32
+/**
+ * The control socket.
+ *
+ * A Unix-domain socket on which local clients send the same commands as in
+ *  the command file, one per line, with immediate effect.  Each line gets a
+ *  single line back: "OK", "OK name=value ...", or "ERROR reason".  Some
+ *  query commands only exist here: STATUS, PIDS, UPTIME and COUNTERS.
+ *  Access is controlled by the permissions of the socket file, and only
+ *  clients running as the same user as the Wrapper, or as root, are
+ *  accepted.
+ */
+#define CONTROL_MAX_CLIENTS     4
+#define CONTROL_LINE_MAX        80    /* Same as for the command file. */
+#define CONTROL_INPUT_MAX       (CONTROL_LINE_MAX * 4)
+#define CONTROL_OUTPUT_MAX      4096
+#define CONTROL_REPLY_MAX       1024
+#define CONTROL_CLIENT_TIMEOUT  5     /* Seconds a client may stay connected without sending anything. */
+
+typedef struct ControlClient ControlClient, *PControlClient;
+struct ControlClient {
+    SOCKET  sd;                             /* Socket of the client, INVALID_SOCKET if the slot is free. */
+    TICKS   lastTicks;                      /* When the client last sent something. */
+    char    input[CONTROL_INPUT_MAX + 1];   /* Start of the line being received. */
+    size_t  inputLen;
+    int     discarding;                     /* TRUE while skipping the rest of a line which was too long. */
+    int     closing;                        /* TRUE once the client stopped sending.  Closed when all replies are sent. */
+    char    output[CONTROL_OUTPUT_MAX];     /* Replies not sent yet. */
+    size_t  outputLen;
+};
+
+static SOCKET controlServerSD = INVALID_SOCKET;
+static ControlClient controlClients[CONTROL_MAX_CLIENTS];
+static char *controlServerPath = NULL;
+
+static void controlCloseClient(PControlClient client) {
+    close(client->sd);
+    client->sd = INVALID_SOCKET;
+    client->inputLen = 0;
+    client->discarding = FALSE;
+    client->closing = FALSE;
+    client->outputLen = 0;
+}
+
+/**
+ * Queues a reply line.  Replies are small, and no more input is read while
+ *  the queue is nearly full, so this only fails if a client never reads.
+ */
+static void controlReply(PControlClient client, const TCHAR *reply) {
+    size_t len;
+
+    len = wcstombs(client->output + client->outputLen, reply, CONTROL_OUTPUT_MAX - client->outputLen - 1);
+    if ((len == (size_t)-1) || (client->outputLen + len + 1 >= CONTROL_OUTPUT_MAX)) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Control client is not reading its replies."));
+        }
+        client->closing = TRUE;
+        return;
+    }
+    client->outputLen += len;
+    client->output[client->outputLen++] = '\n';
+}
+
+/**
+ * Answers the commands which only query the state of the Wrapper.
+ *
+ * @return TRUE if the command was a query.
+ */
+static int controlQuery(PControlClient client, const TCHAR *command, TICKS nowTicks) {
+    TCHAR reply[CONTROL_REPLY_MAX];
+    TCHAR name[64];
+    const char *metricName;
+    size_t len = 0;
+    size_t j;
+    int rc;
+    int i;
+
+    if (strcmpIgnoreCase(command, TEXT("STATUS")) == 0) {
+        _sntprintf(reply, CONTROL_REPLY_MAX, TEXT("OK wrapper=%s java=%s"), wrapperGetWState(wrapperData->wState), wrapperGetJState(wrapperData->jState));
+    } else if (strcmpIgnoreCase(command, TEXT("PIDS")) == 0) {
+        _sntprintf(reply, CONTROL_REPLY_MAX, TEXT("OK wrapper=%d java=%d"), (int)wrapperData->wrapperPID, (int)wrapperData->javaPID);
+    } else if (strcmpIgnoreCase(command, TEXT("UPTIME")) == 0) {
+        _sntprintf(reply, CONTROL_REPLY_MAX, TEXT("OK wrapper=%d java=%d"), wrapperGetTickAgeSeconds(WRAPPER_TICK_INITIAL, nowTicks),
+            (wrapperData->javaPID > 0) ? wrapperGetTickAgeSeconds(wrapperData->jvmLaunchTicks, nowTicks) : 0);
+    } else if (strcmpIgnoreCase(command, TEXT("COUNTERS")) == 0) {
+        /* Same names as on the metrics endpoint. */
+        rc = _sntprintf(reply, CONTROL_REPLY_MAX,
+            TEXT("OK wrapper_jvm_launches_total=%d wrapper_pings_sent_total=%u wrapper_pings_answered_total=%u wrapper_pings_lost_total=%u wrapper_pings_out_of_order_total=%u wrapper_pings_unexpected_total=%u wrapper_pings_pending=%d"),
+            wrapperData->jvmRestarts, wrapperData->pingsSent, wrapperData->pingsAnswered, wrapperData->pingsLost,
+            wrapperData->pingsOutOfOrder, wrapperData->pingsUnexpected, wrapperPingPendingCount());
+        if ((rc < 0) || (rc >= CONTROL_REPLY_MAX)) {
+            /* Can not happen with the size of the buffer, but never index past it. */
+            controlReply(client, TEXT("ERROR Reply too long"));
+            return TRUE;
+        }
+        len = (size_t)rc;
+        for (i = 0; (i < WRAPPER_METRIC_COUNT) && (len < CONTROL_REPLY_MAX); i++) {
+            /* The names are plain ASCII. */
+            metricName = wrapperMetricsGetName(i);
+            for (j = 0; (metricName[j] != '\0') && (j < 63); j++) {
+                name[j] = (TCHAR)metricName[j];
+            }
+            name[j] = TEXT('\0');
+            rc = _sntprintf(reply + len, CONTROL_REPLY_MAX - len, TEXT(" %s=%.0f"), name, wrapperMetricsGet(i));
+            if ((rc < 0) || ((size_t)rc >= CONTROL_REPLY_MAX - len)) {
+                /* Truncated.  Only keep the complete values. */
+                reply[len] = TEXT('\0');
+                break;
+            }
+            len += (size_t)rc;
+        }
+    } else {
+        return FALSE;
+    }
+    reply[CONTROL_REPLY_MAX - 1] = TEXT('\0');
+    controlReply(client, reply);
+    return TRUE;
+}
+
+/**
+ * Executes one line received from a client.
+ */
+static void controlExecuteLine(PControlClient client, TICKS nowTicks) {
+    TCHAR line[CONTROL_LINE_MAX + 1];
+    TCHAR *command;
+    size_t len;
+
+    if ((client->inputLen > 0) && (client->input[client->inputLen - 1] == '\r')) {
+        client->inputLen--;
+    }
+    client->input[client->inputLen] = '\0';
+    len = mbstowcs(line, client->input, CONTROL_LINE_MAX + 1);
+    client->inputLen = 0;
+    if (len == (size_t)-1) {
+        controlReply(client, TEXT("ERROR Invalid characters"));
+        return;
+    } else if (len > CONTROL_LINE_MAX) {
+        controlReply(client, TEXT("ERROR Command too long"));
+        return;
+    }
+
+    /* Queries are checked first so that they are not logged as unknown commands. */
+    command = line;
+    while ((command[0] == TEXT(' ')) || (command[0] == TEXT('\t'))) {
+        command++;
+    }
+    len = _tcslen(command);
+    while ((len > 0) && ((command[len - 1] == TEXT(' ')) || (command[len - 1] == TEXT('\t')))) {
+        command[--len] = TEXT('\0');
+    }
+    if (controlQuery(client, command, nowTicks)) {
+        return;
+    }
+
+    switch (wrapperExecuteCommand(command, WRAPPER_ACTION_SOURCE_CODE_CONTROL_SOCKET, NULL)) {
+    case WRAPPER_COMMAND_OK:
+        controlReply(client, TEXT("OK"));
+        break;
+    case WRAPPER_COMMAND_EMPTY:
+        break;
+    case WRAPPER_COMMAND_UNKNOWN:
+        controlReply(client, TEXT("ERROR Unknown command"));
+        break;
+    default:
+        controlReply(client, TEXT("ERROR Invalid command, see the log"));
+        break;
+    }
+}
+
+/**
+ * Reads and executes what a client sent and sends what it can of the
+ *  replies, without blocking.
+ */
+static void controlServiceClient(PControlClient client, TICKS nowTicks) {
+    char buffer[512];
+    int rc;
+    int i;
+
+    if (wrapperGetTickAgeSeconds(client->lastTicks, nowTicks) >= CONTROL_CLIENT_TIMEOUT) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Control client timed out."));
+        }
+        controlCloseClient(client);
+        return;
+    }
+
+    /* Stop reading while the replies are not being read, so a client can not make us buffer without limit. */
+    while ((!client->closing) && (client->outputLen < CONTROL_OUTPUT_MAX - CONTROL_REPLY_MAX * 2)) {
+        rc = recv(client->sd, buffer, sizeof(buffer), 0);
+        if (rc == SOCKET_ERROR) {
+            if ((errno != EWOULDBLOCK) && (errno != EAGAIN)) {
+                controlCloseClient(client);
+                return;
+            }
+            break;
+        } else if (rc == 0) {
+            /* The client is done sending.  A last line without a line feed is still executed. */
+            if ((client->inputLen > 0) && !client->discarding) {
+                controlExecuteLine(client, nowTicks);
+            }
+            client->closing = TRUE;
+            break;
+        }
+        client->lastTicks = nowTicks;
+        for (i = 0; i < rc; i++) {
+            if (buffer[i] == '\n') {
+                if (client->discarding) {
+                    client->discarding = FALSE;
+                    client->inputLen = 0;
+                } else {
+                    controlExecuteLine(client, nowTicks);
+                }
+            } else if (!client->discarding) {
+                if (client->inputLen >= CONTROL_INPUT_MAX) {
+                    controlReply(client, TEXT("ERROR Command too long"));
+                    client->discarding = TRUE;
+                } else {
+                    client->input[client->inputLen++] = buffer[i];
+                }
+            }
+        }
+    }
+
+    if (client->outputLen > 0) {
+        rc = send(client->sd, client->output, client->outputLen, METRICS_SEND_FLAGS);
+        if (rc == SOCKET_ERROR) {
+            if ((errno != EWOULDBLOCK) && (errno != EAGAIN)) {
+                controlCloseClient(client);
+            }
+            return;
+        }
+        memmove(client->output, client->output + rc, client->outputLen - rc);
+        client->outputLen -= rc;
+    }
+    if (client->closing && (client->outputLen == 0)) {
+        controlCloseClient(client);
+    }
+}
+
+/**
+ * Only accepts clients running as the same user as the Wrapper, or as root.
  *
- * @return TRUE if the directory failed to be set, FALSE otherwise.
+ * @return TRUE if the client must be rejected.
  */
-int wrapperSetWorkingDir(const TCHAR* dir) {
-    int showOutput = wrapperData->configured;
+static int controlCheckPeer(SOCKET sd) {
+ #if defined(LINUX)
+    struct ucred cred;
+    socklen_t credLen = sizeof(cred);
 
-    if (_tchdir(dir)) {
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL,
-            TEXT("Unable to set working directory to: %s (%s)"), dir, getLastErrorText());
+    if (getsockopt(sd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Rejecting a control client whose credentials are unknown. (%s)"), getLastErrorText());
         return TRUE;
     }
-
-    /* This function is sometimes called before the configuration is loaded. */
-#ifdef _DEBUG
-    showOutput = TRUE;
-#endif
-
-    if (showOutput) {
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Working directory set to: %s"), dir);
+    if ((cred.uid != geteuid()) && (cred.uid != 0)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Rejecting a control client from pid %d running as uid %d."), (int)cred.pid, (int)cred.uid);
+        return TRUE;
     }
+ #elif defined(MACOSX) || defined(FREEBSD)
+    uid_t peerUid;
+    gid_t peerGid;
 
-    /* Set a variable to the location of the binary. */
-    setEnv(TEXT("WRAPPER_WORKING_DIR"), dir, ENV_SOURCE_APPLICATION);
-
+    if (getpeereid(sd, &peerUid, &peerGid)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Rejecting a control client whose credentials are unknown. (%s)"), getLastErrorText());
+        return TRUE;
+    }
+    if ((peerUid != geteuid()) && (peerUid != 0)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Rejecting a control client running as uid %d."), (int)peerUid);
+        return TRUE;
+    }
+ #endif
     return FALSE;
 }
 
-/******************************************************************************
- * Protocol callback functions
- *****************************************************************************/
-void wrapperLogSignaled(int logLevel, TCHAR *msg) {
-    /* */
-    if (wrapperData->isDebugging) {
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Got a log message from JVM: %s"), msg);
+int wrapperControlStartServer() {
+    struct sockaddr_un addr_srvUnix;
+    size_t len;
+    mode_t oldUmask;
+    int i;
+    int rc;
+
+    for (i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        memset(&controlClients[i], 0, sizeof(ControlClient));
+        controlClients[i].sd = INVALID_SOCKET;
+    }
+    if (!wrapperData->controlSocketPath) {
+        return FALSE;
     }
-    /* */
 
-    log_printf(wrapperData->jvmRestarts, logLevel, msg);
-}
+    len = wcstombs(NULL, wrapperData->controlSocketPath, 0);
+    if ((len == (size_t)-1) || (len + 1 > sizeof(addr_srvUnix.sun_path))) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("The value of %s is not a valid socket path: %s"), TEXT("wrapper.control.socket"), wrapperData->controlSocketPath);
+        return TRUE;
+    }
+    controlServerPath = malloc(len + 1);
+    if (!controlServerPath) {
+        outOfMemory(TEXT("WCSS"), 1);
+        return TRUE;
+    }
+    wcstombs(controlServerPath, wrapperData->controlSocketPath, len + 1);
 
-/**
- * Return TRUE if the correct key was received but the Wrapper failed to respond, FALSE otherwise.
- */
-int wrapperKeyRegistered(TCHAR *key) {
-    /* Allow for a large integer + \0 */
-    int ret = FALSE;
-    TCHAR buffer[11];
+    memset(&addr_srvUnix, 0, sizeof(addr_srvUnix));
+    addr_srvUnix.sun_family = AF_UNIX;
+    memcpy(addr_srvUnix.sun_path, controlServerPath, len + 1);
 
-    if (wrapperData->isDebugging) {
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Got key from JVM: %s"), key);
+    /* A socket file left behind by a previous Wrapper would make the bind fail. */
+    if (removeStaleSocket(TEXT("control"), wrapperData->controlSocketPath, &addr_srvUnix)) {
+        free(controlServerPath);
+        controlServerPath = NULL;
+        return TRUE;
     }
-    switch (wrapperData->jState) {
-    case WRAPPER_JSTATE_LAUNCHING:
-        /* We now know that the Java side wrapper code has started and
-         *  registered with a key.  We still need to verify that it is
-         *  the correct key however. */
-        if (_tcscmp(key, wrapperData->key) == 0) {
-            /* This is the correct key. */
-            wrapperSetJavaState(WRAPPER_JSTATE_LAUNCHED, 0, -1);
 
-            /* Send the low log level to the JVM so that it can control output via the log method. */
-            _sntprintf(buffer, 11, TEXT("%d"), getLowLogLevel());
-            ret = ret || wrapperProtocolFunction(WRAPPER_MSG_LOW_LOG_LEVEL, buffer);
+    controlServerSD = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (controlServerSD == INVALID_SOCKET) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to create the control socket. (%s)"), getLastErrorText());
+        free(controlServerPath);
+        controlServerPath = NULL;
+        return TRUE;
+    }
+    /* A JVM outliving the Wrapper must not keep the socket open. */
+    fcntl(controlServerSD, F_SETFD, FD_CLOEXEC);
+    /* Only the umask of the socket file matters, so set it for the bind alone. */
+    oldUmask = umask(wrapperData->controlSocketUmask);
+    rc = bind(controlServerSD, (struct sockaddr *)&addr_srvUnix, sizeof(addr_srvUnix));
+    umask(oldUmask);
+    if (rc == SOCKET_ERROR) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to bind the control socket. (%s)"), getLastErrorText());
+        /* Nothing was created, so nothing must be removed. */
+        free(controlServerPath);
+        controlServerPath = NULL;
+        wrapperControlStopServer();
+        return TRUE;
+    }
+    if ((fcntl(controlServerSD, F_SETFL, O_NONBLOCK) == SOCKET_ERROR) || (listen(controlServerSD, CONTROL_MAX_CLIENTS) == SOCKET_ERROR)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to listen on the control socket. (%s)"), getLastErrorText());
+        wrapperControlStopServer();
+        return TRUE;
+    }
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Accepting commands on %s."), wrapperData->controlSocketPath);
 
-            /* Send the log file name. */
-            ret = ret || sendLogFileName();
+    /* The COUNTERS query needs the counters of the metrics endpoint. */
+    if (!wrapperMetricsEnabled) {
+        wrapperMetricsSetEnabled(TRUE);
+    }
+    return FALSE;
+}
 
-            /* Send the Wrapper Properties. */
-            ret = ret || sendProperties();
+void wrapperControlStopServer() {
+    int i;
 
-            /* Send the System Properties. */
-            ret = ret || sendAppProperties();
-            wrapperFreeAppPropertyArray();
+    for (i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (controlClients[i].sd != INVALID_SOCKET) {
+            controlCloseClient(&controlClients[i]);
+        }
+    }
+    if (controlServerSD != INVALID_SOCKET) {
+        close(controlServerSD);
+        controlServerSD = INVALID_SOCKET;
+    }
+    if (controlServerPath) {
+        unlink(controlServerPath);
+        free(controlServerPath);
+        controlServerPath = NULL;
+    }
+}
 
-            /* Send Application Parameters. */
-            if (wrapperData->useBackendParameters) {
-                ret = ret || sendAppParameters();
-                wrapperFreeAppParameterArray();
-            } else {
-                ret = ret || wrapperProtocolFunction(WRAPPER_MSG_APP_PARAMETERS, TEXT(""));
-            }
+void wrapperControlPoll(TICKS nowTicks) {
+    SOCKET sd;
+    int i;
 
-            /* All information sent, inform the WrapperManager class that we are ready to start. */
-            ret = ret || wrapperProtocolFunction(WRAPPER_MSG_PRESTART, TEXT("prestart"));
+    if (controlServerSD == INVALID_SOCKET) {
+        return;
+    }
 
-            if (ret) {
-                /* Make sure to close the backend (if not already done). */
-                wrapperProtocolClose();
-                return TRUE;
+    for (i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (controlClients[i].sd == INVALID_SOCKET) {
+            sd = accept(controlServerSD, NULL, NULL);
+            if (sd == INVALID_SOCKET) {
+                break;
             }
-        } else {
-            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Received a connection request with an incorrect key.  Waiting for another connection."));
-
-            /* Set a flag to allow the response. */
-            wrapperData->wrongKeyPacketReceived = TRUE;
-
-            /* This was the wrong key.  Send a response. */
-            wrapperProtocolFunction(WRAPPER_MSG_BADKEY, TEXT("Incorrect key.  Connection rejected."));
-
-            /* No longer allow to write in this state. */
-            wrapperData->wrongKeyPacketReceived = FALSE;
-
-            /* Close the current connection but return FALSE.  Assume that the real JVM
-             *  is still out there trying to connect.  So don't change
-             *  the state.  If for some reason, this was the correct
-             *  JVM, but the key was wrong.  then this state will time
-             *  out and recover. */
-            wrapperProtocolClose();
+            if (controlCheckPeer(sd)) {
+                close(sd);
+                continue;
+            }
+            fcntl(sd, F_SETFL, O_NONBLOCK);
+            fcntl(sd, F_SETFD, FD_CLOEXEC);
+            controlClients[i].sd = sd;
+            controlClients[i].lastTicks = nowTicks;
         }
-        break;
-
-    case WRAPPER_JSTATE_STOP:
-        /* We got a key registration.  This means that the JVM thinks it was
-         *  being launched but the Wrapper is trying to stop.  This state
-         *  will clean up correctly. */
-        break;
-
-    case WRAPPER_JSTATE_STOPPING:
-        /* We got a key registration.  This means that the JVM thinks it was
-         *  being launched but the Wrapper is trying to stop.  Now that the
-         *  connection to the JVM has been opened, tell it to stop cleanly. */
-        wrapperSetJavaState(WRAPPER_JSTATE_STOP, 0, -1);
-        break;
-
-    default:
-        /* We got a key registration that we were not expecting.  Ignore it. */
-        break;
     }
 
-    return FALSE;
+    for (i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (controlClients[i].sd != INVALID_SOCKET) {
+            controlServiceClient(&controlClients[i], nowTicks);
+        }
+    }
 }
 
-/**
- * Called when a ping is first determined to be slower than the wrapper.ping.alert.threshold.
- *  This will happen before it has actually been responded to.
- *  The 'jvm_ping_slow' event will be raised for each ping that was detected slow, so if the
- *  JVM is hung for a long period of time, it may be raised several times. This can be used
- *  for analytics and to take actions like warning before the ping timeout occurs.
- */
-void wrapperPingSlow() {
+static void pollFdsAdd(struct pollfd *fds, int max, int *count, int fd, short events) {
+    if (fd >= 0) {
+        if (*count < max) {
+            fds[*count].fd = fd;
+            fds[*count].events = events;
+            fds[*count].revents = 0;
+        }
+        /* Keep counting so that the caller can tell that some did not fit. */
+        (*count)++;
+    }
 }
 
 /**
- * Called when a ping is responded to, but was slower than the wrapper.ping.alert.threshold.
+ * Collects the descriptors the event loop should wait on while it is idle.
  *
- * @param tickAge The number of seconds it took to respond.
+ * @return The number of entries filled in, or -1 if the caller must sleep.
  */
-void wrapperPingRespondedSlow(int tickAge) {
-    log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->pingAlertLogLevel, TEXT("Pinging the JVM took %d seconds to respond."), tickAge);
-}
+int wrapperGetPollFds(struct pollfd *fds, int max) {
+    int count = 0;
+    int i;
+    int freeSlot;
 
-/**
- * Called when a ping response is received.
- *
- * @param pingSendTicks Time in ticks when the ping was originally sent.
- * @param queueWarnings TRUE if warnings about the queue should be logged, FALSE if the ping response did not contain a time.
- */
-void wrapperPingResponded(TICKS pingSendTicks, int queueWarnings) {
-    TICKS nowTicks;
-    int tickAge;
-    PPendingPing pendingPing;
-    int pingSearchDone;
-    
-#ifdef DEBUG_PING_QUEUE
-    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Ping Response (tick %08x)"), pingSendTicks);
-#endif
-    /* We want to purge the ping from the PendingPing list. */
-    do {
-        pendingPing = wrapperData->firstPendingPing;
-        if (pendingPing != NULL) {
-            tickAge = wrapperGetTickAgeTicks(pingSendTicks, pendingPing->sentTicks);
-#ifdef DEBUG_PING_QUEUE
-            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE First Queued Ping (tick %08x, age %d)"), pendingPing->sentTicks, tickAge);
-#endif
-            if (tickAge > 0) { /* pendingPing->sentTicks > pingSendTicks */
-                /* We received a ping response that is earlier than the one we were expecting.
-                 *  If the pendingPingQueue has overflown then we will stop writing to it.  Don't log warning messages when in this state as they would be confusing and are expected.
-                 *  Leave this one in the queue for later. */
-                if (queueWarnings) {
-                    if ((!wrapperData->pendingPingQueueOverflow) && (!wrapperData->pendingPingQueueOverflowEmptied)) {
-                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Received an unexpected ping response, sent at tick %08x.  First expected ping was sent at tick %08x."), pingSendTicks, pendingPing->sentTicks);
-                    } else {
-#ifdef DEBUG_PING_QUEUE
-                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Silently skipping unexpected ping response. (tick %08x) (First tick %08x)"), pingSendTicks, pendingPing->sentTicks);
+#ifdef LINUX
+    if (protocolRing.header) {
+        /* Packets written to the ring do not make any descriptor readable. */
+        return -1;
+    }
 #endif
-                    }
-                }
-                pendingPing = NULL;
-                pingSearchDone = TRUE;
+
+    if (!wrapperData->useJavaIOThread) {
+        pollFdsAdd(fds, max, &count, wrapperGetChildOutputFd(), POLLIN);
+    }
+
+    /* Only wait on the backend when wrapperProtocolRead() would read it, or a pending connection would wake us up forever. */
+    if (wrapperGetProtocolState() & WRAPPER_BACKEND_READ_ALLOWED) {
+        if (wrapperData->backendTypeBit == WRAPPER_BACKEND_TYPE_PIPE) {
+            if (protocolActiveServerPipeConnected) {
+                pollFdsAdd(fds, max, &count, protocolActiveServerPipeIn, POLLIN);
             } else {
-                if (tickAge < 0) {
-                    /* This PendingPing object was sent before the PING that we received.  This means that we somehow lost a ping. */
-                    if (queueWarnings) {
-                        if ((!wrapperData->pendingPingQueueOverflow) && (!wrapperData->pendingPingQueueOverflowEmptied)) {
-                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Lost a ping response, sent at tick %08x."), pendingPing->sentTicks);
-                        } else {
-#ifdef DEBUG_PING_QUEUE
-                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Silently skipping lost ping response. (tick %08x)"), pendingPing->sentTicks);
-#endif
-                        }
-                    }
-                    pingSearchDone = FALSE;
-                } else {
-                    /* This PendingPing object is for this PING event. */
-                    pingSearchDone = TRUE;
-#ifdef DEBUG_PING_QUEUE
-                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Expected Ping Response. (tick %08x)"), pendingPing->sentTicks);
-#endif
-                    
-                    /* When the emptied flag is set, we know that we are recovering from an overflow.
-                     *  That flag is reset on the first expected PendingPing found in the queue. */
-                    if (wrapperData->pendingPingQueueOverflowEmptied) {
-                        wrapperData->pendingPingQueueOverflowEmptied = FALSE;
-#ifdef DEBUG_PING_QUEUE
-                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Emptied Set flag reset."));
-#endif
-                    }
-                }
-                
-                /* Detach the PendingPing from the queue. */
-                if (pendingPing->nextPendingPing != NULL) {
-                    /* This was the first PendingPing of several in the queue. */
-                    wrapperData->pendingPingCount--;
-                    if (wrapperData->firstUnwarnedPendingPing == wrapperData->firstPendingPing) {
-                        wrapperData->firstUnwarnedPendingPing = pendingPing->nextPendingPing;
-                    }
-                    wrapperData->firstPendingPing = pendingPing->nextPendingPing;
-                    pendingPing->nextPendingPing = NULL;
-#ifdef DEBUG_PING_QUEUE
-                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Size: %d"), wrapperData->pendingPingCount);
-#endif
-                } else {
-                    /* This was the only PendingPing in the queue. */
-                    wrapperData->pendingPingCount = 0;
-                    wrapperData->firstUnwarnedPendingPing = NULL;
-                    wrapperData->firstPendingPing = NULL;
-                    wrapperData->lastPendingPing = NULL;
-#ifdef DEBUG_PING_QUEUE
-                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Empty.") );
-#endif
-                    if (wrapperData->pendingPingQueueOverflow) {
-                        wrapperData->pendingPingQueueOverflowEmptied = TRUE;
-                        wrapperData->pendingPingQueueOverflow = FALSE;
-#ifdef DEBUG_PING_QUEUE
-                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Reset Overflow, Emptied Set.") );
-#endif
-                    }
-                }
-                
-                /* Free up the pendingPing object. */
-                if (pendingPing != NULL) {
-                    free(pendingPing);
-                    pendingPing = NULL;
-                }
+                pollFdsAdd(fds, max, &count, protocolPipeInFd[0], POLLIN);
             }
+        } else if (protocolActiveBackendSD != INVALID_SOCKET) {
+            pollFdsAdd(fds, max, &count, protocolActiveBackendSD, POLLIN);
         } else {
-            /* Got a ping response when the queue was empty. */
-            if (queueWarnings) {
-                if ((!wrapperData->pendingPingQueueOverflow) && (!wrapperData->pendingPingQueueOverflowEmptied)) {
-                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Received an unexpected ping response, sent at tick %08x."), pingSendTicks);
-                } else {
-#ifdef DEBUG_PING_QUEUE
-                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Silently skipping unexpected ping response. (tick %08x) (Empty)"), pingSendTicks);
-#endif
-                }
+            pollFdsAdd(fds, max, &count, protocolActiveServerSD, POLLIN);
+        }
+    }
+
+    if (controlServerSD != INVALID_SOCKET) {
+        freeSlot = FALSE;
+        for (i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+            if (controlClients[i].sd == INVALID_SOCKET) {
+                freeSlot = TRUE;
+            } else {
+                pollFdsAdd(fds, max, &count, controlClients[i].sd, controlClients[i].outputLen > 0 ? POLLOUT : POLLIN);
             }
-            pingSearchDone = TRUE;
         }
-    } while (!pingSearchDone);
-    
-    /* Depending on the current JVM state, do something. */
-    switch (wrapperData->jState) {
-    case WRAPPER_JSTATE_STARTED:
-        /* We got a response to a ping. */
-        nowTicks = wrapperGetTicks();
-        
-        /* Figure out how long it took for us to get this ping response in seconds. */
-        tickAge = wrapperGetTickAgeSeconds(pingSendTicks, nowTicks);
-        
-        /* If we took longer than the threshold then we want to log a message. */
-        if ((wrapperData->pingAlertThreshold > 0) && (tickAge >= wrapperData->pingAlertThreshold)) {
-            wrapperPingRespondedSlow(tickAge);
+        if (freeSlot) {
+            pollFdsAdd(fds, max, &count, controlServerSD, POLLIN);
         }
-        
-        /* Allow 5 + <pingTimeout> more seconds before the JVM is considered to be dead. */
-        if (wrapperData->pingTimeout > 0) {
-            wrapperUpdateJavaStateTimeout(nowTicks, 5 + wrapperData->pingTimeout);
-        } else {
-            wrapperUpdateJavaStateTimeout(nowTicks, -1);
+    }
+
+    if (metricsServerSD != INVALID_SOCKET) {
+        freeSlot = FALSE;
+        for (i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            if (metricsClients[i].sd == INVALID_SOCKET) {
+                freeSlot = TRUE;
+            } else {
+                pollFdsAdd(fds, max, &count, metricsClients[i].sd, metricsClients[i].response ? POLLOUT : POLLIN);
+            }
         }
+        if (freeSlot) {
+            pollFdsAdd(fds, max, &count, metricsServerSD, POLLIN);
+        }
+    }
 
-        break;
+    for (i = 0; i < wrapperInstanceCount; i++) {
+        pollFdsAdd(fds, max, &count, wrapperInstances[i].outputFd, POLLIN);
+    }
 
-    default:
-        /* We got a ping response that we were not expecting.  Ignore it. */
-        break;
+    if (count > max) {
+        /* Should not happen with the fixed number of clients, but never wait while ignoring some input. */
+        return -1;
     }
+    return count;
 }
+#endif
 
 void wrapperPingTimeoutResponded() {
     wrapperProcessActionList(wrapperData->pingActionList, TEXT("JVM appears hung: Timed out waiting for signal from JVM."),
@@ -13835,6 +17071,9 @@ void wrapperStartedSignaled() {
         } else {
             wrapperSetJavaState(WRAPPER_JSTATE_STARTED, 0, -1);
         }
+        wrapperProfileEnd(TEXT("startup"));
+        wrapperProfileReport(TRUE);
+
         /* Is the wrapper state STARTING? */
         if (wrapperData->wState == WRAPPER_WSTATE_STARTING) {
             wrapperSetWrapperState(WRAPPER_WSTATE_STARTED);
@@ -43,6 +43,7 @@
  #include <sys/types.h>
  #include <time.h>
  #include <unistd.h>
+ #include <poll.h>
  #ifndef MACOSX
   #define u_short unsigned short
  #endif /* MACOSX */
@@ -102,6 +103,8 @@ extern char** environ;
 #define WRAPPER_BACKEND_TYPE_SOCKET    (WRAPPER_BACKEND_TYPE_SOCKET_V4 | WRAPPER_BACKEND_TYPE_SOCKET_V6)
 #define WRAPPER_BACKEND_TYPE_PIPE      0x04 /* Use a pair of pipes to communicate. */
 #define WRAPPER_BACKEND_TYPE_AUTO      (WRAPPER_BACKEND_TYPE_SOCKET | WRAPPER_BACKEND_TYPE_PIPE)
+#define WRAPPER_BACKEND_TYPE_SOCKET_UNIX 0x08 /* Use a Unix-domain socket in a private directory (UNIX only, never part of AUTO). */
+#define WRAPPER_BACKEND_TYPE_ANY_SOCKET (WRAPPER_BACKEND_TYPE_SOCKET | WRAPPER_BACKEND_TYPE_SOCKET_UNIX) /* All types using socket I/O. */
 
 #define WRAPPER_BACKEND_OPENED          1
 #define WRAPPER_BACKEND_CLOSED          2
@@ -181,6 +184,11 @@ extern char** environ;
 #define WRAPPER_JVM_DRY           3
 #define WRAPPER_JVM_APP           4
 
+/* What to do with the lines of java output exceeding the rate limit. */
+#define WRAPPER_LOG_RATE_MODE_DROP      0
+#define WRAPPER_LOG_RATE_MODE_SAMPLE    1
+#define WRAPPER_LOG_RATE_MODE_OVERFLOW  2
+
 /* Defined Action types.  Registered actions are negative.  Custom types are positive. */
 #define ACTION_LIST_END          0
 #define ACTION_NONE              -1
@@ -205,6 +213,19 @@ extern char** environ;
 #define WRAPPER_ACTION_SOURCE_CODE_ON_EXIT                 4  /* Action originated from an on_exit configuration. */
 #define WRAPPER_ACTION_SOURCE_CODE_SIGNAL                  5  /* Action originated from a signal. */
 #define WRAPPER_ACTION_SOURCE_CODE_PING_TIMEOUT            11 /* Action originated from a timeout. */
+#define WRAPPER_ACTION_SOURCE_CODE_JVM_MONITOR             12 /* Action originated from a limit of the JVM resource monitor. */
+#define WRAPPER_ACTION_SOURCE_CODE_CGROUP_PRESSURE         13 /* Action originated from a pressure trigger of the JVM cgroup. */
+#define WRAPPER_ACTION_SOURCE_CODE_CONTROL_SOCKET          14 /* Action originated from the control socket. */
+
+/* Results of wrapperExecuteCommand(). */
+#define WRAPPER_COMMAND_OK          0
+#define WRAPPER_COMMAND_EMPTY       1 /* The line was blank. */
+#define WRAPPER_COMMAND_UNKNOWN     2
+#define WRAPPER_COMMAND_INVALID     3 /* The command is known but its parameters were wrong, or it is disabled. */
+
+/* Limits of the JVM resource monitor, used as the property index of WRAPPER_ACTION_SOURCE_CODE_JVM_MONITOR. */
+#define WRAPPER_JVM_MONITOR_LIMIT_RSS   0
+#define WRAPPER_JVM_MONITOR_LIMIT_CPU   1
 
 /* Required services access rights per action
  * ATTENTION: Any change in the definitions below should be reported to the functions & variables in wrapper_service_permission_win.c  */
@@ -272,12 +293,26 @@ typedef unsigned long TICKS;
 #endif
 
 /*#define DEBUG_PING_QUEUE*/
+/* No more pings are sent while this many pings are waiting for a response. */
 #define WRAPPER_MAX_PENDING_PINGS 10
+/* Number of slots in the ring of pending pings.  Must be a power of two larger than WRAPPER_MAX_PENDING_PINGS so
+ *  that the slot of a ping is not reused before a late response to it can be recognized. */
+#define WRAPPER_PENDING_PING_SLOTS 32
+
+#define PENDING_PING_FREE       0   /* The slot was never used. */
+#define PENDING_PING_WAITING    1   /* The ping was sent and is waiting for its response. */
+#define PENDING_PING_ANSWERED   2   /* The response to the ping was received. */
+#define PENDING_PING_LOST       3   /* A response to a later ping was received first. */
+
+/* Pings are identified by a sequence number which is sent with the ping and echoed back by the JVM.
+ *  The slot of a ping in the ring is its sequence number modulo WRAPPER_PENDING_PING_SLOTS. */
 typedef struct PendingPing PendingPing, *PPendingPing;
 struct PendingPing {
+    unsigned int seq;               /* Sequence number of the ping. */
+    int state;                      /* One of the PENDING_PING_* constants. */
     TICKS sentTicks;
     TICKS slowTicks;
-    PPendingPing nextPendingPing;
+    unsigned int sentMicros;        /* Value of wrapperGetMicros() when the ping was sent, to measure its round trip. */
 };
 
 typedef struct ParameterFile ParameterFile;
@@ -312,8 +347,16 @@ struct WrapperConfig {
     int     use_sun_encoding;       /* TRUE if the Wrapper uses the value of sun.stdout.encoding to read JVM output. */
     int     backendTypeConfiguredBits; /* The type of the backend as configured by the user. */
     int     backendTypeBit;         /* The resolved type of the backend that the Wrapper and Java use to communicate. */
+    int     backendProtocolMax;     /* Highest version of the backend protocol offered to the JVM. */
+#ifdef LINUX
+    int     useBackendRing;         /* TRUE if the JVM should send its log packets through a shared memory ring. */
+    int     backendRingSize;        /* Size of the shared memory ring in bytes. */
+#endif
     int     configured;             /* TRUE if loadConfiguration has been called. */
     int     useSystemTime;          /* TRUE if the wrapper should use the system clock for timing, FALSE if a tick counter should be used. */
+#ifndef WIN32
+    int     useMonotonicTime;       /* TRUE if the tick counter is read from a monotonic clock, FALSE if it is advanced by a timer thread.  Ignored if useSystemTime is set. */
+#endif
     int     logBufferGrowth;        /* TRUE if changes to internal buffer sizes should be logged. */
     int     timerFastThreshold;     /* If the difference between the system time based tick count and the timer tick count ever falls by more than this value then a warning will be displayed. */
     int     timerSlowThreshold;     /* If the difference between the system time based tick count and the timer tick count ever grows by more than this value then a warning will be displayed. */
@@ -403,12 +446,36 @@ struct WrapperConfig {
     int     mainLoopStepCycles;     /* Number of cycles between steps to increase the sleep time of the event loop. */
     int     mainLoopSleepStepMs;    /* Number of milliseconds to increase the sleep time for each step. */
     int     mainLoopMaxSleepMs;     /* Maximum number of milliseconds to allow the event loop to sleep. */
+    int     mainLoopWaitEvents;     /* TRUE if the idle event loop waits on its descriptors with poll() rather than sleeping blindly. */
     int     cpuTimeout;             /* Number of seconds without CPU before the JVM will issue a warning and extend timeouts */
     int     pidLogLevel;            /* The log level to use when logging the PID of the JVM after it is launched. */
     int     startupTimeout;         /* Number of seconds the wrapper will wait for a JVM to startup */
     int     pingTimeout;            /* Number of seconds the wrapper will wait for a JVM to reply to a ping */
     int     pingAlertThreshold;     /* Number of seconds without a ping response that the Wrapper will start to warn about a slow ping. */
     int     pingAlertLogLevel;      /* Long level at which slow ping notices are logged. */
+    int     pingStatsInterval;      /* Number of seconds between summaries of the ping round trip times, 0 to disable them. */
+    int     pingStatsLogLevel;      /* Log level at which the ping round trip summaries are logged. */
+    int     metricsPort;            /* Loopback port of the metrics endpoint, 0 if it is disabled. */
+    int     startupProfile;         /* TRUE if the timeline of the startup should be logged once the JVM is started. */
+    TCHAR   *startupProfileFile;    /* File to which the startup profile is written in the Chrome trace format, NULL if not wanted. */
+    int     stateTraceSize;         /* Number of state transitions kept in the trace ring, 0 to disable the trace. */
+    TCHAR   *stateTraceFile;        /* File to which the state trace is written in the Chrome trace format, NULL if not wanted. */
+    int     stateTraceLogLevel;     /* Log level at which the durations of the phases of each JVM are logged. */
+#ifdef LINUX
+    int     javaMonitorInterval;    /* Number of seconds between samples of the resources used by the JVM, 0 to disable the monitor. */
+    int     javaMonitorLogLevel;    /* Log level at which each sample is logged. */
+    int     javaMonitorRssLimit;    /* Resident memory of the JVM in MB above which javaMonitorRssActionList is fired, 0 for no limit. */
+    int     *javaMonitorRssActionList; /* The action list to take when the resident memory limit is exceeded. */
+    int     javaMonitorCpuLimit;    /* CPU usage of the JVM in percent of one CPU above which javaMonitorCpuActionList is fired, 0 for no limit. */
+    int     javaMonitorCpuDuration; /* Number of seconds the CPU usage must stay above the limit before firing the action. */
+    int     *javaMonitorCpuActionList; /* The action list to take when the CPU usage stayed above the limit. */
+#endif
+#ifndef WIN32
+    TCHAR   *metricsSocketPath;     /* Path of the Unix-domain socket of the metrics endpoint, NULL if it is not used. */
+    int     metricsSocketUmask;     /* Umask to use when creating the metrics socket. */
+    TCHAR   *controlSocketPath;     /* Path of the Unix-domain control socket, NULL if it is not used. */
+    int     controlSocketUmask;     /* Umask to use when creating the control socket. */
+#endif
     int     pingInterval;           /* Number of seconds between pinging the JVM */
     int     pingIntervalLogged;     /* Number of seconds between pings which can be logged to debug output. */
     int     *pingActionList;        /* The action list to take when a ping timeout is detected. */
@@ -550,6 +617,20 @@ struct WrapperConfig {
     gid_t   javaStatusFileGroup;    /* Group to use when creating the java status file. */
     gid_t   anchorFileGroup;        /* Group to use when creating the anchor file. */
     int     javaNewProcessGroup;    /* Indicates whether the Java process should be created in a new process group or not (Unix only). */
+    int     javaUsePosixSpawn;      /* TRUE if the Java process should be launched with posix_spawn rather than fork (Unix only). */
+ #ifdef LINUX
+    TCHAR   *javaCgroupRoot;        /* Path of the cgroup v2 below which the JVM is placed, NULL or empty to leave the JVM in the cgroup of the Wrapper. */
+    TCHAR   *javaCgroupName;        /* Name of the cgroup created for the JVM below javaCgroupRoot, NULL or empty for "jvm-<Wrapper pid>". */
+    TCHAR   *javaCgroupMemoryMax;   /* Value written to memory.max of the JVM cgroup, NULL or empty to leave it unchanged. */
+    TCHAR   *javaCgroupCpuMax;      /* Value written to cpu.max of the JVM cgroup, NULL or empty to leave it unchanged. */
+    TCHAR   *javaCgroupPidsMax;     /* Value written to pids.max of the JVM cgroup, NULL or empty to leave it unchanged. */
+    int     javaCgroupMemoryPressureStall; /* Memory stall in ms within the pressure window which fires javaCgroupMemoryPressureActionList, 0 to not watch it. */
+    int     *javaCgroupMemoryPressureActionList; /* The action list to take on memory pressure. */
+    int     javaCgroupCpuPressureStall; /* CPU stall in ms within the pressure window which fires javaCgroupCpuPressureActionList, 0 to not watch it. */
+    int     *javaCgroupCpuPressureActionList; /* The action list to take on CPU pressure. */
+    int     javaCgroupPressureWindow; /* Size in ms of the window over which stalls are measured. */
+    int     javaCgroupPressureCooldown; /* Minimum number of seconds between two actions fired for the pressure of the same resource. */
+ #endif
 #endif
     int     ignoreSignals;          /* Mask that determines where the Wrapper should ignore any catchable system signals.  Can be ingored in the Wrapper and/or JVM. */
     TCHAR   *consoleTitle;          /* Text to set the console title to. */
@@ -566,6 +647,17 @@ struct WrapperConfig {
     int     pausableStopJVM;        /* Should the JVM be stopped when the service is paused? */
     int     initiallyPaused;        /* Should the Wrapper come up initially in a paused state? */
     int     logLFDelayThreshold;    /* The LF Delay threshold to use when logging java output. */
+    int     logMultiline;           /* TRUE if stack traces and other continuation lines in the java output are logged as a single record. */
+    int     logMultilineMaxLines;   /* Maximum number of lines aggregated in a single record. */
+    int     logCollapseRepeats;     /* TRUE if consecutive identical lines of java output are replaced by a count. */
+    int     logCollapseRepeatsInterval; /* Number of seconds after which the count of a run of repeated lines is logged even if the run goes on. */
+    int     logRateLines;           /* Maximum number of lines of java output logged per second, 0 if unlimited. */
+    int     logRateBytes;           /* Maximum number of bytes of java output logged per second, 0 if unlimited. */
+    int     logRateBurst;           /* Number of seconds worth of output at the maximum rates which can be logged in a burst. */
+    int     logRateMode;            /* What to do with the lines exceeding the rate limit, see WRAPPER_LOG_RATE_MODE_*. */
+    int     logRateSample;          /* In SAMPLE mode, one in that many lines exceeding the rate limit is logged anyway. */
+    TCHAR   *logRateOverflowFile;   /* In OVERFLOW mode, file where the lines exceeding the rate limit are written. */
+    int     logRateSummaryInterval; /* Number of seconds between the summaries of the lines exceeding the rate limit. */
 
 #ifdef WIN32
     int     isSingleInvocation;     /* TRUE if only a single invocation of an application should be allowed to launch. */
@@ -611,12 +703,15 @@ struct WrapperConfig {
     int     jvmStopped;             /* Flag which remembers the stopped state of the JVM process. */
 #endif
     
-    int pendingPingQueueOverflow;   /* Flag which is set to true if the PendingPingQueue overflows the limit of WRAPPER_MAX_PENDING_PINGS. */
-    int pendingPingQueueOverflowEmptied; /* Flag which is set when the queue size is reduced to 0 after having overflowed. */
-    int pendingPingCount;           /* Number of PendingPing events in the list. */
-    PPendingPing firstPendingPing;  /* Pointer to the first PendingPing in the list. */
-    PPendingPing firstUnwarnedPendingPing; /* Pointer to the first PendingPing in the list for which a slow warning has not been logged. */
-    PPendingPing lastPendingPing;   /* Pointer to the last PendingPing in the list. */
+    PendingPing pendingPings[WRAPPER_PENDING_PING_SLOTS]; /* Ring of the pings which were sent to the current JVM. */
+    unsigned int pingSeqNext;       /* Sequence number of the next ping to be sent. */
+    unsigned int pingSeqOldest;     /* Sequence number of the oldest ping still waiting for its response, or pingSeqNext if none. */
+    unsigned int pingSeqUnwarned;   /* Sequence number of the first ping which has not yet been checked for being slow. */
+    unsigned int pingsSent;         /* Number of pings sent to the current JVM. */
+    unsigned int pingsAnswered;     /* Number of pings answered in order. */
+    unsigned int pingsLost;         /* Number of pings whose response was never received. */
+    unsigned int pingsOutOfOrder;   /* Number of pings whose response was received after that of a later ping. */
+    unsigned int pingsUnexpected;   /* Number of ping responses which did not match any ping that was sent. */
 
 #ifdef WIN32
     int     ctrlEventCTRLCTrapped;  /* CTRL_C_EVENT trapped. */
@@ -685,6 +780,21 @@ struct WrapperConfig {
 #endif
 #define WRAPPER_MSG_PRESTART      (char)146
 #define WRAPPER_MSG_APP_PARAMETERS (char)147
+#define WRAPPER_MSG_PROTOCOL      (char)148
+#define WRAPPER_MSG_LOG_BATCH     (char)149
+
+#define WRAPPER_PROTOCOL_VERSION_1 1    /* A packet code followed by a null terminated string. */
+#define WRAPPER_PROTOCOL_VERSION_2 2    /* A packet code, the payload length as an unsigned LEB128 varint, and the payload. */
+#define WRAPPER_PROTOCOL_CAP_UTF8  0x01 /* The JVM encodes its payloads in UTF-8 rather than in the encoding of its output. */
+#define WRAPPER_PROTOCOL_CAP_LOG_BATCH 0x02 /* The JVM may send its log records in bulk with LOG_BATCH packets. */
+#define WRAPPER_PROTOCOL_CAPS      (WRAPPER_PROTOCOL_CAP_UTF8 | WRAPPER_PROTOCOL_CAP_LOG_BATCH) /* All the capabilities supported by this Wrapper. */
+
+/* Separators used in the payload of a LOG_BATCH packet.  Each record is made of the
+ *  level, the creation time as "<seconds>.<millis>", the flags in hex, the source and
+ *  the message, separated by units and terminated by a record separator. */
+#define WRAPPER_LOG_BATCH_UNIT_SEPARATOR   TEXT('\x1f')
+#define WRAPPER_LOG_BATCH_RECORD_SEPARATOR TEXT('\x1e')
+#define WRAPPER_LOG_BATCH_FLAG_FILTERED    0x01 /* The record was already filtered by the JVM, output filters are not applied. */
 
 #define WRAPPER_PROCESS_DOWN      200
 #define WRAPPER_PROCESS_UP        201
@@ -731,6 +841,20 @@ extern void wrapperSetConsoleTitle();
  */
 extern void wrapperProtocolClose();
 
+#ifdef LINUX
+/**
+ * Creates the shared memory ring used by the next JVM, if configured.
+ *  Failures are not fatal as the JVM then sends all its packets through the backend.
+ */
+extern void wrapperProtocolCreateRing();
+#endif
+
+/**
+ * Sleeps for the specified number of milliseconds, but returns as soon
+ *  as the JVM adds a packet to the shared memory ring if one is in use.
+ */
+extern void wrapperProtocolSleep(int ms);
+
 /**
  * Return TRUE when the JVM's state is between LAUNCHING and STOPPING (and the
  *  stopped packed is not received yet), FALSE otherwise.
@@ -1005,6 +1129,19 @@ void initJavaBootstrapParser();
  */
 extern int wrapperReadChildOutput(int maxTimeMS);
 
+/**
+ * Logs any multi-line record of JVM output which is still held back waiting
+ *  for continuation lines, and the count of any run of repeated lines.
+ *  Called once the JVM output has been read to the end.
+ */
+extern void wrapperFlushChildOutputRecord();
+
+/**
+ * Flushes the held back JVM output from the javaio thread once the JVM exited,
+ *  if the main thread is still waiting for it.
+ */
+extern void wrapperJavaIOFlushChildOutputRecord();
+
 extern void wrapperReadAllChildOutputAfterFailure();
 
 /**
@@ -1036,6 +1173,19 @@ extern void wrapperUpdateJavaStateTimeout(TICKS nowTicks, int delay);
  */
 extern void wrapperSetJavaState(int jState, TICKS nowTicks, int delay);
 
+/**
+ * Logs the durations of the phases of the JVMs seen so far, and writes the
+ *  state trace to wrapper.state_trace.file if it is set.
+ *
+ * logLevel - The level at which the durations are logged.
+ */
+extern void wrapperDumpStateTrace(int logLevel);
+
+/**
+ * Frees the state trace.
+ */
+extern void wrapperDisposeStateTrace();
+
 /******************************************************************************
  * Platform specific methods
  *****************************************************************************/
@@ -1118,6 +1268,13 @@ extern void wrapperReportStatus(int useLoggerQueue, int status, int errorCode, i
  */
 extern int wrapperReadChildOutputBlock(char *blockBuffer, int blockSize, int *readCount);
 
+#ifndef WIN32
+/**
+ * Returns the descriptor of the child pipe, or -1 if it is not open.
+ */
+extern int wrapperGetChildOutputFd();
+#endif
+
 /**
  * Simple function to check the status of the JVM process without calling wrapperJVMProcessExited().
  *  IMPORTANT: On Unix, this function calls waitpid() with no WNOHANG.
@@ -1169,6 +1326,15 @@ extern TICKS wrapperGetTicks();
  */
 extern int wrapperTickAssertions();
 
+#ifdef LINUX
+/**
+ * Logs the time the system spent suspended since the previous call.  The
+ *  monotonic clock stops while the system is suspended, so that time does
+ *  not count toward any timeout.
+ */
+extern void wrapperCheckSuspend();
+#endif
+
 /**
  * Set the uptime in seconds (based on internal tick counter and is valid up to one year from startup).
  */
@@ -1344,6 +1510,18 @@ extern int wrapperReleaseTickMutex();
  */
 extern TICKS wrapperGetSystemTicks();
 
+/**
+ * Returns the current value of a microsecond counter.  Only the difference
+ *  between two values is meaningful.
+ */
+extern unsigned int wrapperGetMicros();
+
+/**
+ * Returns the current value of a monotonic microsecond clock.  Unlike
+ *  wrapperGetMicros(), it does not wrap, so it can measure long durations.
+ */
+extern double wrapperGetMonotonicMicros();
+
 /**
  * Returns difference in seconds between the start and end ticks.  This function
  *  handles cases where the tick counter has wrapped between when the start
@@ -1387,7 +1565,9 @@ extern int wrapperSetWorkingDir(const TCHAR* dir);
  * Protocol callback functions
  *****************************************************************************/
 extern void wrapperLogSignaled(int logLevel, TCHAR *msg);
+extern void wrapperLogBatchSignaled(TCHAR *batch);
 extern int wrapperKeyRegistered(TCHAR *key);
+extern void wrapperProtocolNegotiated(TCHAR *request);
 
 /**
  * Called when a ping is first determined to be slower than the wrapper.ping.alert.threshold.
@@ -1405,10 +1585,133 @@ extern void wrapperPingRespondedSlow(int tickAge);
 /**
  * Called when a ping response is received.
  *
- * @param pingSendTicks Time in ticks when the ping was originally sent.
- * @param queueWarnings TRUE if warnings about the queue should be logged, FALSE if the ping response did not contain a time.
+ * @param pingSeq Sequence number of the ping, echoed back by the JVM.
+ * @param seqKnown FALSE if the ping response did not contain a sequence number.
+ */
+extern void wrapperPingResponded(unsigned int pingSeq, int seqKnown);
+
+/**
+ * Called when a ping was sent to the JVM.  Records it in the ring of pending pings.
+ *
+ * @param nowTicks The tick count when the ping was sent.
+ * @param sentMicros The value of wrapperGetMicros() when the ping was sent.
  */
-extern void wrapperPingResponded(TICKS pingSendTicks, int queueWarnings);
+extern void wrapperPingSent(TICKS nowTicks, unsigned int sentMicros);
+
+/**
+ * Returns the number of pings which are waiting for a response.
+ */
+extern int wrapperPingPendingCount();
+
+/**
+ * Clears the ring of pending pings when the JVM exits.
+ */
+extern void wrapperPingQueueReset();
+
+/**
+ * Records the round trip time of a ping, in microseconds.
+ */
+extern void wrapperPingRecordRoundTrip(TICKS nowTicks, unsigned int roundTrip);
+
+/**
+ * Logs the distribution of the ping round trip times of the current JVM.
+ */
+extern void wrapperPingStatsDump();
+
+/**
+ * Clears the ping round trip times when the JVM exits.
+ */
+extern void wrapperPingStatsReset();
+
+/**
+ * Opens the metrics endpoint if it is configured.
+ *
+ * @return TRUE if the endpoint was configured but could not be opened.
+ */
+extern int wrapperMetricsStartServer();
+
+/**
+ * Closes the metrics endpoint.
+ */
+extern void wrapperMetricsStopServer();
+
+/**
+ * Serves the metrics endpoint without blocking.  Called once per cycle of the event loop.
+ */
+extern void wrapperMetricsPoll(TICKS nowTicks);
+
+/**
+ * Parses and executes a single command of the command file or control
+ *  socket.
+ *
+ * @param line The command and its parameters.  Modified while being parsed.
+ * @param actionSourceCode The WRAPPER_ACTION_SOURCE_CODE_* of the command.
+ * @param pDeferredCrash If not NULL, a test crash is not done right away but
+ *                       stored here so the caller can clean up first.
+ *
+ * @return One of the WRAPPER_COMMAND_* results.
+ */
+extern int wrapperExecuteCommand(TCHAR *line, int actionSourceCode, int *pDeferredCrash);
+
+#ifndef WIN32
+/**
+ * Opens the control socket if wrapper.control.socket is set.
+ *
+ * @return TRUE if the socket was configured but could not be opened.
+ */
+extern int wrapperControlStartServer();
+
+/**
+ * Closes the control socket and any client still connected.
+ */
+extern void wrapperControlStopServer();
+
+/**
+ * Accepts new control clients and executes any command they sent.  Called
+ *  once per cycle of the event loop.  Never blocks.
+ */
+extern void wrapperControlPoll(TICKS nowTicks);
+
+/**
+ * Collects the descriptors the event loop should wait on while it is idle:
+ *  the child output, the backend, and the control and metrics sockets.
+ *  Listening sockets are only included while there is room to accept a
+ *  client, and clients with a pending reply are waited on for POLLOUT.
+ *
+ * @param fds Array to fill in.
+ * @param max Number of entries available in fds.
+ *
+ * @return The number of entries filled in, or -1 if some input can not be
+ *         waited on with poll() and the caller must fall back to sleeping.
+ */
+extern int wrapperGetPollFds(struct pollfd *fds, int max);
+#endif
+
+#ifdef LINUX
+/**
+ * Samples the resources used by the JVM when it is time to, and fires the
+ *  actions of any limit which was exceeded.  Called once per cycle of the
+ *  event loop.
+ */
+extern void wrapperJavaMonitorPoll(TICKS nowTicks);
+
+/**
+ * Starts watching the pressure of the cgroup of a newly launched JVM, if one
+ *  is configured.  A JVM launched with posix_spawn is first moved into it.
+ *
+ * @param pid The pid of the JVM.
+ * @param spawned TRUE if the JVM was launched with posix_spawn rather than
+ *                fork.
+ */
+extern void wrapperJavaCgroupAttach(pid_t pid, int spawned);
+
+/**
+ * Fires the actions of any pressure trigger of the JVM cgroup, and removes
+ *  the cgroup once the JVM is gone.  Called once per cycle of the event
+ *  loop.
+ */
+extern void wrapperJavaCgroupPoll(TICKS nowTicks);
+#endif
 
 extern void wrapperPingTimeoutResponded();
 extern void wrapperStopRequested(int exitCode);
@@ -1451,4 +1754,14 @@ struct LoadParameterFileCallbackParam {
 #ifdef CUNIT
 extern void tsJAP_testJavaAdditionalParamSuite(void);
 #endif /* CUNIT */
+
+#ifdef WRAPPER_BENCH
+/* Internals of the Wrapper, exposed for the microbenchmarks in bench.c. */
+extern void logApplyFilters(const TCHAR *log);
+extern int protocolReadVersion;
+ #ifndef WIN32
+extern int protocolActiveBackendSD;
+extern int pipedes[2];
+ #endif
+#endif /* WRAPPER_BENCH */
 #endif
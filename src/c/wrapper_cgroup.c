@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "wrapper_i18n.h"
+#include "wrapper_cgroup.h"
+
+static const char *cgroupPressureFiles[WRAPPER_CGROUP_RESOURCE_COUNT] = { "memory.pressure", "cpu.pressure" };
+
+static int cgroupWriteFile(const char *path, const char *value, size_t len) {
+    int fd;
+    ssize_t written;
+    int err;
+
+    /* Files can not be created on a cgroup file system, so O_CREAT only matters when testing against a plain directory. */
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return TRUE;
+    }
+    written = write(fd, value, len);
+    err = errno;
+    close(fd);
+    if (written != (ssize_t)len) {
+        errno = (written < 0) ? err : EIO;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+int wrapperCgroupEnableController(const char *root, const char *controller) {
+    char path[512];
+    char value[32];
+
+    snprintf(path, sizeof(path), "%s/cgroup.subtree_control", root);
+    snprintf(value, sizeof(value), "+%s", controller);
+    return cgroupWriteFile(path, value, strlen(value));
+}
+
+int wrapperCgroupCreate(PWrapperCgroup cgroup, const char *root, const char *name) {
+    int i;
+
+    memset(cgroup, 0, sizeof(WrapperCgroup));
+    for (i = 0; i < WRAPPER_CGROUP_RESOURCE_COUNT; i++) {
+        cgroup->pressureFds[i] = -1;
+    }
+
+    if ((size_t)snprintf(cgroup->path, sizeof(cgroup->path), "%s/%s", root, name) >= sizeof(cgroup->path)) {
+        errno = ENAMETOOLONG;
+        return TRUE;
+    }
+
+    if (mkdir(cgroup->path, 0755) && (errno != EEXIST)) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+int wrapperCgroupWrite(PWrapperCgroup cgroup, const char *file, const char *value) {
+    char path[600];
+
+    snprintf(path, sizeof(path), "%s/%s", cgroup->path, file);
+    return cgroupWriteFile(path, value, strlen(value));
+}
+
+int wrapperCgroupAddProcess(PWrapperCgroup cgroup, int pid) {
+    char buffer[16];
+
+    snprintf(buffer, sizeof(buffer), "%d", pid);
+    return wrapperCgroupWrite(cgroup, "cgroup.procs", buffer);
+}
+
+int wrapperCgroupWatchPressure(PWrapperCgroup cgroup, int resource, int stallMs, int windowMs) {
+    char path[600];
+    char trigger[64];
+    size_t len;
+    int fd;
+    int err;
+
+    if (cgroup->pressureFds[resource] >= 0) {
+        close(cgroup->pressureFds[resource]);
+        cgroup->pressureFds[resource] = -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", cgroup->path, cgroupPressureFiles[resource]);
+    fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return TRUE;
+    }
+    /* The kernel expects the trigger to be written in a single write, including its terminating null. */
+    len = snprintf(trigger, sizeof(trigger), "some %ld %ld", (long)stallMs * 1000, (long)windowMs * 1000) + 1;
+    if (write(fd, trigger, len) != (ssize_t)len) {
+        err = errno;
+        close(fd);
+        errno = err;
+        return TRUE;
+    }
+    cgroup->pressureFds[resource] = fd;
+    return FALSE;
+}
+
+int wrapperCgroupPollPressure(PWrapperCgroup cgroup) {
+    struct pollfd fds[WRAPPER_CGROUP_RESOURCE_COUNT];
+    int resources[WRAPPER_CGROUP_RESOURCE_COUNT];
+    int count = 0;
+    int mask = 0;
+    int i;
+
+    for (i = 0; i < WRAPPER_CGROUP_RESOURCE_COUNT; i++) {
+        if (cgroup->pressureFds[i] >= 0) {
+            fds[count].fd = cgroup->pressureFds[i];
+            fds[count].events = POLLPRI;
+            fds[count].revents = 0;
+            resources[count] = i;
+            count++;
+        }
+    }
+    if ((count == 0) || (poll(fds, count, 0) <= 0)) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (fds[i].revents & POLLERR) {
+            close(cgroup->pressureFds[resources[i]]);
+            cgroup->pressureFds[resources[i]] = -1;
+        } else if (fds[i].revents & POLLPRI) {
+            mask |= 1 << resources[i];
+        }
+    }
+    return mask;
+}
+
+int wrapperCgroupParsePressure(const char *text, double *someAvg10, double *fullAvg10) {
+    const char *full;
+
+    *someAvg10 = 0;
+    *fullAvg10 = 0;
+    if (strncmp(text, "some avg10=", 11) != 0) {
+        return TRUE;
+    }
+    *someAvg10 = strtod(text + 11, NULL);
+    full = strstr(text, "\nfull avg10=");
+    if (full) {
+        *fullAvg10 = strtod(full + 12, NULL);
+    }
+    return FALSE;
+}
+
+int wrapperCgroupReadPressure(PWrapperCgroup cgroup, int resource, double *someAvg10, double *fullAvg10) {
+    char path[600];
+    char buffer[256];
+    ssize_t len;
+    int fd;
+
+    /* The trigger fds are not read from, so as not to disturb them. */
+    snprintf(path, sizeof(path), "%s/%s", cgroup->path, cgroupPressureFiles[resource]);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return TRUE;
+    }
+    len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (len < 0) {
+        return TRUE;
+    }
+    buffer[len] = '\0';
+    return wrapperCgroupParsePressure(buffer, someAvg10, fullAvg10);
+}
+
+void wrapperCgroupClose(PWrapperCgroup cgroup) {
+    int i;
+
+    for (i = 0; i < WRAPPER_CGROUP_RESOURCE_COUNT; i++) {
+        if (cgroup->pressureFds[i] >= 0) {
+            close(cgroup->pressureFds[i]);
+            cgroup->pressureFds[i] = -1;
+        }
+    }
+}
+
+int wrapperCgroupRemove(PWrapperCgroup cgroup) {
+    wrapperCgroupClose(cgroup);
+    return rmdir(cgroup->path) ? TRUE : FALSE;
+}
+#endif
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Places a process in a cgroup v2 subtree, sets its limits, and watches
+ *  the pressure stall information (PSI) of the subtree.
+ *
+ * The root is the path of an existing cgroup which was delegated to the
+ *  Wrapper.  Nothing here checks that it is really on a cgroup2 file system,
+ *  so the code can be exercised against a plain directory.
+ *
+ * PSI triggers make the kernel wake up a poll() with POLLPRI when the tasks
+ *  of the cgroup were stalled for longer than a threshold within a time
+ *  window.  This notices memory thrashing or CPU starvation within a window,
+ *  well before the JVM would stop answering pings.
+ *
+ * This is only implemented on Linux.
+ */
+
+#ifdef LINUX
+#ifndef _WRAPPER_CGROUP_H
+#define _WRAPPER_CGROUP_H
+
+/* Resources whose pressure can be watched. */
+#define WRAPPER_CGROUP_MEMORY   0
+#define WRAPPER_CGROUP_CPU      1
+#define WRAPPER_CGROUP_RESOURCE_COUNT 2
+
+typedef struct WrapperCgroup WrapperCgroup, *PWrapperCgroup;
+struct WrapperCgroup {
+    char    path[512];                                  /* Directory of the cgroup. */
+    int     pressureFds[WRAPPER_CGROUP_RESOURCE_COUNT]; /* memory.pressure and cpu.pressure with a trigger, -1 if not watched. */
+};
+
+/**
+ * Enables a controller, for example "memory", in the children of a cgroup
+ *  so that its limits can be set on them.  Enabling a controller which is
+ *  already enabled succeeds.
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperCgroupEnableController(const char *root, const char *controller);
+
+/**
+ * Creates the cgroup below a root, or reuses it if it already exists.
+ *
+ * @param cgroup Structure to initialize.
+ * @param root Path of the parent cgroup.
+ * @param name Name of the cgroup to create.
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperCgroupCreate(PWrapperCgroup cgroup, const char *root, const char *name);
+
+/**
+ * Writes a value to one of the files of the cgroup, for example
+ *  "memory.max".
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperCgroupWrite(PWrapperCgroup cgroup, const char *file, const char *value);
+
+/**
+ * Moves a process, with all of its threads, into the cgroup.  A pid of 0
+ *  moves the calling process, which is how the child of a fork enters the
+ *  cgroup before it executes the JVM.
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperCgroupAddProcess(PWrapperCgroup cgroup, int pid);
+
+/**
+ * Starts watching the pressure of a resource.
+ *
+ * @param resource WRAPPER_CGROUP_MEMORY or WRAPPER_CGROUP_CPU.
+ * @param stallMs Time in ms during which at least some tasks were stalled
+ *                within the window that fires the trigger.
+ * @param windowMs Size of the window in ms.  The kernel accepts 500 to
+ *                 10000, and notifies at most once per window.
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperCgroupWatchPressure(PWrapperCgroup cgroup, int resource, int stallMs, int windowMs);
+
+/**
+ * Checks, without waiting, which of the watched resources fired their
+ *  trigger.  A trigger which can no longer fire, because the cgroup was
+ *  removed, stops being watched.
+ *
+ * @return A mask of (1 << resource) for each resource under pressure.
+ */
+extern int wrapperCgroupPollPressure(PWrapperCgroup cgroup);
+
+/**
+ * Parses the content of a pressure file.
+ *
+ * @param text The content, for example "some avg10=1.00 avg60=... total=...\n
+ *             full avg10=0.50 ...".
+ * @param someAvg10 Set to the percentage of time some tasks were stalled
+ *                  over the last 10 seconds.
+ * @param fullAvg10 Set to the percentage of time all tasks were stalled over
+ *                  the last 10 seconds, 0 if the line is missing.
+ *
+ * @return TRUE if the text could not be parsed.
+ */
+extern int wrapperCgroupParsePressure(const char *text, double *someAvg10, double *fullAvg10);
+
+/**
+ * Reads the current pressure of a resource.  See wrapperCgroupParsePressure.
+ *
+ * @return TRUE if there were any problems.
+ */
+extern int wrapperCgroupReadPressure(PWrapperCgroup cgroup, int resource, double *someAvg10, double *fullAvg10);
+
+/**
+ * Stops watching the pressure.
+ */
+extern void wrapperCgroupClose(PWrapperCgroup cgroup);
+
+/**
+ * Stops watching the pressure and removes the cgroup.  This fails if
+ *  processes are still in it.
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperCgroupRemove(PWrapperCgroup cgroup);
+
+#endif
+#endif
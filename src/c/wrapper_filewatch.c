@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include "wrapper_i18n.h"
+#include "wrapper_filewatch.h"
+
+/* Every event a directory watch may need to report.  The masks of the files decide which are of interest. */
+#define FILEWATCH_DIR_EVENTS (WRAPPER_FILEWATCH_CREATED | WRAPPER_FILEWATCH_DELETED | IN_ONLYDIR)
+
+/* File system magic numbers from linux/magic.h, for those whose changes may not go through the local kernel. */
+#define FILEWATCH_NFS_MAGIC     0x6969
+#define FILEWATCH_SMB_MAGIC     0x517B
+#define FILEWATCH_SMB2_MAGIC    0xFE534D42
+#define FILEWATCH_CIFS_MAGIC    0xFF534D42
+#define FILEWATCH_FUSE_MAGIC    0x65735546
+#define FILEWATCH_CEPH_MAGIC    0x00C36400
+#define FILEWATCH_AFS_MAGIC     0x5346414F
+
+static int fileWatchIsRemote(const char *dir) {
+    struct statfs fsStat;
+
+    if (statfs(dir, &fsStat)) {
+        /* inotify_add_watch() will fail as well, with a better errno. */
+        return FALSE;
+    }
+    switch ((unsigned int)fsStat.f_type) {
+    case FILEWATCH_NFS_MAGIC:
+    case FILEWATCH_SMB_MAGIC:
+    case FILEWATCH_SMB2_MAGIC:
+    case FILEWATCH_CIFS_MAGIC:
+    case FILEWATCH_FUSE_MAGIC:
+    case FILEWATCH_CEPH_MAGIC:
+    case FILEWATCH_AFS_MAGIC:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+int wrapperFileWatchOpen(PWrapperFileWatch watch) {
+    memset(watch, 0, sizeof(WrapperFileWatch));
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return (watch->fd < 0) ? TRUE : FALSE;
+}
+
+int wrapperFileWatchAdd(PWrapperFileWatch watch, const char *path, int mask) {
+    char dir[512];
+    const char *name;
+    size_t len;
+    int wd;
+    int index;
+
+    if (watch->fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    if (watch->count >= WRAPPER_FILEWATCH_MAX) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    name = strrchr(path, '/');
+    if (!name) {
+        strcpy(dir, ".");
+        name = path;
+    } else {
+        len = name - path;
+        if (len == 0) {
+            /* A file in the root directory. */
+            len = 1;
+        }
+        if (len >= sizeof(dir)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+        name++;
+    }
+    if ((name[0] == '\0') || (strlen(name) >= sizeof(watch->names[0]))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (fileWatchIsRemote(dir)) {
+        errno = EREMOTE;
+        return -1;
+    }
+
+    /* Adding the same directory again returns its existing watch, with the same events. */
+    wd = inotify_add_watch(watch->fd, dir, FILEWATCH_DIR_EVENTS);
+    if (wd < 0) {
+        return -1;
+    }
+
+    index = watch->count++;
+    watch->wds[index] = wd;
+    watch->masks[index] = mask;
+    strcpy(watch->names[index], name);
+    return index;
+}
+
+int wrapperFileWatchPoll(PWrapperFileWatch watch) {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t len;
+    char *p;
+    int changes = 0;
+    int i;
+
+    if (watch->fd < 0) {
+        return 0;
+    }
+
+    while ((len = read(watch->fd, buffer, sizeof(buffer))) > 0) {
+        for (p = buffer; p < buffer + len; p += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event *)p;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                /* Events were lost, so anything could have happened. */
+                for (i = 0; i < watch->count; i++) {
+                    changes |= 1 << i;
+                }
+                continue;
+            }
+            for (i = 0; i < watch->count; i++) {
+                if (watch->wds[i] != event->wd) {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    /* The directory was deleted or unmounted.  A new directory with the same name would not be watched. */
+                    watch->wds[i] = -1;
+                    changes |= 1 << i;
+                } else if ((event->mask & watch->masks[i]) && (event->len > 0) && (strcmp(event->name, watch->names[i]) == 0)) {
+                    changes |= 1 << i;
+                }
+            }
+        }
+    }
+    return changes;
+}
+
+int wrapperFileWatchIsWatched(PWrapperFileWatch watch, int index) {
+    return ((watch->fd >= 0) && (index >= 0) && (index < watch->count) && (watch->wds[index] >= 0)) ? TRUE : FALSE;
+}
+
+void wrapperFileWatchClose(PWrapperFileWatch watch) {
+    if (watch->fd >= 0) {
+        /* Closing the instance removes all of its watches. */
+        close(watch->fd);
+    }
+    watch->fd = -1;
+    watch->count = 0;
+}
+#endif
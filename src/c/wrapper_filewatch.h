@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Watches files for being created, written or deleted using inotify, so
+ *  that the Wrapper does not need to stat them periodically.
+ *
+ * The directory of each file is watched rather than the file itself, as
+ *  the files being watched come and go.  Several files in the same
+ *  directory share the same watch.
+ *
+ * inotify only reports the changes made through the local kernel.  Files
+ *  on network or FUSE file systems are therefore refused, and the caller
+ *  is expected to keep polling them.
+ *
+ * This is only implemented on Linux.
+ */
+
+#ifdef LINUX
+#ifndef _WRAPPER_FILEWATCH_H
+#define _WRAPPER_FILEWATCH_H
+
+#include <sys/inotify.h>
+
+#define WRAPPER_FILEWATCH_MAX 4
+
+/* Events which can be asked for when adding a file. */
+#define WRAPPER_FILEWATCH_CREATED   (IN_CLOSE_WRITE | IN_MOVED_TO)
+#define WRAPPER_FILEWATCH_DELETED   (IN_DELETE | IN_MOVED_FROM)
+
+typedef struct WrapperFileWatch WrapperFileWatch, *PWrapperFileWatch;
+struct WrapperFileWatch {
+    int     fd;                                 /* inotify instance, -1 if not open. */
+    int     count;                              /* Number of files added. */
+    int     wds[WRAPPER_FILEWATCH_MAX];         /* Watch of the directory of each file, -1 once it is lost. */
+    int     masks[WRAPPER_FILEWATCH_MAX];       /* Events of interest for each file. */
+    char    names[WRAPPER_FILEWATCH_MAX][256];  /* Base name of each file. */
+};
+
+/**
+ * Opens an inotify instance.
+ *
+ * @return TRUE if there were any problems, with errno set.
+ */
+extern int wrapperFileWatchOpen(PWrapperFileWatch watch);
+
+/**
+ * Starts watching a file.  The file does not need to exist, but its
+ *  directory does.
+ *
+ * @param path Path of the file, relative paths are resolved now.
+ * @param mask WRAPPER_FILEWATCH_CREATED and/or WRAPPER_FILEWATCH_DELETED.
+ *             A file which is created is only reported once it has been
+ *             closed after writing, so that its content is complete.
+ *
+ * @return The index of the file, or -1 if there were any problems, with
+ *         errno set.  EREMOTE is used for network file systems.
+ */
+extern int wrapperFileWatchAdd(PWrapperFileWatch watch, const char *path, int mask);
+
+/**
+ * Checks, without waiting, which of the files had any of their events.  A
+ *  file whose directory was deleted or unmounted stops being watched, and
+ *  is reported once more so that the caller looks at it.  If the kernel
+ *  dropped events, all files are reported.
+ *
+ * @return A mask of (1 << index) for each file which had any events.
+ */
+extern int wrapperFileWatchPoll(PWrapperFileWatch watch);
+
+/**
+ * Tests whether a file is still being watched.
+ */
+extern int wrapperFileWatchIsWatched(PWrapperFileWatch watch, int index);
+
+/**
+ * Stops watching all files.
+ */
+extern void wrapperFileWatchClose(PWrapperFileWatch watch);
+
+#endif
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#include <string.h>
+#include "wrapper_histogram.h"
+
+void wrapperHistogramReset(PWrapperHistogram histogram) {
+    memset(histogram, 0, sizeof(WrapperHistogram));
+}
+
+int wrapperHistogramBucketForValue(unsigned int value) {
+    int magnitude;
+    unsigned int v;
+
+    if (value < WRAPPER_HISTOGRAM_SUB_BUCKETS) {
+        return (int)value;
+    }
+
+    /* Position of the highest bit set. */
+    magnitude = 0;
+    v = value;
+    while (v >>= 1) {
+        magnitude++;
+    }
+
+    /* The highest WRAPPER_HISTOGRAM_SUB_BUCKET_BITS + 1 bits select the bucket.  The top one is always set. */
+    return (magnitude - WRAPPER_HISTOGRAM_SUB_BUCKET_BITS + 1) * WRAPPER_HISTOGRAM_SUB_BUCKETS
+        + (int)((value >> (magnitude - WRAPPER_HISTOGRAM_SUB_BUCKET_BITS)) & (WRAPPER_HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+unsigned int wrapperHistogramBucketHighestValue(int bucket) {
+    int shift;
+    unsigned int lowest;
+
+    if (bucket < WRAPPER_HISTOGRAM_SUB_BUCKETS) {
+        return (unsigned int)bucket;
+    }
+
+    shift = bucket / WRAPPER_HISTOGRAM_SUB_BUCKETS - 1;
+    lowest = (unsigned int)(WRAPPER_HISTOGRAM_SUB_BUCKETS + bucket % WRAPPER_HISTOGRAM_SUB_BUCKETS) << shift;
+    return lowest + ((1U << shift) - 1);
+}
+
+void wrapperHistogramRecord(PWrapperHistogram histogram, unsigned int value) {
+    histogram->counts[wrapperHistogramBucketForValue(value)]++;
+    if ((histogram->count == 0) || (value < histogram->min)) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    histogram->count++;
+    histogram->sum += value;
+}
+
+void wrapperHistogramAdd(PWrapperHistogram target, PWrapperHistogram source) {
+    int i;
+
+    if (source->count == 0) {
+        return;
+    }
+    for (i = 0; i < WRAPPER_HISTOGRAM_BUCKETS; i++) {
+        target->counts[i] += source->counts[i];
+    }
+    if ((target->count == 0) || (source->min < target->min)) {
+        target->min = source->min;
+    }
+    if (source->max > target->max) {
+        target->max = source->max;
+    }
+    target->count += source->count;
+    target->sum += source->sum;
+}
+
+unsigned int wrapperHistogramValueAtPercentile(PWrapperHistogram histogram, double percentile) {
+    double threshold;
+    unsigned int seen = 0;
+    unsigned int value;
+    int i;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    /* Number of values which must be at or below the result, at least one. */
+    threshold = histogram->count * percentile / 100.0;
+    if (threshold < 1.0) {
+        threshold = 1.0;
+    }
+    for (i = 0; i < WRAPPER_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if ((double)seen >= threshold) {
+            value = wrapperHistogramBucketHighestValue(i);
+            return (value > histogram->max) ? histogram->max : value;
+        }
+    }
+    return histogram->max;
+}
+
+double wrapperHistogramMean(PWrapperHistogram histogram) {
+    if (histogram->count == 0) {
+        return 0.0;
+    }
+    return histogram->sum / histogram->count;
+}
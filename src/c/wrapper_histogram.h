@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * A small histogram for latencies, in the spirit of HdrHistogram.  Values
+ *  are stored in log-linear buckets: each power of two is split into
+ *  WRAPPER_HISTOGRAM_SUB_BUCKETS linear buckets, so any recorded value is
+ *  known within about 3% whatever its magnitude.  Recording a value is a
+ *  couple of shifts and an increment, and a histogram uses a fixed amount
+ *  of memory.
+ */
+
+#ifndef _WRAPPER_HISTOGRAM_H
+#define _WRAPPER_HISTOGRAM_H
+
+#define WRAPPER_HISTOGRAM_SUB_BUCKET_BITS 5
+#define WRAPPER_HISTOGRAM_SUB_BUCKETS     (1 << WRAPPER_HISTOGRAM_SUB_BUCKET_BITS)
+/* Values below WRAPPER_HISTOGRAM_SUB_BUCKETS are exact, then one set of sub buckets for each of the remaining powers of two of an unsigned int. */
+#define WRAPPER_HISTOGRAM_BUCKETS         (WRAPPER_HISTOGRAM_SUB_BUCKETS * (32 - WRAPPER_HISTOGRAM_SUB_BUCKET_BITS + 1))
+
+typedef struct WrapperHistogram WrapperHistogram, *PWrapperHistogram;
+struct WrapperHistogram {
+    unsigned int counts[WRAPPER_HISTOGRAM_BUCKETS];
+    unsigned int count;         /* Number of recorded values. */
+    unsigned int min;           /* Smallest recorded value. */
+    unsigned int max;           /* Largest recorded value. */
+    double sum;                 /* Sum of the recorded values, to compute the mean. */
+};
+
+/**
+ * Removes all the values from a histogram.
+ */
+extern void wrapperHistogramReset(PWrapperHistogram histogram);
+
+/**
+ * Records a value in a histogram.
+ */
+extern void wrapperHistogramRecord(PWrapperHistogram histogram, unsigned int value);
+
+/**
+ * Adds all the values of one histogram to another.
+ */
+extern void wrapperHistogramAdd(PWrapperHistogram target, PWrapperHistogram source);
+
+/**
+ * Returns the value below which the given percentage of the recorded values
+ *  fall.  The value is the highest value of its bucket, but never more than
+ *  the largest recorded value.
+ *
+ * @param percentile Percentile between 0 and 100.
+ *
+ * @return The value, or 0 if the histogram is empty.
+ */
+extern unsigned int wrapperHistogramValueAtPercentile(PWrapperHistogram histogram, double percentile);
+
+/**
+ * Returns the mean of the recorded values, or 0 if the histogram is empty.
+ */
+extern double wrapperHistogramMean(PWrapperHistogram histogram);
+
+/**
+ * Returns the index of the bucket which holds a value.
+ */
+extern int wrapperHistogramBucketForValue(unsigned int value);
+
+/**
+ * Returns the highest value which is stored in a bucket.
+ */
+extern unsigned int wrapperHistogramBucketHighestValue(int bucket);
+
+#endif
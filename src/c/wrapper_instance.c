@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "logger.h"
+#include "wrapper_i18n.h"
+#include "wrapper_instance.h"
+
+/* Maximum number of bytes of output read from an instance in one cycle, so that a chatty one does not hold up the event loop. */
+#define INSTANCE_READ_MAX   65536
+
+#define INSTANCE_PROPERTY_NAME_LEN 64
+
+WrapperInstance *wrapperInstances = NULL;
+int wrapperInstanceCount = 0;
+
+/* Set once the Wrapper is stopping, the instances are then never launched again. */
+static int instancesStopping = FALSE;
+
+/**
+ * Converts a property value to an argument of the command line of an instance.
+ *
+ * @return The argument, which must be freed, or NULL if there were any problems.
+ */
+static char *instanceArgument(int id, const TCHAR *value) {
+    char *arg;
+    size_t req;
+
+    req = wcstombs(NULL, value, 0);
+    if (req == (size_t)-1) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Instance %d: the argument '%s' can not be represented in the encoding of the current locale."), id, value);
+        return NULL;
+    }
+    arg = malloc(req + 1);
+    if (!arg) {
+        outOfMemory(TEXT("IA"), 1);
+        return NULL;
+    }
+    wcstombs(arg, value, req + 1);
+    return arg;
+}
+
+static void instanceFreeArgv(PWrapperInstance instance) {
+    int i;
+
+    if (instance->argv) {
+        for (i = 0; instance->argv[i]; i++) {
+            free(instance->argv[i]);
+        }
+        free(instance->argv);
+        instance->argv = NULL;
+    }
+}
+
+/**
+ * Builds the command line of an instance from its java.command,
+ *  java.additional.<n>, java.mainclass and app.parameter.<n> properties.
+ *  Each value is passed to the JVM as a single argument.
+ *
+ * @return TRUE if there were any problems, FALSE if successful.
+ */
+static int instanceLoadCommand(Properties *properties, PWrapperInstance instance, const TCHAR *mainClass) {
+    TCHAR propertyName[INSTANCE_PROPERTY_NAME_LEN];
+    const TCHAR *javaCommand;
+    TCHAR **additionalNames;
+    TCHAR **additionalValues;
+    long unsigned int *additionalIndices;
+    TCHAR **parameterNames;
+    TCHAR **parameterValues;
+    long unsigned int *parameterIndices;
+    int additionalCount;
+    int parameterCount;
+    int argc;
+    int i;
+    int result = FALSE;
+
+    _sntprintf(propertyName, INSTANCE_PROPERTY_NAME_LEN, TEXT("wrapper.instance.%d.java.command"), instance->id);
+    javaCommand = getNotEmptyStringProperty(properties, propertyName, getNotEmptyStringProperty(properties, TEXT("wrapper.java.command"), TEXT("java")));
+
+    _sntprintf(propertyName, INSTANCE_PROPERTY_NAME_LEN, TEXT("wrapper.instance.%d.java.additional."), instance->id);
+    if (getStringProperties(properties, propertyName, TEXT(""), wrapperData->ignoreSequenceGaps, FALSE, &additionalNames, &additionalValues, &additionalIndices)) {
+        return TRUE;
+    }
+    _sntprintf(propertyName, INSTANCE_PROPERTY_NAME_LEN, TEXT("wrapper.instance.%d.app.parameter."), instance->id);
+    if (getStringProperties(properties, propertyName, TEXT(""), wrapperData->ignoreSequenceGaps, FALSE, &parameterNames, &parameterValues, &parameterIndices)) {
+        freeStringProperties(additionalNames, additionalValues, additionalIndices);
+        return TRUE;
+    }
+    for (additionalCount = 0; additionalValues[additionalCount]; additionalCount++) {
+        ;
+    }
+    for (parameterCount = 0; parameterValues[parameterCount]; parameterCount++) {
+        ;
+    }
+
+    instance->argv = calloc(1 + additionalCount + 1 + parameterCount + 1, sizeof(char *));
+    if (!instance->argv) {
+        outOfMemory(TEXT("ILC"), 1);
+        result = TRUE;
+    } else {
+        argc = 0;
+        result = ((instance->argv[argc++] = instanceArgument(instance->id, javaCommand)) == NULL);
+        for (i = 0; !result && (i < additionalCount); i++) {
+            result = ((instance->argv[argc++] = instanceArgument(instance->id, additionalValues[i])) == NULL);
+        }
+        if (!result) {
+            result = ((instance->argv[argc++] = instanceArgument(instance->id, mainClass)) == NULL);
+        }
+        for (i = 0; !result && (i < parameterCount); i++) {
+            result = ((instance->argv[argc++] = instanceArgument(instance->id, parameterValues[i])) == NULL);
+        }
+        if (result) {
+            instanceFreeArgv(instance);
+        }
+    }
+
+    freeStringProperties(additionalNames, additionalValues, additionalIndices);
+    freeStringProperties(parameterNames, parameterValues, parameterIndices);
+    return result;
+}
+
+/**
+ * Returns the value of the wrapper.instance.<n>.<name> property, or the
+ *  default if it is not set.
+ */
+static int instanceIntProperty(Properties *properties, int id, const TCHAR *name, int defaultValue) {
+    TCHAR propertyName[INSTANCE_PROPERTY_NAME_LEN];
+
+    _sntprintf(propertyName, INSTANCE_PROPERTY_NAME_LEN, TEXT("wrapper.instance.%d.%s"), id, name);
+    return getIntProperty(properties, propertyName, defaultValue);
+}
+
+int wrapperInstancesLoad(Properties *properties) {
+    TCHAR **propertyNames;
+    TCHAR **propertyValues;
+    long unsigned int *propertyIndices;
+    PWrapperInstance instance;
+    int count;
+    int i;
+
+    if (getStringProperties(properties, TEXT("wrapper.instance."), TEXT(".java.mainclass"), TRUE, FALSE, &propertyNames, &propertyValues, &propertyIndices)) {
+        return TRUE;
+    }
+    for (count = 0; propertyValues[count]; count++) {
+        ;
+    }
+    if (count == 0) {
+        freeStringProperties(propertyNames, propertyValues, propertyIndices);
+        return FALSE;
+    }
+    if (count > WRAPPER_INSTANCE_MAX) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("%d instances are configured, only the first %d will be supervised."), count, WRAPPER_INSTANCE_MAX);
+        count = WRAPPER_INSTANCE_MAX;
+    }
+
+    wrapperInstances = calloc(count, sizeof(WrapperInstance));
+    if (!wrapperInstances) {
+        outOfMemory(TEXT("WIL"), 1);
+        freeStringProperties(propertyNames, propertyValues, propertyIndices);
+        return TRUE;
+    }
+    for (i = 0; i < count; i++) {
+        instance = &wrapperInstances[wrapperInstanceCount];
+        instance->id = (int)propertyIndices[i];
+        instance->outputFd = -1;
+        if (instanceLoadCommand(properties, instance, propertyValues[i])) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Instance %d will not be launched."), instance->id);
+            continue;
+        }
+        instance->restartDelay = propIntMax(instanceIntProperty(properties, instance->id, TEXT("restart.delay"), wrapperData->restartDelay), 0);
+        instance->successfulInvocationTime = propIntMax(instanceIntProperty(properties, instance->id, TEXT("successful_invocation_time"), wrapperData->successfulInvocationTime), 0);
+        instance->maxFailedInvocations = propIntMax(instanceIntProperty(properties, instance->id, TEXT("max_failed_invocations"), wrapperData->maxFailedInvocations), 1);
+        instance->exitTimeout = propIntMax(instanceIntProperty(properties, instance->id, TEXT("jvm_exit.timeout"), wrapperData->jvmExitTimeout), 1);
+        instance->state = WRAPPER_INSTANCE_STATE_DOWN;
+        instance->stateTicks = wrapperGetTicks();
+        wrapperInstanceCount++;
+    }
+    freeStringProperties(propertyNames, propertyValues, propertyIndices);
+
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Supervising %d additional instances."), wrapperInstanceCount);
+    }
+    return FALSE;
+}
+
+/**
+ * Logs the line of output held in the buffer of an instance.
+ */
+static void instanceLogLine(PWrapperInstance instance) {
+    TCHAR *line;
+
+    if ((instance->outputLen > 0) && (instance->outputBuffer[instance->outputLen - 1] == '\r')) {
+        instance->outputLen--;
+    }
+    instance->outputBuffer[instance->outputLen] = '\0';
+    instance->outputLen = 0;
+
+    if (converterMBToWide(instance->outputBuffer, NULL, &line, TRUE)) {
+        if (line) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("%s"), line);
+            free(line);
+        } else {
+            outOfMemory(TEXT("ILL"), 1);
+        }
+        return;
+    }
+    log_printf(WRAPPER_SOURCE_INSTANCE(instance->id), LEVEL_INFO, TEXT("%s"), line);
+    free(line);
+}
+
+/**
+ * Reads and logs the output of an instance until none is left, or until
+ *  INSTANCE_READ_MAX bytes were read.
+ *
+ * @return TRUE if there may be more output to read.
+ */
+static int instanceReadOutput(PWrapperInstance instance) {
+    char buffer[1024];
+    ssize_t len;
+    ssize_t i;
+    size_t total = 0;
+
+    while (instance->outputFd != -1) {
+        if (total >= INSTANCE_READ_MAX) {
+            return TRUE;
+        }
+        len = read(instance->outputFd, buffer, sizeof(buffer));
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return FALSE;
+            }
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Failed to read the output of instance %d: %s"), instance->id, getLastErrorText());
+        }
+        if (len <= 0) {
+            /* The JVM and any process it launched are done with their output. */
+            if (instance->outputLen > 0) {
+                instanceLogLine(instance);
+            }
+            close(instance->outputFd);
+            instance->outputFd = -1;
+            return FALSE;
+        }
+        total += len;
+        for (i = 0; i < len; i++) {
+            if (buffer[i] == '\n') {
+                instanceLogLine(instance);
+            } else {
+                if (instance->outputLen >= WRAPPER_INSTANCE_LINE_MAX - 1) {
+                    instanceLogLine(instance);
+                }
+                instance->outputBuffer[instance->outputLen++] = buffer[i];
+            }
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Launches the JVM of an instance with its stdout and stderr sent to a pipe
+ *  read by the event loop.
+ *
+ * @return TRUE if there were any problems, FALSE if successful.
+ */
+static int instanceLaunch(PWrapperInstance instance, TICKS nowTicks) {
+    posix_spawn_file_actions_t fileActions;
+    posix_spawnattr_t attr;
+    int pipeFds[2];
+    pid_t pid;
+    int ret;
+
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Launching instance %d..."), instance->id);
+
+    if (pipe(pipeFds) < 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Could not init %s pipe: %s"), TEXT("instance output"), getLastErrorText());
+        return TRUE;
+    }
+    /* Keep both ends from the other children.  The copies made for the stdout and stderr of the JVM do not have the flag. */
+    fcntl(pipeFds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeFds[1], F_SETFD, FD_CLOEXEC);
+    fcntl(pipeFds[0], F_SETFL, O_NONBLOCK);
+
+    if ((ret = posix_spawn_file_actions_init(&fileActions)) == 0) {
+        if ((ret = posix_spawnattr_init(&attr)) == 0) {
+            ret = posix_spawn_file_actions_addopen(&fileActions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+            if (!ret) {
+                ret = posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDOUT_FILENO);
+            }
+            if (!ret) {
+                ret = posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDERR_FILENO);
+            }
+            if (!ret) {
+                /* In its own process group so that a CTRL-C in the console only reaches the Wrapper, which then stops the instance. */
+                ret = posix_spawnattr_setpgroup(&attr, 0);
+            }
+            if (!ret) {
+                ret = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+            }
+            if (!ret) {
+                /* The working directory, the environment and the umask are inherited from the Wrapper process. */
+                ret = posix_spawnp(&pid, instance->argv[0], &fileActions, &attr, instance->argv, environ);
+            }
+            posix_spawnattr_destroy(&attr);
+        }
+        posix_spawn_file_actions_destroy(&fileActions);
+    }
+    close(pipeFds[1]);
+    if (ret) {
+        close(pipeFds[0]);
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to launch instance %d: %s (%d)"), instance->id, getErrorText(ret, NULL), ret);
+        return TRUE;
+    }
+
+    instance->pid = pid;
+    instance->outputFd = pipeFds[0];
+    instance->outputLen = 0;
+    instance->launchTicks = nowTicks;
+    instance->invocations++;
+    if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Instance %d launched with PID %d."), instance->id, (int)pid);
+    }
+    return FALSE;
+}
+
+/**
+ * Decides what to do with an instance whose JVM is gone, or could not be
+ *  launched.
+ *
+ * @param ranSeconds Number of seconds the JVM ran.
+ */
+static void instanceDown(PWrapperInstance instance, TICKS nowTicks, int ranSeconds) {
+    if (instancesStopping) {
+        instance->state = WRAPPER_INSTANCE_STATE_STOPPED;
+        return;
+    }
+
+    if (ranSeconds < instance->successfulInvocationTime) {
+        instance->failedInvocations++;
+    } else {
+        instance->failedInvocations = 0;
+    }
+    if (instance->failedInvocations >= instance->maxFailedInvocations) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Instance %d failed %d times in a row, each within %d seconds of its launch.  Giving up on it."),
+            instance->id, instance->failedInvocations, instance->successfulInvocationTime);
+        instance->state = WRAPPER_INSTANCE_STATE_STOPPED;
+        return;
+    }
+
+    if (instance->restartDelay > 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Relaunching instance %d in %d seconds."), instance->id, instance->restartDelay);
+    }
+    instance->state = WRAPPER_INSTANCE_STATE_DOWN;
+    instance->stateTicks = wrapperAddToTicks(nowTicks, instance->restartDelay);
+}
+
+/**
+ * Checks whether the JVM of an instance exited, and handles it if it did.
+ */
+static void instanceCheckExit(PWrapperInstance instance, TICKS nowTicks) {
+    pid_t ret;
+    int status;
+    int logLevel;
+
+    ret = waitpid(instance->pid, &status, WNOHANG);
+    if ((ret == 0) || ((ret < 0) && (errno == EINTR))) {
+        return;
+    }
+
+    /* Log what is left of its output before the exit.  A process launched by the JVM may keep
+     *  the pipe open, but the next JVM gets a new one, so stop reading it. */
+    instanceReadOutput(instance);
+    if (instance->outputFd != -1) {
+        if (instance->outputLen > 0) {
+            instanceLogLine(instance);
+        }
+        close(instance->outputFd);
+        instance->outputFd = -1;
+    }
+
+    logLevel = (instance->state == WRAPPER_INSTANCE_STATE_UP) ? LEVEL_STATUS : LEVEL_INFO;
+    if (ret < 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("Unable to get the status of instance %d: %s"), instance->id, getLastErrorText());
+    } else if (WIFSIGNALED(status)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, logLevel, TEXT("Instance %d was terminated by signal %d."), instance->id, WTERMSIG(status));
+    } else {
+        log_printf(WRAPPER_SOURCE_WRAPPER, logLevel, TEXT("Instance %d exited with code %d."), instance->id, WEXITSTATUS(status));
+    }
+    instance->pid = 0;
+
+    instanceDown(instance, nowTicks, wrapperGetTickAgeSeconds(instance->launchTicks, nowTicks));
+}
+
+int wrapperInstancesPoll(TICKS nowTicks) {
+    PWrapperInstance instance;
+    int moreOutput = FALSE;
+    int i;
+
+    for (i = 0; i < wrapperInstanceCount; i++) {
+        instance = &wrapperInstances[i];
+
+        if (instanceReadOutput(instance)) {
+            moreOutput = TRUE;
+        }
+
+        switch (instance->state) {
+        case WRAPPER_INSTANCE_STATE_DOWN:
+            if (wrapperTickExpired(nowTicks, instance->stateTicks)) {
+                if (instanceLaunch(instance, nowTicks)) {
+                    instanceDown(instance, nowTicks, 0);
+                } else {
+                    instance->state = WRAPPER_INSTANCE_STATE_UP;
+                }
+            }
+            break;
+
+        case WRAPPER_INSTANCE_STATE_UP:
+        case WRAPPER_INSTANCE_STATE_KILLING:
+            instanceCheckExit(instance, nowTicks);
+            break;
+
+        case WRAPPER_INSTANCE_STATE_STOPPING:
+            instanceCheckExit(instance, nowTicks);
+            if ((instance->state == WRAPPER_INSTANCE_STATE_STOPPING) && wrapperTickExpired(nowTicks, instance->stateTicks)) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Instance %d did not exit within %d seconds.  Killing it."), instance->id, instance->exitTimeout);
+                kill(instance->pid, SIGKILL);
+                instance->state = WRAPPER_INSTANCE_STATE_KILLING;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+    return moreOutput;
+}
+
+void wrapperInstancesStop(TICKS nowTicks) {
+    PWrapperInstance instance;
+    int i;
+
+    if (instancesStopping) {
+        return;
+    }
+    instancesStopping = TRUE;
+
+    for (i = 0; i < wrapperInstanceCount; i++) {
+        instance = &wrapperInstances[i];
+        if (instance->state == WRAPPER_INSTANCE_STATE_UP) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Stopping instance %d..."), instance->id);
+            kill(instance->pid, SIGTERM);
+            instance->state = WRAPPER_INSTANCE_STATE_STOPPING;
+            instance->stateTicks = wrapperAddToTicks(nowTicks, instance->exitTimeout);
+        } else if (instance->state == WRAPPER_INSTANCE_STATE_DOWN) {
+            instance->state = WRAPPER_INSTANCE_STATE_STOPPED;
+        }
+    }
+}
+
+int wrapperInstancesDown() {
+    int i;
+
+    for (i = 0; i < wrapperInstanceCount; i++) {
+        if (wrapperInstances[i].pid != 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void wrapperInstancesDispose() {
+    PWrapperInstance instance;
+    int i;
+
+    for (i = 0; i < wrapperInstanceCount; i++) {
+        instance = &wrapperInstances[i];
+        if (instance->pid != 0) {
+            /* Only left when the Wrapper is exiting without stopping the instances first. */
+            kill(instance->pid, SIGKILL);
+            waitpid(instance->pid, NULL, 0);
+            instance->pid = 0;
+        }
+        if (instance->outputFd != -1) {
+            close(instance->outputFd);
+            instance->outputFd = -1;
+        }
+        instanceFreeArgv(instance);
+    }
+    free(wrapperInstances);
+    wrapperInstances = NULL;
+    wrapperInstanceCount = 0;
+    instancesStopping = FALSE;
+}
+#endif
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Supervises additional JVM instances, defined by the
+ *  wrapper.instance.<n>.* properties, alongside the JVM of the Wrapper.
+ *
+ * The instances are serviced by the event loop of the Wrapper and their
+ *  output is logged through its logger, so they do not cost any thread,
+ *  timer or log file of their own.  Each instance has its own small state
+ *  machine: it is launched, relaunched after a delay when it exits, given
+ *  up on after too many failed invocations in a row, and stopped with the
+ *  Wrapper.
+ *
+ * The backend protocol is bound to the JVM of the Wrapper, so an instance
+ *  has no backend and is not pinged.  It is a plain process whose exit is
+ *  the only thing watched.
+ *
+ * This is only implemented on UNIX platforms.
+ */
+
+#ifndef WIN32
+#ifndef _WRAPPER_INSTANCE_H
+#define _WRAPPER_INSTANCE_H
+
+#include <sys/types.h>
+#include "property.h"
+#include "wrapper.h"
+
+/* Largest number of instances, so that their output descriptors fit in the poll set of the event loop. */
+#define WRAPPER_INSTANCE_MAX            64
+
+/* Longest line of output, longer lines are logged in several parts. */
+#define WRAPPER_INSTANCE_LINE_MAX       4096
+
+#define WRAPPER_INSTANCE_STATE_DOWN     0   /* Not running, launched once stateTicks expires. */
+#define WRAPPER_INSTANCE_STATE_UP       1   /* Running. */
+#define WRAPPER_INSTANCE_STATE_STOPPING 2   /* Asked to exit with SIGTERM, killed once stateTicks expires. */
+#define WRAPPER_INSTANCE_STATE_KILLING  3   /* Killed with SIGKILL, waiting for the process to go away. */
+#define WRAPPER_INSTANCE_STATE_STOPPED  4   /* Will not be launched again. */
+
+typedef struct WrapperInstance WrapperInstance, *PWrapperInstance;
+struct WrapperInstance {
+    int     id;                         /* The <n> of the wrapper.instance.<n>.* properties. */
+    char  **argv;                       /* NULL terminated command line of the JVM, in the encoding of the current locale. */
+    int     restartDelay;               /* Delay in seconds before relaunching the JVM after it exited. */
+    int     successfulInvocationTime;   /* Number of seconds the JVM must run for its invocation to be considered a success. */
+    int     maxFailedInvocations;       /* Number of failed invocations in a row after which the instance is given up on. */
+    int     exitTimeout;                /* Number of seconds the JVM is given to exit on SIGTERM before it is killed. */
+
+    int     state;                      /* One of the WRAPPER_INSTANCE_STATE_* constants. */
+    TICKS   stateTicks;                 /* Tick at which the DOWN or STOPPING state times out. */
+    TICKS   launchTicks;                /* Tick at which the JVM was launched. */
+    pid_t   pid;                        /* PID of the JVM, 0 when it is not running. */
+    int     invocations;                /* Number of times the JVM was launched. */
+    int     failedInvocations;          /* Number of invocations in a row which ran for less than successfulInvocationTime. */
+
+    int     outputFd;                   /* Read end of the pipe of the stdout and stderr of the JVM, -1 when closed. */
+    char    outputBuffer[WRAPPER_INSTANCE_LINE_MAX]; /* Output read since the last line feed. */
+    size_t  outputLen;                  /* Number of bytes in outputBuffer. */
+};
+
+/* Instances loaded by wrapperInstancesLoad(), ordered by their number. */
+extern WrapperInstance *wrapperInstances;
+extern int wrapperInstanceCount;
+
+/**
+ * Loads the wrapper.instance.<n>.* properties.  An instance is defined by
+ *  its wrapper.instance.<n>.java.mainclass property.  The settings which are
+ *  not set for an instance default to the ones of the JVM of the Wrapper.
+ *
+ * An instance whose configuration is invalid is logged and skipped.
+ *
+ * @param properties The properties to load the instances from.
+ *
+ * @return TRUE if there were any problems, FALSE if successful.
+ */
+extern int wrapperInstancesLoad(Properties *properties);
+
+/**
+ * Services the instances on each cycle of the event loop: logs their output,
+ *  launches them when it is time to, notices when they exit, and kills them
+ *  if they do not stop in time.
+ *
+ * @param nowTicks The tick counter value this time through the event loop.
+ *
+ * @return TRUE if some output was left to read, so that the event loop
+ *         should not sleep on its next cycle.
+ */
+extern int wrapperInstancesPoll(TICKS nowTicks);
+
+/**
+ * Asks all running instances to exit with SIGTERM, and makes sure that none
+ *  will be launched again.  Calling it again has no effect.
+ *
+ * @param nowTicks The current tick.
+ */
+extern void wrapperInstancesStop(TICKS nowTicks);
+
+/**
+ * @return TRUE if none of the instances has a process left.
+ */
+extern int wrapperInstancesDown();
+
+/**
+ * Kills any instance still running, and frees the instances.
+ */
+extern void wrapperInstancesDispose();
+
+#endif
+#endif
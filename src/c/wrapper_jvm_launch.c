@@ -32,9 +32,329 @@
  *   Tanuki Software Development Team <support@tanukisoftware.com>
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "logger.h"
 #include "wrapper.h"
+#include "wrapperinfo.h"
 #include "wrapper_jvm_launch.h"
+#include "wrapper_file.h"
+#include "wrapper_zip.h"
+#include "wrapper_profile.h"
+
+/**
+ * Converts a string read from a jar manifest or a Java 'release' file.  Only
+ *  ASCII is accepted so that no assumption has to be made on the encoding of
+ *  file names.
+ *
+ * @return The converted string, which must be freed, or NULL if it is not
+ *         ASCII or if out of memory.
+ */
+static TCHAR *asciiToTChar(const char *value, size_t len) {
+    TCHAR *result;
+    size_t i;
+
+    result = malloc(sizeof(TCHAR) * (len + 1));
+    if (!result) {
+        outOfMemory(TEXT("ATT"), 1);
+        return NULL;
+    }
+    for (i = 0; i < len; i++) {
+        if ((unsigned char)value[i] > 0x7f) {
+            free(result);
+            return NULL;
+        }
+        result[i] = (TCHAR)value[i];
+    }
+    result[len] = TEXT('\0');
+    return result;
+}
+
+/* Largest 'release' file read. */
+#define JAVA_RELEASE_MAX_SIZE   65536
+
+/* Duration of the last Java query (version, bootstrap or dry run) in microseconds, or 0 if none was launched yet.
+ *  This is about what it costs to launch 'java -version'. */
+static unsigned int javaQueryMicros = 0;
+
+/**
+ * Gets the path of the java binary from the command used to query its version.
+ *
+ * @return The path, which must be freed, or NULL if out of memory.
+ */
+static TCHAR *javaReleaseGetJavaPath() {
+    TCHAR *path;
+#ifdef WIN32
+    const TCHAR *start = wrapperData->jvmVersionCommand;
+    const TCHAR *end;
+
+    if (start[0] == TEXT('"')) {
+        start++;
+        end = _tcschr(start, TEXT('"'));
+    } else {
+        end = _tcschr(start, TEXT(' '));
+    }
+    if (!end) {
+        end = start + _tcslen(start);
+    }
+    path = malloc(sizeof(TCHAR) * (end - start + 1));
+    if (!path) {
+        outOfMemory(TEXT("JRGJP"), 1);
+        return NULL;
+    }
+    _tcsncpy(path, start, end - start);
+    path[end - start] = TEXT('\0');
+#else
+    /* The path has already been resolved to the real path of the binary. */
+    path = malloc(sizeof(TCHAR) * (_tcslen(wrapperData->jvmVersionCommand[0]) + 1));
+    if (!path) {
+        outOfMemory(TEXT("JRGJP"), 1);
+        return NULL;
+    }
+    _tcsncpy(path, wrapperData->jvmVersionCommand[0], _tcslen(wrapperData->jvmVersionCommand[0]) + 1);
+#endif
+    return path;
+}
+
+/**
+ * Removes the last component of a path in place.
+ *
+ * @return A pointer to the removed component, or NULL if there is none.
+ */
+static TCHAR *javaReleaseCutPath(TCHAR *path) {
+    TCHAR *sep1 = _tcsrchr(path, TEXT('/'));
+#ifdef WIN32
+    TCHAR *sep2 = _tcsrchr(path, TEXT('\\'));
+
+    if (sep2 > sep1) {
+        sep1 = sep2;
+    }
+#endif
+    if (!sep1) {
+        return NULL;
+    }
+    *sep1 = TEXT('\0');
+    return sep1 + 1;
+}
+
+/**
+ * Reads the 'release' file in a directory.
+ *
+ * @return The content of the file, which must be freed, or NULL if it could
+ *         not be read.
+ */
+static char *javaReleaseRead(const TCHAR *home) {
+    TCHAR *path;
+    FILE *file;
+    char *content;
+    size_t len;
+
+    path = malloc(sizeof(TCHAR) * (_tcslen(home) + 9 + 1));
+    if (!path) {
+        outOfMemory(TEXT("JRR"), 1);
+        return NULL;
+    }
+    _sntprintf(path, _tcslen(home) + 9 + 1, TEXT("%s/release"), home);
+    file = _tfopen(path, TEXT("rb"));
+    free(path);
+    if (!file) {
+        return NULL;
+    }
+    content = malloc(JAVA_RELEASE_MAX_SIZE + 1);
+    if (!content) {
+        outOfMemory(TEXT("JRR"), 2);
+        fclose(file);
+        return NULL;
+    }
+    len = fread(content, 1, JAVA_RELEASE_MAX_SIZE, file);
+    fclose(file);
+    content[len] = '\0';
+    return content;
+}
+
+/**
+ * Gets a value from a 'release' file.  Its lines have the form: NAME="value"
+ *
+ * @return The value without the quotes, which must be freed, or NULL if it
+ *         is not set or not ASCII.
+ */
+static TCHAR *javaReleaseGetValue(const char *release, const char *name) {
+    size_t nameLen = strlen(name);
+    const char *line;
+    const char *value;
+    const char *end;
+
+    for (line = release; *line; line = end + strspn(end, "\r\n")) {
+        end = line + strcspn(line, "\r\n");
+        if ((strncmp(line, name, nameLen) == 0) && (line[nameLen] == '=')) {
+            value = line + nameLen + 1;
+            if ((end - value >= 2) && (value[0] == '"') && (end[-1] == '"')) {
+                return asciiToTChar(value + 1, end - value - 2);
+            }
+            return asciiToTChar(value, end - value);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Reads the bits of the JVM library from its ELF header.
+ *
+ * @return JVM_BITS_32, JVM_BITS_64, or JVM_BITS_UNKNOWN if the library
+ *         was not found or is not an ELF file.
+ */
+static int javaReleaseGetLibJvmBits(const TCHAR *home, const TCHAR *osArch) {
+    static const TCHAR *locations[] = { TEXT("%s/lib/server/libjvm.so"), TEXT("%s/lib/client/libjvm.so"), TEXT("%s/lib/%s/server/libjvm.so"), TEXT("%s/jre/lib/%s/server/libjvm.so"), NULL };
+    TCHAR *path;
+    size_t len;
+    FILE *file;
+    unsigned char ident[5];
+    int bits = JVM_BITS_UNKNOWN;
+    int i;
+
+    len = _tcslen(home) + _tcslen(osArch) + 32;
+    path = malloc(sizeof(TCHAR) * len);
+    if (!path) {
+        outOfMemory(TEXT("JRGLJB"), 1);
+        return JVM_BITS_UNKNOWN;
+    }
+    for (i = 0; locations[i] && (bits == JVM_BITS_UNKNOWN); i++) {
+        _sntprintf(path, len, locations[i], home, osArch);
+        file = _tfopen(path, TEXT("rb"));
+        if (file) {
+            /* e_ident: the magic number, followed by EI_CLASS which is ELFCLASS32 (1) or ELFCLASS64 (2). */
+            if ((fread(ident, 1, 5, file) == 5) && (memcmp(ident, "\177ELF", 4) == 0)) {
+                if (ident[4] == 1) {
+                    bits = JVM_BITS_32;
+                } else if (ident[4] == 2) {
+                    bits = JVM_BITS_64;
+                }
+            }
+            fclose(file);
+        }
+    }
+    free(path);
+    return bits;
+}
+
+/**
+ * Resolve the version, maker and bits of the JVM from the 'release' file of
+ *  the Java installation, instead of launching 'java -version'.
+ *
+ * Nothing is set unless the file gives all of them, and they are consistent
+ *  with the JVM library.  'java -version' should then be launched.
+ *
+ * @return TRUE if the Java version was resolved.
+ */
+int wrapperResolveJavaVersionFromRelease() {
+    unsigned int startMicros = wrapperGetMicros();
+    TCHAR *home;
+    TCHAR *dir;
+    char *release = NULL;
+    TCHAR *value;
+    TCHAR *quoted = NULL;
+    TCHAR *osArch = NULL;
+    TCHAR *implementor = NULL;
+    TCHAR *buildType = NULL;
+    TCHAR *jvmVariant = NULL;
+    JavaVersion *javaVersion = NULL;
+    int jvmVendor;
+    int jvmBits;
+    int libJvmBits;
+    int ok = FALSE;
+
+    home = javaReleaseGetJavaPath();
+    if (!home) {
+        return FALSE;
+    }
+    /* The binary is in <home>/bin, or <home>/jre/bin up to Java 8. */
+    javaReleaseCutPath(home);
+    dir = javaReleaseCutPath(home);
+    if (dir && (strcmpIgnoreCase(dir, TEXT("bin")) == 0)) {
+        release = javaReleaseRead(home);
+        if (!release) {
+            dir = javaReleaseCutPath(home);
+            if (dir && (strcmpIgnoreCase(dir, TEXT("jre")) == 0)) {
+                release = javaReleaseRead(home);
+            }
+        }
+    }
+    if (!release) {
+        free(home);
+        return FALSE;
+    }
+
+    value = javaReleaseGetValue(release, "JAVA_VERSION");
+    osArch = javaReleaseGetValue(release, "OS_ARCH");
+    implementor = javaReleaseGetValue(release, "IMPLEMENTOR");
+    buildType = javaReleaseGetValue(release, "BUILD_TYPE");
+    jvmVariant = javaReleaseGetValue(release, "JVM_VARIANT");
+    if (value) {
+        /* Reuse the parser of the 'java -version' output, which expects the version in quotes. */
+        quoted = malloc(sizeof(TCHAR) * (_tcslen(value) + 2 + 1));
+        if (quoted) {
+            _sntprintf(quoted, _tcslen(value) + 2 + 1, TEXT("\"%s\""), value);
+            javaVersion = parseOutputJavaVersion(quoted);
+        } else {
+            outOfMemory(TEXT("WRJVFR"), 1);
+        }
+    }
+    jvmVendor = parseReleaseJvmVendor(implementor, buildType, jvmVariant);
+    jvmBits = parseReleaseJvmBits(osArch);
+
+    if (javaVersion && (jvmVendor != JVM_VENDOR_UNKNOWN) && (jvmBits != JVM_BITS_UNKNOWN)) {
+#if defined(HPUX) || defined(MACOSX) || defined(SOLARIS) || defined(FREEBSD)
+        /* Before Java 9, the JVM can run both in 32-bit and 64-bit on these systems.  See parseOutputJvmBits(). */
+        ok = (javaVersion->major >= 9);
+#else
+        ok = TRUE;
+#endif
+        libJvmBits = javaReleaseGetLibJvmBits(home, osArch);
+#if defined(LINUX) || defined(FREEBSD) || defined(SOLARIS)
+        /* The JVM library of these systems is always an ELF file, so not finding it means the layout is not the expected one. */
+        if (libJvmBits != jvmBits) {
+            ok = FALSE;
+        }
+#else
+        if ((libJvmBits != JVM_BITS_UNKNOWN) && (libJvmBits != jvmBits)) {
+            ok = FALSE;
+        }
+#endif
+    }
+
+    if (ok) {
+        wrapperData->jvmVendor = jvmVendor;
+        wrapperData->jvmBits = jvmBits;
+        wrapperSetJavaVersion(javaVersion);
+        javaVersion = NULL;
+        log_printf_queue(TRUE, WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Java vendor: %s"), getJvmVendorName(wrapperData->jvmVendor));
+        log_printf_queue(TRUE, WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Java bits: %s"), getJvmBitsName(wrapperData->jvmBits));
+        maintainLogger();
+        if (javaQueryMicros > 0) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->javaQueryLogLevel, TEXT("Resolved the Java version from %s/release in %u us, saving about %u ms (duration of the last Java query)."),
+                home, wrapperGetMicros() - startMicros, javaQueryMicros / 1000);
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->javaQueryLogLevel, TEXT("Resolved the Java version from %s/release in %u us without launching the Java version query."),
+                home, wrapperGetMicros() - startMicros);
+        }
+    } else if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("The Java version could not be resolved from %s/release.  Launching the Java version query."), home);
+    }
+
+    if (javaVersion) {
+        disposeJavaVersion(javaVersion);
+    }
+    free(quoted);
+    free(value);
+    free(osArch);
+    free(implementor);
+    free(buildType);
+    free(jvmVariant);
+    free(release);
+    free(home);
+    return ok;
+}
 
 /**
  * Create a child process to print the Java version running the command:
@@ -55,6 +375,7 @@ int wrapperLaunchJavaVersion(QueryCallback callback, TICKS nowTicks) {
     const TCHAR* desc = TEXT("Java Version");
     int exitCode = 0;
     int result;
+    unsigned int startMicros;
 
     if (wrapperData->printJVMVersion) {
         wrapperData->jvmDefaultLogLevel = __max(wrapperData->javaQueryLogLevel, LEVEL_INFO);
@@ -71,7 +392,13 @@ int wrapperLaunchJavaVersion(QueryCallback callback, TICKS nowTicks) {
     printJavaCommand(wrapperData->jvmVersionCommand, wrapperData->javaQueryLogLevel, FALSE);
 
     /* If the user sets the value to 0, then we will wait indefinitely. */
+    wrapperProfileBegin(TEXT("helper JVM (version)"));
+    startMicros = wrapperGetMicros();
     result = wrapperQueryJava(wrapperData->jvmVersionCommand, desc, TRUE, wrapperData->javaVersionTimeout, TRUE, &exitCode);
+    if (result == JAVA_PROC_COMPLETED) {
+        javaQueryMicros = wrapperGetMicros() - startMicros;
+    }
+    wrapperProfileEnd(TEXT("helper JVM (version)"));
 
     switch (result) {
     case JAVA_PROC_COMPLETED:
@@ -125,6 +452,7 @@ int wrapperLaunchBootstrap(QueryCallback callback, TICKS nowTicks) {
     const TCHAR* desc = TEXT("Bootstrap");
     int exitCode = 0;
     int result;
+    unsigned int startMicros;
 
     wrapperData->jvmDefaultLogLevel = wrapperData->javaQueryLogLevel;
     wrapperData->jvmCallType = WRAPPER_JVM_BOOTSTRAP;
@@ -136,7 +464,13 @@ int wrapperLaunchBootstrap(QueryCallback callback, TICKS nowTicks) {
     log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->javaQueryLogLevel, TEXT("Java Command Line (%s):"), desc);
     printJavaCommand(wrapperData->jvmBootstrapCommand, wrapperData->javaQueryLogLevel, FALSE);
 
+    wrapperProfileBegin(TEXT("helper JVM (bootstrap)"));
+    startMicros = wrapperGetMicros();
     result = wrapperQueryJava(wrapperData->jvmBootstrapCommand, desc, TRUE, wrapperData->javaQueryTimeout, FALSE, &exitCode);
+    if (result == JAVA_PROC_COMPLETED) {
+        javaQueryMicros = wrapperGetMicros() - startMicros;
+    }
+    wrapperProfileEnd(TEXT("helper JVM (bootstrap)"));
 
     wrapperData->javaQueryPID = 0;
 
@@ -168,6 +502,293 @@ int wrapperLaunchBootstrap(QueryCallback callback, TICKS nowTicks) {
     return callback ? callback(nowTicks, result, desc) : 0;
 }
 
+/* Largest manifest read when resolving the bootstrap natively. */
+#define BOOTSTRAP_MAX_MANIFEST_SIZE     (1024 * 1024)
+/* How deep Class-Path attributes of jars referenced by other Class-Path attributes are followed. */
+#define BOOTSTRAP_MAX_CLASSPATH_DEPTH   4
+
+/**
+ * Gets the name of the entry of a class, for example "org/example/Main.class"
+ *  for "org.example.Main".
+ *
+ * @return The name, which must be freed, or NULL if the class name is not
+ *         ASCII or if out of memory.
+ */
+static char *bootstrapClassEntryName(const TCHAR *className) {
+    size_t len = _tcslen(className);
+    char *entry;
+    size_t i;
+
+    entry = malloc(len + 6 + 1);
+    if (!entry) {
+        outOfMemory(TEXT("BCEN"), 1);
+        return NULL;
+    }
+    for (i = 0; i < len; i++) {
+        if ((className[i] > 0x7f) || (className[i] == TEXT('/'))) {
+            free(entry);
+            return NULL;
+        }
+        entry[i] = (className[i] == TEXT('.')) ? '/' : (char)className[i];
+    }
+    strcpy(entry + len, ".class");
+    return entry;
+}
+
+/**
+ * Reads the main section attribute of the manifest of an open jar file.
+ *
+ * @return The value, which must be freed, or NULL if the jar has no manifest
+ *         or the attribute is not set.
+ */
+static char *bootstrapGetManifestAttribute(PWrapperZip zip, const char *name) {
+    char *manifest;
+    char *value;
+
+    manifest = wrapperZipReadEntry(zip, "META-INF/MANIFEST.MF", BOOTSTRAP_MAX_MANIFEST_SIZE, NULL);
+    if (!manifest) {
+        return NULL;
+    }
+    value = wrapperManifestGetAttribute(manifest, name);
+    free(manifest);
+    return value;
+}
+
+static int bootstrapFindClassInJar(const TCHAR *jarPath, const char *entry, int depth);
+
+/**
+ * Looks for a class in the Class-Path of the manifest of a jar.  Its entries
+ *  are space separated URLs relative to the directory of the jar.  Entries
+ *  with a scheme or which are not ASCII are skipped.
+ *
+ * @return TRUE if the class was found.
+ */
+static int bootstrapFindClassInManifestClassPath(PWrapperZip zip, const TCHAR *jarPath, const char *entry, int depth) {
+    char *classPath;
+    char *token;
+    char *next;
+    char *p;
+    char *q;
+    TCHAR *relPath;
+    TCHAR *path;
+    size_t dirLen;
+    size_t len;
+    int found = FALSE;
+    unsigned int hex;
+
+    classPath = bootstrapGetManifestAttribute(zip, "Class-Path");
+    if (!classPath) {
+        return FALSE;
+    }
+
+    for (dirLen = _tcslen(jarPath); dirLen > 0; dirLen--) {
+        if ((jarPath[dirLen - 1] == TEXT('/')) || (jarPath[dirLen - 1] == TEXT('\\'))) {
+            break;
+        }
+    }
+
+    /* Note: strtok() can't be used as this is called recursively. */
+    for (token = classPath; *token && !found; token = next) {
+        for (next = token; *next && (*next != ' '); next++) {
+        }
+        if (*next) {
+            *next++ = '\0';
+        }
+        if ((*token == '\0') || strchr(token, ':')) {
+            continue;
+        }
+        /* Decode %XX escapes in place. */
+        for (p = q = token; *p; q++) {
+            if ((p[0] == '%') && p[1] && p[2] && (sscanf(p + 1, "%2x", &hex) == 1)) {
+                *q = (char)hex;
+                p += 3;
+            } else {
+                *q = *p++;
+            }
+        }
+        *q = '\0';
+
+        relPath = asciiToTChar(token, strlen(token));
+        if (!relPath) {
+            continue;
+        }
+        len = dirLen + _tcslen(relPath) + strlen(entry);
+        path = malloc(sizeof(TCHAR) * (len + 1));
+        if (!path) {
+            outOfMemory(TEXT("BFCMC"), 1);
+            free(relPath);
+            break;
+        }
+        _tcsncpy(path, jarPath, dirLen);
+        _tcsncpy(path + dirLen, relPath, len + 1 - dirLen);
+        if ((token[0] != '\0') && (token[strlen(token) - 1] == '/')) {
+            /* A directory. */
+            len = _tcslen(path);
+            for (p = (char *)entry; *p; p++) {
+                path[len++] = (TCHAR)*p;
+            }
+            path[len] = TEXT('\0');
+            found = wrapperFileExists(path);
+        } else {
+            found = bootstrapFindClassInJar(path, entry, depth + 1);
+        }
+        free(path);
+        free(relPath);
+    }
+    free(classPath);
+    return found;
+}
+
+/**
+ * Looks for a class in a jar and in the jars of its Class-Path.
+ *
+ * @return TRUE if the class was found.
+ */
+static int bootstrapFindClassInJar(const TCHAR *jarPath, const char *entry, int depth) {
+    WrapperZip zip;
+    int found;
+
+    if (wrapperZipOpen(&zip, jarPath)) {
+        return FALSE;
+    }
+    found = wrapperZipHasEntry(&zip, entry);
+    if (!found && (depth < BOOTSTRAP_MAX_CLASSPATH_DEPTH)) {
+        found = bootstrapFindClassInManifestClassPath(&zip, jarPath, entry, depth);
+    }
+    wrapperZipClose(&zip);
+    return found;
+}
+
+/**
+ * Looks for a class in a classpath.
+ *
+ * @return TRUE if the class was found.
+ */
+static int bootstrapFindClassInClasspath(const TCHAR *classpath, const char *entry) {
+    const TCHAR *start;
+    const TCHAR *end;
+    TCHAR *path;
+    size_t len;
+    size_t entryLen = strlen(entry);
+    size_t i;
+    int found = FALSE;
+
+    for (start = classpath; start && !found; start = end ? end + 1 : NULL) {
+        end = _tcschr(start, wrapperClasspathSeparator);
+        len = end ? (size_t)(end - start) : _tcslen(start);
+        if (len == 0) {
+            continue;
+        }
+        path = malloc(sizeof(TCHAR) * (len + 1 + entryLen + 1));
+        if (!path) {
+            outOfMemory(TEXT("BFCC"), 1);
+            break;
+        }
+        _tcsncpy(path, start, len);
+        path[len] = TEXT('\0');
+        /* An entry which is not a readable jar file is taken as a directory. */
+        found = bootstrapFindClassInJar(path, entry, 0);
+        if (!found) {
+            path[len++] = TEXT('/');
+            for (i = 0; i <= entryLen; i++) {
+                path[len + i] = (TCHAR)entry[i];
+            }
+            found = wrapperFileExists(path);
+        }
+        free(path);
+    }
+    return found;
+}
+
+/**
+ * Checks that the Wrapper jar file has the same version as this Wrapper.
+ *
+ * @return TRUE if it does.
+ */
+static int bootstrapCheckWrapperJar() {
+    WrapperZip zip;
+    char *version;
+    TCHAR *versionT = NULL;
+    int ok = FALSE;
+
+    if (wrapperZipOpen(&zip, wrapperData->wrapperJar)) {
+        return FALSE;
+    }
+    version = bootstrapGetManifestAttribute(&zip, "Implementation-Version");
+    if (version) {
+        versionT = asciiToTChar(version, strlen(version));
+        ok = versionT && (_tcscmp(versionT, wrapperVersionRoot) == 0);
+        free(versionT);
+        free(version);
+    }
+    wrapperZipClose(&zip);
+    return ok;
+}
+
+/**
+ * Resolves the main class of the application without launching a JVM, by
+ *  reading the jar files directly.  This only answers the questions the
+ *  WrapperBootstrap class would for an application in the unnamed module.
+ *
+ * Nothing is reported if this fails: the Java bootstrap should then be
+ *  launched, and will report the problem if there is one.
+ *
+ * @return TRUE if the main class was resolved.
+ */
+int wrapperResolveBootstrap() {
+    unsigned int startMicros = wrapperGetMicros();
+    WrapperZip zip;
+    char *mainClass = NULL;
+    char *entry = NULL;
+    TCHAR *mainClassT = NULL;
+    int found = FALSE;
+
+    if (!wrapperData->wrapperJar || !bootstrapCheckWrapperJar()) {
+        return FALSE;
+    }
+
+    switch (wrapperData->jvmBootstrapMode) {
+    case BOOTSTRAP_ENTRYPOINT_MAINCLASS:
+        entry = bootstrapClassEntryName(wrapperData->mainUsrClass);
+        found = entry && bootstrapFindClassInClasspath(wrapperData->classpath, entry);
+        break;
+
+    case BOOTSTRAP_ENTRYPOINT_JAR:
+        if (wrapperZipOpen(&zip, wrapperData->mainJar)) {
+            break;
+        }
+        mainClass = bootstrapGetManifestAttribute(&zip, "Main-Class");
+        if (mainClass) {
+            mainClassT = asciiToTChar(mainClass, strlen(mainClass));
+            entry = mainClassT ? bootstrapClassEntryName(mainClassT) : NULL;
+            if (entry) {
+                found = wrapperZipHasEntry(&zip, entry) ||
+                        bootstrapFindClassInManifestClassPath(&zip, wrapperData->mainJar, entry, 0) ||
+                        bootstrapFindClassInClasspath(wrapperData->classpath, entry);
+            }
+        }
+        wrapperZipClose(&zip);
+        if (found) {
+            updateStringValue(&wrapperData->mainUsrClass, mainClassT);
+            found = (wrapperData->mainUsrClass != NULL);
+        }
+        free(mainClassT);
+        free(mainClass);
+        break;
+    }
+    free(entry);
+
+    if (found) {
+        wrapperData->jvmBootstrapVersionOk = TRUE;
+        wrapperData->jvmBootstrapFailed = FALSE;
+        /* The main class was found in the classpath, so it belongs to the unnamed module. */
+        wrapperData->jvmAddOpens = FALSE;
+        log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->javaQueryLogLevel, TEXT("Resolved main class '%s' without the Java bootstrap in %u us."),
+            wrapperData->mainUsrClass, wrapperGetMicros() - startMicros);
+    }
+    return found;
+}
+
 /**
  * Launch the Java command with '--dry-run' to check if it is valid.
  *
@@ -180,6 +801,7 @@ int wrapperLaunchDryJavaApp(QueryCallback callback, TICKS nowTicks) {
     const TCHAR* desc = TEXT("Dry Run");
     int exitCode = 0;
     int result;
+    unsigned int startMicros;
 #ifdef WIN32
     JAVA_COMMAND_TYPE dryCmd = wrapperData->jvmDryCommandPrint;
     JAVA_COMMAND_TYPE cmd = wrapperData->jvmCommandPrint;
@@ -196,7 +818,13 @@ int wrapperLaunchDryJavaApp(QueryCallback callback, TICKS nowTicks) {
     log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->javaQueryLogLevel, TEXT("Java Command Line (%s):"), desc);
     printJavaCommand(dryCmd, wrapperData->javaQueryLogLevel, FALSE);
 
+    wrapperProfileBegin(TEXT("helper JVM (dry run)"));
+    startMicros = wrapperGetMicros();
     result = wrapperQueryJava(wrapperData->jvmDryCommand, desc, FALSE, wrapperData->javaQueryTimeout, FALSE, &exitCode);
+    if (result == JAVA_PROC_COMPLETED) {
+        javaQueryMicros = wrapperGetMicros() - startMicros;
+    }
+    wrapperProfileEnd(TEXT("helper JVM (dry run)"));
 
     wrapperData->javaQueryPID = 0;
 
@@ -68,6 +68,15 @@ typedef int (*QueryCallback)(TICKS nowTicks, int queryResult, const TCHAR* query
  */
 int wrapperLaunchJavaVersion(QueryCallback callback, TICKS nowTicks);
 
+/**
+ * Resolve the version, maker and bits of the JVM from the 'release' file of
+ *  the Java installation, instead of launching 'java -version'.
+ *
+ * @return TRUE if the Java version was resolved, FALSE if 'java -version'
+ *         should be launched.
+ */
+int wrapperResolveJavaVersionFromRelease();
+
 /**
  * Create a child process to find the jar file containing the main class.
  *
@@ -78,6 +87,15 @@ int wrapperLaunchJavaVersion(QueryCallback callback, TICKS nowTicks);
  */
 int wrapperLaunchBootstrap(QueryCallback callback, TICKS nowTicks);
 
+/**
+ * Resolve the main class of the application by reading the jar files
+ *  directly, instead of launching the Java bootstrap.
+ *
+ * @return TRUE if the main class was resolved, FALSE if the Java bootstrap
+ *         should be launched.
+ */
+int wrapperResolveBootstrap();
+
 /**
  * Launch the Java command with '--dry-run' to check if it is valid.
  *
@@ -520,3 +520,63 @@ const TCHAR* getJvmBitsName(int jvmBits) {
     }
     return name;
 }
+
+/**
+ * Get the maker (implementation) of the JVM from the values of the 'release'
+ *  file of a Java installation.
+ *
+ * @param implementor the value of IMPLEMENTOR.
+ * @param buildType   the value of BUILD_TYPE, or NULL if not set.
+ * @param jvmVariant  the value of JVM_VARIANT, or NULL if not set.
+ *
+ * @return an integer representing the JVM implementation, or
+ *         JVM_VENDOR_UNKNOWN if implementor is NULL.
+ */
+int parseReleaseJvmVendor(const TCHAR* implementor, const TCHAR* buildType, const TCHAR* jvmVariant) {
+    if (!implementor) {
+        return JVM_VENDOR_UNKNOWN;
+    }
+    if (_tcsstr(implementor, TEXT("IBM")) || (jvmVariant && (strcmpIgnoreCase(jvmVariant, TEXT("openj9")) == 0))) {
+        return JVM_VENDOR_IBM;
+    }
+    /* Oracle also publishes OpenJDK builds, which are not marked as commercial. */
+    if (_tcsstr(implementor, TEXT("Oracle")) && buildType && (_tcscmp(buildType, TEXT("commercial")) == 0)) {
+        return JVM_VENDOR_ORACLE;
+    }
+    /* Other implementors (Eclipse Adoptium, Azul, Amazon, Red Hat, etc.) all ship builds of OpenJDK. */
+    return JVM_VENDOR_OPENJDK;
+}
+
+/**
+ * Get the bits of the JVM from the value of OS_ARCH in the 'release' file of
+ *  a Java installation.
+ *
+ * @param osArch the value of OS_ARCH.
+ *
+ * @return an integer which indicates the bits of the JVM:
+ *              JVM_BITS_64
+ *              JVM_BITS_32
+ *              JVM_BITS_UNKNOWN
+ */
+int parseReleaseJvmBits(const TCHAR* osArch) {
+    static const TCHAR *arch32[] = { TEXT("x86"), TEXT("i386"), TEXT("i486"), TEXT("i586"), TEXT("i686"), TEXT("arm"), TEXT("aarch32"), TEXT("ppc"), TEXT("s390"), TEXT("sparc"), NULL };
+    size_t len;
+    int i;
+
+    if (!osArch) {
+        return JVM_BITS_UNKNOWN;
+    }
+    len = _tcslen(osArch);
+    if (((len > 2) && (_tcscmp(osArch + len - 2, TEXT("64")) == 0)) ||
+        (_tcscmp(osArch, TEXT("ppc64le")) == 0) ||
+        (_tcscmp(osArch, TEXT("s390x")) == 0) ||
+        (_tcscmp(osArch, TEXT("sparcv9")) == 0)) {
+        return JVM_BITS_64;
+    }
+    for (i = 0; arch32[i]; i++) {
+        if (_tcscmp(osArch, arch32[i]) == 0) {
+            return JVM_BITS_32;
+        }
+    }
+    return JVM_BITS_UNKNOWN;
+}
@@ -160,4 +160,30 @@ int parseOutputJvmBits(TCHAR* output, JavaVersion *optionalJavaVersion);
  * @return the string representing the bits of the JVM.
  */
 const TCHAR* getJvmBitsName(int jvmBits);
+
+/**
+ * Get the maker (implementation) of the JVM from the values of the 'release'
+ *  file of a Java installation.
+ *
+ * @param implementor the value of IMPLEMENTOR.
+ * @param buildType   the value of BUILD_TYPE, or NULL if not set.
+ * @param jvmVariant  the value of JVM_VARIANT, or NULL if not set.
+ *
+ * @return an integer representing the JVM implementation, or
+ *         JVM_VENDOR_UNKNOWN if implementor is NULL.
+ */
+int parseReleaseJvmVendor(const TCHAR* implementor, const TCHAR* buildType, const TCHAR* jvmVariant);
+
+/**
+ * Get the bits of the JVM from the value of OS_ARCH in the 'release' file of
+ *  a Java installation.
+ *
+ * @param osArch the value of OS_ARCH.
+ *
+ * @return an integer which indicates the bits of the JVM:
+ *              JVM_BITS_64
+ *              JVM_BITS_32
+ *              JVM_BITS_UNKNOWN
+ */
+int parseReleaseJvmBits(const TCHAR* osArch);
 #endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#include <string.h>
+#include "wrapper_metrics.h"
+
+/* Room for one more slot than needed so that the first one can start on a cache line. */
+static char wrapperMetricsSlotBuffer[sizeof(WrapperMetricsSlot) * (WRAPPER_THREAD_COUNT + 1)];
+
+int wrapperMetricsEnabled = FALSE;
+
+PWrapperMetricsSlot wrapperMetricsSlots = (PWrapperMetricsSlot)wrapperMetricsSlotBuffer;
+
+static const char *wrapperMetricNames[WRAPPER_METRIC_COUNT] = {
+    "wrapper_loop_cycles_total",
+    "wrapper_backend_packets_read_total",
+    "wrapper_jvm_output_lines_total",
+    "wrapper_jvm_output_bytes_total",
+    "wrapper_filter_hits_total",
+    "wrapper_log_messages_total",
+    "wrapper_log_queue_dropped_total",
+    "wrapper_log_rolls_total",
+    "wrapper_jvm_output_records_total",
+    "wrapper_jvm_output_repeats_total",
+    "wrapper_jvm_output_rate_limited_total"
+};
+
+static const char *wrapperMetricHelps[WRAPPER_METRIC_COUNT] = {
+    "Number of cycles of the main event loop.",
+    "Number of packets read from the JVM on the backend.",
+    "Number of lines of output read from the JVM.",
+    "Number of bytes of output read from the JVM.",
+    "Number of lines of output which matched a filter.",
+    "Number of messages logged by the Wrapper, including the output of the JVM.",
+    "Number of messages dropped because the log queue of a thread was full.",
+    "Number of times the log file was rolled.",
+    "Number of multi-line records the output of the JVM was aggregated into.",
+    "Number of repeated lines of output from the JVM which were collapsed.",
+    "Number of lines of output from the JVM which exceeded the rate limit."
+};
+
+void wrapperMetricsSetEnabled(int enabled) {
+    size_t offset;
+
+    offset = (size_t)wrapperMetricsSlotBuffer % WRAPPER_METRICS_CACHE_LINE;
+    if (offset > 0) {
+        offset = WRAPPER_METRICS_CACHE_LINE - offset;
+    }
+    wrapperMetricsEnabled = FALSE;
+    wrapperMetricsSlots = (PWrapperMetricsSlot)(wrapperMetricsSlotBuffer + offset);
+    memset(wrapperMetricsSlots, 0, sizeof(WrapperMetricsSlot) * WRAPPER_THREAD_COUNT);
+    wrapperMetricsEnabled = enabled;
+}
+
+double wrapperMetricsGet(int metric) {
+    int i;
+    double value = 0;
+
+    for (i = 0; i < WRAPPER_THREAD_COUNT; i++) {
+        value += wrapperMetricsSlots[i].values[metric];
+    }
+    return value;
+}
+
+const char *wrapperMetricsGetName(int metric) {
+    return wrapperMetricNames[metric];
+}
+
+const char *wrapperMetricsGetHelp(int metric) {
+    return wrapperMetricHelps[metric];
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Counters for the metrics endpoint.
+ *
+ * Each thread of the Wrapper has its own slot of counters, aligned on a
+ *  cache line, so the threads which log or read the output of the JVM never
+ *  write to the same line and can update their counters without any lock.
+ *  A counter only has one writer.  A scrape sums the slots of all threads,
+ *  which may miss an update which is in progress, but that is fine for
+ *  values which only grow.
+ *
+ * The counters are doubles as this is what the exposition format uses and
+ *  they will not wrap, even on platforms without a 64-bit integer.
+ */
+
+#ifndef _WRAPPER_METRICS_H
+#define _WRAPPER_METRICS_H
+
+#include "logger.h"
+
+#define WRAPPER_METRIC_LOOP_CYCLES          0
+#define WRAPPER_METRIC_BACKEND_PACKETS      1
+#define WRAPPER_METRIC_JVM_OUTPUT_LINES     2
+#define WRAPPER_METRIC_JVM_OUTPUT_BYTES     3
+#define WRAPPER_METRIC_FILTER_HITS          4
+#define WRAPPER_METRIC_LOG_MESSAGES         5
+#define WRAPPER_METRIC_LOG_QUEUE_DROPPED    6
+#define WRAPPER_METRIC_LOG_ROLLS            7
+#define WRAPPER_METRIC_JVM_OUTPUT_RECORDS   8
+#define WRAPPER_METRIC_JVM_OUTPUT_REPEATS   9
+#define WRAPPER_METRIC_JVM_OUTPUT_DROPPED   10
+#define WRAPPER_METRIC_COUNT                11
+
+#define WRAPPER_METRICS_CACHE_LINE          64
+
+typedef union WrapperMetricsSlot WrapperMetricsSlot, *PWrapperMetricsSlot;
+union WrapperMetricsSlot {
+    double values[WRAPPER_METRIC_COUNT];
+    /* Rounds the size of the slot up to a whole number of cache lines. */
+    char padding[((sizeof(double) * WRAPPER_METRIC_COUNT + WRAPPER_METRICS_CACHE_LINE - 1) / WRAPPER_METRICS_CACHE_LINE) * WRAPPER_METRICS_CACHE_LINE];
+};
+
+/* TRUE when the counters are being updated.  When FALSE, updating a counter costs a single test. */
+extern int wrapperMetricsEnabled;
+
+/* One slot per thread, see WRAPPER_THREAD_*. */
+extern PWrapperMetricsSlot wrapperMetricsSlots;
+
+/**
+ * Adds to a counter of the slot of a thread.  Only use the slot of the calling thread.
+ */
+#define WRAPPER_METRICS_ADD(threadId, metric, n) \
+    do { \
+        if (wrapperMetricsEnabled) { \
+            wrapperMetricsSlots[(threadId)].values[(metric)] += (n); \
+        } \
+    } while (0)
+
+/**
+ * Clears the counters and starts or stops updating them.
+ */
+extern void wrapperMetricsSetEnabled(int enabled);
+
+/**
+ * Returns the value of a counter, summed over all threads.
+ */
+extern double wrapperMetricsGet(int metric);
+
+/**
+ * Returns the name of a counter as it is exposed.
+ */
+extern const char *wrapperMetricsGetName(int metric);
+
+/**
+ * Returns the description of a counter.
+ */
+extern const char *wrapperMetricsGetHelp(int metric);
+
+#endif
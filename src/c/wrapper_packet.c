@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "wrapper_i18n.h"
+#include "wrapper_packet.h"
+
+#define PACKET_STATE_CODE       0
+#define PACKET_STATE_LENGTH     1
+#define PACKET_STATE_PAYLOAD    2
+#define PACKET_STATE_COMPLETE   3
+#define PACKET_STATE_DISCARD    4
+
+/* A varint of more than 5 bytes can not hold a 32-bit length. */
+#define PACKET_MAX_LENGTH_SHIFT 28
+
+void wrapperPacketReaderInit(PWrapperPacketReader reader, size_t maxLength) {
+    memset(reader, 0, sizeof(WrapperPacketReader));
+    reader->maxLength = maxLength;
+}
+
+void wrapperPacketReaderDispose(PWrapperPacketReader reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->bufferSize = 0;
+    wrapperPacketReaderReset(reader);
+}
+
+void wrapperPacketReaderReset(PWrapperPacketReader reader) {
+    reader->state = PACKET_STATE_CODE;
+    reader->code = 0;
+    reader->length = 0;
+    reader->shift = 0;
+    reader->got = 0;
+}
+
+size_t wrapperPacketReaderWanted(PWrapperPacketReader reader) {
+    if ((reader->state == PACKET_STATE_PAYLOAD) || (reader->state == PACKET_STATE_DISCARD)) {
+        return reader->length - reader->got;
+    }
+    /* The code, or the next byte of the length. */
+    return 1;
+}
+
+/**
+ * Makes sure that the buffer can hold the payload and its terminating null.
+ *
+ * @return TRUE if out of memory.
+ */
+static int packetReaderReserve(PWrapperPacketReader reader) {
+    char *newBuffer;
+
+    if (reader->length + 1 > reader->bufferSize) {
+        newBuffer = realloc(reader->buffer, reader->length + 1);
+        if (!newBuffer) {
+            return TRUE;
+        }
+        reader->buffer = newBuffer;
+        reader->bufferSize = reader->length + 1;
+    }
+    return FALSE;
+}
+
+int wrapperPacketReaderFeed(PWrapperPacketReader reader, const char *data, size_t len, size_t *used) {
+    unsigned char c;
+    size_t n;
+    size_t pos = 0;
+    int result = WRAPPER_PACKET_INCOMPLETE;
+
+    if (reader->state == PACKET_STATE_COMPLETE) {
+        /* The previous packet has been handled. */
+        wrapperPacketReaderReset(reader);
+    }
+
+    while ((pos < len) && (result == WRAPPER_PACKET_INCOMPLETE)) {
+        switch (reader->state) {
+        case PACKET_STATE_CODE:
+            reader->code = data[pos++];
+            reader->state = PACKET_STATE_LENGTH;
+            break;
+
+        case PACKET_STATE_LENGTH:
+            c = (unsigned char)data[pos++];
+            if ((reader->shift == PACKET_MAX_LENGTH_SHIFT) && (c & 0xf0)) {
+                /* Either more than 5 bytes, or a value which does not fit in 32 bits. */
+                result = WRAPPER_PACKET_BAD_LENGTH;
+                break;
+            }
+            reader->length |= ((size_t)(c & 0x7f)) << reader->shift;
+            reader->shift += 7;
+            if (c & 0x80) {
+                break;
+            }
+            if (reader->length > reader->maxLength) {
+                if (reader->discardTooLong) {
+                    /* Skip the payload without storing it, so the stream stays in sync. */
+                    reader->state = PACKET_STATE_DISCARD;
+                } else {
+                    result = WRAPPER_PACKET_TOO_LONG;
+                }
+            } else if (packetReaderReserve(reader)) {
+                result = WRAPPER_PACKET_OUT_OF_MEMORY;
+            } else {
+                reader->state = PACKET_STATE_PAYLOAD;
+            }
+            break;
+
+        default:
+            n = reader->length - reader->got;
+            if (n > len - pos) {
+                n = len - pos;
+            }
+            if (reader->state == PACKET_STATE_PAYLOAD) {
+                memcpy(reader->buffer + reader->got, data + pos, n);
+            }
+            reader->got += n;
+            pos += n;
+            break;
+        }
+
+        if ((reader->state == PACKET_STATE_DISCARD) && (reader->got == reader->length)) {
+            reader->state = PACKET_STATE_COMPLETE;
+            result = WRAPPER_PACKET_DISCARDED;
+        }
+
+        if ((reader->state == PACKET_STATE_PAYLOAD) && (reader->got == reader->length)) {
+            reader->buffer[reader->length] = '\0';
+            reader->state = PACKET_STATE_COMPLETE;
+            result = WRAPPER_PACKET_COMPLETE;
+        }
+    }
+
+    *used = pos;
+    return result;
+}
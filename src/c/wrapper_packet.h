@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Reassembly of the version 2 packets read from the JVM.  A packet is a one
+ *  byte code, its length as an unsigned LEB128 varint, and the payload.
+ *
+ * The bytes are fed to the reader as they become available, so a packet
+ *  which arrives in several pieces is kept here until it is complete rather
+ *  than blocking the caller.  wrapperPacketReaderWanted() tells how many bytes
+ *  can be read without reading into the next packet.
+ */
+
+#ifndef _WRAPPER_PACKET_H
+#define _WRAPPER_PACKET_H
+
+#include <stddef.h>
+
+/* Largest payload accepted once the JVM has been authenticated. */
+#define WRAPPER_PACKET_MAX_LENGTH               (4 * 1024 * 1024)
+/* Largest payload accepted before the key of the JVM has been verified.  Only short packets are expected then. */
+#define WRAPPER_PACKET_MAX_UNVERIFIED_LENGTH    1024
+
+/* Results of wrapperPacketReaderFeed(). */
+#define WRAPPER_PACKET_INCOMPLETE       0   /* More bytes are needed. */
+#define WRAPPER_PACKET_COMPLETE         1   /* A packet is complete.  It is in code and buffer until the next call. */
+#define WRAPPER_PACKET_TOO_LONG         2   /* The length of the packet exceeds maxLength, and discardTooLong is not set. */
+#define WRAPPER_PACKET_BAD_LENGTH       3   /* The length is not a valid varint. */
+#define WRAPPER_PACKET_OUT_OF_MEMORY    4
+#define WRAPPER_PACKET_DISCARDED        5   /* A packet longer than maxLength was skipped.  Its code and length are kept until the next call. */
+
+typedef struct WrapperPacketReader WrapperPacketReader, *PWrapperPacketReader;
+struct WrapperPacketReader {
+    int             state;          /* Part of the packet being read. */
+    char            code;           /* Code of the packet. */
+    size_t          length;         /* Length of the payload, once the varint has been read. */
+    int             shift;          /* Shift of the next byte of the varint. */
+    size_t          got;            /* Number of bytes of the payload read so far. */
+    char            *buffer;        /* Payload, null terminated once the packet is complete. */
+    size_t          bufferSize;
+    size_t          maxLength;      /* Longest payload accepted. */
+    int             discardTooLong; /* If TRUE, a packet longer than maxLength is skipped rather than being an error. */
+};
+
+/**
+ * Initializes a reader with an empty buffer.
+ */
+extern void wrapperPacketReaderInit(PWrapperPacketReader reader, size_t maxLength);
+
+/**
+ * Frees the buffer of a reader.
+ */
+extern void wrapperPacketReaderDispose(PWrapperPacketReader reader);
+
+/**
+ * Drops any partial packet, so that the next byte fed is the code of a new
+ *  packet.  The buffer is kept.
+ */
+extern void wrapperPacketReaderReset(PWrapperPacketReader reader);
+
+/**
+ * Returns the number of bytes which belong to the current packet, and can
+ *  therefore be read from the stream and fed at once.
+ */
+extern size_t wrapperPacketReaderWanted(PWrapperPacketReader reader);
+
+/**
+ * Feeds bytes to a reader.  Bytes are consumed until a packet is complete or
+ *  an error is found, so *used may be less than len.
+ *
+ * @param used Set to the number of bytes consumed.
+ *
+ * @return One of the WRAPPER_PACKET_* results.  After an error the stream is
+ *         out of sync and the reader must be reset before being used again.
+ */
+extern int wrapperPacketReaderFeed(PWrapperPacketReader reader, const char *data, size_t len, size_t *used);
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "wrapper_i18n.h"
+#include "wrapper_procstat.h"
+
+/* Large enough for any of the files we read.  /proc/<pid>/status is the largest at around 1.5KB. */
+#define PROCSTAT_BUFFER_SIZE 4096
+
+static double procStatNow() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int procStatOpenFile(const char *procRoot, int pid, const char *name) {
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s/%d/%s", procRoot, pid, name);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * Reads a whole file which was already opened.
+ *
+ * @return The number of bytes read, or -1 on failure.
+ */
+static ssize_t procStatRead(int fd, char *buffer) {
+    ssize_t len;
+
+    len = pread(fd, buffer, PROCSTAT_BUFFER_SIZE - 1, 0);
+    if (len >= 0) {
+        buffer[len] = '\0';
+    }
+    return len;
+}
+
+/**
+ * Finds the value of a "Name: value" line.
+ *
+ * @return The value, or 0 if the line is not there.
+ */
+static double procStatFindValue(const char *buffer, const char *name) {
+    const char *line;
+    size_t len = strlen(name);
+
+    line = buffer;
+    while (line) {
+        if ((strncmp(line, name, len) == 0) && (line[len] == ':')) {
+            return strtod(line + len + 1, NULL);
+        }
+        line = strchr(line, '\n');
+        if (line) {
+            line++;
+        }
+    }
+    return 0;
+}
+
+int wrapperProcStatOpen(PWrapperProcStat procStat, const char *procRoot, int pid) {
+    char path[256];
+    int err;
+
+    memset(procStat, 0, sizeof(WrapperProcStat));
+    procStat->statmFd = -1;
+    procStat->statusFd = -1;
+    procStat->ioFd = -1;
+    procStat->clockTicks = sysconf(_SC_CLK_TCK);
+    procStat->pageSize = sysconf(_SC_PAGESIZE);
+
+    procStat->statFd = procStatOpenFile(procRoot, pid, "stat");
+    if (procStat->statFd < 0) {
+        return TRUE;
+    }
+    procStat->statmFd = procStatOpenFile(procRoot, pid, "statm");
+    procStat->statusFd = procStatOpenFile(procRoot, pid, "status");
+    if ((procStat->statmFd < 0) || (procStat->statusFd < 0)) {
+        err = errno;
+        wrapperProcStatClose(procStat);
+        errno = err;
+        return TRUE;
+    }
+
+    /* These need the same privileges as ptrace, which we may not have if the JVM runs as another user. */
+    procStat->ioFd = procStatOpenFile(procRoot, pid, "io");
+    snprintf(path, sizeof(path), "%s/%d/fd", procRoot, pid);
+    procStat->fdDir = opendir(path);
+
+    procStat->cpuPercent = -1;
+    procStat->fds = -1;
+    procStat->readBytesPerSec = -1;
+    procStat->writeBytesPerSec = -1;
+    return FALSE;
+}
+
+int wrapperProcStatSample(PWrapperProcStat procStat) {
+    char buffer[PROCSTAT_BUFFER_SIZE];
+    double start;
+    double now;
+    double elapsed;
+    char *pos;
+    int field;
+    double utime = 0;
+    double stime = 0;
+    double cpuTicks;
+    double readBytes;
+    double writeBytes;
+    struct dirent *entry;
+    int fds;
+
+    start = procStatNow();
+
+    /* The command name is between parentheses and may contain anything, so start after the last one.
+     *  Field 3 (state) follows it, then utime is field 14, stime 15 and num_threads 20. */
+    if (procStatRead(procStat->statFd, buffer) <= 0) {
+        return TRUE;
+    }
+    pos = strrchr(buffer, ')');
+    if (!pos) {
+        return TRUE;
+    }
+    for (field = 2; pos && (field < 20); field++) {
+        pos = strchr(pos + 1, ' ');
+        if (pos) {
+            if (field + 1 == 14) {
+                utime = strtod(pos + 1, NULL);
+            } else if (field + 1 == 15) {
+                stime = strtod(pos + 1, NULL);
+            } else if (field + 1 == 20) {
+                procStat->threads = atoi(pos + 1);
+            }
+        }
+    }
+    if (!pos) {
+        return TRUE;
+    }
+
+    /* The resident size is the second field, in pages. */
+    if (procStatRead(procStat->statmFd, buffer) <= 0) {
+        return TRUE;
+    }
+    pos = strchr(buffer, ' ');
+    procStat->rssBytes = pos ? strtod(pos + 1, NULL) * procStat->pageSize : 0;
+
+    if (procStatRead(procStat->statusFd, buffer) > 0) {
+        procStat->peakRssBytes = procStatFindValue(buffer, "VmHWM") * 1024;
+        procStat->swapBytes = procStatFindValue(buffer, "VmSwap") * 1024;
+    }
+
+    if (procStat->fdDir) {
+        rewinddir(procStat->fdDir);
+        fds = 0;
+        while ((entry = readdir(procStat->fdDir)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                fds++;
+            }
+        }
+        procStat->fds = fds;
+    }
+
+    now = procStatNow();
+    elapsed = now - procStat->lastTime;
+    cpuTicks = utime + stime;
+    if (procStat->sampled && (elapsed > 0)) {
+        procStat->cpuPercent = (cpuTicks - procStat->lastCpuTicks) / procStat->clockTicks / elapsed * 100.0;
+    }
+    procStat->lastCpuTicks = cpuTicks;
+
+    if ((procStat->ioFd >= 0) && (procStatRead(procStat->ioFd, buffer) > 0)) {
+        readBytes = procStatFindValue(buffer, "read_bytes");
+        writeBytes = procStatFindValue(buffer, "write_bytes");
+        if (procStat->sampled && (elapsed > 0)) {
+            procStat->readBytesPerSec = (readBytes - procStat->lastReadBytes) / elapsed;
+            procStat->writeBytesPerSec = (writeBytes - procStat->lastWriteBytes) / elapsed;
+        }
+        procStat->lastReadBytes = readBytes;
+        procStat->lastWriteBytes = writeBytes;
+    }
+
+    procStat->lastTime = now;
+    procStat->sampled = TRUE;
+    procStat->sampleMicros = (unsigned int)((procStatNow() - start) * 1e6);
+    return FALSE;
+}
+
+void wrapperProcStatClose(PWrapperProcStat procStat) {
+    if (procStat->statFd >= 0) {
+        close(procStat->statFd);
+        procStat->statFd = -1;
+    }
+    if (procStat->statmFd >= 0) {
+        close(procStat->statmFd);
+        procStat->statmFd = -1;
+    }
+    if (procStat->statusFd >= 0) {
+        close(procStat->statusFd);
+        procStat->statusFd = -1;
+    }
+    if (procStat->ioFd >= 0) {
+        close(procStat->ioFd);
+        procStat->ioFd = -1;
+    }
+    if (procStat->fdDir) {
+        closedir(procStat->fdDir);
+        procStat->fdDir = NULL;
+    }
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Samples the resource usage of a process from /proc.
+ *
+ * The files of the process are opened once and re-read with pread() for
+ *  each sample, so a sample costs a few system calls and no allocation.
+ *  Rates (CPU and I/O) are computed against the previous sample, so they
+ *  are only available from the second sample on.
+ *
+ * This is only implemented on Linux.
+ */
+
+#ifdef LINUX
+#ifndef _WRAPPER_PROCSTAT_H
+#define _WRAPPER_PROCSTAT_H
+
+#include <dirent.h>
+
+typedef struct WrapperProcStat WrapperProcStat, *PWrapperProcStat;
+struct WrapperProcStat {
+    int     statFd;             /* /proc/<pid>/stat */
+    int     statmFd;            /* /proc/<pid>/statm */
+    int     statusFd;           /* /proc/<pid>/status */
+    int     ioFd;               /* /proc/<pid>/io, -1 if we are not allowed to read it. */
+    DIR     *fdDir;             /* /proc/<pid>/fd, NULL if we are not allowed to read it. */
+    long    clockTicks;         /* Clock ticks per second used by the CPU times. */
+    long    pageSize;
+    int     sampled;            /* TRUE once a sample was taken, so the next one can compute rates. */
+    double  lastTime;           /* Monotonic time of the last sample, in seconds. */
+    double  lastCpuTicks;       /* User and system time of the last sample, in clock ticks. */
+    double  lastReadBytes;
+    double  lastWriteBytes;
+
+    /* Results of the last sample. */
+    double  cpuPercent;         /* Percentage of one CPU, so may be over 100 on several CPUs.  -1 until rates are known. */
+    double  rssBytes;           /* Resident memory. */
+    double  peakRssBytes;       /* Peak resident memory (VmHWM), 0 if unknown. */
+    double  swapBytes;          /* Memory swapped out (VmSwap), 0 if unknown. */
+    int     threads;
+    int     fds;                /* Open file descriptors, -1 if unknown. */
+    double  readBytesPerSec;    /* Bytes read from storage per second, -1 if unknown. */
+    double  writeBytesPerSec;   /* Bytes written to storage per second, -1 if unknown. */
+    unsigned int sampleMicros;  /* Time it took to take the last sample. */
+};
+
+/**
+ * Opens the files of a process.
+ *
+ * @param procStat Structure to initialize.
+ * @param procRoot Mount point of procfs, normally "/proc".
+ * @param pid Process to sample.
+ *
+ * @return TRUE if the process could not be opened.  errno is set.
+ */
+extern int wrapperProcStatOpen(PWrapperProcStat procStat, const char *procRoot, int pid);
+
+/**
+ * Takes a sample.
+ *
+ * @return TRUE if the process could not be read, normally because it exited.
+ */
+extern int wrapperProcStatSample(PWrapperProcStat procStat);
+
+/**
+ * Closes the files of a process.  Safe to call more than once.
+ */
+extern void wrapperProcStatClose(PWrapperProcStat procStat);
+
+#endif
+#endif
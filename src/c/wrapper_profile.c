@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "logger.h"
+#include "wrapper.h"
+#include "wrapper_profile.h"
+
+#define PROFILE_PHASE   1
+#define PROFILE_MARK    2
+
+typedef struct ProfileEvent ProfileEvent;
+struct ProfileEvent {
+    const TCHAR     *name;
+    int             type;       /* PROFILE_PHASE or PROFILE_MARK. */
+    int             depth;      /* Number of phases the event is nested within. */
+    int             ended;      /* TRUE once a phase was ended. */
+    unsigned int    begin;      /* Microseconds since the origin. */
+    unsigned int    end;        /* Microseconds since the origin, once a phase was ended. */
+};
+
+static ProfileEvent profileEvents[WRAPPER_PROFILE_MAX_EVENTS];
+static int profileEventCount = 0;
+static int profileDropped = 0;
+/* Indexes in profileEvents of the phases which were begun but not ended, innermost last. */
+static int profileOpen[WRAPPER_PROFILE_MAX_DEPTH];
+static int profileOpenCount = 0;
+/* Value of wrapperGetMicros() when the first event was recorded.  It wraps every 71 minutes, which is far longer than any startup. */
+static unsigned int profileOrigin;
+static int profileReported = FALSE;
+
+/**
+ * Adds an event at the current time.
+ *
+ * @return The event, or NULL if there is no room left or recording stopped.
+ */
+static ProfileEvent *profileAddEvent(const TCHAR *name, int type) {
+    ProfileEvent *event;
+    unsigned int now;
+
+    if (profileReported) {
+        return NULL;
+    }
+    if ((profileEventCount >= WRAPPER_PROFILE_MAX_EVENTS) || ((type == PROFILE_PHASE) && (profileOpenCount >= WRAPPER_PROFILE_MAX_DEPTH))) {
+        profileDropped++;
+        return NULL;
+    }
+    now = wrapperGetMicros();
+    if (profileEventCount == 0) {
+        profileOrigin = now;
+    }
+    event = &profileEvents[profileEventCount++];
+    event->name = name;
+    event->type = type;
+    event->depth = profileOpenCount;
+    event->ended = FALSE;
+    event->begin = now - profileOrigin;
+    event->end = event->begin;
+    return event;
+}
+
+void wrapperProfileBegin(const TCHAR *name) {
+    if (profileAddEvent(name, PROFILE_PHASE)) {
+        profileOpen[profileOpenCount++] = profileEventCount - 1;
+    }
+}
+
+void wrapperProfileEnd(const TCHAR *name) {
+    ProfileEvent *event;
+    int i;
+
+    if (profileReported) {
+        return;
+    }
+    for (i = profileOpenCount - 1; i >= 0; i--) {
+        event = &profileEvents[profileOpen[i]];
+        if (_tcscmp(event->name, name) == 0) {
+            event->end = wrapperGetMicros() - profileOrigin;
+            event->ended = TRUE;
+            /* Any phase nested within it stays incomplete. */
+            profileOpenCount = i;
+            return;
+        }
+    }
+}
+
+void wrapperProfileMark(const TCHAR *name) {
+    profileAddEvent(name, PROFILE_MARK);
+}
+
+/**
+ * Writes the events in the Chrome trace format, which can be loaded in
+ *  chrome://tracing or Perfetto.  Incomplete phases end at the time of the
+ *  report.
+ */
+static void profileWriteChromeTrace(const TCHAR *file, unsigned int now) {
+    FILE *fp;
+    ProfileEvent *event;
+    int i;
+
+    fp = _tfopen(file, TEXT("w"));
+    if (!fp) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to write the startup profile to %s: %s"), file, getLastErrorText());
+        return;
+    }
+    _ftprintf(fp, TEXT("{\"traceEvents\":[\n"));
+    for (i = 0; i < profileEventCount; i++) {
+        event = &profileEvents[i];
+        if (event->type == PROFILE_MARK) {
+            _ftprintf(fp, TEXT("{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%u,\"pid\":%d,\"tid\":1}"),
+                event->name, event->begin, (int)wrapperData->wrapperPID);
+        } else {
+            _ftprintf(fp, TEXT("{\"name\":\"%s\",\"cat\":\"startup\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,\"pid\":%d,\"tid\":1,\"args\":{\"completed\":%s}}"),
+                event->name, event->begin, (event->ended ? event->end : now) - event->begin, (int)wrapperData->wrapperPID,
+                event->ended ? TEXT("true") : TEXT("false"));
+        }
+        _ftprintf(fp, (i < profileEventCount - 1) ? TEXT(",\n") : TEXT("\n"));
+    }
+    _ftprintf(fp, TEXT("],\"displayTimeUnit\":\"ms\"}\n"));
+    if (fclose(fp)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to write the startup profile to %s: %s"), file, getLastErrorText());
+    } else {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Startup profile written to %s."), file);
+    }
+}
+
+void wrapperProfileReport(int started) {
+    TCHAR indent[WRAPPER_PROFILE_MAX_DEPTH * 2 + 1];
+    ProfileEvent *event;
+    unsigned int now;
+    int i;
+
+    if (profileReported) {
+        return;
+    }
+    /* Stop recording, whether the profile is wanted or not. */
+    profileReported = TRUE;
+    if (!wrapperData->startupProfile || (profileEventCount == 0)) {
+        return;
+    }
+
+    now = wrapperGetMicros() - profileOrigin;
+    if (started) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Startup profile (the JVM was started after %.1f ms):"), now / 1000.0);
+    } else {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("Startup profile (stopping after %.1f ms before the JVM was started):"), now / 1000.0);
+    }
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("     at (ms)   took (ms)  phase"));
+    for (i = 0; i < profileEventCount; i++) {
+        event = &profileEvents[i];
+        _tcsncpy(indent, TEXT("                                "), event->depth * 2);
+        indent[event->depth * 2] = TEXT('\0');
+        if (event->type == PROFILE_MARK) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("  %10.1f              %s* %s"), event->begin / 1000.0, indent, event->name);
+        } else if (event->ended) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("  %10.1f  %10.1f  %s%s"), event->begin / 1000.0, (event->end - event->begin) / 1000.0, indent, event->name);
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("  %10.1f  %10.1f  %s%s (incomplete)"), event->begin / 1000.0, (now - event->begin) / 1000.0, indent, event->name);
+        }
+    }
+    if (profileDropped > 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO, TEXT("  %d events could not be recorded."), profileDropped);
+    }
+
+    if (wrapperData->startupProfileFile) {
+        profileWriteChromeTrace(wrapperData->startupProfileFile, now);
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Records how long each phase of the startup takes, from the launch of the
+ *  Wrapper until the JVM signals that the application was started.  This
+ *  includes the Java queries (version, bootstrap, dry run) and, for those
+ *  that need one, the launch of a helper JVM.
+ *
+ * Events are always recorded as it is only known once the configuration is
+ *  loaded whether wrapper.startup.profile is set.  Recording an event reads
+ *  the monotonic clock and fills a slot of a fixed array, nothing more.
+ *  Recording stops once the report was made, so restarts of the JVM are not
+ *  profiled.
+ *
+ * Names must be literals (only their pointer is kept), and all events must be
+ *  recorded from the main thread.
+ */
+
+#ifndef _WRAPPER_PROFILE_H
+#define _WRAPPER_PROFILE_H
+
+#include "wrapper_i18n.h"
+
+/* Maximum number of recorded phases and marks.  Any event beyond this is dropped. */
+#define WRAPPER_PROFILE_MAX_EVENTS  128
+/* Maximum depth of nested phases. */
+#define WRAPPER_PROFILE_MAX_DEPTH   16
+
+/**
+ * Begins a phase.  Phases begun after it and before it ends are nested
+ *  within it.  The first event recorded is the origin of the timeline.
+ */
+extern void wrapperProfileBegin(const TCHAR *name);
+
+/**
+ * Ends the innermost phase with the given name.  Any phase nested within it
+ *  which was not ended is left incomplete.
+ */
+extern void wrapperProfileEnd(const TCHAR *name);
+
+/**
+ * Records an instant event.
+ */
+extern void wrapperProfileMark(const TCHAR *name);
+
+/**
+ * Logs the timeline of the startup and writes it to
+ *  wrapper.startup.profile.file in the Chrome trace format, if
+ *  wrapper.startup.profile is set.  Only the first call does anything, and
+ *  recording stops after it.
+ *
+ * @param started TRUE if the JVM was started, FALSE if the Wrapper is
+ *                stopping before that.  Phases which were not ended are
+ *                reported as incomplete.
+ */
+extern void wrapperProfileReport(int started);
+
+#endif
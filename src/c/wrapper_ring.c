@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "wrapper_i18n.h"
+#include "wrapper_ring.h"
+
+/* Placed instead of a record length when the record did not fit before the end of the data area. */
+#define WRAPPER_RING_WRAP       0xffffffffU
+
+/* Each record is its length, its code, its data and a null terminator, aligned on 4 bytes. */
+#define WRAPPER_RING_RECORD_SIZE(len) ((unsigned int)((4 + 1 + (len) + 1 + 3) & ~((size_t)3)))
+
+static int mapRing(WrapperRing *ring, int fd, size_t mapSize) {
+    void *addr;
+
+    addr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        return TRUE;
+    }
+    ring->header = (WrapperRingHeader *)addr;
+    ring->mapSize = mapSize;
+    return FALSE;
+}
+
+int wrapperRingCreate(WrapperRing *ring, char *pathTemplate, size_t capacity) {
+    size_t size;
+    size_t mapSize;
+    long pageSize;
+    int fd;
+    int err;
+
+    memset(ring, 0, sizeof(WrapperRing));
+    ring->fd = -1;
+
+    /* Round the capacity up to a power of two. */
+    size = WRAPPER_RING_MIN_SIZE;
+    while ((size < capacity) && (size < WRAPPER_RING_MAX_SIZE)) {
+        size <<= 1;
+    }
+
+    /* Keep the data area on its own pages. */
+    pageSize = sysconf(_SC_PAGESIZE);
+    if (pageSize < (long)sizeof(WrapperRingHeader)) {
+        pageSize = 4096;
+    }
+    mapSize = (size_t)pageSize + size;
+
+    /* mkostemp() creates the file with a 0600 mode. */
+    fd = mkostemp(pathTemplate, O_CLOEXEC);
+    if (fd == -1) {
+        return TRUE;
+    }
+    if ((ftruncate(fd, (off_t)mapSize) == -1) || mapRing(ring, fd, mapSize)) {
+        err = errno;
+        close(fd);
+        unlink(pathTemplate);
+        errno = err;
+        return TRUE;
+    }
+    /* Keep the file open to be able to check that its size did not change. */
+    ring->fd = fd;
+
+    /* The file was extended with zeros, so the positions and the doorbell are already reset. */
+    ring->header->capacity = (unsigned int)size;
+    ring->header->dataOffset = (unsigned int)pageSize;
+    ring->header->version = WRAPPER_RING_VERSION;
+    ring->data = (char *)ring->header + pageSize;
+    ring->mask = (unsigned int)size - 1;
+    /* The magic is written last so a ring is never seen valid before it is complete. */
+    __atomic_store_n(&(ring->header->magic), WRAPPER_RING_MAGIC, __ATOMIC_RELEASE);
+    return FALSE;
+}
+
+int wrapperRingAttach(WrapperRing *ring, const char *path) {
+    struct stat st;
+    WrapperRingHeader *header;
+    int fd;
+
+    memset(ring, 0, sizeof(WrapperRing));
+    ring->fd = -1;
+
+    fd = open(path, O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        return TRUE;
+    }
+    if ((fstat(fd, &st) == -1) || (st.st_size < (off_t)sizeof(WrapperRingHeader)) || mapRing(ring, fd, (size_t)st.st_size)) {
+        close(fd);
+        return TRUE;
+    }
+    close(fd);
+
+    header = ring->header;
+    if ((__atomic_load_n(&(header->magic), __ATOMIC_ACQUIRE) != WRAPPER_RING_MAGIC) ||
+        (header->version != WRAPPER_RING_VERSION) ||
+        (header->capacity < WRAPPER_RING_MIN_SIZE) ||
+        ((header->capacity & (header->capacity - 1)) != 0) ||
+        (header->dataOffset < sizeof(WrapperRingHeader)) ||
+        ((size_t)header->dataOffset + header->capacity > ring->mapSize)) {
+        wrapperRingDetach(ring);
+        errno = EINVAL;
+        return TRUE;
+    }
+    ring->data = (char *)header + header->dataOffset;
+    ring->mask = header->capacity - 1;
+    return FALSE;
+}
+
+void wrapperRingDetach(WrapperRing *ring) {
+    if (ring->header) {
+        munmap(ring->header, ring->mapSize);
+        if (ring->fd != -1) {
+            close(ring->fd);
+        }
+    }
+    memset(ring, 0, sizeof(WrapperRing));
+    ring->fd = -1;
+}
+
+int wrapperRingWrite(WrapperRing *ring, char code, const char *data, size_t len) {
+    WrapperRingHeader *header = ring->header;
+    unsigned int capacity = ring->mask + 1;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int pos;
+    unsigned int skip;
+    unsigned int size;
+
+    if (len > capacity) {
+        return TRUE;
+    }
+    size = WRAPPER_RING_RECORD_SIZE(len);
+    if (size > capacity) {
+        return TRUE;
+    }
+
+    head = header->head;
+    tail = __atomic_load_n(&(header->tail), __ATOMIC_ACQUIRE);
+    pos = head & ring->mask;
+
+    /* Records are never split, so skip the end of the data area if the record does not fit there. */
+    skip = (capacity - pos < size) ? capacity - pos : 0;
+    if ((head - tail) + skip + size > capacity) {
+        return TRUE;
+    }
+    if (skip) {
+        *((unsigned int *)(ring->data + pos)) = WRAPPER_RING_WRAP;
+        head += skip;
+        pos = 0;
+    }
+
+    *((unsigned int *)(ring->data + pos)) = (unsigned int)len;
+    ring->data[pos + 4] = code;
+    memcpy(ring->data + pos + 5, data, len);
+    ring->data[pos + 5 + len] = '\0';
+    __atomic_store_n(&(header->head), head + size, __ATOMIC_RELEASE);
+
+    /* The consumer sets its flag before checking the head one last time, so one of the two always sees the other. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(header->consumerWaiting), __ATOMIC_RELAXED) && __atomic_exchange_n(&(header->consumerWaiting), 0, __ATOMIC_SEQ_CST)) {
+        __atomic_add_fetch(&(header->doorbell), 1, __ATOMIC_SEQ_CST);
+        syscall(SYS_futex, &(header->doorbell), FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+    return FALSE;
+}
+
+int wrapperRingPeek(WrapperRing *ring, char *code, const char **data, size_t *len) {
+    unsigned int capacity = ring->mask + 1;
+    unsigned int head;
+    unsigned int tail = ring->readPos;
+    unsigned int pos;
+    unsigned int recordLen;
+    unsigned int size;
+
+    if (ring->corrupt) {
+        return TRUE;
+    }
+    head = __atomic_load_n(&(ring->header->head), __ATOMIC_ACQUIRE);
+    if (tail == head) {
+        return TRUE;
+    }
+
+    /* The tail is kept on this side, so it is always on a record boundary within the data area.  Values in the
+     *  mapping are read once, as the producer could change them in between. */
+    pos = tail & ring->mask;
+    recordLen = __atomic_load_n((unsigned int *)(ring->data + pos), __ATOMIC_RELAXED);
+    if ((recordLen == WRAPPER_RING_WRAP) && (capacity - pos < head - tail)) {
+        tail += capacity - pos;
+        pos = 0;
+        recordLen = __atomic_load_n((unsigned int *)(ring->data), __ATOMIC_RELAXED);
+    }
+    size = WRAPPER_RING_RECORD_SIZE(recordLen);
+    if ((head - tail > capacity) || (recordLen > ring->mask) || (size > head - tail) || (pos + size > capacity)) {
+        /* Only the producer could have corrupted the ring.  Stop reading it. */
+        ring->corrupt = TRUE;
+        return TRUE;
+    }
+
+    *code = ring->data[pos + 4];
+    *data = ring->data + pos + 5;
+    *len = recordLen;
+    ring->readEnd = tail + size;
+    return FALSE;
+}
+
+void wrapperRingRelease(WrapperRing *ring) {
+    ring->readPos = ring->readEnd;
+    __atomic_store_n(&(ring->header->tail), ring->readEnd, __ATOMIC_RELEASE);
+}
+
+unsigned int wrapperRingHead(WrapperRing *ring) {
+    return __atomic_load_n(&(ring->header->head), __ATOMIC_ACQUIRE);
+}
+
+int wrapperRingReadBefore(WrapperRing *ring, unsigned int position) {
+    /* Positions are free running, so compare their distance. */
+    return (int)(position - ring->readPos) > 0;
+}
+
+int wrapperRingCheck(WrapperRing *ring) {
+    struct stat st;
+
+    if (ring->fd == -1) {
+        return FALSE;
+    }
+    if ((fstat(ring->fd, &st) == -1) || (st.st_size < (off_t)ring->mapSize)) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+void wrapperRingWait(WrapperRing *ring, int timeoutMS) {
+    WrapperRingHeader *header = ring->header;
+    struct timespec timeout;
+    int doorbell;
+
+    doorbell = __atomic_load_n(&(header->doorbell), __ATOMIC_ACQUIRE);
+    __atomic_store_n(&(header->consumerWaiting), 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(header->head), __ATOMIC_SEQ_CST) == ring->readPos) {
+        timeout.tv_sec = timeoutMS / 1000;
+        timeout.tv_nsec = (timeoutMS % 1000) * 1000000L;
+        /* Returns as soon as the doorbell value differs from what was read above. */
+        syscall(SYS_futex, &(header->doorbell), FUTEX_WAIT, doorbell, &timeout, NULL, 0);
+    }
+    __atomic_store_n(&(header->consumerWaiting), 0, __ATOMIC_RELAXED);
+}
+#endif
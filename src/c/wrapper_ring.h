@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * Single-producer/single-consumer ring shared by the Wrapper and the JVM
+ *  through a memory mapped file.  The JVM writes records into it with the
+ *  native library, and the Wrapper reads them in its main loop.  A futex
+ *  stored in the mapping is used as a doorbell to wake up the Wrapper when
+ *  it is waiting for data.
+ *
+ * This is currently only implemented on Linux.
+ */
+
+#ifdef LINUX
+#ifndef _WRAPPER_RING_H
+#define _WRAPPER_RING_H
+
+#include <stddef.h>
+
+#define WRAPPER_RING_MAGIC      0x57524e47  /* "WRNG" */
+#define WRAPPER_RING_VERSION    1
+
+#define WRAPPER_RING_MIN_SIZE   (64 * 1024)
+#define WRAPPER_RING_MAX_SIZE   (64 * 1024 * 1024)
+
+/* Positions are free running 32-bit counters.  The capacity is a power of two so they can be masked. */
+typedef struct WrapperRingHeader WrapperRingHeader, *PWrapperRingHeader;
+struct WrapperRingHeader {
+    unsigned int magic;         /* WRAPPER_RING_MAGIC */
+    unsigned int version;       /* WRAPPER_RING_VERSION */
+    unsigned int capacity;      /* Size of the data area following the header. */
+    unsigned int dataOffset;    /* Offset of the data area from the start of the mapping. */
+    char pad0[48];
+    unsigned int head;          /* Written by the producer only. */
+    char pad1[60];
+    unsigned int tail;          /* Written by the consumer only. */
+    int consumerWaiting;        /* Set by the consumer while it waits on the doorbell. */
+    int doorbell;               /* Futex word, incremented by the producer to wake up the consumer. */
+    char pad2[52];
+};
+
+typedef struct WrapperRing WrapperRing, *PWrapperRing;
+struct WrapperRing {
+    WrapperRingHeader *header;  /* NULL if the ring is not mapped. */
+    char *data;
+    size_t mapSize;
+    unsigned int mask;
+    int fd;                     /* Consumer only: the file backing the ring, kept open to check its size.  -1 on the producer side. */
+    unsigned int readPos;       /* Consumer only: position of the next record.  The tail in the header is only written, never trusted. */
+    unsigned int readEnd;       /* Consumer only: position following the record returned by wrapperRingPeek. */
+    int corrupt;                /* Consumer only: set when the producer wrote an invalid record.  Nothing is read after that. */
+};
+
+/**
+ * Creates the file backing a ring with a data area of at least capacity
+ *  bytes and maps it.  pathTemplate must end with "XXXXXX", which is
+ *  replaced to make the name unique, as with mkstemp().
+ *
+ * @return TRUE if there were any problems.  errno is set.
+ */
+extern int wrapperRingCreate(WrapperRing *ring, char *pathTemplate, size_t capacity);
+
+/**
+ * Maps a ring created by another process.
+ *
+ * @return TRUE if there were any problems.
+ */
+extern int wrapperRingAttach(WrapperRing *ring, const char *path);
+
+/**
+ * Unmaps the ring.  Does nothing if it is not mapped.
+ */
+extern void wrapperRingDetach(WrapperRing *ring);
+
+/**
+ * Producer side.  Adds a record and rings the doorbell if the consumer is waiting.
+ *
+ * @return TRUE if there is not enough space for the record.
+ */
+extern int wrapperRingWrite(WrapperRing *ring, char code, const char *data, size_t len);
+
+/**
+ * Consumer side.  Returns the oldest record without removing it.  The data
+ *  stays valid until wrapperRingRelease is called.
+ *
+ * The producer can write anywhere in the mapping, so a record is only
+ *  returned if it lies entirely within the data area, and only len bytes of
+ *  its data should be used: the producer may change the terminating null at
+ *  any time.  If a record is invalid, corrupt is set and the ring is then
+ *  treated as empty.
+ *
+ * @return TRUE if the ring is empty or corrupt.
+ */
+extern int wrapperRingPeek(WrapperRing *ring, char *code, const char **data, size_t *len);
+
+/**
+ * Consumer side.  Returns the position following the last record written so
+ *  far, to be passed to wrapperRingReadBefore.
+ */
+extern unsigned int wrapperRingHead(WrapperRing *ring);
+
+/**
+ * Consumer side.  Tells whether the next record to read was written before
+ *  a position returned by wrapperRingHead.
+ */
+extern int wrapperRingReadBefore(WrapperRing *ring, unsigned int position);
+
+/**
+ * Consumer side.  Makes sure that the producer did not truncate the file
+ *  backing the ring.  Accessing the mapping beyond the end of the file would
+ *  raise a SIGBUS, so this should be called before reading the ring.
+ *
+ * @return TRUE if the ring can no longer be read safely.
+ */
+extern int wrapperRingCheck(WrapperRing *ring);
+
+/**
+ * Consumer side.  Removes the record returned by the last wrapperRingPeek.
+ */
+extern void wrapperRingRelease(WrapperRing *ring);
+
+/**
+ * Consumer side.  Waits up to timeoutMS for the producer to add a record.
+ *  Returns immediately if the ring is not empty.
+ */
+extern void wrapperRingWait(WrapperRing *ring, int timeoutMS);
+
+#endif
+#endif
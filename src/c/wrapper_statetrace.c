@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "logger.h"
+#include "wrapper.h"
+#include "wrapper_statetrace.h"
+
+int wrapperStateTraceInit(PWrapperStateTrace trace, int capacity, double nowMicros) {
+    int i;
+
+    memset(trace, 0, sizeof(WrapperStateTrace));
+    trace->records = malloc(sizeof(WrapperStateTraceRecord) * capacity);
+    if (!trace->records) {
+        outOfMemory(TEXT("WSTI"), 1);
+        return TRUE;
+    }
+    trace->capacity = capacity;
+    trace->originMicros = nowMicros;
+    for (i = 0; i < WRAPPER_STATE_TRACE_PHASES; i++) {
+        wrapperHistogramReset(&trace->phaseMillis[i]);
+    }
+    return FALSE;
+}
+
+void wrapperStateTraceDispose(PWrapperStateTrace trace) {
+    if (trace->records) {
+        free(trace->records);
+        trace->records = NULL;
+    }
+    trace->capacity = 0;
+}
+
+/**
+ * Returns the lifecycle phase a JVM state belongs to, or -1 if none.
+ */
+static int stateTracePhase(int jState) {
+    switch (jState) {
+    case WRAPPER_JSTATE_LAUNCH:
+    case WRAPPER_JSTATE_LAUNCHING:
+    case WRAPPER_JSTATE_LAUNCHED:
+        return WRAPPER_STATE_TRACE_LAUNCHING;
+    case WRAPPER_JSTATE_STARTING:
+        return WRAPPER_STATE_TRACE_STARTING;
+    case WRAPPER_JSTATE_STOP:
+    case WRAPPER_JSTATE_STOPPING:
+    case WRAPPER_JSTATE_STOPPED:
+        return WRAPPER_STATE_TRACE_STOPPING;
+    case WRAPPER_JSTATE_KILLING:
+    case WRAPPER_JSTATE_KILL:
+    case WRAPPER_JSTATE_KILLED:
+        return WRAPPER_STATE_TRACE_KILLING;
+    default:
+        return -1;
+    }
+}
+
+int wrapperStateTraceAdd(PWrapperStateTrace trace, double nowMicros, int machine, int oldState, int newState, int cause, int jvmId) {
+    PWrapperStateTraceRecord record;
+    int phase;
+    int i;
+
+    record = &trace->records[trace->count % trace->capacity];
+    record->micros = nowMicros;
+    record->jvmId = jvmId;
+    record->machine = (unsigned char)machine;
+    record->oldState = (unsigned char)oldState;
+    record->newState = (unsigned char)newState;
+    record->cause = (unsigned char)cause;
+    trace->count++;
+
+    if (machine != WRAPPER_STATE_TRACE_JAVA) {
+        return FALSE;
+    }
+
+    phase = stateTracePhase(oldState);
+    if (trace->lifecycleActive && (phase >= 0)) {
+        trace->lifecycleMicros[phase] += nowMicros - trace->javaStateMicros;
+    }
+    trace->javaStateMicros = nowMicros;
+
+    if (newState == WRAPPER_JSTATE_LAUNCH) {
+        for (i = 0; i < WRAPPER_STATE_TRACE_PHASES; i++) {
+            trace->lifecycleMicros[i] = 0.0;
+        }
+        trace->lifecycleActive = TRUE;
+        trace->lifecycleJvmId = jvmId;
+    } else if ((newState == WRAPPER_JSTATE_DOWN_CLEAN) && trace->lifecycleActive) {
+        for (i = 0; i < WRAPPER_STATE_TRACE_PHASES; i++) {
+            wrapperHistogramRecord(&trace->phaseMillis[i], (unsigned int)(trace->lifecycleMicros[i] / 1000.0 + 0.5));
+        }
+        trace->lifecycleActive = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+int wrapperStateTraceSize(PWrapperStateTrace trace) {
+    if (trace->count < (unsigned int)trace->capacity) {
+        return (int)trace->count;
+    }
+    return trace->capacity;
+}
+
+PWrapperStateTraceRecord wrapperStateTraceGet(PWrapperStateTrace trace, int index) {
+    return &trace->records[(trace->count - wrapperStateTraceSize(trace) + index) % trace->capacity];
+}
+
+const TCHAR *wrapperStateTraceGetPhaseName(int phase) {
+    switch (phase) {
+    case WRAPPER_STATE_TRACE_LAUNCHING:
+        return TEXT("launching");
+    case WRAPPER_STATE_TRACE_STARTING:
+        return TEXT("starting");
+    case WRAPPER_STATE_TRACE_STOPPING:
+        return TEXT("stopping");
+    default:
+        return TEXT("killing");
+    }
+}
+
+const TCHAR *wrapperStateTraceGetCauseName(int cause) {
+    switch (cause) {
+    case WRAPPER_STATE_TRACE_CAUSE_TIMEOUT:
+        return TEXT("timeout");
+    case WRAPPER_STATE_TRACE_CAUSE_RESTART:
+        return TEXT("restart");
+    case WRAPPER_STATE_TRACE_CAUSE_STOP:
+        return TEXT("stop");
+    default:
+        return NULL;
+    }
+}
+
+int wrapperStateTraceWriteChromeTrace(PWrapperStateTrace trace, FILE *fp, double nowMicros, int pid) {
+    PWrapperStateTraceRecord record;
+    PWrapperHistogram histogram;
+    /* End of the slice of each state machine, walking back from the current states. */
+    double endMicros[2];
+    const TCHAR *name;
+    const TCHAR *from;
+    const TCHAR *cause;
+    int i;
+
+    _ftprintf(fp, TEXT("{\"traceEvents\":[\n"));
+    _ftprintf(fp, TEXT("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"wrapper\"}},\n"), pid);
+    _ftprintf(fp, TEXT("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"Wrapper state\"}},\n"), pid);
+    _ftprintf(fp, TEXT("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":2,\"args\":{\"name\":\"JVM state\"}}"), pid);
+
+    endMicros[WRAPPER_STATE_TRACE_WRAPPER] = nowMicros;
+    endMicros[WRAPPER_STATE_TRACE_JAVA] = nowMicros;
+    for (i = wrapperStateTraceSize(trace) - 1; i >= 0; i--) {
+        record = wrapperStateTraceGet(trace, i);
+        if (record->machine == WRAPPER_STATE_TRACE_JAVA) {
+            name = wrapperGetJState(record->newState);
+            from = wrapperGetJState(record->oldState);
+        } else {
+            name = wrapperGetWState(record->newState);
+            from = wrapperGetWState(record->oldState);
+        }
+        cause = wrapperStateTraceGetCauseName(record->cause);
+        _ftprintf(fp, TEXT(",\n{\"name\":\"%s\",\"cat\":\"state\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":%d,\"tid\":%d,\"args\":{\"from\":\"%s\",\"cause\":\"%s\",\"jvm\":%d}}"),
+            name, record->micros - trace->originMicros, endMicros[record->machine] - record->micros, pid, record->machine + 1,
+            from, cause ? cause : TEXT("none"), record->jvmId);
+        endMicros[record->machine] = record->micros;
+    }
+
+    _ftprintf(fp, TEXT("\n],\"displayTimeUnit\":\"ms\",\"droppedTransitions\":%u,\"stateDurations\":{"), trace->count - wrapperStateTraceSize(trace));
+    for (i = 0; i < WRAPPER_STATE_TRACE_PHASES; i++) {
+        histogram = &trace->phaseMillis[i];
+        _ftprintf(fp, TEXT("%s\"%s\":{\"jvms\":%u,\"mean_ms\":%.0f,\"p50_ms\":%u,\"p99_ms\":%u,\"max_ms\":%u}"),
+            (i == 0) ? TEXT("") : TEXT(","), wrapperStateTraceGetPhaseName(i), histogram->count, wrapperHistogramMean(histogram),
+            wrapperHistogramValueAtPercentile(histogram, 50.0), wrapperHistogramValueAtPercentile(histogram, 99.0), histogram->max);
+    }
+    _ftprintf(fp, TEXT("}}\n"));
+
+    return ferror(fp) ? TRUE : FALSE;
+}
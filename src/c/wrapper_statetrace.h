@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * A trace of the transitions of the Wrapper and JVM state machines.
+ *
+ * Each transition is stored as a small fixed-size record in a ring, so the
+ *  last transitions are always available and recording one costs a clock
+ *  read and a copy.  The ring can be written in the Chrome trace format,
+ *  which chrome://tracing and Perfetto both load, with one track for each
+ *  state machine.
+ *
+ * The time each JVM spends launching, starting, stopping and being killed is
+ *  also added up over its lifecycle, from WRAPPER_JSTATE_LAUNCH until it is
+ *  back to WRAPPER_JSTATE_DOWN_CLEAN, and kept in a histogram for each phase.
+ */
+
+#ifndef _WRAPPER_STATETRACE_H
+#define _WRAPPER_STATETRACE_H
+
+#include <stdio.h>
+#include "wrapper_i18n.h"
+#include "wrapper_histogram.h"
+
+/* The state machines. */
+#define WRAPPER_STATE_TRACE_WRAPPER         0
+#define WRAPPER_STATE_TRACE_JAVA            1
+
+/* What caused a transition, as far as the state of the Wrapper tells. */
+#define WRAPPER_STATE_TRACE_CAUSE_NONE      0   /* The state machine moved on by itself or on a message from the JVM. */
+#define WRAPPER_STATE_TRACE_CAUSE_TIMEOUT   1   /* The timeout of the JVM state had expired. */
+#define WRAPPER_STATE_TRACE_CAUSE_RESTART   2   /* A restart of the JVM was requested. */
+#define WRAPPER_STATE_TRACE_CAUSE_STOP      3   /* The Wrapper was asked to stop. */
+
+/* The phases of a JVM lifecycle whose durations are aggregated. */
+#define WRAPPER_STATE_TRACE_LAUNCHING       0   /* LAUNCH, LAUNCHING and LAUNCHED. */
+#define WRAPPER_STATE_TRACE_STARTING        1   /* STARTING. */
+#define WRAPPER_STATE_TRACE_STOPPING        2   /* STOP, STOPPING and STOPPED. */
+#define WRAPPER_STATE_TRACE_KILLING         3   /* KILLING, KILL and KILLED. */
+#define WRAPPER_STATE_TRACE_PHASES          4
+
+typedef struct WrapperStateTraceRecord WrapperStateTraceRecord, *PWrapperStateTraceRecord;
+struct WrapperStateTraceRecord {
+    double          micros;     /* Value of wrapperGetMonotonicMicros() at the time of the transition. */
+    int             jvmId;      /* Number of the JVM at the time of the transition. */
+    unsigned char   machine;    /* WRAPPER_STATE_TRACE_WRAPPER or WRAPPER_STATE_TRACE_JAVA. */
+    unsigned char   oldState;
+    unsigned char   newState;
+    unsigned char   cause;      /* One of the WRAPPER_STATE_TRACE_CAUSE_* values. */
+};
+
+typedef struct WrapperStateTrace WrapperStateTrace, *PWrapperStateTrace;
+struct WrapperStateTrace {
+    PWrapperStateTraceRecord records;   /* Ring of capacity records. */
+    int             capacity;
+    unsigned int    count;              /* Number of transitions recorded.  The ring holds the last ones. */
+    double          originMicros;       /* Time at which the trace was created, the origin of the exported timeline. */
+    double          javaStateMicros;    /* Time at which the JVM entered its current state. */
+    int             lifecycleActive;    /* TRUE from the launch of a JVM until it is down and cleaned up. */
+    int             lifecycleJvmId;     /* Number of the JVM of the current or last lifecycle. */
+    double          lifecycleMicros[WRAPPER_STATE_TRACE_PHASES]; /* Time spent in each phase during the current or last lifecycle. */
+    WrapperHistogram phaseMillis[WRAPPER_STATE_TRACE_PHASES]; /* Time spent in each phase by each JVM, in milliseconds. */
+};
+
+/**
+ * Allocates the ring of a trace and clears its statistics.
+ *
+ * @param capacity Number of transitions kept.
+ * @param nowMicros The origin of the trace.
+ *
+ * @return TRUE if out of memory.
+ */
+extern int wrapperStateTraceInit(PWrapperStateTrace trace, int capacity, double nowMicros);
+
+/**
+ * Frees the ring of a trace.
+ */
+extern void wrapperStateTraceDispose(PWrapperStateTrace trace);
+
+/**
+ * Records a transition, and adds the time spent in the previous JVM state to
+ *  the current lifecycle.
+ *
+ * @return TRUE if the transition ended the lifecycle of a JVM.  Its durations
+ *         are then in lifecycleMicros until the next JVM is launched.
+ */
+extern int wrapperStateTraceAdd(PWrapperStateTrace trace, double nowMicros, int machine, int oldState, int newState, int cause, int jvmId);
+
+/**
+ * Returns the number of transitions held in the ring.
+ */
+extern int wrapperStateTraceSize(PWrapperStateTrace trace);
+
+/**
+ * Returns a transition held in the ring, 0 being the oldest one.
+ */
+extern PWrapperStateTraceRecord wrapperStateTraceGet(PWrapperStateTrace trace, int index);
+
+/**
+ * Returns the name of a phase, in lower case.
+ */
+extern const TCHAR *wrapperStateTraceGetPhaseName(int phase);
+
+/**
+ * Returns the name of a cause, in lower case, or NULL for
+ *  WRAPPER_STATE_TRACE_CAUSE_NONE.
+ */
+extern const TCHAR *wrapperStateTraceGetCauseName(int cause);
+
+/**
+ * Writes the transitions held in the ring in the Chrome trace format.  Each
+ *  state is a slice which lasts until the next transition of its state
+ *  machine, or until nowMicros for the current states.  The phase
+ *  statistics are added under a "stateDurations" key, which viewers ignore.
+ *
+ * @return TRUE if the file could not be written.
+ */
+extern int wrapperStateTraceWriteChromeTrace(PWrapperStateTrace trace, FILE *fp, double nowMicros, int pid);
+
+#endif
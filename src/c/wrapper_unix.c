@@ -50,6 +50,7 @@
 #include <signal.h>
 #include <limits.h>
 #include <pthread.h>
+#include <spawn.h>
 #include <pwd.h>
 #include <sys/ioctl.h>
 #ifdef SOLARIS
@@ -69,6 +70,10 @@
 #include "wrapper_file.h"
 #include "wrapper_jvm_launch.h"
 #include "wrapper_encoding.h"
+#include "wrapper_profile.h"
+#ifdef LINUX
+ #include "wrapper_cgroup.h"
+#endif
 
 #include <sys/time.h>
 #if defined(LINUX) || defined(MACOSX) || defined(AIX)
@@ -1142,7 +1147,9 @@ void *javaIORunner(void *arg) {
             }
             nextSleep = FALSE;
         }
+        wrapperJavaIOFlushChildOutputRecord();
     }
+    wrapperFlushChildOutputRecord();
 
     javaIOThreadStopped = TRUE;
     if (wrapperData->isJavaIOOutputEnabled) {
@@ -1367,8 +1374,8 @@ int wrapperInitializeRun() {
 
     wrapperSetConsoleTitle();
 
-    if (wrapperData->useSystemTime) {
-        /* We are going to be using system time so there is no reason to start up a timer thread. */
+    if (wrapperData->useSystemTime || wrapperData->useMonotonicTime) {
+        /* We are going to be using system time or the monotonic clock so there is no reason to start up a timer thread. */
         timerThreadSet = FALSE;
         /* Unable to set the timerThreadId to a null value on all platforms
          * timerThreadId = 0;*/
@@ -1765,6 +1772,377 @@ size_t wrapperCalculateEnvironmentLength() {
     return lenTotal;
 }
 
+/**
+ * Checks whether the JVM can be launched with posix_spawn.  The umask of the
+ *  Wrapper process is only ever changed temporarily, around the creation of
+ *  a file, and the log file may be created by the JavaIO thread while the
+ *  JVM is being spawned.  The umask inherited by the JVM is only guaranteed
+ *  to be the one of the JVM if all of these are the same.  Otherwise the JVM
+ *  is launched with fork, and the child sets its own umask.
+ *
+ * @return TRUE if posix_spawn can be used.
+ */
+static int wrapperCanSpawnJvm() {
+    if (!wrapperData->javaUsePosixSpawn) {
+        return FALSE;
+    }
+    if ((wrapperData->javaUmask != wrapperData->umask) || (getLogfileUmask() != wrapperData->umask)) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("The umask of the JVM (%04o) or of the log file (%04o) differs from the umask of the Wrapper (%04o).  Launching the JVM with fork."),
+                wrapperData->javaUmask, getLogfileUmask(), wrapperData->umask);
+            fflush(stdout);
+            fflush(stderr);
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Launch a JVM using posix_spawn rather than fork.  On the platforms where
+ *  this is enabled by default, posix_spawn does not copy the page tables of
+ *  the Wrapper process, which reduces the launch latency when the Wrapper is
+ *  using a lot of memory.
+ *
+ * The file actions must mirror what the child side of the fork does in
+ *  wrapperLaunchJvm().  The umask is not part of the spawn attributes and
+ *  can not be changed in the parent without affecting the files created by
+ *  the other threads in the meantime, so the JVM inherits the umask of the
+ *  Wrapper process.  wrapperCanSpawnJvm() makes sure that it is the right one.
+ *
+ * @return 0 if the process was launched, an error number otherwise.
+ */
+static int wrapperSpawnJvm(TCHAR** command, int isApp, int useStdin, int newGroup, pid_t *pidPtr) {
+    posix_spawn_file_actions_t fileActions;
+    posix_spawnattr_t attr;
+    short flags = 0;
+    char **cCmd;
+    size_t req;
+    int size;
+    int i;
+    int ret = 0;
+
+    for (size = 0; command[size] != NULL; size++) {
+        ;
+    }
+    cCmd = calloc(size + 1, sizeof(char *));
+    if (!cCmd) {
+        outOfMemory(TEXT("WSJ"), 1);
+        return ENOMEM;
+    }
+    for (i = 0; i < size; i++) {
+        req = wcstombs(NULL, command[i], 0);
+        if (req == (size_t)-1) {
+            ret = EILSEQ;
+            break;
+        }
+        cCmd[i] = malloc(req + 1);
+        if (!cCmd[i]) {
+            outOfMemory(TEXT("WSJ"), 2);
+            ret = ENOMEM;
+            break;
+        }
+        wcstombs(cCmd[i], command[i], req + 1);
+    }
+
+    if (!ret && ((ret = posix_spawn_file_actions_init(&fileActions)) == 0)) {
+        if ((ret = posix_spawnattr_init(&attr)) == 0) {
+            /* Send both stdout and stderr to the pipe. */
+            ret = posix_spawn_file_actions_addclose(&fileActions, pipedes[PIPE_READ_END]);
+            if (!ret) {
+                ret = posix_spawn_file_actions_adddup2(&fileActions, pipedes[PIPE_WRITE_END], STDOUT_FILENO);
+            }
+            if (!ret) {
+                ret = posix_spawn_file_actions_adddup2(&fileActions, pipedes[PIPE_WRITE_END], STDERR_FILENO);
+            }
+            if (!ret) {
+                ret = posix_spawn_file_actions_addclose(&fileActions, pipedes[PIPE_WRITE_END]);
+            }
+            if (!ret && useStdin) {
+                ret = posix_spawn_file_actions_addclose(&fileActions, pipeind[PIPE_WRITE_END]);
+                if (!ret) {
+                    ret = posix_spawn_file_actions_adddup2(&fileActions, pipeind[PIPE_READ_END], STDIN_FILENO);
+                }
+                if (!ret) {
+                    ret = posix_spawn_file_actions_addclose(&fileActions, pipeind[PIPE_READ_END]);
+                }
+            }
+            if (!ret && isApp) {
+                if (protocolPipeInFd[PIPE_READ_END] != -1) {
+                    ret = posix_spawn_file_actions_addclose(&fileActions, protocolPipeInFd[PIPE_READ_END]);
+                }
+                if (!ret && (protocolPipeOuFd[PIPE_WRITE_END] != -1)) {
+                    ret = posix_spawn_file_actions_addclose(&fileActions, protocolPipeOuFd[PIPE_WRITE_END]);
+                }
+            }
+            if (!ret && newGroup) {
+                /* Java should be started in a new process group. */
+                flags |= POSIX_SPAWN_SETPGROUP;
+                ret = posix_spawnattr_setpgroup(&attr, 0);
+            }
+#ifdef POSIX_SPAWN_USEVFORK
+            flags |= POSIX_SPAWN_USEVFORK;
+#endif
+            if (!ret && flags) {
+                ret = posix_spawnattr_setflags(&attr, flags);
+            }
+            if (!ret) {
+                /* The working directory and the umask are inherited from the Wrapper process. */
+                ret = posix_spawnp(pidPtr, cCmd[0], &fileActions, &attr, cCmd, environ);
+            }
+            posix_spawnattr_destroy(&attr);
+        }
+        posix_spawn_file_actions_destroy(&fileActions);
+    }
+
+    for (i = 0; i < size; i++) {
+        free(cCmd[i]);
+    }
+    free(cCmd);
+    return ret;
+}
+
+#ifdef LINUX
+/**
+ * The cgroup of the JVM.
+ *
+ * The cgroup is created and its limits are set before the JVM is launched.
+ *  When the JVM is forked, the child enters the cgroup before it executes
+ *  the JVM, so the JVM never runs outside of it.  The cgroup is removed
+ *  again once the JVM is gone, and recreated for the next JVM.
+ */
+static WrapperCgroup javaCgroup;
+static int javaCgroupReady = FALSE;
+static int javaCgroupActive = FALSE;
+static pid_t javaCgroupPid = 0;
+static TICKS javaCgroupLastActionTicks[WRAPPER_CGROUP_RESOURCE_COUNT];
+static int javaCgroupActionFired[WRAPPER_CGROUP_RESOURCE_COUNT];
+
+/**
+ * Returns the name of the cgroup of the JVM.  By default, it includes the
+ *  pid of the Wrapper so that the JVMs of several Wrappers sharing the same
+ *  root do not end up in the same cgroup.
+ */
+static const TCHAR *javaCgroupName() {
+    static TCHAR defaultName[32];
+
+    if (wrapperData->javaCgroupName && wrapperData->javaCgroupName[0]) {
+        return wrapperData->javaCgroupName;
+    }
+    _sntprintf(defaultName, 32, TEXT("jvm-%d"), (int)wrapperData->wrapperPID);
+    return defaultName;
+}
+
+/**
+ * Converts a configured value to the multi-byte string the file system
+ *  expects.
+ *
+ * @return The value, which must be freed, or NULL if it is not set or could
+ *         not be converted.
+ */
+static char *javaCgroupValue(const TCHAR *name, const TCHAR *value) {
+    size_t len;
+    char *mbValue;
+
+    if (!value || (value[0] == TEXT('\0'))) {
+        return NULL;
+    }
+    len = wcstombs(NULL, value, 0);
+    if (len == (size_t)-1) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("The value of %s could not be converted: %s"), name, value);
+        return NULL;
+    }
+    mbValue = malloc(len + 1);
+    if (!mbValue) {
+        outOfMemory(TEXT("JCV"), 1);
+        return NULL;
+    }
+    wcstombs(mbValue, value, len + 1);
+    return mbValue;
+}
+
+/**
+ * Writes one of the limits of the JVM cgroup, if it is configured.
+ */
+static void javaCgroupSetLimit(const TCHAR *name, const TCHAR *value, const char *file) {
+    char *mbValue;
+
+    mbValue = javaCgroupValue(name, value);
+    if (mbValue) {
+        if (wrapperCgroupWrite(&javaCgroup, file, mbValue)) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to set %s of the JVM cgroup to '%s': %s"), name, value, getLastErrorText());
+        } else if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Set %s of the JVM cgroup to '%s'."), name, value);
+        }
+        free(mbValue);
+    }
+}
+
+static void javaCgroupWatch(int resource, int stallMs, const TCHAR *name) {
+    if (stallMs <= 0) {
+        return;
+    }
+    if (wrapperCgroupWatchPressure(&javaCgroup, resource, __min(stallMs, wrapperData->javaCgroupPressureWindow), wrapperData->javaCgroupPressureWindow)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to watch the %s pressure of the JVM cgroup: %s"), name, getLastErrorText());
+    }
+}
+
+/**
+ * Enables a controller in the root of the JVM cgroup.  A failure is only a
+ *  problem if a limit of that controller is configured.
+ */
+static void javaCgroupEnableController(const char *root, const char *controller, const TCHAR *name, const TCHAR *limit) {
+    if (wrapperCgroupEnableController(root, controller)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, (limit && limit[0]) ? LEVEL_WARN : LEVEL_DEBUG,
+            TEXT("Unable to enable the %s controller in %s: %s"), name, wrapperData->javaCgroupRoot, getLastErrorText());
+    }
+}
+
+/**
+ * Creates the cgroup of the JVM, if one is configured, and sets its limits
+ *  before the JVM is launched.
+ */
+static void javaCgroupPrepare() {
+    char *root;
+    char *name;
+    int err;
+
+    if (javaCgroupActive) {
+        /* The previous JVM is gone but the cgroup was not polled since.  Reuse it. */
+        wrapperCgroupClose(&javaCgroup);
+        javaCgroupActive = FALSE;
+        javaCgroupPid = 0;
+    }
+    javaCgroupReady = FALSE;
+
+    root = javaCgroupValue(TEXT("wrapper.java.cgroup.root"), wrapperData->javaCgroupRoot);
+    if (!root) {
+        return;
+    }
+    name = javaCgroupValue(TEXT("wrapper.java.cgroup.name"), javaCgroupName());
+    if (!name) {
+        free(root);
+        return;
+    }
+
+    /* Each controller is enabled on its own so that one which is missing does not prevent the others. */
+    javaCgroupEnableController(root, "memory", TEXT("memory"), wrapperData->javaCgroupMemoryMax);
+    javaCgroupEnableController(root, "cpu", TEXT("cpu"), wrapperData->javaCgroupCpuMax);
+    javaCgroupEnableController(root, "pids", TEXT("pids"), wrapperData->javaCgroupPidsMax);
+
+    err = wrapperCgroupCreate(&javaCgroup, root, name);
+    free(root);
+    free(name);
+    if (err) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to create the JVM cgroup %s below %s: %s"),
+            javaCgroupName(), wrapperData->javaCgroupRoot, getLastErrorText());
+        return;
+    }
+
+    /* Set the limits before launching the JVM so that it never runs without them. */
+    javaCgroupSetLimit(TEXT("wrapper.java.cgroup.memory.max"), wrapperData->javaCgroupMemoryMax, "memory.max");
+    javaCgroupSetLimit(TEXT("wrapper.java.cgroup.cpu.max"), wrapperData->javaCgroupCpuMax, "cpu.max");
+    javaCgroupSetLimit(TEXT("wrapper.java.cgroup.pids.max"), wrapperData->javaCgroupPidsMax, "pids.max");
+    javaCgroupReady = TRUE;
+}
+
+/**
+ * Called in the child of the fork, before the JVM is executed.  Only errors
+ *  may be logged here.
+ */
+static void javaCgroupEnter() {
+    if (javaCgroupReady && wrapperCgroupAddProcess(&javaCgroup, 0)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_ERROR, TEXT("%sUnable to enter the JVM cgroup %s/%s: %s"), LOG_FORK_MARKER,
+            wrapperData->javaCgroupRoot, javaCgroupName(), getLastErrorText());
+    }
+}
+
+void wrapperJavaCgroupAttach(pid_t pid, int spawned) {
+    int i;
+
+    if (!javaCgroupReady) {
+        return;
+    }
+    javaCgroupReady = FALSE;
+
+    if (spawned) {
+        /* posix_spawn can not run anything in the child before the JVM is executed, so the JVM is moved after
+         *  the fact.  Until then, it runs without the limits of the cgroup, and any process it starts in the
+         *  meantime stays outside of it.  Set wrapper.java.use_posix_spawn=FALSE to avoid this. */
+        if (wrapperCgroupAddProcess(&javaCgroup, (int)pid)) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to move the JVM into the cgroup %s/%s: %s"),
+                wrapperData->javaCgroupRoot, javaCgroupName(), getLastErrorText());
+            wrapperCgroupRemove(&javaCgroup);
+            return;
+        }
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("JVM moved into the cgroup %s/%s."), wrapperData->javaCgroupRoot, javaCgroupName());
+        }
+    } else if (wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("JVM launched in the cgroup %s/%s."), wrapperData->javaCgroupRoot, javaCgroupName());
+    }
+
+    javaCgroupWatch(WRAPPER_CGROUP_MEMORY, wrapperData->javaCgroupMemoryPressureStall, TEXT("memory"));
+    javaCgroupWatch(WRAPPER_CGROUP_CPU, wrapperData->javaCgroupCpuPressureStall, TEXT("CPU"));
+
+    for (i = 0; i < WRAPPER_CGROUP_RESOURCE_COUNT; i++) {
+        javaCgroupActionFired[i] = FALSE;
+    }
+    javaCgroupPid = pid;
+    javaCgroupActive = TRUE;
+}
+
+void wrapperJavaCgroupPoll(TICKS nowTicks) {
+    int pressure;
+    int resource;
+    double someAvg10;
+    double fullAvg10;
+    TCHAR message[128];
+
+    if (!javaCgroupActive) {
+        return;
+    }
+
+    if (wrapperData->javaPID != javaCgroupPid) {
+        /* The JVM is gone.  The cgroup can only be removed once it is empty, which it is once the JVM was reaped. */
+        if (wrapperCgroupRemove(&javaCgroup) && wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Unable to remove the JVM cgroup: %s"), getLastErrorText());
+        }
+        javaCgroupActive = FALSE;
+        javaCgroupPid = 0;
+        return;
+    }
+
+    pressure = wrapperCgroupPollPressure(&javaCgroup);
+    if (pressure == 0) {
+        return;
+    }
+    for (resource = 0; resource < WRAPPER_CGROUP_RESOURCE_COUNT; resource++) {
+        if (!(pressure & (1 << resource))) {
+            continue;
+        }
+        if (wrapperCgroupReadPressure(&javaCgroup, resource, &someAvg10, &fullAvg10)) {
+            someAvg10 = 0;
+            fullAvg10 = 0;
+        }
+        _sntprintf(message, 128, TEXT("The JVM is stalled on %s (some %.2f%%, full %.2f%% over 10s)."),
+            resource == WRAPPER_CGROUP_MEMORY ? TEXT("memory") : TEXT("CPU"), someAvg10, fullAvg10);
+        if ((wrapperData->jState != WRAPPER_JSTATE_STARTED) ||
+                (javaCgroupActionFired[resource] && (wrapperGetTickAgeSeconds(javaCgroupLastActionTicks[resource], nowTicks) < wrapperData->javaCgroupPressureCooldown))) {
+            /* Only log it while the JVM is not running normally, or if an action was just taken. */
+            if (wrapperData->isDebugging) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("%s"), message);
+            }
+            continue;
+        }
+        javaCgroupActionFired[resource] = TRUE;
+        javaCgroupLastActionTicks[resource] = nowTicks;
+        wrapperProcessActionList(resource == WRAPPER_CGROUP_MEMORY ? wrapperData->javaCgroupMemoryPressureActionList : wrapperData->javaCgroupCpuPressureActionList,
+            message, WRAPPER_ACTION_SOURCE_CODE_CGROUP_PRESSURE, resource, TRUE, wrapperData->errorExitCode);
+    }
+}
+#endif
+
 /**
  * Launch a JVM and collect the pid.
  *
@@ -1778,6 +2156,9 @@ int wrapperLaunchJvm(TCHAR** command, int isApp, pid_t *pidPtr) {
     size_t lenEnv;
     int useStdin;
     int newGroup;
+    int spawnErr;
+    struct timeval launchStart;
+    struct timeval launchEnd;
 
     /* Create a single pipe for stdout and stderr (they will be merged). */
     if (pipe(pipedes) < 0) {
@@ -1823,8 +2204,33 @@ int wrapperLaunchJvm(TCHAR** command, int isApp, pid_t *pidPtr) {
     fflush(stdout);
     fflush(stderr);
 
-    /* Fork off the child. */
-    proc = fork();
+#ifdef LINUX
+    if (isApp) {
+        javaCgroupPrepare();
+    }
+#endif
+
+    gettimeofday(&launchStart, NULL);
+    proc = -1;
+    if (wrapperCanSpawnJvm()) {
+        spawnErr = wrapperSpawnJvm(command, isApp, useStdin, newGroup, &proc);
+        if (spawnErr) {
+            /* Fall back to fork.  If the problem was with the command, the child side will report it in detail. */
+            if (wrapperData->isDebugging) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Unable to launch the JVM with posix_spawn: %s (%d)  Falling back to fork."), getErrorText(spawnErr, NULL), spawnErr);
+                fflush(stdout);
+                fflush(stderr);
+            }
+            proc = -1;
+        }
+    } else {
+        spawnErr = -1;
+    }
+
+    if (proc == -1) {
+        /* Fork off the child. */
+        proc = fork();
+    }
 
     if (proc == -1) {
         /* Fork failed. */
@@ -1872,6 +2278,12 @@ int wrapperLaunchJvm(TCHAR** command, int isApp, pid_t *pidPtr) {
         /* Set the umask of the JVM */
         umask(wrapperData->javaUmask);
 
+#ifdef LINUX
+        if (isApp) {
+            javaCgroupEnter();
+        }
+#endif
+
         /* The logging code causes some log corruption if logging is called from the
          *  child of a fork.  Not sure exactly why but most likely because the forked
          *  child receives a copy of the mutex and thus synchronization is not working.
@@ -1992,6 +2404,19 @@ int wrapperLaunchJvm(TCHAR** command, int isApp, pid_t *pidPtr) {
     } else {
         /* We are the parent side and need to assume that at this point the JVM is up. */
         *pidPtr = proc;
+
+        if (wrapperData->isDebugging) {
+            gettimeofday(&launchEnd, NULL);
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("JVM process launched with %s in %ld microseconds."),
+                (spawnErr == 0 ? TEXT("posix_spawn") : TEXT("fork")),
+                (long)((launchEnd.tv_sec - launchStart.tv_sec) * 1000000 + (launchEnd.tv_usec - launchStart.tv_usec)));
+        }
+
+#ifdef LINUX
+        if (isApp) {
+            wrapperJavaCgroupAttach(proc, spawnErr == 0);
+        }
+#endif
         
         /* Close the write end as it is not used. */
         close(pipedes[PIPE_WRITE_END]);
@@ -2542,6 +2967,75 @@ int wrapperLaunchJavaApp() {
     return FALSE;
 }
 
+#ifdef CLOCK_MONOTONIC
+/**
+ * Converts a clock reading to ticks.  Only the lower 32 bits are kept, which
+ *  is fine as the tick counter is expected to wrap.
+ */
+static TICKS timespecToTicks(const struct timespec *ts) {
+    return (TICKS)ts->tv_sec * (1000 / WRAPPER_TICK_MS) + (TICKS)(ts->tv_nsec / (WRAPPER_TICK_MS * 1000000L));
+}
+
+/**
+ * Returns a tick count based on the monotonic clock.  It starts at
+ *  WRAPPER_TICK_INITIAL like the timer thread does, but needs neither a
+ *  thread nor a mutex as the clock can be read from any thread.
+ *
+ * Like the timer thread, the monotonic clock does not advance while the
+ *  system is suspended.  See wrapperCheckSuspend().
+ */
+static TICKS wrapperGetMonotonicTicks() {
+    static TICKS monotonicTicksBase = 0;
+    static int monotonicTicksBaseSet = FALSE;
+    struct timespec ts;
+    TICKS ticks;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ticks = timespecToTicks(&ts);
+    if (!monotonicTicksBaseSet) {
+        /* The first call is made by the main thread during startup, from wrapperTickAssertions(). */
+        monotonicTicksBase = ticks - WRAPPER_TICK_INITIAL;
+        monotonicTicksBaseSet = TRUE;
+    }
+    return ticks - monotonicTicksBase;
+}
+#endif
+
+#ifdef LINUX
+void wrapperCheckSuspend() {
+ #ifdef CLOCK_BOOTTIME
+    static TICKS lastSuspendTicks = 0;
+    static int lastSuspendTicksSet = FALSE;
+    struct timespec monotonic;
+    struct timespec boottime;
+    TICKS suspendTicks;
+    int suspendedTicks;
+
+    if (wrapperData->useSystemTime || !wrapperData->useMonotonicTime) {
+        return;
+    }
+
+    /* CLOCK_BOOTTIME is the monotonic clock plus the time spent suspended. */
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+    if (clock_gettime(CLOCK_BOOTTIME, &boottime)) {
+        return;
+    }
+    suspendTicks = timespecToTicks(&boottime) - timespecToTicks(&monotonic);
+    if (lastSuspendTicksSet) {
+        suspendedTicks = wrapperGetTickAgeTicks(lastSuspendTicks, suspendTicks);
+        /* Shorter suspends are not worth mentioning, and the clocks are read a moment apart. */
+        if (suspendedTicks >= 1000 / WRAPPER_TICK_MS) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO,
+                TEXT("The system was suspended for %d seconds.  Time spent suspended does not count toward any timeouts."),
+                suspendedTicks * WRAPPER_TICK_MS / 1000);
+        }
+    }
+    lastSuspendTicks = suspendTicks;
+    lastSuspendTicksSet = TRUE;
+ #endif
+}
+#endif
+
 /**
  * Returns a tick count that can be used in combination with the
  *  wrapperGetTickAgeSeconds() function to perform time keeping.
@@ -2553,6 +3047,11 @@ TICKS wrapperGetTicks() {
         /* We want to return a tick count that is based on the current system time. */
         ticks = wrapperGetSystemTicks();
 
+#ifdef CLOCK_MONOTONIC
+    } else if (wrapperData->useMonotonicTime) {
+        ticks = wrapperGetMonotonicTicks();
+
+#endif
     } else {
         /* Lock the tick mutex whenever the "timerTicks" variable is accessed. */
         if (wrapperData->useTickMutex && wrapperLockTickMutex()) {
@@ -2770,6 +3269,13 @@ int wrapperReadChildOutputBlock(char *blockBuffer, int blockSize, int *readCount
     return FALSE;
 }
 
+/**
+ * Returns the descriptor of the child pipe, or -1 if it is not open.
+ */
+int wrapperGetChildOutputFd() {
+    return pipedes[PIPE_READ_END];
+}
+
 /**
  * Transform a program into a daemon.
  *
@@ -2900,7 +3406,7 @@ int setWorkingDir(TCHAR *app) {
 /*******************************************************************************
  * Main function                                                               *
  *******************************************************************************/
-#ifndef CUNIT
+#if !defined(CUNIT) && !defined(WRAPPER_BENCH)
 #ifdef UNICODE
 int main(int argc, char **cargv) {
     size_t req;
@@ -2917,6 +3423,9 @@ int main(int argc, char **argv) {
     TCHAR *logFilePath;
     int ret;
 
+    /* This is the origin of the startup profile. */
+    wrapperProfileBegin(TEXT("startup"));
+
 #ifdef FREEBSD
     /* In the case of FreeBSD, we need to dynamically load and initialize the iconv library to work with all versions of FreeBSD. */
     if (loadIconvLibrary()) {
@@ -2993,10 +3502,12 @@ int main(int argc, char **argv) {
         }
     }
 
+    wrapperProfileBegin(TEXT("initialize"));
     if (wrapperInitialize()) {
         appExit(1, argc, argv);
         return 1; /* For compiler. */
     }
+    wrapperProfileEnd(TEXT("initialize"));
 
 #ifdef _DEBUG
     log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Wrapper DEBUG build!"));
@@ -3017,10 +3528,12 @@ int main(int argc, char **argv) {
     }
 #endif
     /* Parse the command and configuration file from the command line. */
+    wrapperProfileBegin(TEXT("parse arguments"));
     if (!wrapperParseArguments(argc, argv)) {
         appExit(1, argc, argv);
         return 1; /* For compiler. */
     }
+    wrapperProfileEnd(TEXT("parse arguments"));
     if (!localeSet) {
         log_printf_queue(TRUE, WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Unable to set the locale to '%s'.  Please make sure $LC_* and $LANG are correct."), (envLang ? envLang : TEXT("<NULL>")));
 #if defined(UNICODE)
@@ -3052,6 +3565,7 @@ int main(int argc, char **argv) {
         return 0; /* For compiler. */
     }
 
+    wrapperProfileBegin(TEXT("load configuration"));
     if (loadConfigurationSettings(TRUE)) {
         if (!strcmpIgnoreCase(wrapperData->argCommand, TEXT("-request_default_log_file"))) {
             /* For this request, we can still return the path to the default log file even if the configuration failed to load. */
@@ -3071,6 +3585,8 @@ int main(int argc, char **argv) {
         }
     }
 
+    wrapperProfileEnd(TEXT("load configuration"));
+
     /* Set the default umask of the Wrapper process. */
     umask(wrapperData->umask);
     if (!strcmpIgnoreCase(wrapperData->argCommand, TEXT("-translate"))) {
@@ -75,6 +75,7 @@
 #include "wrapper_file.h"
 #include "wrapper_jvm_launch.h"
 #include "wrapper_encoding.h"
+#include "wrapper_profile.h"
 
 /*#define WRAPPER_DEBUG_CONTROL_HANDLER */
 /*#define WRAPPER_DEBUG_MESSAGES */
@@ -2573,7 +2574,9 @@ DWORD WINAPI javaIORunner(LPVOID parameter) {
                 }
                 nextSleep = FALSE;
             }
+            wrapperJavaIOFlushChildOutputRecord();
         }
+        wrapperFlushChildOutputRecord();
     } __except (exceptionFilterFunction(GetExceptionInformation())) {
         /* This call is not queued to make sure it makes it to the log prior to a shutdown. */
         log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Fatal error in the %s thread."), TEXT("JavaIO"));
@@ -9093,6 +9096,9 @@ void _tmain(int argc, TCHAR **argv) {
     HMODULE hk;
     FARPROC pfnSetDEP;
     
+    /* This is the origin of the startup profile. */
+    wrapperProfileBegin(TEXT("startup"));
+
     /* Enable DEP as soon as possible in the main method.
      *  - Use SetProcessDEPPolicy() instead of the /DYNAMICBASE link
      *    option to allow DEP on WIN XP SP3 (/DYNAMICBASE is from Vista).
@@ -9137,10 +9143,12 @@ void _tmain(int argc, TCHAR **argv) {
         toggleLogDestinations(silentMask, FALSE);
     }
 
+    wrapperProfileBegin(TEXT("initialize"));
     if (wrapperInitialize()) {
         appExit(1);
         return; /* For clarity. */
     }
+    wrapperProfileEnd(TEXT("initialize"));
     
     /* Store the DEP status to print it after the version banner. */
     wrapperData->DEPApiAvailable = DEPApiAvailable;
@@ -9180,10 +9188,12 @@ void _tmain(int argc, TCHAR **argv) {
 #endif
 
         /* Parse the command and configuration file from the command line. */
+        wrapperProfileBegin(TEXT("parse arguments"));
         if (!wrapperParseArguments(argc, argv)) {
             appExit(1);
             return; /* For clarity. */
         }
+        wrapperProfileEnd(TEXT("parse arguments"));
         
         /* Set launcher mode as soon as possible after the arguments are parsed. */
         if(!strcmpIgnoreCase(wrapperData->argCommand, TEXT("su")) || !strcmpIgnoreCase(wrapperData->argCommand, TEXT("-setup")) ||
@@ -9246,6 +9256,7 @@ void _tmain(int argc, TCHAR **argv) {
             }
         }
 
+        wrapperProfileBegin(TEXT("load configuration"));
         if (loadConfigurationSettings(TRUE)) {
             /* Unable to load the configuration.  Any errors will have already
              *  been reported. */
@@ -9260,6 +9271,7 @@ void _tmain(int argc, TCHAR **argv) {
             appExit(wrapperData->errorExitCode);
             return; /* For clarity. */
         }
+        wrapperProfileEnd(TEXT("load configuration"));
 
         /* Set the default umask of the Wrapper process. */
         _umask(wrapperData->umask);
@@ -0,0 +1,713 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wrapper_i18n.h"
+#include "wrapper_zip.h"
+
+#define ZIP_EOCD_SIGNATURE          0x06054b50
+#define ZIP_EOCD_SIZE               22
+#define ZIP64_LOCATOR_SIGNATURE     0x07064b50
+#define ZIP64_LOCATOR_SIZE          20
+#define ZIP64_EOCD_SIGNATURE        0x06064b50
+#define ZIP64_EOCD_SIZE             56
+#define ZIP_CENTRAL_SIGNATURE       0x02014b50
+#define ZIP_CENTRAL_SIZE            46
+#define ZIP_LOCAL_SIGNATURE         0x04034b50
+#define ZIP_LOCAL_SIZE              30
+
+#define ZIP_METHOD_STORED           0
+#define ZIP_METHOD_DEFLATED         8
+#define ZIP_FLAG_ENCRYPTED          0x0001
+
+/* Largest offset accepted, so that it fits in the long taken by fseek(). */
+#define ZIP_MAX_OFFSET              0x7fffffffUL
+/* Largest central directory read in memory.  A jar with 100000 entries needs about 8MB. */
+#define ZIP_MAX_CENTRAL_DIR_SIZE    (64 * 1024 * 1024)
+
+static unsigned int zipGet16(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static unsigned int zipGet32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/**
+ * Reads a 64-bit value which is expected to fit in 31 bits.
+ *
+ * @return TRUE if it does not.
+ */
+static int zipGet64(const unsigned char *p, unsigned long *pValue) {
+    if ((zipGet32(p + 4) != 0) || (zipGet32(p) > ZIP_MAX_OFFSET)) {
+        return TRUE;
+    }
+    *pValue = zipGet32(p);
+    return FALSE;
+}
+
+static int zipReadAt(FILE *file, unsigned long offset, unsigned char *buffer, size_t size) {
+    if (fseek(file, (long)offset, SEEK_SET) != 0) {
+        return TRUE;
+    }
+    return (fread(buffer, 1, size, file) != size) ? TRUE : FALSE;
+}
+
+int wrapperZipOpen(PWrapperZip zip, const TCHAR *path) {
+    unsigned char tail[ZIP_EOCD_SIZE + 0xffff];
+    unsigned char zip64[ZIP64_EOCD_SIZE];
+    unsigned char *eocd = NULL;
+    long fileSize;
+    unsigned long tailOffset;
+    size_t tailSize;
+    size_t i;
+    unsigned long entryCount;
+    unsigned long centralDirSize;
+    unsigned long centralDirOffset;
+    unsigned long zip64Offset;
+
+    memset(zip, 0, sizeof(WrapperZip));
+
+    zip->file = _tfopen(path, TEXT("rb"));
+    if (!zip->file) {
+        return TRUE;
+    }
+    if ((fseek(zip->file, 0, SEEK_END) != 0) || ((fileSize = ftell(zip->file)) < ZIP_EOCD_SIZE)) {
+        goto fail;
+    }
+
+    /* The end of central directory record is at the end of the file, followed by a comment of up to 64KB. */
+    tailSize = __min((size_t)fileSize, sizeof(tail));
+    tailOffset = (unsigned long)fileSize - tailSize;
+    if (zipReadAt(zip->file, tailOffset, tail, tailSize)) {
+        goto fail;
+    }
+    for (i = tailSize - ZIP_EOCD_SIZE + 1; i-- > 0; ) {
+        if ((zipGet32(tail + i) == ZIP_EOCD_SIGNATURE) && (i + ZIP_EOCD_SIZE + zipGet16(tail + i + 20) == tailSize)) {
+            eocd = tail + i;
+            break;
+        }
+    }
+    if (!eocd) {
+        goto fail;
+    }
+    if ((zipGet16(eocd + 4) != 0) || (zipGet16(eocd + 6) != 0)) {
+        /* Split archive. */
+        goto fail;
+    }
+    entryCount = zipGet16(eocd + 10);
+    centralDirSize = zipGet32(eocd + 12);
+    centralDirOffset = zipGet32(eocd + 16);
+
+    if ((entryCount == 0xffff) || (centralDirSize == 0xffffffffUL) || (centralDirOffset == 0xffffffffUL)) {
+        /* ZIP64: the real values are in a record located by a locator just before the end of central directory. */
+        if ((eocd - tail < ZIP64_LOCATOR_SIZE) || (zipGet32(eocd - ZIP64_LOCATOR_SIZE) != ZIP64_LOCATOR_SIGNATURE)) {
+            goto fail;
+        }
+        if (zipGet64(eocd - ZIP64_LOCATOR_SIZE + 8, &zip64Offset)
+                || zipReadAt(zip->file, zip64Offset, zip64, ZIP64_EOCD_SIZE)
+                || (zipGet32(zip64) != ZIP64_EOCD_SIGNATURE)
+                || zipGet64(zip64 + 32, &entryCount)
+                || zipGet64(zip64 + 40, &centralDirSize)
+                || zipGet64(zip64 + 48, &centralDirOffset)) {
+            goto fail;
+        }
+    }
+
+    if ((centralDirSize > ZIP_MAX_CENTRAL_DIR_SIZE) || (centralDirOffset + centralDirSize > (unsigned long)fileSize)) {
+        goto fail;
+    }
+    zip->centralDir = malloc(centralDirSize + 1);
+    if (!zip->centralDir) {
+        goto fail;
+    }
+    if (zipReadAt(zip->file, centralDirOffset, zip->centralDir, centralDirSize)) {
+        goto fail;
+    }
+    zip->centralDirSize = centralDirSize;
+    zip->entryCount = (unsigned int)entryCount;
+    zip->fileSize = (unsigned long)fileSize;
+    return FALSE;
+
+  fail:
+    wrapperZipClose(zip);
+    return TRUE;
+}
+
+/**
+ * Finds the central directory header of an entry.
+ *
+ * @return A pointer to the header, or NULL if there is no such entry.
+ */
+static const unsigned char *zipFindEntry(PWrapperZip zip, const char *name) {
+    const unsigned char *p = zip->centralDir;
+    const unsigned char *end = zip->centralDir + zip->centralDirSize;
+    size_t nameLen = strlen(name);
+    size_t entryNameLen;
+    size_t headerLen;
+
+    while ((p + ZIP_CENTRAL_SIZE <= end) && (zipGet32(p) == ZIP_CENTRAL_SIGNATURE)) {
+        entryNameLen = zipGet16(p + 28);
+        headerLen = ZIP_CENTRAL_SIZE + entryNameLen + zipGet16(p + 30) + zipGet16(p + 32);
+        if (p + headerLen > end) {
+            break;
+        }
+        if ((entryNameLen == nameLen) && (memcmp(p + ZIP_CENTRAL_SIZE, name, nameLen) == 0)) {
+            return p;
+        }
+        p += headerLen;
+    }
+    return NULL;
+}
+
+int wrapperZipHasEntry(PWrapperZip zip, const char *name) {
+    return zipFindEntry(zip, name) ? TRUE : FALSE;
+}
+
+char *wrapperZipReadEntry(PWrapperZip zip, const char *name, size_t maxSize, size_t *pSize) {
+    const unsigned char *header;
+    unsigned char local[ZIP_LOCAL_SIZE];
+    unsigned char *compressed = NULL;
+    char *data = NULL;
+    unsigned int method;
+    unsigned int crc;
+    unsigned long compressedSize;
+    unsigned long size;
+    unsigned long offset;
+
+    header = zipFindEntry(zip, name);
+    if (!header) {
+        return NULL;
+    }
+    method = zipGet16(header + 10);
+    crc = zipGet32(header + 16);
+    compressedSize = zipGet32(header + 20);
+    size = zipGet32(header + 24);
+    offset = zipGet32(header + 42);
+    if ((zipGet16(header + 8) & ZIP_FLAG_ENCRYPTED) || ((method != ZIP_METHOD_STORED) && (method != ZIP_METHOD_DEFLATED))) {
+        return NULL;
+    }
+    /* Sizes that do not fit are in a ZIP64 extra field, which is not worth supporting for the entries read here. */
+    if ((size > maxSize) || (compressedSize > ZIP_MAX_OFFSET) || (offset > ZIP_MAX_OFFSET)) {
+        return NULL;
+    }
+
+    /* The name and extra field of the local header may differ from those in the central directory. */
+    if (zipReadAt(zip->file, offset, local, ZIP_LOCAL_SIZE) || (zipGet32(local) != ZIP_LOCAL_SIGNATURE)) {
+        return NULL;
+    }
+    offset += ZIP_LOCAL_SIZE + zipGet16(local + 26) + zipGet16(local + 28);
+
+    /* Do not trust a corrupt central directory with the size of the allocation. */
+    if ((offset > zip->fileSize) || (compressedSize > zip->fileSize - offset)) {
+        return NULL;
+    }
+    if ((method == ZIP_METHOD_STORED) && (compressedSize != size)) {
+        return NULL;
+    }
+
+    data = malloc(size + 1);
+    compressed = malloc(compressedSize + 1);
+    if (!data || !compressed || zipReadAt(zip->file, offset, compressed, compressedSize)) {
+        goto fail;
+    }
+    if (method == ZIP_METHOD_STORED) {
+        memcpy(data, compressed, size);
+    } else if (wrapperZipInflate(compressed, compressedSize, (unsigned char *)data, size) != (long)size) {
+        goto fail;
+    }
+    if (wrapperZipCrc32((unsigned char *)data, size) != crc) {
+        goto fail;
+    }
+    free(compressed);
+    data[size] = '\0';
+    if (pSize) {
+        *pSize = size;
+    }
+    return data;
+
+  fail:
+    free(compressed);
+    free(data);
+    return NULL;
+}
+
+void wrapperZipClose(PWrapperZip zip) {
+    if (zip->file) {
+        fclose(zip->file);
+    }
+    free(zip->centralDir);
+    memset(zip, 0, sizeof(WrapperZip));
+}
+
+/********************************************************************
+ * Inflate (RFC 1951)
+ *******************************************************************/
+#define INFLATE_MAX_BITS        15
+#define INFLATE_MAX_LIT_CODES   288
+#define INFLATE_MAX_DIST_CODES  30
+
+typedef struct InflateState {
+    const unsigned char *in;
+    size_t              inSize;
+    size_t              inPos;
+    unsigned int        bitBuffer;
+    int                 bitCount;
+    unsigned char       *out;
+    size_t              outSize;
+    size_t              outPos;
+} InflateState;
+
+/* Canonical Huffman code: the number of codes of each length, and the symbols ordered by code. */
+typedef struct InflateHuffman {
+    short               counts[INFLATE_MAX_BITS + 1];
+    short               symbols[INFLATE_MAX_LIT_CODES];
+} InflateHuffman;
+
+static const short inflateLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short inflateLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short inflateDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short inflateDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/**
+ * @return The next count bits of input, or -1 if the input is exhausted.
+ */
+static int inflateBits(InflateState *s, int count) {
+    int value;
+
+    while (s->bitCount < count) {
+        if (s->inPos >= s->inSize) {
+            return -1;
+        }
+        s->bitBuffer |= (unsigned int)s->in[s->inPos++] << s->bitCount;
+        s->bitCount += 8;
+    }
+    value = (int)(s->bitBuffer & ((1U << count) - 1));
+    s->bitBuffer >>= count;
+    s->bitCount -= count;
+    return value;
+}
+
+/**
+ * @return TRUE if the lengths do not make a valid code.  Incomplete codes
+ *         are accepted, decoding fails if a missing code is met.
+ */
+static int inflateBuild(InflateHuffman *h, const short *lengths, int n) {
+    short offsets[INFLATE_MAX_BITS + 1];
+    int left;
+    int len;
+    int symbol;
+
+    memset(h->counts, 0, sizeof(h->counts));
+    for (symbol = 0; symbol < n; symbol++) {
+        h->counts[lengths[symbol]]++;
+    }
+    left = 1;
+    for (len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left <<= 1;
+        left -= h->counts[len];
+        if (left < 0) {
+            /* Over-subscribed. */
+            return TRUE;
+        }
+    }
+    offsets[1] = 0;
+    for (len = 1; len < INFLATE_MAX_BITS; len++) {
+        offsets[len + 1] = offsets[len] + h->counts[len];
+    }
+    for (symbol = 0; symbol < n; symbol++) {
+        if (lengths[symbol] != 0) {
+            h->symbols[offsets[lengths[symbol]]++] = (short)symbol;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @return The next symbol, or -1 if the input is exhausted or the code is
+ *         not in the table.
+ */
+static int inflateDecode(InflateState *s, const InflateHuffman *h) {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    int count;
+    int len;
+    int bit;
+
+    for (len = 1; len <= INFLATE_MAX_BITS; len++) {
+        bit = inflateBits(s, 1);
+        if (bit < 0) {
+            return -1;
+        }
+        code |= bit;
+        count = h->counts[len];
+        if (code - first < count) {
+            return h->symbols[index + code - first];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static int inflateCodes(InflateState *s, const InflateHuffman *lengthCode, const InflateHuffman *distCode) {
+    int symbol;
+    int extra;
+    int len;
+    size_t dist;
+
+    for (;;) {
+        symbol = inflateDecode(s, lengthCode);
+        if (symbol < 0) {
+            return TRUE;
+        } else if (symbol < 256) {
+            if (s->outPos >= s->outSize) {
+                return TRUE;
+            }
+            s->out[s->outPos++] = (unsigned char)symbol;
+        } else if (symbol == 256) {
+            return FALSE;
+        } else {
+            symbol -= 257;
+            if (symbol >= 29) {
+                return TRUE;
+            }
+            if ((extra = inflateBits(s, inflateLengthExtra[symbol])) < 0) {
+                return TRUE;
+            }
+            len = inflateLengthBase[symbol] + extra;
+
+            symbol = inflateDecode(s, distCode);
+            if ((symbol < 0) || (symbol >= 30)) {
+                return TRUE;
+            }
+            if ((extra = inflateBits(s, inflateDistExtra[symbol])) < 0) {
+                return TRUE;
+            }
+            dist = inflateDistBase[symbol] + extra;
+            if ((dist > s->outPos) || ((size_t)len > s->outSize - s->outPos)) {
+                return TRUE;
+            }
+            /* The copy may overlap what it writes, so it is done one byte at a time. */
+            while (len-- > 0) {
+                s->out[s->outPos] = s->out[s->outPos - dist];
+                s->outPos++;
+            }
+        }
+    }
+}
+
+static int inflateStored(InflateState *s) {
+    unsigned int len;
+
+    /* Skip to the next byte boundary. */
+    s->bitBuffer = 0;
+    s->bitCount = 0;
+    if (s->inPos + 4 > s->inSize) {
+        return TRUE;
+    }
+    len = zipGet16(s->in + s->inPos);
+    if ((zipGet16(s->in + s->inPos + 2) ^ 0xffff) != len) {
+        return TRUE;
+    }
+    s->inPos += 4;
+    if ((len > s->inSize - s->inPos) || (len > s->outSize - s->outPos)) {
+        return TRUE;
+    }
+    memcpy(s->out + s->outPos, s->in + s->inPos, len);
+    s->inPos += len;
+    s->outPos += len;
+    return FALSE;
+}
+
+static int inflateFixed(InflateState *s) {
+    static InflateHuffman lengthCode;
+    static InflateHuffman distCode;
+    static int built = FALSE;
+    short lengths[INFLATE_MAX_LIT_CODES];
+    int symbol;
+
+    if (!built) {
+        for (symbol = 0; symbol < 144; symbol++) {
+            lengths[symbol] = 8;
+        }
+        for (; symbol < 256; symbol++) {
+            lengths[symbol] = 9;
+        }
+        for (; symbol < 280; symbol++) {
+            lengths[symbol] = 7;
+        }
+        for (; symbol < INFLATE_MAX_LIT_CODES; symbol++) {
+            lengths[symbol] = 8;
+        }
+        inflateBuild(&lengthCode, lengths, INFLATE_MAX_LIT_CODES);
+        for (symbol = 0; symbol < INFLATE_MAX_DIST_CODES; symbol++) {
+            lengths[symbol] = 5;
+        }
+        inflateBuild(&distCode, lengths, INFLATE_MAX_DIST_CODES);
+        built = TRUE;
+    }
+    return inflateCodes(s, &lengthCode, &distCode);
+}
+
+static int inflateDynamic(InflateState *s) {
+    static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    short lengths[INFLATE_MAX_LIT_CODES + INFLATE_MAX_DIST_CODES];
+    InflateHuffman lengthCode;
+    InflateHuffman distCode;
+    int nlen;
+    int ndist;
+    int ncode;
+    int index;
+    int symbol;
+    int len;
+    int repeat;
+
+    nlen = inflateBits(s, 5) + 257;
+    ndist = inflateBits(s, 5) + 1;
+    ncode = inflateBits(s, 4) + 4;
+    if ((nlen > 286) || (ndist > INFLATE_MAX_DIST_CODES) || (ncode < 4)) {
+        return TRUE;
+    }
+
+    /* The code lengths are themselves Huffman coded. */
+    memset(lengths, 0, sizeof(lengths));
+    for (index = 0; index < ncode; index++) {
+        if ((len = inflateBits(s, 3)) < 0) {
+            return TRUE;
+        }
+        lengths[order[index]] = (short)len;
+    }
+    if (inflateBuild(&lengthCode, lengths, 19)) {
+        return TRUE;
+    }
+
+    index = 0;
+    while (index < nlen + ndist) {
+        symbol = inflateDecode(s, &lengthCode);
+        if (symbol < 0) {
+            return TRUE;
+        } else if (symbol < 16) {
+            lengths[index++] = (short)symbol;
+        } else {
+            len = 0;
+            if (symbol == 16) {
+                if (index == 0) {
+                    return TRUE;
+                }
+                len = lengths[index - 1];
+                repeat = 3 + inflateBits(s, 2);
+            } else if (symbol == 17) {
+                repeat = 3 + inflateBits(s, 3);
+            } else {
+                repeat = 11 + inflateBits(s, 7);
+            }
+            if ((repeat < 3) || (index + repeat > nlen + ndist)) {
+                return TRUE;
+            }
+            while (repeat-- > 0) {
+                lengths[index++] = (short)len;
+            }
+        }
+    }
+    if (lengths[256] == 0) {
+        /* No end of block code. */
+        return TRUE;
+    }
+    if (inflateBuild(&lengthCode, lengths, nlen) || inflateBuild(&distCode, lengths + nlen, ndist)) {
+        return TRUE;
+    }
+    return inflateCodes(s, &lengthCode, &distCode);
+}
+
+long wrapperZipInflate(const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize) {
+    InflateState s;
+    int last;
+    int type;
+    int err;
+
+    memset(&s, 0, sizeof(InflateState));
+    s.in = in;
+    s.inSize = inSize;
+    s.out = out;
+    s.outSize = outSize;
+
+    do {
+        last = inflateBits(&s, 1);
+        type = inflateBits(&s, 2);
+        switch (type) {
+        case 0:
+            err = inflateStored(&s);
+            break;
+        case 1:
+            err = inflateFixed(&s);
+            break;
+        case 2:
+            err = inflateDynamic(&s);
+            break;
+        default:
+            /* Reserved block type, or no more input. */
+            err = TRUE;
+            break;
+        }
+        if (err) {
+            return -1;
+        }
+    } while (!last);
+
+    return (long)s.outPos;
+}
+
+unsigned int wrapperZipCrc32(const unsigned char *data, size_t size) {
+    static unsigned int table[256];
+    static int built = FALSE;
+    unsigned int crc;
+    unsigned int c;
+    int i;
+    int k;
+
+    if (!built) {
+        for (i = 0; i < 256; i++) {
+            c = (unsigned int)i;
+            for (k = 0; k < 8; k++) {
+                c = (c & 1) ? (0xedb88320U ^ (c >> 1)) : (c >> 1);
+            }
+            table[i] = c;
+        }
+        built = TRUE;
+    }
+
+    crc = 0xffffffffU;
+    while (size-- > 0) {
+        crc = table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffU;
+}
+
+/********************************************************************
+ * Manifest
+ *******************************************************************/
+/**
+ * Compares the name at the start of a manifest line, ignoring case.
+ *
+ * @return A pointer to the value if the line is "<name>: <value>", NULL
+ *         otherwise.
+ */
+static const char *manifestMatchName(const char *line, const char *name) {
+    char a;
+    char b;
+
+    while (*name) {
+        a = *line++;
+        b = *name++;
+        if ((a >= 'A') && (a <= 'Z')) {
+            a = a - 'A' + 'a';
+        }
+        if ((b >= 'A') && (b <= 'Z')) {
+            b = b - 'A' + 'a';
+        }
+        if (a != b) {
+            return NULL;
+        }
+    }
+    if ((line[0] != ':') || (line[1] != ' ')) {
+        return NULL;
+    }
+    return line + 2;
+}
+
+static size_t manifestLineLength(const char *p) {
+    size_t len = 0;
+
+    while ((p[len] != '\0') && (p[len] != '\r') && (p[len] != '\n')) {
+        len++;
+    }
+    return len;
+}
+
+static const char *manifestNextLine(const char *p) {
+    p += manifestLineLength(p);
+    if (*p == '\r') {
+        p++;
+    }
+    if (*p == '\n') {
+        p++;
+    }
+    return p;
+}
+
+char *wrapperManifestGetAttribute(const char *manifest, const char *name) {
+    const char *line;
+    const char *value;
+    const char *next;
+    char *result;
+    size_t size;
+    size_t len;
+
+    /* The main section ends at the first empty line. */
+    for (line = manifest; (*line != '\0') && (*line != '\r') && (*line != '\n'); line = manifestNextLine(line)) {
+        if (line[0] == ' ') {
+            continue;
+        }
+        value = manifestMatchName(line, name);
+        if (!value) {
+            continue;
+        }
+
+        /* Lines are at most 72 bytes long.  Longer values continue on lines starting with a single space. */
+        size = manifestLineLength(value);
+        for (next = manifestNextLine(line); next[0] == ' '; next = manifestNextLine(next)) {
+            size += manifestLineLength(next + 1);
+        }
+        result = malloc(size + 1);
+        if (!result) {
+            return NULL;
+        }
+        len = manifestLineLength(value);
+        memcpy(result, value, len);
+        size = len;
+        for (next = manifestNextLine(line); next[0] == ' '; next = manifestNextLine(next)) {
+            len = manifestLineLength(next + 1);
+            memcpy(result + size, next + 1, len);
+            size += len;
+        }
+        result[size] = '\0';
+        return result;
+    }
+    return NULL;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ *
+ *
+ * Portions of the Software have been derived from source code
+ * developed by Silver Egg Technology under the following license:
+ *
+ * Copyright (c) 2001 Silver Egg Technology
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sub-license, and/or
+ * sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ */
+
+/**
+ * A minimal reader of ZIP files, enough to answer the questions the
+ *  WrapperBootstrap class would otherwise be launched for: does a jar
+ *  contain a given entry, and what are the attributes of its manifest.
+ *
+ * The central directory is read once when the file is opened, after which
+ *  looking up an entry does not touch the file.  Entries can be stored or
+ *  deflated.  Encrypted entries, split archives and archives whose
+ *  offsets do not fit in 31 bits are refused.
+ */
+
+#ifndef _WRAPPER_ZIP_H
+#define _WRAPPER_ZIP_H
+
+#include <stdio.h>
+#include "wrapper_i18n.h"
+
+typedef struct WrapperZip WrapperZip, *PWrapperZip;
+struct WrapperZip {
+    FILE            *file;
+    unsigned char   *centralDir;        /* The whole central directory. */
+    size_t          centralDirSize;     /* Size of the central directory in bytes. */
+    unsigned int    entryCount;         /* Number of entries in the central directory. */
+    unsigned long   fileSize;           /* Size of the file in bytes. */
+};
+
+/**
+ * Opens a ZIP file and reads its central directory.
+ *
+ * @return TRUE if the file could not be opened or is not a ZIP file that
+ *         can be read.
+ */
+extern int wrapperZipOpen(PWrapperZip zip, const TCHAR *path);
+
+/**
+ * Tests whether the ZIP file has an entry.
+ *
+ * @param name Name of the entry, for example "org/example/Main.class".
+ */
+extern int wrapperZipHasEntry(PWrapperZip zip, const char *name);
+
+/**
+ * Reads an entry in full.
+ *
+ * @param name Name of the entry.
+ * @param maxSize Largest uncompressed size that will be read.
+ * @param pSize Set to the size of the entry, if not NULL.
+ *
+ * @return The content of the entry followed by a '\0', which must be freed,
+ *         or NULL if the entry does not exist or could not be read.
+ */
+extern char *wrapperZipReadEntry(PWrapperZip zip, const char *name, size_t maxSize, size_t *pSize);
+
+/**
+ * Closes a ZIP file.
+ */
+extern void wrapperZipClose(PWrapperZip zip);
+
+/**
+ * Decompresses raw deflate data.
+ *
+ * @return The number of bytes written to out, or -1 if the data is invalid
+ *         or does not fit in outSize bytes.
+ */
+extern long wrapperZipInflate(const unsigned char *in, size_t inSize, unsigned char *out, size_t outSize);
+
+/**
+ * Computes the CRC-32 used by ZIP files.
+ */
+extern unsigned int wrapperZipCrc32(const unsigned char *data, size_t size);
+
+/**
+ * Gets an attribute from the main section of a manifest.  Attribute names
+ *  are not case sensitive, and continuation lines are joined.
+ *
+ * @param manifest Content of a META-INF/MANIFEST.MF file.
+ * @param name Name of the attribute, for example "Main-Class".
+ *
+ * @return The value, which must be freed, or NULL if the attribute is not
+ *         set.
+ */
+extern char *wrapperManifestGetAttribute(const char *manifest, const char *name);
+
+#endif
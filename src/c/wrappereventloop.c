@@ -58,11 +58,18 @@
 #include "logger.h"
 #ifndef WIN32
  #include "wrapper_ulimit.h"
+ #include "wrapper_instance.h"
 #endif
 #include "wrapper_file.h"
 #include "wrapper_jvm_launch.h"
 #include "wrapper_encoding.h"
 #include "wrapper_i18n.h"
+#include "wrapper_metrics.h"
+#include "wrapper_profile.h"
+#include "wrapper_statetrace.h"
+#ifdef LINUX
+ #include "wrapper_filewatch.h"
+#endif
 
 #ifndef MAX
 #define MAX(a, b)  (((a) > (b)) ? (a) : (b))
@@ -286,6 +293,92 @@ void writeStateFile(const TCHAR *filename, const TCHAR *state, int newUmask
     log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to write to the status file: %s"), filename);
 }
 
+/* Trace of the state transitions, created on the first transition once wrapper.state_trace.size is set. */
+static WrapperStateTrace stateTrace;
+static int stateTraceFailed = FALSE;
+
+/**
+ * Records a transition in the state trace.  Must be called before the new
+ *  state is set, so that the cause can be told from the old one.
+ */
+static void stateTraceTransition(int machine, int oldState, int newState) {
+    double nowMicros;
+    int cause;
+
+    if ((oldState == newState) || (wrapperData->stateTraceSize <= 0) || stateTraceFailed) {
+        return;
+    }
+    nowMicros = wrapperGetMonotonicMicros();
+    if (!stateTrace.records) {
+        if (wrapperStateTraceInit(&stateTrace, wrapperData->stateTraceSize, nowMicros)) {
+            stateTraceFailed = TRUE;
+            return;
+        }
+    }
+
+    if (wrapperData->jStateTimeoutTicksSet && (wrapperGetTickAgeTicks(wrapperData->jStateTimeoutTicks, wrapperGetTicks()) >= 0)) {
+        cause = WRAPPER_STATE_TRACE_CAUSE_TIMEOUT;
+    } else if ((wrapperData->restartRequested == WRAPPER_RESTART_REQUESTED_AUTOMATIC) || (wrapperData->restartRequested == WRAPPER_RESTART_REQUESTED_CONFIGURED)) {
+        cause = WRAPPER_STATE_TRACE_CAUSE_RESTART;
+    } else if (wrapperData->exitRequested || (wrapperData->wState == WRAPPER_WSTATE_STOPPING)) {
+        cause = WRAPPER_STATE_TRACE_CAUSE_STOP;
+    } else {
+        cause = WRAPPER_STATE_TRACE_CAUSE_NONE;
+    }
+
+    if (wrapperStateTraceAdd(&stateTrace, nowMicros, machine, oldState, newState, cause, wrapperData->jvmRestarts)) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, wrapperData->stateTraceLogLevel, TEXT("JVM %d spent %.0f ms launching, %.0f ms starting, %.0f ms stopping and %.0f ms being killed."),
+            stateTrace.lifecycleJvmId,
+            stateTrace.lifecycleMicros[WRAPPER_STATE_TRACE_LAUNCHING] / 1000.0,
+            stateTrace.lifecycleMicros[WRAPPER_STATE_TRACE_STARTING] / 1000.0,
+            stateTrace.lifecycleMicros[WRAPPER_STATE_TRACE_STOPPING] / 1000.0,
+            stateTrace.lifecycleMicros[WRAPPER_STATE_TRACE_KILLING] / 1000.0);
+    }
+}
+
+void wrapperDumpStateTrace(int logLevel) {
+    PWrapperHistogram histogram;
+    FILE *fp;
+    int failed;
+    int i;
+
+    if (!stateTrace.records) {
+        return;
+    }
+
+    log_printf(WRAPPER_SOURCE_WRAPPER, logLevel, TEXT("State trace: %d transitions held, %u older ones dropped."),
+        wrapperStateTraceSize(&stateTrace), stateTrace.count - wrapperStateTraceSize(&stateTrace));
+    for (i = 0; i < WRAPPER_STATE_TRACE_PHASES; i++) {
+        histogram = &stateTrace.phaseMillis[i];
+        if (histogram->count > 0) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, logLevel, TEXT("  Time spent %s by %u JVMs: mean %.0f ms, p50 %u ms, p99 %u ms, max %u ms."),
+                wrapperStateTraceGetPhaseName(i), histogram->count, wrapperHistogramMean(histogram),
+                wrapperHistogramValueAtPercentile(histogram, 50.0), wrapperHistogramValueAtPercentile(histogram, 99.0), histogram->max);
+        }
+    }
+
+    if (wrapperData->stateTraceFile) {
+        fp = _tfopen(wrapperData->stateTraceFile, TEXT("w"));
+        if (!fp) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to write the state trace to %s: %s"), wrapperData->stateTraceFile, getLastErrorText());
+            return;
+        }
+        failed = wrapperStateTraceWriteChromeTrace(&stateTrace, fp, wrapperGetMonotonicMicros(), (int)wrapperData->wrapperPID);
+        if (fclose(fp)) {
+            failed = TRUE;
+        }
+        if (failed) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Unable to write the state trace to %s: %s"), wrapperData->stateTraceFile, getLastErrorText());
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, logLevel, TEXT("State trace written to %s."), wrapperData->stateTraceFile);
+        }
+    }
+}
+
+void wrapperDisposeStateTrace() {
+    wrapperStateTraceDispose(&stateTrace);
+}
+
 /**
  * Changes the current Wrapper state.
  *
@@ -299,6 +392,7 @@ void wrapperSetWrapperState(int wState) {
             wrapperGetWState(wState));
     }
 
+    stateTraceTransition(WRAPPER_STATE_TRACE_WRAPPER, wrapperData->wState, wState);
     wrapperData->wState = wState;
 
     if (wrapperData->statusFilename != NULL) {
@@ -382,6 +476,8 @@ void wrapperSetJavaState(int jState, TICKS nowTicks, int delay) {
             wrapperGetJState(jState));
     }
 
+    stateTraceTransition(WRAPPER_STATE_TRACE_JAVA, wrapperData->jState, jState);
+
     if (wrapperData->jState != jState) {
         /* If the state has changed, then the old timeout will never be used.
          *  Clear it here so any new timeout will be used. */
@@ -494,6 +590,130 @@ void handleDebugJVMTimeout(TICKS nowTicks, const TCHAR *message, const TCHAR *ti
     wrapperUpdateJavaStateTimeout(nowTicks, -1);
 }
 
+/* Index of the anchor and command files in the file watch, -1 if they are not watched. */
+static int fileWatchAnchor = -1;
+static int fileWatchCommand = -1;
+
+#ifdef LINUX
+/**
+ * inotify watch of the anchor and command files.  While a file is watched,
+ *  it is only checked after an event was reported for it, rather than every
+ *  poll_interval seconds.  A file which can not be watched, or stops being
+ *  watched, falls back to being polled.
+ */
+static WrapperFileWatch fileWatch = { -1 };
+static int fileWatchChanges = 0;
+/* Paths of the anchor and command files when the watch was started. */
+static TCHAR *fileWatchAnchorPath = NULL;
+static TCHAR *fileWatchCommandPath = NULL;
+
+static int fileWatchAdd(const TCHAR *name, const TCHAR *path, int mask) {
+    size_t len;
+    char *mbPath;
+    int index;
+
+    len = wcstombs(NULL, path, 0);
+    if (len == (size_t)-1) {
+        return -1;
+    }
+    mbPath = malloc(len + 1);
+    if (!mbPath) {
+        outOfMemory(TEXT("FWA"), 1);
+        return -1;
+    }
+    wcstombs(mbPath, path, len + 1);
+    index = wrapperFileWatchAdd(&fileWatch, mbPath, mask);
+    free(mbPath);
+
+    if (wrapperData->isDebugging) {
+        if (index < 0) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Unable to watch the %s %s, polling it instead: %s"), name, path, getLastErrorText());
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Watching the %s %s."), name, path);
+        }
+    }
+    return index;
+}
+
+static void fileWatchStart() {
+    updateStringValue(&fileWatchAnchorPath, wrapperData->anchorFilename);
+    updateStringValue(&fileWatchCommandPath, wrapperData->commandFilename);
+    if (!wrapperData->anchorFilename && !wrapperData->commandFilename) {
+        return;
+    }
+    if (wrapperFileWatchOpen(&fileWatch)) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Unable to watch files, polling them instead: %s"), getLastErrorText());
+        }
+        return;
+    }
+    if (wrapperData->anchorFilename) {
+        fileWatchAnchor = fileWatchAdd(TEXT("anchor file"), wrapperData->anchorFilename, WRAPPER_FILEWATCH_DELETED);
+    }
+    if (wrapperData->commandFilename) {
+        fileWatchCommand = fileWatchAdd(TEXT("command file"), wrapperData->commandFilename, WRAPPER_FILEWATCH_CREATED);
+    }
+    /* Events are only reported from now on, so both files are checked once to begin with. */
+    fileWatchChanges = ~0;
+}
+
+static void fileWatchStop() {
+    wrapperFileWatchClose(&fileWatch);
+    fileWatchAnchor = -1;
+    fileWatchCommand = -1;
+    updateStringValue(&fileWatchAnchorPath, NULL);
+    updateStringValue(&fileWatchCommandPath, NULL);
+}
+
+/**
+ * Tests whether a file needs to be watched again after the configuration
+ *  was reloaded.  A relative path is resolved when the watch is added, so it
+ *  may point somewhere else once the working directory was changed.
+ */
+static int fileWatchPathChanged(const TCHAR *watchedPath, const TCHAR *path) {
+    if (!watchedPath || !path) {
+        return watchedPath != path;
+    }
+    return (_tcscmp(watchedPath, path) != 0) || (path[0] != TEXT('/'));
+}
+
+/**
+ * Called after the configuration was reloaded.  Watches the anchor and
+ *  command files again if their paths changed.
+ */
+static void fileWatchRefresh() {
+    if (fileWatchPathChanged(fileWatchAnchorPath, wrapperData->anchorFilename)
+        || fileWatchPathChanged(fileWatchCommandPath, wrapperData->commandFilename)) {
+        if (wrapperData->isDebugging) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Restarting the watch of the anchor and command files."));
+        }
+        fileWatchStop();
+        fileWatchStart();
+    }
+}
+#endif
+
+/**
+ * Decides whether the anchor or command file needs to be checked this time
+ *  through the event loop.
+ *
+ * watchIndex: Index of the file in the file watch, -1 if it is not watched.
+ * nowTicks: The tick counter value this time through the event loop.
+ * timeoutTicks: The tick at which a file that is not watched is due.
+ */
+static int fileCheckDue(int watchIndex, TICKS nowTicks, TICKS timeoutTicks) {
+#ifdef LINUX
+    if (wrapperFileWatchIsWatched(&fileWatch, watchIndex)) {
+        if (fileWatchChanges & (1 << watchIndex)) {
+            fileWatchChanges &= ~(1 << watchIndex);
+            return TRUE;
+        }
+        return FALSE;
+    }
+#endif
+    return wrapperTickExpired(nowTicks, timeoutTicks);
+}
+
 /**
  * Tests for the existence of the anchor file.  If it does not exist then
  *  the Wrapper will begin its shutdown process.
@@ -514,7 +734,7 @@ void anchorPoll(TICKS nowTicks) {
 #endif
 
     if (wrapperData->anchorFilename) {
-        if (wrapperTickExpired(nowTicks, wrapperData->anchorTimeoutTicks)) {
+        if (fileCheckDue(fileWatchAnchor, nowTicks, wrapperData->anchorTimeoutTicks)) {
             if (wrapperData->isLoopOutputEnabled) {
                 log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Loop: check anchor file"));
             }
@@ -579,6 +799,319 @@ struct S {
 } var;
 #endif
 
+#define MAX_COMMAND_LENGTH 80
+
+/* Test crashes requested by a command. */
+#define COMMAND_CRASH_NONE              0
+#define COMMAND_CRASH_ACCESS_VIOLATION  1
+#define COMMAND_CRASH_BUFFER_OVERFLOW1  2
+
+/**
+ * Intentionally crashes the Wrapper, as requested by a test command.
+ */
+static void commandCrash(int crash) {
+    TCHAR *c;
+
+    /* Make sure that everything is logged before the crash. */
+    flushLogfile();
+
+    if (crash == COMMAND_CRASH_ACCESS_VIOLATION) {
+        /* Actually cause the access violation. */
+        c = NULL;
+        c[0] = TEXT('\0');
+        /* Should never get here. */
+    }
+#ifdef TEST_FORTIFY_SOURCE
+    if (crash == COMMAND_CRASH_BUFFER_OVERFLOW1) {
+        /* Actually cause the buffer overflow. */
+        strcpy (&var.t.buf[1], "abcdefg");
+        /* Should never get here. */
+    }
+#endif
+}
+
+/**
+ * Parses and executes a single command, as read from a line of the command
+ *  file or received on the control socket.
+ *
+ * line: The command and its parameters.  Modified while being parsed.
+ * actionSourceCode: The WRAPPER_ACTION_SOURCE_CODE_* of the command.
+ * pDeferredCrash: If not NULL, a test crash is not done right away but
+ *                 stored here so the caller can clean up first.
+ *
+ * Returns one of the WRAPPER_COMMAND_* results.
+ */
+int wrapperExecuteCommand(TCHAR *line, int actionSourceCode, int *pDeferredCrash) {
+    TCHAR *d;
+    TCHAR *command;
+    TCHAR *param1;
+    TCHAR *param2;
+    TCHAR levelBuffer[8];
+    int exitCode;
+    int pauseTime;
+    int logLevel;
+    int oldLowLogLevel;
+    int newLowLogLevel;
+    int flag;
+    int crash = COMMAND_CRASH_NONE;
+    int result = WRAPPER_COMMAND_OK;
+    size_t i;
+
+    /* Always strip both ^M and ^J off the end of the line, this is done rather
+     *  than simply checking for \n so that files will work on all platforms
+     *  even if their line feeds are incorrect. */
+    if ((d = _tcschr(line, 13 /* ^M */)) != NULL) {
+        d[0] = TEXT('\0');
+    }
+    if ((d = _tcschr(line, 10 /* ^J */)) != NULL) {
+        d[0] = TEXT('\0');
+    }
+
+    command = line;
+    
+    /* Remove any leading space or tabs */
+    while (command[0] == TEXT(' ') || command[0] == TEXT('\t')) {
+        command++;
+    }
+    if (command[0] == TEXT('\0')) {
+        /* Empty line. Ignore it silently. */
+        return WRAPPER_COMMAND_EMPTY;
+    }
+    /* Remove any tailing space or tabs */
+    i = _tcslen(command) - 1;
+    while (command[i] == TEXT(' ') || command[i] == TEXT('\t')) {
+        i--;
+    }
+    command[i + 1] = TEXT('\0');
+
+    /** Look for the first space, everything after it will be the parameter(s). */
+    /* Look for parameter 1. */
+    if ((param1 = _tcschr(command, ' ')) != NULL ) {
+        param1[0] = TEXT('\0'); /* Terminate the command. */
+
+        /* Find the first non-space character. */
+        do {
+            param1++;
+        } while (param1[0] == TEXT(' '));
+    }
+    if (param1 != NULL) {
+        /* Look for parameter 2. */
+        if ((param2 = _tcschr(param1, ' ')) != NULL ) {
+            param2[0] = TEXT('\0'); /* Terminate param1. */
+
+            /* Find the first non-space character. */
+            do {
+                param2++;
+            } while (param2[0] == TEXT(' '));
+        }
+        if (param2 != NULL) {
+            /* Make sure parameter 2 is terminated. */
+            if ((d = _tcschr(param2, ' ')) != NULL ) {
+                d[0] = TEXT('\0'); /* Terminate param2. */
+            }
+        }
+    } else {
+        param2 = NULL;
+    }
+
+    /* Process the command. */
+    if (strcmpIgnoreCase(command, TEXT("RESTART")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. %s"), command, wrapperGetRestartProcessMessage());
+        wrapperRestartProcess();
+    } else if (strcmpIgnoreCase(command, TEXT("STOP")) == 0) {
+        if (param1 == NULL) {
+            exitCode = 0;
+        } else {
+            exitCode = _ttoi(param1);
+        }
+        
+        if (exitCode < 0 || exitCode > 255) {
+            exitCode = wrapperData->errorExitCode;
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN,
+                TEXT("The exit code specified along with the 'STOP' command must be in the range %d to %d.\n  Changing to the default error exit code %d."), 1, 255, exitCode);
+        }
+        
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Shutting down with exit code %d."), command, exitCode);
+
+        /* Always force the shutdown as this is an external event. */
+        wrapperStopProcess(exitCode, TRUE);
+        
+        /* To make sure that the JVM will not be restarted for any reason,
+         *  start the Wrapper shutdown process as well. */
+        if ((wrapperData->wState == WRAPPER_WSTATE_STOPPING) ||
+            (wrapperData->wState == WRAPPER_WSTATE_STOPPED)) {
+            /* Already stopping. */
+        } else {
+            wrapperSetWrapperState(WRAPPER_WSTATE_STOPPING);
+        }
+    } else if (strcmpIgnoreCase(command, TEXT("PAUSE")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. %s"), command, wrapperGetPauseProcessMessage());
+        wrapperPauseProcess(actionSourceCode);
+    } else if (strcmpIgnoreCase(command, TEXT("RESUME")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. %s"), command, wrapperGetResumeProcessMessage());
+        wrapperResumeProcess(actionSourceCode);
+    } else if (strcmpIgnoreCase(command, TEXT("DUMP")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Requesting a Thread Dump."), command);
+        wrapperRequestDumpJVMState();
+    } else if (strcmpIgnoreCase(command, TEXT("GC")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Requesting a GC."), command);
+        wrapperRequestJVMGC(actionSourceCode);
+    } else if (strcmpIgnoreCase(command, TEXT("PING_STATS")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Dumping the ping round trip times."), command);
+        wrapperPingStatsDump();
+    } else if (strcmpIgnoreCase(command, TEXT("STATE_TRACE")) == 0) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Dumping the state trace."), command);
+        wrapperDumpStateTrace(LEVEL_STATUS);
+    } else if ((strcmpIgnoreCase(command, TEXT("CONSOLE_LOGLEVEL")) == 0) ||
+            (strcmpIgnoreCase(command, TEXT("LOGFILE_LOGLEVEL")) == 0) ||
+            (strcmpIgnoreCase(command, TEXT("SYSLOG_LOGLEVEL")) == 0)) {
+        if (param1 == NULL) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' is missing its log level."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        } else {
+            logLevel = getLogLevelForName(param1);
+            if (logLevel == LEVEL_UNKNOWN) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' specified an unknown log level: '%s'"), command, param1);
+                result = WRAPPER_COMMAND_INVALID;
+            } else {
+                oldLowLogLevel = getLowLogLevel();
+
+                if (strcmpIgnoreCase(command, TEXT("CONSOLE_LOGLEVEL")) == 0) {
+                    setConsoleLogLevelInt(logLevel);
+                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Set console log level to '%s'."), command, param1);
+                } else if (strcmpIgnoreCase(command, TEXT("LOGFILE_LOGLEVEL")) == 0) {
+                    setLogfileLevelInt(logLevel);
+                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Set log file log level to '%s'."), command, param1);
+                } else if (strcmpIgnoreCase(command, TEXT("SYSLOG_LOGLEVEL")) == 0) {
+                    setSyslogLevelInt(logLevel);
+                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Set syslog log level to '%s'."), command, param1);
+                } else {
+                    /* Shouldn't get here. */
+                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' lead to an unexpected state."), command);
+                }
+
+                newLowLogLevel = getLowLogLevel();
+                if (oldLowLogLevel != newLowLogLevel) {
+                    wrapperData->isDebugging = (newLowLogLevel <= LEVEL_DEBUG);
+
+                    _sntprintf(levelBuffer, 8, TEXT("%d"), getLowLogLevel());
+                    wrapperProtocolFunction(WRAPPER_MSG_LOW_LOG_LEVEL, levelBuffer);
+                }
+            }
+        }
+    } else if ((strcmpIgnoreCase(command, TEXT("LOOP_OUTPUT")) == 0) ||
+            (strcmpIgnoreCase(command, TEXT("STATE_OUTPUT")) == 0) ||
+            (strcmpIgnoreCase(command, TEXT("TIMER_OUTPUT")) == 0) ||
+            (strcmpIgnoreCase(command, TEXT("SLEEP_OUTPUT")) == 0)) {
+        flag = ((param1 != NULL) && (strcmpIgnoreCase(param1, TEXT("TRUE")) == 0));
+        if (strcmpIgnoreCase(command, TEXT("LOOP_OUTPUT")) == 0) {
+            wrapperData->isLoopOutputEnabled = flag;
+        } else if (strcmpIgnoreCase(command, TEXT("STATE_OUTPUT")) == 0) {
+            wrapperData->isStateOutputEnabled = flag;
+        } else if (strcmpIgnoreCase(command, TEXT("TIMER_OUTPUT")) == 0) {
+            wrapperData->isTickOutputEnabled = flag;
+        } else if (strcmpIgnoreCase(command, TEXT("SLEEP_OUTPUT")) == 0) {
+            wrapperData->isSleepOutputEnabled = flag;
+        }
+        if (flag) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Enable %s."), command, command);
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Disable %s."), command, command);
+        }
+    } else if (strcmpIgnoreCase(command, TEXT("NAK")) == 0) {
+        if (wrapperData->commandFileTests) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Sending NAK signal to the JVM..."), command);
+            wrapperProtocolFunction(MSG_NAK, TEXT("\x03\x03"));
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        }
+    } else if ((strcmpIgnoreCase(command, TEXT("CLOSE_SOCKET")) == 0) || (strcmpIgnoreCase(command, TEXT("CLOSE_BACKEND")) == 0)) {
+        if (wrapperData->commandFileTests) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Closing backend socket to JVM..."), command);
+            wrapperProtocolClose();
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        }
+    } else if (strcmpIgnoreCase(command, TEXT("PAUSE_THREAD")) == 0) {
+        if (wrapperData->commandFileTests) {
+            if (param2 == NULL) {
+                pauseTime = -1;
+            } else {
+                pauseTime = __max(0, __min(3600, _ttoi(param2)));
+            }
+            if (strcmpIgnoreCase(param1, TEXT("MAIN")) == 0) {
+                wrapperData->pauseThreadMain = pauseTime;
+            } else if (strcmpIgnoreCase(param1, TEXT("TIMER")) == 0) {
+                wrapperData->pauseThreadTimer = pauseTime;
+            } else if (strcmpIgnoreCase(param1, TEXT("JAVAIO")) == 0) {
+                wrapperData->pauseThreadJavaIO = pauseTime;
+            } else {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause unknown thread."), command);
+                pauseTime = 0;
+                result = WRAPPER_COMMAND_INVALID;
+            }
+            if (pauseTime > 0) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause %s thread for %d seconds..."), command, param1, pauseTime);
+            } else if (pauseTime < 0) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause %s thread indefinitely..."), command, param1);
+            }
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        }
+    } else if (strcmpIgnoreCase(command, TEXT("PAUSE_LOGGER")) == 0) {
+        if (wrapperData->commandFileTests) {
+            if (param1 == NULL) {
+                pauseTime = -1;
+            } else {
+                pauseTime = __max(0, __min(3600, _ttoi(param1)));
+            }
+            if (pauseTime > 0) {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause logger for %d seconds..."), command, pauseTime);
+            } else {
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause logger indefinitely..."), command);
+            }
+            setPauseTime(pauseTime);
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        }
+    } else if (strcmpIgnoreCase(command, TEXT("ACCESS_VIOLATION")) == 0) {
+        if (wrapperData->commandFileTests) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Command '%s'.  Intentionally causing an Access Violation in Wrapper..."), command);
+            crash = COMMAND_CRASH_ACCESS_VIOLATION;
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        }
+#ifdef TEST_FORTIFY_SOURCE
+    } else if (strcmpIgnoreCase(command, TEXT("BUFFER_OVERFLOW1")) == 0) {
+        if (wrapperData->commandFileTests) {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Command '%s'.  Intentionally causing a Buffer Overflow in Wrapper..."), command);
+            crash = COMMAND_CRASH_BUFFER_OVERFLOW1;
+        } else {
+            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
+            result = WRAPPER_COMMAND_INVALID;
+        }
+#endif
+    } else {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' is unknown, ignoring."), command);
+        result = WRAPPER_COMMAND_UNKNOWN;
+    }
+
+    if (crash != COMMAND_CRASH_NONE) {
+        if (pDeferredCrash) {
+            /* The caller will crash once it has cleaned up. */
+            *pDeferredCrash = crash;
+        } else {
+            commandCrash(crash);
+        }
+    }
+    return result;
+}
+
 /**
  * Tests for the existence of the command file.  If it exists then it will be
  *  opened and any included commands will be processed.  On completion, the
@@ -586,7 +1119,6 @@ struct S {
  *
  * nowTicks: The tick counter value this time through the event loop.
  */
-#define MAX_COMMAND_LENGTH 80
 void commandPoll(TICKS nowTicks) {
 #if defined(WIN32) && !defined(WIN64)
     struct _stat64i32 fileStat;
@@ -598,19 +1130,7 @@ void commandPoll(TICKS nowTicks) {
     int cnt;
     TCHAR buffer[MAX_COMMAND_LENGTH];
     TCHAR *c;
-    TCHAR *d;
-    TCHAR *command;
-    TCHAR *param1;
-    TCHAR *param2;
-    int exitCode;
-    int pauseTime;
-    int logLevel;
-    int oldLowLogLevel;
-    int newLowLogLevel;
-    int flag;
-    int accessViolation = FALSE;
-    int bufferOverflow1 = FALSE;
-    size_t i;
+    int crash = COMMAND_CRASH_NONE;
 
 #ifdef _DEBUG
     log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO,
@@ -618,7 +1138,7 @@ void commandPoll(TICKS nowTicks) {
 #endif
 
     if (wrapperData->commandFilename) {
-        if (wrapperTickExpired(nowTicks, wrapperData->commandTimeoutTicks)) {
+        if (fileCheckDue(fileWatchCommand, nowTicks, wrapperData->commandTimeoutTicks)) {
             if (wrapperData->isLoopOutputEnabled) {
                 log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Loop: check command file"));
             }
@@ -652,235 +1172,9 @@ void commandPoll(TICKS nowTicks) {
                     do {
                         c = _fgetts(buffer, MAX_COMMAND_LENGTH, stream);
                         if (c != NULL) {
-                            /* Always strip both ^M and ^J off the end of the line, this is done rather
-                             *  than simply checking for \n so that files will work on all platforms
-                             *  even if their line feeds are incorrect. */
-                            if ((d = _tcschr(buffer, 13 /* ^M */)) != NULL) {
-                                d[0] = TEXT('\0');
-                            }
-                            if ((d = _tcschr(buffer, 10 /* ^J */)) != NULL) {
-                                d[0] = TEXT('\0');
-                            }
-
-                            command = buffer;
-                            
-                            /* Remove any leading space or tabs */
-                            while (command[0] == TEXT(' ') || command[0] == TEXT('\t')) {
-                                command++;
-                            }
-                            if (command[0] == TEXT('\0')) {
-                                /* Empty line. Ignore it silently. */
-                                continue;
-                            }
-                            /* Remove any tailing space or tabs */
-                            i = _tcslen(command) - 1;
-                            while (command[i] == TEXT(' ') || command[i] == TEXT('\t')) {
-                                i--;
-                            }
-                            command[i + 1] = TEXT('\0');
-
-                            /** Look for the first space, everything after it will be the parameter(s). */
-                            /* Look for parameter 1. */
-                            if ((param1 = _tcschr(command, ' ')) != NULL ) {
-                                param1[0] = TEXT('\0'); /* Terminate the command. */
-
-                                /* Find the first non-space character. */
-                                do {
-                                    param1++;
-                                } while (param1[0] == TEXT(' '));
-                            }
-                            if (param1 != NULL) {
-                                /* Look for parameter 2. */
-                                if ((param2 = _tcschr(param1, ' ')) != NULL ) {
-                                    param2[0] = TEXT('\0'); /* Terminate param1. */
-    
-                                    /* Find the first non-space character. */
-                                    do {
-                                        param2++;
-                                    } while (param2[0] == TEXT(' '));
-                                }
-                                if (param2 != NULL) {
-                                    /* Make sure parameter 2 is terminated. */
-                                    if ((d = _tcschr(param2, ' ')) != NULL ) {
-                                        d[0] = TEXT('\0'); /* Terminate param2. */
-                                    }
-                                }
-                            } else {
-                                param2 = NULL;
-                            }
-
-                            /* Process the command. */
-                            if (strcmpIgnoreCase(command, TEXT("RESTART")) == 0) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. %s"), command, wrapperGetRestartProcessMessage());
-                                wrapperRestartProcess();
-                            } else if (strcmpIgnoreCase(command, TEXT("STOP")) == 0) {
-                                if (param1 == NULL) {
-                                    exitCode = 0;
-                                } else {
-                                    exitCode = _ttoi(param1);
-                                }
-                                
-                                if (exitCode < 0 || exitCode > 255) {
-                                    exitCode = wrapperData->errorExitCode;
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN,
-                                        TEXT("The exit code specified along with the 'STOP' command must be in the range %d to %d.\n  Changing to the default error exit code %d."), 1, 255, exitCode);
-                                }
-                                
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Shutting down with exit code %d."), command, exitCode);
-
-                                /* Always force the shutdown as this is an external event. */
-                                wrapperStopProcess(exitCode, TRUE);
-                                
-                                /* To make sure that the JVM will not be restarted for any reason,
-                                 *  start the Wrapper shutdown process as well. */
-                                if ((wrapperData->wState == WRAPPER_WSTATE_STOPPING) ||
-                                    (wrapperData->wState == WRAPPER_WSTATE_STOPPED)) {
-                                    /* Already stopping. */
-                                } else {
-                                    wrapperSetWrapperState(WRAPPER_WSTATE_STOPPING);
-                                }
-                            } else if (strcmpIgnoreCase(command, TEXT("PAUSE")) == 0) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. %s"), command, wrapperGetPauseProcessMessage());
-                                wrapperPauseProcess(WRAPPER_ACTION_SOURCE_CODE_COMMANDFILE);
-                            } else if (strcmpIgnoreCase(command, TEXT("RESUME")) == 0) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. %s"), command, wrapperGetResumeProcessMessage());
-                                wrapperResumeProcess(WRAPPER_ACTION_SOURCE_CODE_COMMANDFILE);
-                            } else if (strcmpIgnoreCase(command, TEXT("DUMP")) == 0) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Requesting a Thread Dump."), command);
-                                wrapperRequestDumpJVMState();
-                            } else if (strcmpIgnoreCase(command, TEXT("GC")) == 0) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Requesting a GC."), command);
-                                wrapperRequestJVMGC(WRAPPER_ACTION_SOURCE_CODE_COMMANDFILE);
-                            } else if ((strcmpIgnoreCase(command, TEXT("CONSOLE_LOGLEVEL")) == 0) ||
-                                    (strcmpIgnoreCase(command, TEXT("LOGFILE_LOGLEVEL")) == 0) ||
-                                    (strcmpIgnoreCase(command, TEXT("SYSLOG_LOGLEVEL")) == 0)) {
-                                if (param1 == NULL) {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' is missing its log level."), command);
-                                } else {
-                                    logLevel = getLogLevelForName(param1);
-                                    if (logLevel == LEVEL_UNKNOWN) {
-                                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' specified an unknown log level: '%'"), command, param1);
-                                    } else {
-                                        oldLowLogLevel = getLowLogLevel();
-
-                                        if (strcmpIgnoreCase(command, TEXT("CONSOLE_LOGLEVEL")) == 0) {
-                                            setConsoleLogLevelInt(logLevel);
-                                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Set console log level to '%s'."), command, param1);
-                                        } else if (strcmpIgnoreCase(command, TEXT("LOGFILE_LOGLEVEL")) == 0) {
-                                            setLogfileLevelInt(logLevel);
-                                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Set log file log level to '%s'."), command, param1);
-                                        } else if (strcmpIgnoreCase(command, TEXT("SYSLOG_LOGLEVEL")) == 0) {
-                                            setSyslogLevelInt(logLevel);
-                                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Set syslog log level to '%s'."), command, param1);
-                                        } else {
-                                            /* Shouldn't get here. */
-                                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' lead to an unexpected state."), command);
-                                        }
-
-                                        newLowLogLevel = getLowLogLevel();
-                                        if (oldLowLogLevel != newLowLogLevel) {
-                                            wrapperData->isDebugging = (newLowLogLevel <= LEVEL_DEBUG);
-
-                                            _sntprintf(buffer, MAX_COMMAND_LENGTH, TEXT("%d"), getLowLogLevel());
-                                            wrapperProtocolFunction(WRAPPER_MSG_LOW_LOG_LEVEL, buffer);
-                                        }
-                                    }
-                                }
-                            } else if ((strcmpIgnoreCase(command, TEXT("LOOP_OUTPUT")) == 0) ||
-                                    (strcmpIgnoreCase(command, TEXT("STATE_OUTPUT")) == 0) ||
-                                    (strcmpIgnoreCase(command, TEXT("TIMER_OUTPUT")) == 0) ||
-                                    (strcmpIgnoreCase(command, TEXT("SLEEP_OUTPUT")) == 0)) {
-                                flag = ((param1 != NULL) && (strcmpIgnoreCase(param1, TEXT("TRUE")) == 0));
-                                if (strcmpIgnoreCase(command, TEXT("LOOP_OUTPUT")) == 0) {
-                                    wrapperData->isLoopOutputEnabled = flag;
-                                } else if (strcmpIgnoreCase(command, TEXT("STATE_OUTPUT")) == 0) {
-                                    wrapperData->isStateOutputEnabled = flag;
-                                } else if (strcmpIgnoreCase(command, TEXT("TIMER_OUTPUT")) == 0) {
-                                    wrapperData->isTickOutputEnabled = flag;
-                                } else if (strcmpIgnoreCase(command, TEXT("SLEEP_OUTPUT")) == 0) {
-                                    wrapperData->isSleepOutputEnabled = flag;
-                                }
-                                if (flag) {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Enable %s."), command, command);
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Command '%s'. Disable %s."), command, command);
-                                }
-                            } else if (strcmpIgnoreCase(command, TEXT("NAK")) == 0) {
-                                if (wrapperData->commandFileTests) {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Sending NAK signal to the JVM..."), command);
-                                    wrapperProtocolFunction(MSG_NAK, TEXT("\x03\x03"));
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
-                                }
-                            } else if ((strcmpIgnoreCase(command, TEXT("CLOSE_SOCKET")) == 0) || (strcmpIgnoreCase(command, TEXT("CLOSE_BACKEND")) == 0)) {
-                                if (wrapperData->commandFileTests) {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Closing backend socket to JVM..."), command);
-                                    wrapperProtocolClose();
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
-                                }
-                            } else if (strcmpIgnoreCase(command, TEXT("PAUSE_THREAD")) == 0) {
-                                if (wrapperData->commandFileTests) {
-                                    if (param2 == NULL) {
-                                        pauseTime = -1;
-                                    } else {
-                                        pauseTime = __max(0, __min(3600, _ttoi(param2)));
-                                    }
-                                    if (strcmpIgnoreCase(param1, TEXT("MAIN")) == 0) {
-                                        wrapperData->pauseThreadMain = pauseTime;
-                                    } else if (strcmpIgnoreCase(param1, TEXT("TIMER")) == 0) {
-                                        wrapperData->pauseThreadTimer = pauseTime;
-                                    } else if (strcmpIgnoreCase(param1, TEXT("JAVAIO")) == 0) {
-                                        wrapperData->pauseThreadJavaIO = pauseTime;
-                                    } else {
-                                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause unknown thread."), command);
-                                        pauseTime = 0;
-                                    }
-                                    if (pauseTime > 0) {
-                                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause %s thread for %d seconds..."), command, param1, pauseTime);
-                                    } else if (pauseTime < 0) {
-                                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause %s thread indefinitely..."), command, param1);
-                                    }
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
-                                }
-                            } else if (strcmpIgnoreCase(command, TEXT("PAUSE_LOGGER")) == 0) {
-                                if (wrapperData->commandFileTests) {
-                                    if (param1 == NULL) {
-                                        pauseTime = -1;
-                                    } else {
-                                        pauseTime = __max(0, __min(3600, _ttoi(param1)));
-                                    }
-                                    if (pauseTime > 0) {
-                                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause logger for %d seconds..."), command, pauseTime);
-                                    } else {
-                                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Enqueue request to pause logger indefinitely..."), command);
-                                    }
-                                    setPauseTime(pauseTime);
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
-                                }
-                            } else if (strcmpIgnoreCase(command, TEXT("ACCESS_VIOLATION")) == 0) {
-                                if (wrapperData->commandFileTests) {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Command '%s'.  Intentionally causing an Access Violation in Wrapper..."), command);
-                                    /* We can't do the access violation here because we want to make sure the
-                                     *  file is deleted first, otherwise it be executed again when the Wrapper is restarted. */
-                                    accessViolation = TRUE;
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
-                                }
-#ifdef TEST_FORTIFY_SOURCE
-                            } else if (strcmpIgnoreCase(command, TEXT("BUFFER_OVERFLOW1")) == 0) {
-                                if (wrapperData->commandFileTests) {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_FATAL, TEXT("Command '%s'.  Intentionally causing a Buffer Overflow in Wrapper..."), command);
-                                    bufferOverflow1 = TRUE;
-                                } else {
-                                    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s'.  Tests disabled."), command);
-                                }
-#endif
-                            } else {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_WARN, TEXT("Command '%s' is unknown, ignoring."), command);
-                            }
+                            /* We can't crash right away because we want to make sure the file is deleted
+                             *  first, otherwise the command would be executed again when the Wrapper is restarted. */
+                            wrapperExecuteCommand(buffer, WRAPPER_ACTION_SOURCE_CODE_COMMANDFILE, &crash);
                         }
                     } while (c != NULL);
 
@@ -897,23 +1191,8 @@ void commandPoll(TICKS nowTicks) {
                             TEXT("Command file has been processed and deleted."));
                     }
                     
-                    if (accessViolation || bufferOverflow1) {
-                        /* Make sure that everything is logged before the crash. */
-                        flushLogfile();
-                        
-                        if (accessViolation) {
-                            /* Actually cause the access violation. */
-                            c = NULL;
-                            c[0] = TEXT('\0');
-                            /* Should never get here. */
-                        }
-#ifdef TEST_FORTIFY_SOURCE
-                        if (bufferOverflow1) {
-                            /* Actually cause the buffer overflow. */
-                            strcpy (&var.t.buf[1], "abcdefg");
-                            /* Should never get here. */
-                        }
-#endif
+                    if (crash != COMMAND_CRASH_NONE) {
+                        commandCrash(crash);
                     }
                 }
             } else {
@@ -1095,17 +1374,23 @@ void wStateResuming(TICKS nowTicks) {
  * nowTicks: The tick counter value this time through the event loop.
  */
 void wStateStopping(TICKS nowTicks) {
+    int instancesDown = TRUE;
+
     /* The wrapper is stopping, we need to ping the service manager
      *  to reasure it that we are still alive. */
 
 #ifdef WIN32
     /* Tell the service manager that we are stopping */
     wrapperReportStatus(FALSE, WRAPPER_WSTATE_STOPPING, wrapperData->exitCode, wrapperData->ntShutdownWaitHint * 1000);
+#else
+    /* The additional instances are stopped along with the JVM. */
+    wrapperInstancesStop(nowTicks);
+    instancesDown = wrapperInstancesDown();
 #endif
 
     /* If the JVM state is now DOWN_CLEAN, then change the wrapper state
      *  to be STOPPED as well. */
-    if (wrapperData->jState == WRAPPER_JSTATE_DOWN_CLEAN) {
+    if ((wrapperData->jState == WRAPPER_JSTATE_DOWN_CLEAN) && instancesDown) {
         wrapperSetWrapperState(WRAPPER_WSTATE_STOPPED);
 
         /* Don't tell the service manager that we stopped here.  That
@@ -1413,6 +1698,7 @@ void jStateLaunchDelay(TICKS nowTicks) {
     int addWrapperToClassPath;
     TCHAR *ptr;
     int userDefined;
+    int useModules;
     int checkJavaCommand;
 
     /* The Waiting state is set from the DOWN_CLEAN state if a JVM had
@@ -1456,6 +1742,9 @@ void jStateLaunchDelay(TICKS nowTicks) {
                          *  The JVM is already down.  Shutdown the Wrapper. */
                         goto stop;
                     }
+#ifdef LINUX
+                    fileWatchRefresh();
+#endif
 #ifndef WIN32
                     /* Reset the group of the pid files in case the properties were changed.
                      *  All PID files related to the Java process will be recreated so it is not necessary to reset their group. */
@@ -1509,6 +1798,11 @@ void jStateLaunchDelay(TICKS nowTicks) {
                 goto stop;
             }
 
+#ifdef LINUX
+            /* The ring is created for each JVM, as its file is removed once the JVM has opened it. */
+            wrapperProtocolCreateRing();
+#endif
+
             /* Java will be executed a few times before launching the application:
              *  1) to query the Java version
              *  2) to query additional information (module, mainclass, etc.) using the WrapperBootstrap class
@@ -1523,8 +1817,14 @@ void jStateLaunchDelay(TICKS nowTicks) {
                 goto stop;
             }
 
-            /* Get the Java version. */
-            ret = wrapperLaunchJavaVersion(postProcessJavaQuery, nowTicks);
+            /* Get the Java version.  It is usually in the 'release' file of the Java installation, which is much faster to read than launching a JVM. */
+            wrapperProfileBegin(TEXT("resolve Java version"));
+            if (!wrapperData->printJVMVersion && getBooleanProperty(properties, TEXT("wrapper.java.version.release_file"), TRUE) && wrapperResolveJavaVersionFromRelease()) {
+                ret = 0;
+            } else {
+                ret = wrapperLaunchJavaVersion(postProcessJavaQuery, nowTicks);
+            }
+            wrapperProfileEnd(TEXT("resolve Java version"));
             if (ret == -1) {
                 goto stop;
             } else if (ret == 0) {
@@ -1708,9 +2008,11 @@ void jStateLaunchDelay(TICKS nowTicks) {
                 } else {
                     addWrapperToClassPath = FALSE;
                 }
+                wrapperProfileBegin(TEXT("build classpath"));
                 if (wrapperBuildJavaClasspath(&wrapperData->classpath, addWrapperToClassPath) < 0) {
                     goto stop;
                 }
+                wrapperProfileEnd(TEXT("build classpath"));
 
                 /* Update the CLASSPATH in the environment if requested so the Bootstrap and dry-run calls can access it. */ 
                 if (wrapperData->environmentClasspath) {
@@ -1750,16 +2052,27 @@ void jStateLaunchDelay(TICKS nowTicks) {
                         goto stop;
                     }
                 }
-                ret = wrapperLaunchBootstrap(postProcessJavaQuery, nowTicks);
+                /* The Java bootstrap is only needed to find a main class in a module.  Otherwise the jar files can be read directly. */
+                useModules = wrapperData->moduleList || wrapperData->mainModule || wrapperData->modulePath || userDefined ||
+                             (wrapperData->upgradeModulePath && !addWrapperToUpgradeModulePath);
+                wrapperProfileBegin(TEXT("resolve bootstrap"));
+                if (!useModules && !isWrapperJarEmbedded && getBooleanProperty(properties, TEXT("wrapper.java.bootstrap.native"), TRUE) && wrapperResolveBootstrap()) {
+                    ret = 0;
+                } else {
+                    ret = wrapperLaunchBootstrap(postProcessJavaQuery, nowTicks);
+                }
+                wrapperProfileEnd(TEXT("resolve bootstrap"));
                 if ((ret == -1) || wrapperData->jvmBootstrapFailed) {
                     goto stop;
                 } else if (ret == 0) {
                     /* Resolve the encoding to be used for reading the JVM output (this needs to be done before building the Java command line). */
+                    wrapperProfileBegin(TEXT("resolve JVM encoding"));
                     if (resolveJvmEncoding(wrapperData->javaVersion->major, wrapperData->jvmVendor)) {
                         /* Failed to get the encoding of the JVM output.
                          *  Stop here because won't be able to display output correctly. */
                         goto stop;
                     }
+                    wrapperProfileEnd(TEXT("resolve JVM encoding"));
 
                     /* The internal application property array is used when building the command line.
                      *  Building the array here is also useful to verify before starting the appplication
@@ -1771,10 +2084,12 @@ void jStateLaunchDelay(TICKS nowTicks) {
                     checkJavaCommand = isJava9 && getBooleanProperty(properties, TEXT("wrapper.java.command.check"), TRUE);
 
                     /* Generate the command used to launch the Java process */
+                    wrapperProfileBegin(TEXT("build Java command"));
                     if (wrapperBuildJavaCommand(checkJavaCommand)) {
                         /* Failed. Wrapper shutdown. */
                         goto stop;
                     }
+                    wrapperProfileEnd(TEXT("build Java command"));
 
                     if (wrapperData->useBackendParameters) {
                         /* If application parameters are going to be sent via the backend, we want to
@@ -1787,7 +2102,9 @@ void jStateLaunchDelay(TICKS nowTicks) {
                     /* Check the command used to launch the Java process */
                     if (checkJavaCommand) {
                         /* Launch the command with the --dry-run option. */
+                        wrapperProfileBegin(TEXT("check Java command"));
                         ret = wrapperLaunchDryJavaApp(postProcessJavaQuery, nowTicks);
+                        wrapperProfileEnd(TEXT("check Java command"));
                         if (ret == -1) {
                             goto stop;
                         } else if (ret == 1) {
@@ -1871,6 +2188,7 @@ void jStateRestart(TICKS nowTicks) {
  * nowTicks: The tick counter value this time through the event loop.
  */
 void jStateLaunch(TICKS nowTicks) {
+    int ret;
 
     if ((wrapperData->wState == WRAPPER_WSTATE_STARTING) ||
         (wrapperData->wState == WRAPPER_WSTATE_STARTED) ||
@@ -1880,7 +2198,10 @@ void jStateLaunch(TICKS nowTicks) {
             log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("Launching a JVM..."));
         }
 
-        if (wrapperLaunchJavaApp()) {
+        wrapperProfileBegin(TEXT("launch JVM"));
+        ret = wrapperLaunchJavaApp();
+        wrapperProfileEnd(TEXT("launch JVM"));
+        if (ret) {
             /* We know that there was a problem launching the JVM process.
              *  If we fail at this level, assume it is a critical problem and don't bother trying to restart later.
              *  A message should have already been logged. */
@@ -1994,6 +2315,8 @@ void jStateLaunched(TICKS nowTicks) {
         /* Restart the JVM. */
         wrapperData->restartRequested = WRAPPER_RESTART_REQUESTED_AUTOMATIC;
     } else {
+        wrapperProfileMark(TEXT("start sent"));
+
         /* Start command send.  Start waiting for the app to signal
          *  that it has started.  Allow <startupTimeout> seconds before
          *  giving up.  A good application will send starting signals back
@@ -2050,11 +2373,12 @@ void jStateStarting(TICKS nowTicks) {
  *
  * nowTicks: The tick counter value this time through the event loop.
  */
-#define JSTATESTARTED_MESSAGE_MAXLEN (7 + 8 + 1) /* "silent ffffffff\0" */
+#define JSTATESTARTED_MESSAGE_MAXLEN (7 + 8 + 1 + 8 + 1) /* "silent ffffffff ffffffff\0" */
 void jStateStarted(TICKS nowTicks) {
     int ret;
     TCHAR protocolMessage[JSTATESTARTED_MESSAGE_MAXLEN];
     PPendingPing pendingPing;
+    unsigned int sentMicros;
 
     /* Make sure that the JVM process is still up and running */
     if (wrapperCheckAndUpdateProcessStatus(nowTicks, FALSE) == WRAPPER_PROCESS_DOWN) {
@@ -2064,15 +2388,22 @@ void jStateStarted(TICKS nowTicks) {
     
     /* Look for any PendingPings which are slow but that we have not yet made a note of.
      *  Don't worry about the posibility of finding more than one in a single pass as that should only happen if the Wrapper process was without CPU for a while.  We will quickly catchup on the following cycles. */
-    if (wrapperData->firstUnwarnedPendingPing != NULL) {
-        if ((wrapperData->pingAlertThreshold > 0) && (wrapperGetTickAgeTicks(wrapperData->firstUnwarnedPendingPing->slowTicks, nowTicks) >= 0)) {
+    if ((int)(wrapperData->pingSeqUnwarned - wrapperData->pingSeqOldest) < 0) {
+        wrapperData->pingSeqUnwarned = wrapperData->pingSeqOldest;
+    }
+    if (wrapperData->pingSeqUnwarned != wrapperData->pingSeqNext) {
+        pendingPing = &(wrapperData->pendingPings[wrapperData->pingSeqUnwarned & (WRAPPER_PENDING_PING_SLOTS - 1)]);
+        if (pendingPing->state != PENDING_PING_WAITING) {
+            /* Already answered or lost.  Skip it. */
+            wrapperData->pingSeqUnwarned++;
+        } else if ((wrapperData->pingAlertThreshold > 0) && (wrapperGetTickAgeTicks(pendingPing->slowTicks, nowTicks) >= 0)) {
             /* This PendingPing is considered slow. 
              *  Note: The number of times wrapperPingSlow() is called can be limited if WRAPPER_MAX_PENDING_PINGS is reached. But the 'jvm_ping_slow' event
              *        is mainly used to warn when the JVM is slow before we time out, and having a few warnings should be enough for most use cases. */
             wrapperPingSlow();
             
-            /* Remove the PendingPing so it won't be warned again.  It still exists in the main list, so it should not be cleaned up here. */
-            wrapperData->firstUnwarnedPendingPing = wrapperData->firstUnwarnedPendingPing->nextPendingPing;
+            /* Move on so it won't be warned again.  It is still pending, so it should not be cleaned up here. */
+            wrapperData->pingSeqUnwarned++;
         }
     }
     
@@ -2095,35 +2426,27 @@ void jStateStarted(TICKS nowTicks) {
         }
     } else if (wrapperGetTickAgeTicks(wrapperAddToTicks(wrapperData->lastPingTicks, wrapperData->pingInterval), nowTicks) >= 0) {
         /* It is time to send another ping to the JVM */
-            if (wrapperData->pendingPingQueueOverflow && (!wrapperData->pendingPingQueueOverflowEmptied)) {
+            if (wrapperPingPendingCount() >= WRAPPER_MAX_PENDING_PINGS) {
                 /* There are already too many pending Pings. Keep sending more pings would not help anything and is a risk of
-                 *  filling up the pipe if the frequency is too high and the timeout to kill to the JVM is set to a large value. */
-
-                /* To resume pinging, two strategies would work:
-                 *  1) start sending pings again once the queue goes back to WRAPPER_MAX_PENDING_PINGS -1.
-                 *  2) start sending pings again once the queue is emptied and reset.
-                 *  => I find it more clear to not send any ping until we fully catch up, so I prefer 2).
-                 *     Notes: - When the queue will be emptied and reset, a new ping will be sent almost immediately because 
-                 *              wrapperData->lastPingTicks will be old enough.
-                 *            - A ping is always sent before its corresponding pendingPing object is created. Therefore, when 
-                 *              the queue of pendingPings is full, a final ping is sent but not added to the pendingPing queue.
-                 *              This ensures that there is at least one more ping waiting for reading in the pipe (or socket)
-                 *              following last pendingPing object. When pinging resumes, this final ping will be the first to
-                 *              be received by the Wrapper, with minimal delay.
-                 */
+                 *  filling up the pipe if the frequency is too high and the timeout to kill to the JVM is set to a large value.
+                 *  Pinging resumes as soon as the JVM answers one of them, or a later one that shows the older ones were lost. */
+#ifdef DEBUG_PING_QUEUE
+                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Full"));
+#endif
             } else {
+                sentMicros = wrapperGetMicros();
                 if (wrapperGetTickAgeTicks(wrapperAddToTicks(wrapperData->lastLoggedPingTicks, wrapperData->pingIntervalLogged), nowTicks) >= 0) {
                     if (wrapperData->isLoopOutputEnabled) {
                         log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Loop: Sending a ping packet."));
                     }
-                    _sntprintf(protocolMessage, JSTATESTARTED_MESSAGE_MAXLEN, TEXT("ping %08x"), nowTicks);
+                    _sntprintf(protocolMessage, JSTATESTARTED_MESSAGE_MAXLEN, TEXT("ping %08x %08x"), nowTicks, wrapperData->pingSeqNext);
                     ret = wrapperProtocolFunction(WRAPPER_MSG_PING, protocolMessage);
                     wrapperData->lastLoggedPingTicks = nowTicks;
                 } else {
                     if (wrapperData->isLoopOutputEnabled) {
                         log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Loop: Sending a silent ping packet."));
                     }
-                    _sntprintf(protocolMessage, JSTATESTARTED_MESSAGE_MAXLEN, TEXT("silent %08x"), nowTicks);
+                    _sntprintf(protocolMessage, JSTATESTARTED_MESSAGE_MAXLEN, TEXT("silent %08x %08x"), nowTicks, wrapperData->pingSeqNext);
                     ret = wrapperProtocolFunction(WRAPPER_MSG_PING, protocolMessage);
                 }
                 if (ret) {
@@ -2133,49 +2456,10 @@ void jStateStarted(TICKS nowTicks) {
                     }
                 } else {
                     /* Ping sent successfully. */
-                    if (wrapperData->pendingPingCount >= WRAPPER_MAX_PENDING_PINGS) {
-                        if (wrapperData->isDebugging) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Too many Pending Pings.  Disabling some ping checks until the JVM has caught up."));
-                        }
-                        wrapperData->pendingPingQueueOverflow = TRUE;
-                        wrapperData->pendingPingQueueOverflowEmptied = FALSE;
-#ifdef DEBUG_PING_QUEUE
-                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    PING QUEUE Set Overflow"));
-#endif
-                    } else {
-                        pendingPing = malloc(sizeof(PendingPing));
-                        if (!pendingPing) {
-                            outOfMemory(TEXT("JSS"), 1);
-                        } else {
-                            memset(pendingPing, 0, sizeof(PendingPing));
-                            
-                            pendingPing->sentTicks = nowTicks;
-                            pendingPing->slowTicks = wrapperAddToTicks(nowTicks, wrapperData->pingAlertThreshold);
-                            
-                            /*  Add it to the PendingPing queue. */
-                            if (wrapperData->firstPendingPing == NULL) {
-                                /* The queue was empty. */
-                                wrapperData->pendingPingCount = 1;
-                                wrapperData->firstUnwarnedPendingPing = pendingPing;
-                                wrapperData->firstPendingPing = pendingPing;
-                                wrapperData->lastPendingPing = pendingPing;
-                            } else {
-                                /* Add to the end of an existing queue. */
-                                wrapperData->pendingPingCount++;
-                                if (wrapperData->firstUnwarnedPendingPing == NULL) {
-                                    wrapperData->firstUnwarnedPendingPing = pendingPing;
-                                }
-                                wrapperData->lastPendingPing->nextPendingPing = pendingPing;
-                                wrapperData->lastPendingPing = pendingPing;
-                            }
-#ifdef DEBUG_PING_QUEUE
-                            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("+++ PING QUEUE Size: %d"), wrapperData->pendingPingCount);
-#endif
-                            
-                            if ((wrapperData->pendingPingCount > 1) && wrapperData->isDebugging) {
-                                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Pending Pings %d"), wrapperData->pendingPingCount);
-                            }
-                        }
+                    wrapperPingSent(nowTicks, sentMicros);
+                    
+                    if ((wrapperPingPendingCount() > 1) && wrapperData->isDebugging) {
+                        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Pending Pings %d"), wrapperPingPendingCount());
                     }
                 }
                 
@@ -2562,8 +2846,6 @@ void jStateDownFlushStdin(TICKS nowTicks) {
  * nowTicks: The tick counter value this time through the event loop.
  */
 void jStateDownFlush(TICKS nowTicks) {
-    PPendingPing pendingPing;
-    
     /* Always proceed after a single cycle. */
     /* TODO - Look into ways of reliably detecting when the backend and stdout piles are closed. */
     
@@ -2573,49 +2855,17 @@ void jStateDownFlush(TICKS nowTicks) {
      *  still open at this point. */
     wrapperProtocolClose();
     
-    /* Make sure that the PendingPing pool is empty so they don't cause strange behavior with the next JVM invocation. */
-    if (wrapperData->firstPendingPing != NULL) {
-        if (wrapperData->isDebugging) {
-            log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("%d pings were not replied to when the JVM process exited."), wrapperData->pendingPingCount);
-        }
-        while (wrapperData->firstPendingPing != NULL) {
-            pendingPing = wrapperData->firstPendingPing;
-            if (pendingPing->nextPendingPing != NULL) {
-                /* This was the first PendingPing of several in the queue. */
-                wrapperData->pendingPingCount--;
-                if (wrapperData->firstUnwarnedPendingPing == wrapperData->firstPendingPing) {
-                    wrapperData->firstUnwarnedPendingPing = pendingPing->nextPendingPing;
-                }
-                wrapperData->firstPendingPing = pendingPing->nextPendingPing;
-                pendingPing->nextPendingPing = NULL;
-#ifdef DEBUG_PING_QUEUE
-                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Size: %d"), wrapperData->pendingPingCount);
-#endif
-            } else {
-                /* This was the only PendingPing in the queue. */
-                wrapperData->pendingPingCount = 0;
-                wrapperData->firstUnwarnedPendingPing = NULL;
-                wrapperData->firstPendingPing = NULL;
-                wrapperData->lastPendingPing = NULL;
-#ifdef DEBUG_PING_QUEUE
-                log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Empty.") );
-#endif
-            }
-            
-            /* Free up the pendingPing object. */
-            if (pendingPing != NULL) {
-                free(pendingPing);
-                pendingPing = NULL;
-            }
-        }
+    /* Make sure that the PendingPing ring is empty so they don't cause strange behavior with the next JVM invocation. */
+    if ((wrapperPingPendingCount() > 0) && wrapperData->isDebugging) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("%d pings were not replied to when the JVM process exited."), wrapperPingPendingCount());
     }
-    if (wrapperData->pendingPingQueueOverflow) {
-        wrapperData->pendingPingQueueOverflow = FALSE;
-        wrapperData->pendingPingQueueOverflowEmptied = FALSE;
+    wrapperPingQueueReset();
 #ifdef DEBUG_PING_QUEUE
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Reset Overflow.") );
+    log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("--- PING QUEUE Empty.") );
 #endif
-    }
+    
+    /* The round trip times of the next JVM should not be mixed with those of this one. */
+    wrapperPingStatsReset();
     
     /* We are now down and clean. */
     wrapperSetJavaState(WRAPPER_JSTATE_DOWN_CLEAN, nowTicks, -1);
@@ -2669,6 +2919,52 @@ void logTickTimerStats() {
     }
 }
 
+#ifndef WIN32
+#define EVENT_LOOP_MAX_POLL_FDS     (16 + WRAPPER_INSTANCE_MAX)
+#define EVENT_LOOP_FALLBACK_SLEEP   10
+
+/**
+ * Waits up to ms milliseconds for input on any of the descriptors serviced
+ *  by the event loop.  Falls back to a short sleep when some input can not
+ *  be waited on, so that it is never noticed later than before.
+ */
+static void eventLoopWait(int ms) {
+    struct pollfd fds[EVENT_LOOP_MAX_POLL_FDS];
+    int count;
+    int i;
+    int rc;
+
+    count = wrapperGetPollFds(fds, EVENT_LOOP_MAX_POLL_FDS - 1);
+    if (count < 0) {
+        wrapperProtocolSleep(__min(ms, EVENT_LOOP_FALLBACK_SLEEP));
+        return;
+    }
+ #ifdef LINUX
+    if (fileWatch.fd != -1) {
+        fds[count].fd = fileWatch.fd;
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        count++;
+    }
+ #endif
+
+    if (wrapperData->isSleepOutputEnabled) {
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Sleep: poll %d descriptors %dms"), count, ms);
+    }
+    rc = poll(fds, count, ms);
+    if (rc > 0) {
+        for (i = 0; i < count; i++) {
+            if ((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) && !(fds[i].revents & (POLLIN | POLLOUT))) {
+                /* A descriptor which can not be read any more would wake us up in a loop until it gets closed.
+                 *  Give the cycle a chance to close it without spinning. */
+                wrapperSleep(EVENT_LOOP_FALLBACK_SLEEP);
+                break;
+            }
+        }
+    }
+}
+#endif
+
 /**
  * The main event loop for the wrapper.  Handles all state changes and events.
  */
@@ -2682,6 +2978,7 @@ void wrapperEventLoop() {
     int skipSleep;
     int prevWState;
     int prevJState;
+    int metricsThreadId;
 
     /* Initialize the tick timeouts. */
     wrapperData->anchorTimeoutTicks = lastCycleTicks;
@@ -2708,12 +3005,25 @@ void wrapperEventLoop() {
     }
 
     if (wrapperData->isDebugging) {
-        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Main loop sleep settings: max: %dms, step size: %dms, step cycles: %d"), wrapperData->mainLoopMaxSleepMs, wrapperData->mainLoopSleepStepMs, wrapperData->mainLoopStepCycles);
+        log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_DEBUG, TEXT("Main loop sleep settings: max: %dms, step size: %dms, step cycles: %d, wait events: %s"), wrapperData->mainLoopMaxSleepMs, wrapperData->mainLoopSleepStepMs, wrapperData->mainLoopStepCycles, wrapperData->mainLoopWaitEvents ? TEXT("TRUE") : TEXT("FALSE"));
     }
+    /* A failure to open the metrics endpoint or the control socket has been logged, but is not a reason to stop the Wrapper. */
+    wrapperMetricsStartServer();
+#ifndef WIN32
+    wrapperControlStartServer();
+    wrapperInstancesLoad(properties);
+#endif
+#ifdef LINUX
+    fileWatchStart();
+#endif
+    metricsThreadId = getThreadId();
+    
     nextSleepMs = 0;
     sleepCycle = 0;
     skipSleep = FALSE;
     do {
+        WRAPPER_METRICS_ADD(metricsThreadId, WRAPPER_METRIC_LOOP_CYCLES, 1);
+
         if (wrapperData->isLoopOutputEnabled) {
             log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_STATUS, TEXT("    Loop: sleep: %dms, cycle count: %d"), skipSleep ? 0 : nextSleepMs, sleepCycle);
         }
@@ -2722,11 +3032,23 @@ void wrapperEventLoop() {
         } else {
             if (nextSleepMs > 0) {
                 /* Sleep this cycle to prevent high cpu use. */
-                wrapperSleep(nextSleepMs);
+#ifndef WIN32
+                if (wrapperData->mainLoopWaitEvents) {
+                    eventLoopWait(nextSleepMs);
+                } else {
+                    wrapperProtocolSleep(nextSleepMs);
+                }
+#else
+                wrapperProtocolSleep(nextSleepMs);
+#endif
             }
             
             /* Make any adjustments to the nextSleepMs and sleepCycle. */
-            if (nextSleepMs < wrapperData->mainLoopMaxSleepMs) {
+            if (wrapperData->mainLoopWaitEvents) {
+                /* Any input ends the wait, so there is no need to ease into longer sleeps. */
+                nextSleepMs = wrapperData->mainLoopMaxSleepMs;
+                sleepCycle = 0;
+            } else if (nextSleepMs < wrapperData->mainLoopMaxSleepMs) {
                 if (sleepCycle + 1 >= wrapperData->mainLoopStepCycles) {
                     nextSleepMs += wrapperData->mainLoopSleepStepMs;
                     if (nextSleepMs > wrapperData->mainLoopMaxSleepMs) {
@@ -2914,8 +3236,13 @@ void wrapperEventLoop() {
             wrapperData->logfileFlushTimeoutTicksSet = FALSE;
         }
 
+#ifdef LINUX
+        /* Suspending the system does not show in the monotonic tick count, so report it here. */
+        wrapperCheckSuspend();
+#endif
+
         /* Has the process been getting CPU? This check will only detect a lag
-         * if the useSystemTime flag is set. */
+         * if the useSystemTime or useMonotonicTime flag is set. */
         if (wrapperGetTickAgeSeconds(lastCycleTicks, nowTicks) > wrapperData->cpuTimeout) {
             log_printf(WRAPPER_SOURCE_WRAPPER, LEVEL_INFO,
                 TEXT("Wrapper Process has not received any CPU time for %d seconds.  Extending timeouts."),
@@ -2930,6 +3257,11 @@ void wrapperEventLoop() {
 
         printStateOutput(nowTicks, nextSleepMs, sleepCycle);
 
+#ifdef LINUX
+        /* Find out which of the watched files were touched since the last pass. */
+        fileWatchChanges |= wrapperFileWatchPoll(&fileWatch);
+#endif
+
         /* If we are configured to do so, confirm that the anchor file still exists. */
         anchorPoll(nowTicks);
 
@@ -2937,6 +3269,30 @@ void wrapperEventLoop() {
          *  requested operations. */
         commandPoll(nowTicks);
 
+#ifndef WIN32
+        /* Execute any command received on the control socket. */
+        wrapperControlPoll(nowTicks);
+#endif
+
+#ifdef LINUX
+        /* Sample the resources used by the JVM if it is time to. */
+        wrapperJavaMonitorPoll(nowTicks);
+
+        /* Act on any pressure of the JVM cgroup. */
+        wrapperJavaCgroupPoll(nowTicks);
+#endif
+
+        /* Answer any scrape of the metrics endpoint. */
+        wrapperMetricsPoll(nowTicks);
+
+#ifndef WIN32
+        /* Supervise the additional instances. */
+        if (wrapperInstancesPoll(nowTicks)) {
+            nextSleepMs = 0;
+            sleepCycle = 0;
+        }
+#endif
+
         if (wrapperData->exitRequested) {
             /* A new request for the JVM to be stopped has been made. */
 
@@ -3116,6 +3472,10 @@ void wrapperEventLoop() {
         }
     } while (wrapperData->wState != WRAPPER_WSTATE_STOPPED);
 
+#ifdef LINUX
+    fileWatchStop();
+#endif
+
     /* Assertion check of Java State. */
     if (wrapperData->jState != WRAPPER_JSTATE_DOWN_CLEAN) {
         /* Should never appear - no need to localize this message. */
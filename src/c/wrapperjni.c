@@ -863,6 +863,9 @@ void wrapperJNIHandleSignal(int signal) {
         /* Failed.  Should have been reported. */
         return;
     }
+
+    /* Wake up any thread waiting in nativeWaitForControlEvent. */
+    wrapperNotifyControlEvent();
 }
 
 
@@ -935,6 +938,28 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetControlEvent(JNIEnv *env
     return event;
 }
 
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeWaitForControlEvent
+ * Signature: (I)I
+ *
+ * @param timeoutMS The maximum number of milliseconds to wait if the queue is empty.
+ *
+ * @return The next control event, or 0 if none was received before the timeout.
+ */
+JNIEXPORT jint JNICALL
+Java_org_tanukisoftware_wrapper_WrapperManager_nativeWaitForControlEvent(JNIEnv *env, jclass clazz, jint timeoutMS) {
+    int event;
+
+    event = Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetControlEvent(env, clazz);
+    if ((event == 0) && (timeoutMS > 0)) {
+        /* Events queued after the above check will still wake us up immediately. */
+        wrapperWaitForControlEvent(timeoutMS);
+        event = Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetControlEvent(env, clazz);
+    }
+    return event;
+}
+
 /*
  * Class:     org_tanukisoftware_wrapper_WrapperManager
  * Method:    accessViolationInner
@@ -100,6 +100,8 @@ extern void wrapperSleep(int ms);
 extern int wrapperJNIDebugging;
 extern int wrapperLockControlEventQueue();
 extern int wrapperReleaseControlEventQueue();
+extern void wrapperNotifyControlEvent();
+extern void wrapperWaitForControlEvent(int timeoutMS);
 extern void wrapperJNIHandleSignal(int signal);
 extern void throwThrowable(JNIEnv *env, const char *throwableClassName, const TCHAR *lpszFmt, ...);
 
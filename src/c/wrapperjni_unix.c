@@ -39,17 +39,32 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #ifdef LINUX
  #include <dirent.h>
  #include <arpa/inet.h>
  #include <ctype.h>
+ #include <sys/socket.h>
+ #include <sys/stat.h>
+ #include <netinet/in.h>
+ #include <linux/netlink.h>
+ #include <linux/sock_diag.h>
+ #include <linux/inet_diag.h>
 #endif
 #include <unistd.h>
 #include "loggerjni.h"
 #include "wrapperjni.h"
+#ifdef LINUX
+ #include "wrapper_ring.h"
+#endif
 
 pid_t wrapperProcessId = -1;
 pthread_mutex_t controlEventQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+/* Pipe used to wake up the thread waiting for control events.  Control events are queued from
+ *  signal handlers, where write() is safe to call but pthread_cond_signal() is not. */
+int controlEventPipe[2] = {-1, -1};
 
 
 int wrapperLockControlEventQueue() {
@@ -82,6 +97,58 @@ int wrapperReleaseControlEventQueue() {
     return ret;
 }
 
+static void initControlEventPipe() {
+    int i;
+
+    if (pipe(controlEventPipe)) {
+        log_printf(TEXT("WrapperJNI Error: Failed to create control event pipe. Control events will be polled. %s"), getLastErrorText());
+        controlEventPipe[0] = -1;
+        controlEventPipe[1] = -1;
+        return;
+    }
+    for (i = 0; i < 2; i++) {
+        fcntl(controlEventPipe[i], F_SETFL, O_NONBLOCK);
+        fcntl(controlEventPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+}
+
+/**
+ * Wake up the thread waiting for control events.  Called from signal handlers.
+ */
+void wrapperNotifyControlEvent() {
+    int savedErrno = errno;
+
+    if (controlEventPipe[1] != -1) {
+        /* If the pipe is full, there is already a wake up pending. */
+        if (write(controlEventPipe[1], "", 1) < 0) {
+            /* Nothing can be done in a signal handler. */
+        }
+    }
+    errno = savedErrno;
+}
+
+/**
+ * Wait until a control event has been queued or the timeout expires.
+ */
+void wrapperWaitForControlEvent(int timeoutMS) {
+    struct pollfd pfd;
+    char buffer[32];
+
+    if (controlEventPipe[0] == -1) {
+        wrapperSleep(timeoutMS);
+        return;
+    }
+
+    pfd.fd = controlEventPipe[0];
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeoutMS) > 0) {
+        /* Consume the wake ups.  Any event queued after this will write to the pipe again. */
+        while (read(controlEventPipe[0], buffer, sizeof(buffer)) > 0) {
+        }
+    }
+}
+
 /**
  * Handle interrupt signals (i.e. Crtl-C).
  */
@@ -162,6 +229,8 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeInit(JNIEnv *env, jclass jC
         log_printf(TEXT("WrapperJNI Debug: Inside native WrapperManager initialization method"));
     }
 
+    initControlEventPipe();
+
     /* Set handlers for signals */
     signal(SIGINT,  handleInterrupt);
     signal(SIGTERM, handleTermination);
@@ -276,6 +345,140 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetFileDescriptor(JNIEnv *e
     return fileDesc;
 }
 
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeConnectBackendSocketUnix
+ * Signature: (Ljava/lang/String;)I
+ *
+ * Connects to the Unix-domain socket of the Wrapper.  The Wrapper identifies
+ *  this process with the credentials of the socket.
+ *
+ * Returns the file descriptor of the connected socket, or -1 on failure.
+ */
+JNIEXPORT jint JNICALL
+Java_org_tanukisoftware_wrapper_WrapperManager_nativeConnectBackendSocketUnix(JNIEnv *env, jclass clazz, jstring jPath) {
+    struct sockaddr_un addr;
+    const char *path;
+    int fd;
+    int rc;
+
+    path = (*env)->GetStringUTFChars(env, jPath, 0);
+    if (!path) {
+        throwOutOfMemoryError(env, TEXT("NCBSU1"));
+        return -1;
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_printf(TEXT("WrapperJNI Error: The path of the backend socket is too long."));
+        (*env)->ReleaseStringUTFChars(env, jPath, path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    (*env)->ReleaseStringUTFChars(env, jPath, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        log_printf(TEXT("WrapperJNI Error: Unable to create the backend socket: %s"), getLastErrorText());
+        return -1;
+    }
+    /* Child processes launched by the JVM should not inherit the backend. */
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    do {
+        rc = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    } while ((rc == -1) && (errno == EINTR));
+    if (rc == -1) {
+        log_printf(TEXT("WrapperJNI Error: Unable to connect to the backend socket: %s"), getLastErrorText());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#ifdef LINUX
+/* Ring shared with the Wrapper.  The Java side serializes the calls to nativeRingWrite. */
+static WrapperRing jniRing;
+#endif
+
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeRingOpen
+ * Signature: (Ljava/lang/String;)Z
+ *
+ * Maps the ring created by the Wrapper.  Only implemented on Linux.
+ */
+JNIEXPORT jboolean JNICALL
+Java_org_tanukisoftware_wrapper_WrapperManager_nativeRingOpen(JNIEnv *env, jclass clazz, jstring jPath) {
+#ifdef LINUX
+    const char *path;
+    int failed;
+
+    if (jniRing.header) {
+        wrapperRingDetach(&jniRing);
+    }
+
+    path = (*env)->GetStringUTFChars(env, jPath, 0);
+    if (!path) {
+        throwOutOfMemoryError(env, TEXT("NRO1"));
+        return JNI_FALSE;
+    }
+    failed = wrapperRingAttach(&jniRing, path);
+    (*env)->ReleaseStringUTFChars(env, jPath, path);
+    if (failed) {
+        if (wrapperJNIDebugging) {
+            log_printf(TEXT("WrapperJNI Debug: Unable to open the backend ring: %s"), getLastErrorText());
+        }
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+#else
+    return JNI_FALSE;
+#endif
+}
+
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeRingWrite
+ * Signature: (B[BI)Z
+ *
+ * Returns JNI_FALSE if the record could not be added, in which case it should be sent through the backend.
+ */
+JNIEXPORT jboolean JNICALL
+Java_org_tanukisoftware_wrapper_WrapperManager_nativeRingWrite(JNIEnv *env, jclass clazz, jbyte code, jbyteArray jData, jint len) {
+#ifdef LINUX
+    jbyte *data;
+    int failed;
+
+    if (!jniRing.header || (len < 0)) {
+        return JNI_FALSE;
+    }
+
+    /* The array is only pinned for the time of a copy. */
+    data = (*env)->GetPrimitiveArrayCritical(env, jData, NULL);
+    if (!data) {
+        return JNI_FALSE;
+    }
+    failed = wrapperRingWrite(&jniRing, (char)code, (const char *)data, (size_t)len);
+    (*env)->ReleasePrimitiveArrayCritical(env, jData, data, JNI_ABORT);
+    return failed ? JNI_FALSE : JNI_TRUE;
+#else
+    return JNI_FALSE;
+#endif
+}
+
+/*
+ * Class:     org_tanukisoftware_wrapper_WrapperManager
+ * Method:    nativeRingClose
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL
+Java_org_tanukisoftware_wrapper_WrapperManager_nativeRingClose(JNIEnv *env, jclass clazz) {
+#ifdef LINUX
+    wrapperRingDetach(&jniRing);
+#endif
+}
+
 /*
  * Class:     org_tanukisoftware_wrapper_WrapperManager
  * Method:    nativeGetJavaPID
@@ -563,8 +766,8 @@ static int hasSocketDescriptor(pid_t pid, unsigned long inode) {
                     if (len2 != -1) {
                         buffer2[len2] = 0;
                         if ((ptr = strstr(buffer2, "socket:[")) != NULL) {
-                            sscanf(ptr + 8, "%lx", &tempInode);
-                            if (tempInode == inode) {
+                            /* The inode is in decimal. */
+                            if ((sscanf(ptr + 8, "%lu", &tempInode) == 1) && (tempInode == inode)) {
                                 result = TRUE;
                                 break;
                             }
@@ -577,6 +780,186 @@ static int hasSocketDescriptor(pid_t pid, unsigned long inode) {
     }
     return result;
 }
+
+/**
+ * Retrieve the inode of a TCP socket using NETLINK_SOCK_DIAG.  This avoids
+ *  parsing /proc/net/tcp, which lists every socket of the system.
+ *
+ * A listening socket is looked up directly by its local address and port.
+ *  For an established socket the remote end is not known, so the kernel is
+ *  asked to dump the sockets in that state whose local port matches, using
+ *  an INET_DIAG_REQ_BYTECODE filter, and the local address is matched here.
+ *
+ * @param family AF_INET or AF_INET6.
+ * @param addr The local address in network byte order (4 or 16 bytes).
+ * @param port The local port.
+ * @param tcpState The TCP state of the socket.
+ * @param pInode Set to the inode of the socket, or 0 if it was not found.
+ * @param pUid Set to the uid of the owner of the socket.
+ *
+ * @return TRUE if netlink could not be used, FALSE otherwise.
+ */
+static int getSocketInodeNetlink(int family, const void *addr, int port, int tcpState, unsigned long *pInode, uid_t *pUid) {
+    struct {
+        struct nlmsghdr nlh;
+        struct inet_diag_req_v2 req;
+        struct nlattr filterAttr;
+        struct inet_diag_bc_op filter[4];
+    } request;
+    struct sockaddr_nl nladdr;
+    long buffer[2048]; /* long for the alignment of the netlink headers. */
+    struct nlmsghdr *nlh;
+    struct inet_diag_msg *msg;
+    size_t addrLen = (family == AF_INET ? 4 : 16);
+    int dump = (tcpState != 10); /* TCP_LISTEN */
+    int len;
+    int err;
+    int fd;
+    int done = FALSE;
+    int result = FALSE;
+
+    *pInode = 0;
+
+    fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+    if (fd < 0) {
+        return TRUE;
+    }
+
+    memset(&request, 0, sizeof(request));
+    if (dump) {
+        /* Only dump the sockets whose local port is >= port and <= port.  Each
+         *  comparison is followed by an operand holding the port in its 'no'
+         *  field.  A match falls through to the end of the filter, while a
+         *  mismatch jumps 4 bytes past its end, which rejects the socket. */
+        request.nlh.nlmsg_len = sizeof(request);
+        request.filterAttr.nla_len = sizeof(request.filterAttr) + sizeof(request.filter);
+        request.filterAttr.nla_type = INET_DIAG_REQ_BYTECODE;
+        request.filter[0].code = INET_DIAG_BC_S_GE;
+        request.filter[0].yes = 2 * sizeof(struct inet_diag_bc_op);
+        request.filter[0].no = sizeof(request.filter) + 4;
+        request.filter[1].no = (unsigned short)port;
+        request.filter[2].code = INET_DIAG_BC_S_LE;
+        request.filter[2].yes = 2 * sizeof(struct inet_diag_bc_op);
+        request.filter[2].no = 2 * sizeof(struct inet_diag_bc_op) + 4;
+        request.filter[3].no = (unsigned short)port;
+    } else {
+        request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(request.req));
+    }
+    request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | (dump ? NLM_F_DUMP : 0);
+    request.req.sdiag_family = family;
+    request.req.sdiag_protocol = IPPROTO_TCP;
+    request.req.idiag_states = 1 << tcpState;
+    request.req.id.idiag_sport = htons((unsigned short)port);
+    memcpy(request.req.id.idiag_src, addr, addrLen);
+    request.req.id.idiag_cookie[0] = INET_DIAG_NOCOOKIE;
+    request.req.id.idiag_cookie[1] = INET_DIAG_NOCOOKIE;
+
+    memset(&nladdr, 0, sizeof(nladdr));
+    nladdr.nl_family = AF_NETLINK;
+    if (sendto(fd, &request, request.nlh.nlmsg_len, 0, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0) {
+        close(fd);
+        return TRUE;
+    }
+
+    while (!done) {
+        len = (int)recv(fd, buffer, sizeof(buffer), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = TRUE;
+            break;
+        } else if (len == 0) {
+            break;
+        }
+        for (nlh = (struct nlmsghdr *)buffer; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                done = TRUE;
+                break;
+            } else if (nlh->nlmsg_type == NLMSG_ERROR) {
+                /* ENOENT means that the lookup is supported but that there is no such socket. */
+                err = ((struct nlmsgerr *)NLMSG_DATA(nlh))->error;
+                if (err != -ENOENT) {
+                    result = TRUE;
+                }
+                done = TRUE;
+                break;
+            } else if (nlh->nlmsg_type == SOCK_DIAG_BY_FAMILY) {
+                msg = (struct inet_diag_msg *)NLMSG_DATA(nlh);
+                if ((ntohs(msg->id.idiag_sport) == port) && (memcmp(msg->id.idiag_src, addr, addrLen) == 0)) {
+                    *pInode = msg->idiag_inode;
+                    *pUid = msg->idiag_uid;
+                    done = TRUE;
+                    break;
+                }
+            }
+        }
+        if (!dump) {
+            /* A direct lookup is answered with a single message. */
+            done = TRUE;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+/**
+ * Search the descendants of a process for the owner of a socket.  The
+ *  children of each thread are listed in /proc/<pid>/task/<tid>/children.
+ *
+ * @param pid The process whose descendants should be searched.
+ * @param inode The inode of the socket.
+ * @param depth The number of generations left to search.
+ *
+ * @return The pid of the owner, 0 if it was not found, or -1 if the children
+ *         of the process could not be listed.
+ */
+static pid_t findSocketOwnerInTree(pid_t pid, unsigned long inode, int depth) {
+    char path[64];
+    DIR *taskDir;
+    struct dirent *entry;
+    FILE *file;
+    pid_t childPid;
+    pid_t found = 0;
+    int listed = FALSE;
+
+    snprintf(path, sizeof(path), "/proc/%d/task", pid);
+    taskDir = opendir(path);
+    if (!taskDir) {
+        return -1;
+    }
+    while ((found <= 0) && ((entry = readdir(taskDir)) != NULL)) {
+        if (!isdigit(entry->d_name[0])) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/proc/%d/task/%.16s/children", pid, entry->d_name);
+        file = fopen(path, "r");
+        if (!file) {
+            /* Not available before Linux 3.5, or without CONFIG_PROC_CHILDREN. */
+            continue;
+        }
+        listed = TRUE;
+        while ((found <= 0) && (fscanf(file, "%d", &childPid) == 1)) {
+            if (childPid == getpid()) {
+                /* The JVM itself is not the server. */
+                continue;
+            }
+            if (hasSocketDescriptor(childPid, inode)) {
+                found = childPid;
+            } else if (depth > 1) {
+                found = findSocketOwnerInTree(childPid, inode, depth - 1);
+            }
+        }
+        fclose(file);
+    }
+    closedir(taskDir);
+
+    if ((found <= 0) && !listed) {
+        return -1;
+    }
+    return (found > 0 ? found : 0);
+}
 #endif
 
 /*
@@ -613,12 +996,33 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetSocketRemotePID(JNIEnv *
     unsigned int local_port;
     unsigned int st = 0;
     unsigned long inode = 0;
+    struct in_addr inAddr;
+    int useNetlink;
+    uid_t socketUid = 0;
+    struct stat procStat;
+    char procPath[32];
     TCHAR* wrapperPidStr;
     pid_t wrapperPid = 0;
     DIR *procDir;
     struct dirent *entry;
 
-    /* 1) Convert the address to the appropriate format (ipv4 uses ulong, ipv6 uses bytes array). */
+    /* 1) Figure out which state to select. */
+    switch (state) {
+    case 0:
+        tcpState = 10; /* TCP_LISTEN */
+        break;
+
+    case 1:
+        tcpState = 1; /* TCP_ESTABLISHED; */
+        break;
+
+    default:
+        /* Invalid. */
+        return 0;
+    }
+
+    /* 2) Convert the address to the appropriate format (ipv4 uses ulong, ipv6 uses bytes array),
+     *    and ask the kernel for the inode of the socket. */
     nativeAddress = (*env)->GetStringUTFChars(env, jAddress, 0);
     if (!nativeAddress) {
         throwOutOfMemoryError(env, TEXT("GSRP2"));
@@ -632,71 +1036,62 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetSocketRemotePID(JNIEnv *
             /* Failed. */
             return 0;
         }
+        inAddr.s_addr = (in_addr_t)local_addr_ipv4;
+        useNetlink = !getSocketInodeNetlink(AF_INET, &inAddr, port, tcpState, &inode, &socketUid);
         fileName = TEXT("/proc/net/tcp");
     } else {
         /* IPv6 */
  #ifdef IPV6_SUPPORT
         ret = fillIpv6ByteArray(local_addr_ipv6, nativeAddress);
         (*env)->ReleaseStringUTFChars(env, jAddress, nativeAddress);
-        if (ret == 0) {
+        if (ret != 0) {
             /* Failed. */
             return 0;
         }
+        useNetlink = !getSocketInodeNetlink(AF_INET6, local_addr_ipv6, port, tcpState, &inode, &socketUid);
         fileName = TEXT("/proc/net/tcp6");
  #else
+        (*env)->ReleaseStringUTFChars(env, jAddress, nativeAddress);
         return 0;
  #endif
     }
 
-    /* 2) Figure out which state to select. */
-    switch (state) {
-    case 0:
-        tcpState = 10; /* TCP_LISTEN */
-        break;
-
-    case 1:
-        tcpState = 1; /* TCP_ESTABLISHED; */
-        break;
-
-    default:
-        /* Invalid. */
-        return 0;
-    }
-
-    /* 3) Seek for our socket in the tcp file and retrieve the inode. */
-    file = _tfopen(fileName, TEXT("r"));
-    if (!file) {
-        return 0;
-    }
-    if (fgets(buffer, sizeof(buffer), file)) {
-        /* First line is the header: '  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode' */
-        ptr1 = strstr(buffer, "local_address");
-        ptr2 = strstr(buffer, "st ");
-        ptr3 = strstr(buffer, "inode");
-    }
-    if (ptr1 && ptr2 && ptr3) {
-        while (fgets(buffer, sizeof(buffer), file)) {
+    /* 3) If netlink is not available, seek for our socket in the tcp file and retrieve the inode. */
+    if (!useNetlink) {
+        file = _tfopen(fileName, TEXT("r"));
+        if (!file) {
+            return 0;
+        }
+        if (fgets(buffer, sizeof(buffer), file)) {
+            /* First line is the header: '  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode' */
+            ptr1 = strstr(buffer, "local_address");
+            ptr2 = strstr(buffer, "st ");
+            ptr3 = strstr(buffer, "inode");
+        }
+        if (ptr1 && ptr2 && ptr3) {
+            while (fgets(buffer, sizeof(buffer), file)) {
  #ifdef IPV6_SUPPORT
-            /* Not implemented */
-            break;
+                /* Not implemented */
+                break;
  #else
-            /* address:port */
-            if (sscanf(ptr1, "%lx:%x", &local_addr, &local_port) == 2) {
-                if ((local_addr == local_addr_ipv4) && (local_port == port)) {
-                    /* status (listening=0A, established=01) - IMPORTANT: there might be a delay for /proc/net/tcp to be updated! */
-                    if (sscanf(ptr2, "%x", &st) == 1) {
-                        if (st == tcpState) {
-                            /* inode */
-                            sscanf(ptr3, "%lx", &inode);
-                            break;
+                /* address:port */
+                if (sscanf(ptr1, "%lx:%x", &local_addr, &local_port) == 2) {
+                    if ((local_addr == local_addr_ipv4) && (local_port == port)) {
+                        /* status (listening=0A, established=01) - IMPORTANT: there might be a delay for /proc/net/tcp to be updated! */
+                        if (sscanf(ptr2, "%x", &st) == 1) {
+                            if (st == tcpState) {
+                                /* inode (decimal) */
+                                sscanf(ptr3, "%lu", &inode);
+                                break;
+                            }
                         }
                     }
                 }
-            }
  #endif
+            }
         }
+        fclose(file);
     }
-    fclose(file);
     if (inode == 0) {
         return 0;
     }
@@ -709,7 +1104,16 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetSocketRemotePID(JNIEnv *
         }
     }
 
-    /* 5) Search for other processes: Iterate through the /proc folders and try to find the corresponding inode. */
+    /* 5) Then look in the process tree of the Wrapper. */
+    if (useNetlink && (wrapperPid > 0)) {
+        tempPid = findSocketOwnerInTree(wrapperPid, inode, 4);
+        if (tempPid > 0) {
+            return tempPid;
+        }
+    }
+
+    /* 6) Search for other processes: Iterate through the /proc folders and try to find the corresponding inode.
+     *    When the owner of the socket is known, skip the processes of other users. */
     procDir = opendir("/proc");
     if (!procDir) {
         return 0;
@@ -718,6 +1122,12 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeGetSocketRemotePID(JNIEnv *
         if ((entry->d_type == DT_DIR) && isdigit(entry->d_name[0])) {   /* look into directories whose name are PIDs */
             tempPid = atoi(entry->d_name);
             if ((tempPid != wrapperPid) && (tempPid != getpid())) {  /* make sure to not look into the folder of the current process */
+                if (useNetlink) {
+                    snprintf(procPath, sizeof(procPath), "/proc/%d", tempPid);
+                    if ((stat(procPath, &procStat) != 0) || (procStat.st_uid != socketUid)) {
+                        continue;
+                    }
+                }
                 if (hasSocketDescriptor(tempPid, inode)) {
                     pid = tempPid;
                     break;
@@ -66,6 +66,7 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 static DWORD javaProcessId = 0;
 
 HANDLE controlEventQueueMutexHandle = NULL;
+HANDLE controlEventHandle = NULL;
 
 FARPROC OptionalProcess32First = NULL;
 FARPROC OptionalProcess32Next = NULL;
@@ -116,6 +117,27 @@ int wrapperReleaseControlEventQueue() {
     return 0;
 }
 
+/**
+ * Wake up the thread waiting for control events.
+ */
+void wrapperNotifyControlEvent() {
+    if (controlEventHandle) {
+        SetEvent(controlEventHandle);
+    }
+}
+
+/**
+ * Wait until a control event has been queued or the timeout expires.
+ */
+void wrapperWaitForControlEvent(int timeoutMS) {
+    if (!controlEventHandle) {
+        wrapperSleep(timeoutMS);
+        return;
+    }
+    /* The event is auto-reset, so it is cleared when the wait returns. */
+    WaitForSingleObject(controlEventHandle, timeoutMS);
+}
+
 /**
  * Handler to take care of the case where the user hits CTRL-C when the wrapper
  *  is being run as a console.  If this is not done, then the Java process
@@ -809,6 +831,10 @@ Java_org_tanukisoftware_wrapper_WrapperManager_nativeInit(JNIEnv *env, jclass jC
         log_printf(TEXT("WrapperJNI Error: Failed to create control event queue mutex. Signals will be ignored. %s"), getLastErrorText());
         controlEventQueueMutexHandle = NULL;
     }
+    if (!(controlEventHandle = CreateEvent(NULL, FALSE, FALSE, NULL))) {
+        log_printf(TEXT("WrapperJNI Error: Failed to create control event. Control events will be polled. %s"), getLastErrorText());
+        controlEventHandle = NULL;
+    }
 
     /* Make sure that the handling of CTRL-C signals is enabled for this process. */
     if (!SetConsoleCtrlHandler(NULL, FALSE)) {
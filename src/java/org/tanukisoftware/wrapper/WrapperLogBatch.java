@@ -0,0 +1,277 @@
+package org.tanukisoftware.wrapper;
+
+/*
+ * Copyright (c) 1999, 2025 Tanuki Software, Ltd.
+ * http://www.tanukisoftware.com
+ * All rights reserved.
+ *
+ * This software is the proprietary information of Tanuki Software.
+ * You shall use it only in accordance with the terms of the
+ * license agreement you entered into with Tanuki Software.
+ * http://wrapper.tanukisoftware.com/doc/english/licenseOverview.html
+ */
+
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * A WrapperLogBatch collects log records which are then sent to the Wrapper
+ *  in a single packet by calling WrapperManager.log( WrapperLogBatch ).
+ *  Each record keeps its own level, the time at which it was created and the
+ *  name of its source, usually the name of a logger.
+ * <p>
+ * This makes it possible for a logging framework to send its output
+ *  directly to the Wrapper log rather than writing it to System.out, where
+ *  the Wrapper would need to split it back into lines and would log each of
+ *  them at the default level and with the time at which it was read.
+ * <p>
+ * Records which were already filtered by the application can be marked so
+ *  that the Wrapper does not apply its output filters to them.  Other
+ *  records are matched against the filters just like console output.
+ * <p>
+ * Records at a level which will not be logged by the Wrapper are dropped as
+ *  they are added.  A batch can be reused once it has been logged.  If a
+ *  record would make the batch too large to be sent in one packet, the
+ *  records already in the batch are logged first, and a single record which
+ *  is too large has its message truncated.  The methods of this class are
+ *  thread safe.
+ * <pre>
+ * WrapperLogBatch batch = new WrapperLogBatch();
+ * batch.add( WrapperManager.WRAPPER_LOG_LEVEL_INFO, "com.example.App", "Started." );
+ * batch.add( WrapperManager.WRAPPER_LOG_LEVEL_WARN, "com.example.App", "Low memory." );
+ * WrapperManager.log( batch );
+ * </pre>
+ *
+ * @author Tanuki Software Development Team &lt;support@tanukisoftware.com&gt;
+ * @since Wrapper 3.6.2
+ */
+public final class WrapperLogBatch
+{
+    /** Separates the fields of a record. */
+    private static final char UNIT_SEPARATOR = '\u001f';
+    
+    /** Terminates a record. */
+    private static final char RECORD_SEPARATOR = '\u001e';
+    
+    /** Flag telling the Wrapper that the record was already filtered. */
+    private static final int FLAG_FILTERED = 0x01;
+    
+    /** Longest payload, in characters, which is sure to fit in a packet once
+     *  encoded in UTF-8. */
+    private static final int MAX_PAYLOAD_LENGTH = WrapperManager.PROTOCOL_MAX_PACKET_LENGTH / 3;
+    
+    /** The records, encoded as they will be sent to the Wrapper. */
+    private StringBuffer m_payload = new StringBuffer();
+    
+    /** The number of records in the batch. */
+    private int m_size;
+    
+    /*---------------------------------------------------------------
+     * Constructors
+     *-------------------------------------------------------------*/
+    /**
+     * Creates a new empty batch.
+     */
+    public WrapperLogBatch()
+    {
+    }
+    
+    /*---------------------------------------------------------------
+     * Static Methods
+     *-------------------------------------------------------------*/
+    /**
+     * Appends a value to the payload, replacing any characters which have
+     *  a special meaning in the payload.
+     */
+    private static void appendField( StringBuffer sb, String value )
+    {
+        int len = value.length();
+        for ( int i = 0; i < len; i++ )
+        {
+            char c = value.charAt( i );
+            if ( ( c == UNIT_SEPARATOR ) || ( c == RECORD_SEPARATOR ) || ( c == '\0' ) )
+            {
+                sb.append( ' ' );
+            }
+            else
+            {
+                sb.append( c );
+            }
+        }
+    }
+    
+    /*---------------------------------------------------------------
+     * Methods
+     *-------------------------------------------------------------*/
+    /**
+     * Adds a record, created now, which will be matched against the output
+     *  filters of the Wrapper.
+     *
+     * @param logLevel The level of the record, one of the
+     *                 WrapperManager.WRAPPER_LOG_LEVEL_* constants.
+     * @param source The name of the source of the record, or null.
+     * @param message The message of the record.
+     */
+    public void add( int logLevel, String source, String message )
+    {
+        add( logLevel, System.currentTimeMillis(), source, message, false );
+    }
+    
+    /**
+     * Adds a record.
+     *
+     * @param logLevel The level of the record, one of the
+     *                 WrapperManager.WRAPPER_LOG_LEVEL_* constants.
+     * @param time The time at which the record was created, in milliseconds
+     *             since the epoch.
+     * @param source The name of the source of the record, or null.
+     * @param message The message of the record.
+     * @param filtered True if the record was already filtered by the
+     *                 application and should not be matched against the
+     *                 output filters of the Wrapper.
+     *
+     * @throws IllegalArgumentException If the time is negative.
+     * @throws SecurityException If the records already in the batch have to
+     *                           be logged to make room for this one, a
+     *                           SecurityManager is present and the calling
+     *                           thread does not have the
+     *                           WrapperPermission("log") permission.
+     */
+    public synchronized void add( int logLevel, long time, String source, String message, boolean filtered )
+    {
+        if ( ( logLevel < WrapperManager.WRAPPER_LOG_LEVEL_DEBUG ) || ( logLevel > WrapperManager.WRAPPER_LOG_LEVEL_NOTICE ) )
+        {
+            throw new IllegalArgumentException( WrapperManager.getRes().getString( "The specified logLevel is not valid." ) );
+        }
+        if ( message == null )
+        {
+            throw new IllegalArgumentException( WrapperManager.getRes().getString( "The message parameter can not be null." ) );
+        }
+        if ( time < 0 )
+        {
+            // The Wrapper reads the seconds as an unsigned number.
+            throw new IllegalArgumentException( WrapperManager.getRes().getString( "The time parameter can not be negative." ) );
+        }
+        
+        if ( !WrapperManager.isLogLevelEnabled( logLevel ) )
+        {
+            return;
+        }
+        
+        StringBuffer record = new StringBuffer();
+        record.append( logLevel );
+        record.append( UNIT_SEPARATOR );
+        record.append( time / 1000 );
+        record.append( '.' );
+        record.append( time % 1000 );
+        record.append( UNIT_SEPARATOR );
+        record.append( Integer.toHexString( filtered ? FLAG_FILTERED : 0 ) );
+        record.append( UNIT_SEPARATOR );
+        if ( source != null )
+        {
+            appendField( record, source );
+        }
+        record.append( UNIT_SEPARATOR );
+        appendField( record, message );
+        if ( record.length() >= MAX_PAYLOAD_LENGTH )
+        {
+            // Keep as much of the message as fits in a packet of its own, without splitting a surrogate pair.
+            int length = MAX_PAYLOAD_LENGTH - 1;
+            char last = record.charAt( length - 1 );
+            if ( ( last >= '\uD800' ) && ( last <= '\uDBFF' ) )
+            {
+                length--;
+            }
+            record.setLength( length );
+        }
+        record.append( RECORD_SEPARATOR );
+        
+        if ( ( m_size > 0 ) && ( m_payload.length() + record.length() > MAX_PAYLOAD_LENGTH ) )
+        {
+            // Send what the batch holds so far, so that no packet exceeds the limit of the Wrapper.
+            WrapperManager.log( this );
+        }
+        
+        m_payload.append( record );
+        m_size++;
+    }
+    
+    /**
+     * Returns the number of records in the batch.
+     *
+     * @return The number of records.
+     */
+    public synchronized int size()
+    {
+        return m_size;
+    }
+    
+    /**
+     * Removes all of the records from the batch.
+     */
+    public synchronized void clear()
+    {
+        m_payload.setLength( 0 );
+        m_size = 0;
+    }
+    
+    /**
+     * Returns the payload of the LOG_BATCH packet.
+     */
+    synchronized String getPayload()
+    {
+        return m_payload.toString();
+    }
+    
+    /**
+     * Returns the levels of the records, for Wrappers which do not support
+     *  log batches.
+     */
+    synchronized int[] getLevels()
+    {
+        String payload = m_payload.toString();
+        int[] levels = new int[m_size];
+        int pos = 0;
+        for ( int i = 0; i < m_size; i++ )
+        {
+            int end = payload.indexOf( UNIT_SEPARATOR, pos );
+            levels[i] = Integer.parseInt( payload.substring( pos, end ) );
+            pos = payload.indexOf( RECORD_SEPARATOR, end ) + 1;
+        }
+        return levels;
+    }
+    
+    /**
+     * Returns the messages of the records, prefixed with their sources, for
+     *  Wrappers which do not support log batches.
+     */
+    synchronized String[] getMessages()
+    {
+        String payload = m_payload.toString();
+        List messages = new ArrayList();
+        int pos = 0;
+        while ( pos < payload.length() )
+        {
+            int end = payload.indexOf( RECORD_SEPARATOR, pos );
+            // Skip the level, time and flags.
+            int sourceStart = pos;
+            for ( int i = 0; i < 3; i++ )
+            {
+                sourceStart = payload.indexOf( UNIT_SEPARATOR, sourceStart ) + 1;
+            }
+            int messageStart = payload.indexOf( UNIT_SEPARATOR, sourceStart ) + 1;
+            String source = payload.substring( sourceStart, messageStart - 1 );
+            String message = payload.substring( messageStart, end );
+            if ( source.length() > 0 )
+            {
+                messages.add( "[" + source + "] " + message );
+            }
+            else
+            {
+                messages.add( message );
+            }
+            pos = end + 1;
+        }
+        return (String[])messages.toArray( new String[messages.size()] );
+    }
+}
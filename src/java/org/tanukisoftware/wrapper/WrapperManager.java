@@ -143,14 +143,18 @@ public final class WrapperManager
     private static final int TIMER_FAST_THRESHOLD        = 2 * 24 * 3600 * 1000 / TICK_MS; // 2 days.
     private static final int TIMER_SLOW_THRESHOLD        = 2 * 24 * 3600 * 1000 / TICK_MS; // 2 days.
     
+    /** Longest time that the control event thread will wait when it does not need to maintain the tick counter. */
+    private static final int EVENT_IDLE_WAIT_MS          = 1000;
+    
 
     /**
-     * Backend server can be of 3 types: socket IPv4, socket IPv6 or pipe
+     * Backend server can be of 4 types: socket IPv4, socket IPv6, pipe or Unix-domain socket
      */
     private static final int BACKEND_TYPE_UNKNOWN        = 0;
     private static final int BACKEND_TYPE_SOCKET_V4      = 0x01;
     private static final int BACKEND_TYPE_SOCKET_V6      = 0x02;
     private static final int BACKEND_TYPE_PIPE           = 0x04;
+    private static final int BACKEND_TYPE_SOCKET_UNIX    = 0x08;
    
     
     private static final byte MSG_NAK                    = (byte)21;
@@ -188,6 +192,19 @@ public final class WrapperManager
     private static final byte WRAPPER_MSG_RESUME_TIMEOUTS = (byte)145;
     private static final byte WRAPPER_MSG_PRESTART       = (byte)146;
     private static final byte WRAPPER_MSG_APP_PARAMETERS = (byte)147;
+    private static final byte WRAPPER_MSG_PROTOCOL       = (byte)148;
+    private static final byte WRAPPER_MSG_LOG_BATCH      = (byte)149;
+    
+    /** Original framing: a packet code followed by a null terminated string. */
+    private static final int PROTOCOL_VERSION_1          = 1;
+    /** Length-prefixed framing: a packet code, a varint payload length and the payload. */
+    private static final int PROTOCOL_VERSION_2          = 2;
+    /** Capability: payloads sent to the Wrapper are encoded in UTF-8 rather than the default encoding. */
+    private static final int PROTOCOL_CAP_UTF8           = 0x01;
+    /** Capability: log records can be sent in bulk with LOG_BATCH packets. */
+    private static final int PROTOCOL_CAP_LOG_BATCH      = 0x02;
+    /** Largest payload accepted by the Wrapper in a version 2 packet.  Must match WRAPPER_PACKET_MAX_LENGTH in wrapper_packet.h. */
+    static final int PROTOCOL_MAX_PACKET_LENGTH          = 4 * 1024 * 1024;
     
     /** Received when the user presses CTRL-C in the console on Windows or UNIX platforms. */
     public static final int WRAPPER_CTRL_C_EVENT         = 200;
@@ -375,6 +392,8 @@ public final class WrapperManager
     private static int m_jvmPortMin;
     private static int m_jvmPortMax;
     private static String m_wrapperPortAddress = null;
+    /** Path of the Wrapper's Unix-domain socket when using the SOCKET_UNIX backend. */
+    private static String m_backendPath = null;
     private static String m_key;
     private static int m_soTimeout = -1;
     private static long m_cpuTimeout = DEFAULT_CPU_TIMEOUT;
@@ -400,6 +419,8 @@ public final class WrapperManager
     private static boolean m_commRunnerStarted = false;
     private static Thread m_eventRunner;
     private static int m_eventRunnerTicks;
+    /** False if the native library is too old to support nativeWaitForControlEvent. */
+    private static boolean m_eventRunnerNativeWait = true;
     private static Thread m_startupRunner;
     
     /** True if the system time should be used for internal timeouts. */
@@ -468,6 +489,16 @@ public final class WrapperManager
     private static boolean m_libraryVersionOk = false;
     private static boolean m_wrapperVersionOk = false;
     private static byte[] m_commandBuffer = new byte[512];
+    /** Framing used to send packets to the Wrapper. */
+    private static int m_protocolWriteVersion = PROTOCOL_VERSION_1;
+    /** Framing used to read packets from the Wrapper.  Switched when the Wrapper acknowledges the negotiation. */
+    private static int m_protocolReadVersion = PROTOCOL_VERSION_1;
+    /** Capabilities requested to the Wrapper when negotiating the protocol. */
+    private static int m_protocolCapabilities = 0;
+    /** Capabilities accepted by the Wrapper in its acknowledgement of the negotiation. */
+    private static int m_protocolAcceptedCapabilities = 0;
+    /** True if log packets are written into the shared memory ring of the Wrapper. */
+    private static boolean m_backendRingOpen = false;
     private static File m_logFile = null;
     
     /** The contents of the wrapper configuration. */
@@ -853,6 +884,19 @@ public final class WrapperManager
                 // Pipe based communication
                 m_backendType = BACKEND_TYPE_PIPE;
             }
+            else if ( backendType.equalsIgnoreCase( "SOCKET_UNIX" ) )
+            {
+                // Unix-domain socket based communication
+                m_backendType = BACKEND_TYPE_SOCKET_UNIX;
+                
+                if ( ( m_backendPath = System.getProperty( "wrapper.backend.path" ) ) == null )
+                {
+                    // This message is logged when localization is not yet initialized.
+                    String msg = "The 'wrapper.backend.path' system property was not set.";
+                    m_outError.println( msg );
+                    throw new ExceptionInInitializerError( msg );
+                }
+            }
             else
             {
                 // Socket based communication
@@ -1099,14 +1143,54 @@ public final class WrapperManager
                             }
                         }
                         
-                        // Wait before checking for another control event.
-                        try
+                        // Wait before the next tick.  Control events received in the
+                        //  meantime are processed immediately.  The tick counter is
+                        //  incremented once per loop, so a longer wait is only possible
+                        //  when the system time is used and nobody listens to tick events.
+                        //  It is kept under half of the CPU timeout, unless that check is
+                        //  disabled, but never below a tick.
+                        long waitMs = TICK_MS;
+                        if ( m_useSystemTime && !m_produceCoreEvents )
                         {
-                            Thread.sleep( TICK_MS );
+                            waitMs = EVENT_IDLE_WAIT_MS;
+                            if ( m_cpuTimeout > 0 )
+                            {
+                                waitMs = Math.max( TICK_MS, Math.min( waitMs, m_cpuTimeout / 2 ) );
+                            }
                         }
-                        catch ( InterruptedException e )
+                        long deadline = System.currentTimeMillis() + waitMs;
+                        long remaining = waitMs;
+                        do
                         {
+                            if ( m_eventRunnerNativeWait && isNativeLibraryOk() && !isShuttingDown() )
+                            {
+                                try
+                                {
+                                    int event = WrapperManager.nativeWaitForControlEvent( (int)remaining );
+                                    if ( event != 0 )
+                                    {
+                                        WrapperManager.controlEvent( event );
+                                    }
+                                }
+                                catch ( UnsatisfiedLinkError e )
+                                {
+                                    // This can happen if an old native library is used.  Fall back to polling.
+                                    m_eventRunnerNativeWait = false;
+                                }
+                            }
+                            else
+                            {
+                                try
+                                {
+                                    Thread.sleep( remaining );
+                                }
+                                catch ( InterruptedException e )
+                                {
+                                }
+                            }
+                            remaining = deadline - System.currentTimeMillis();
                         }
+                        while ( ( remaining > 0 ) && ( remaining <= waitMs ) && !m_stopped );
                     }
                 }
                 finally
@@ -1231,8 +1315,13 @@ public final class WrapperManager
     private static native boolean nativeIsProfessionalEdition();
     private static native boolean nativeIsStandardEdition();
     private static native int nativeGetControlEvent();
+    private static native int nativeWaitForControlEvent( int timeoutMS );
     private static native int nativeRedirectPipes();
     private static native FileDescriptor nativeGetFileDescriptor( int fdInt );
+    private static native int nativeConnectBackendSocketUnix( String path );
+    private static native boolean nativeRingOpen( String path );
+    private static native boolean nativeRingWrite( byte code, byte[] data, int len );
+    private static native void nativeRingClose();
     private static native void nativeRequestThreadDump();
     private static native void accessViolationInner(); // Should start with native, but need to preserve for compatibility.
     private static native void nativeRaiseExceptionInner( int code );
@@ -4142,6 +4231,80 @@ public final class WrapperManager
         }
     }
     
+    /**
+     * Requests that the Wrapper log all of the records in a batch, then
+     *  clears the batch so it can be reused.  The records are sent to the
+     *  Wrapper in a single packet, as the batch never grows larger than a
+     *  packet can be, and keep the level, time and source which
+     *  they were given when they were added to the batch.  This is much more
+     *  efficient than calling log( int, String ) for each message, or than
+     *  writing the messages to System.out.
+     * <p>
+     * If the Wrapper does not support log batches, the records are logged
+     *  one by one as if log( int, String ) had been called.  If the JVM is
+     *  not being managed by the Wrapper then calls to this method will be
+     *  ignored.
+     *
+     * @param batch The batch of records to be logged.
+     *
+     * @throws SecurityException If a SecurityManager is present and the
+     *                           calling thread does not have the
+     *                           WrapperPermission("log") permission.
+     *
+     * @see WrapperLogBatch
+     * @see WrapperPermission
+     *
+     * @since Wrapper 3.6.2
+     */
+    public static void log( WrapperLogBatch batch )
+    {
+        SecurityManager sm = System.getSecurityManager();
+        if ( sm != null )
+        {
+            sm.checkPermission( new WrapperPermission( "log" ) );
+        }
+        
+        if ( batch == null )
+        {
+            throw new IllegalArgumentException( getRes().getString( "The batch parameter can not be null." ) );
+        }
+        
+        synchronized( batch )
+        {
+            if ( batch.size() > 0 )
+            {
+                if ( ( m_protocolAcceptedCapabilities & PROTOCOL_CAP_LOG_BATCH ) != 0 )
+                {
+                    sendCommand( WRAPPER_MSG_LOG_BATCH, batch.getPayload() );
+                }
+                else
+                {
+                    // Older Wrappers only understand individual log packets.
+                    String[] records = batch.getMessages();
+                    int[] levels = batch.getLevels();
+                    for ( int i = 0; i < records.length; i++ )
+                    {
+                        sendCommand( (byte)( WRAPPER_MSG_LOG + levels[i] ), records[i] );
+                    }
+                }
+                batch.clear();
+            }
+        }
+    }
+    
+    /**
+     * Returns true if messages at the specified log level will be logged by
+     *  the Wrapper.
+     *
+     * @param logLevel The level to test.
+     *
+     * @return True if messages at the level will be logged.
+     */
+    static boolean isLogLevelEnabled( int logLevel )
+    {
+        return m_lowLogLevel <= logLevel;
+    }
+    
     /**
      * Returns an array of all registered services.  This method is only
      *  supported on Windows platforms which support services.  Calling this
@@ -5811,6 +5974,35 @@ public final class WrapperManager
         m_backendConnected = true;
     }
     
+    private static synchronized void openBackendSocketUnix()
+    {
+        try
+        {
+            if ( !isNativeLibraryOk() )
+            {
+                throw new WrapperJNIError( getRes().getString( "Wrapper native library not loaded." ) );
+            }
+            
+            int fdInt = nativeConnectBackendSocketUnix( m_backendPath );
+            if ( fdInt < 0 )
+            {
+                throw new IOException( getRes().getString( "Unable to connect to {0}.", m_backendPath ) );
+            }
+            
+            // Both streams share the same FileDescriptor instance so the descriptor only gets closed once.
+            FileDescriptor fileDesc = nativeGetFileDescriptor( fdInt );
+            m_backendIS = new FileInputStream( fileDesc );
+            m_backendOS = new FileOutputStream( fileDesc );
+        }
+        catch ( Throwable e )
+        {
+            m_outError.println( getRes().getString( "Error connecting the backend socket. {0}", e ) );
+            closeBackend();
+            return;
+        }
+        m_backendConnected = true;
+    }
+    
     private static synchronized void openBackend()
     {
         m_backendConnected = false;
@@ -5828,6 +6020,10 @@ public final class WrapperManager
         {
             openBackendPipe();
         }
+        else if ( m_backendType == BACKEND_TYPE_SOCKET_UNIX )
+        {
+            openBackendSocketUnix();
+        }
         else
         {
             openBackendSocket();
@@ -5843,6 +6039,39 @@ public final class WrapperManager
         
         // The backend is open.
         
+        // Negotiate the protocol version before anything else.  The Wrapper offers the highest version
+        //  it supports, so it will accept whichever version we pick up to that one.  From now on our
+        //  packets use the new framing, but the Wrapper switches only once it has read this packet.
+        m_protocolWriteVersion = PROTOCOL_VERSION_1;
+        m_protocolReadVersion = PROTOCOL_VERSION_1;
+        m_protocolAcceptedCapabilities = 0;
+        int offeredVersion = WrapperSystemPropertyUtil.getIntProperty( "wrapper.backend.protocol", PROTOCOL_VERSION_1 );
+        if ( offeredVersion >= PROTOCOL_VERSION_2 )
+        {
+            m_protocolCapabilities = ( isZOS() ? 0 : PROTOCOL_CAP_UTF8 ) | PROTOCOL_CAP_LOG_BATCH;
+            sendCommand( WRAPPER_MSG_PROTOCOL, PROTOCOL_VERSION_2 + " " + Integer.toHexString( m_protocolCapabilities ) );
+            m_protocolWriteVersion = PROTOCOL_VERSION_2;
+        }
+        
+        // Open the shared memory ring if the Wrapper created one.  This must be done before
+        //  sending the key as the Wrapper removes the file of the ring once it gets it.
+        String ringPath = WrapperSystemPropertyUtil.getStringProperty( "wrapper.backend.ring", null );
+        if ( ( ringPath != null ) && isNativeLibraryOk() )
+        {
+            m_backendRingOpen = nativeRingOpen( ringPath );
+            if ( m_debug )
+            {
+                if ( m_backendRingOpen )
+                {
+                    m_outDebug.println( getRes().getString( "Backend ring opened: {0}", ringPath ) );
+                }
+                else
+                {
+                    m_outDebug.println( getRes().getString( "Unable to open the backend ring {0}.  Log packets will be sent through the backend.", ringPath ) );
+                }
+            }
+        }
+        
         // Send the key back to the wrapper so that the wrapper can feel safe
         //  that it is talking to the correct JVM
         sendCommand( WRAPPER_MSG_KEY, m_key );
@@ -5893,6 +6122,12 @@ public final class WrapperManager
             m_backendConnected = false;
             m_backendClosed = true;
             
+            if ( m_backendRingOpen )
+            {
+                m_backendRingOpen = false;
+                nativeRingClose();
+            }
+            
             // On HP platforms, an attempt to close a socket while a read is blocking will
             //  cause the close to block until the read completes.  To avoid this, send an
             //  interrupt to the communications runner to abort any existing reads.
@@ -6027,6 +6262,14 @@ public final class WrapperManager
             name ="APP_PARAMETERS";
             break;
     
+        case WRAPPER_MSG_PROTOCOL:
+            name ="PROTOCOL";
+            break;
+    
+        case WRAPPER_MSG_LOG_BATCH:
+            name ="LOG_BATCH";
+            break;
+    
         case WRAPPER_MSG_LOG + WRAPPER_LOG_LEVEL_DEBUG:
             name ="LOG(DEBUG)";
             break;
@@ -6179,27 +6422,90 @@ public final class WrapperManager
             {
                 try
                 {
-                    // It is possible that a logged message is quite large.  Expand the size
-                    // of the command buffer if necessary so that it can be included.  This
-                    //  means that the command buffer will be the size of the largest message.
-                    byte[] messageBytes = message.getBytes();
-                    if ( m_commandBuffer.length < messageBytes.length + 2 )
+                    byte[] messageBytes;
+                    if ( ( m_protocolWriteVersion >= PROTOCOL_VERSION_2 ) && ( ( m_protocolCapabilities & PROTOCOL_CAP_UTF8 ) != 0 ) )
                     {
-                        m_commandBuffer = new byte[messageBytes.length + 2];
+                        messageBytes = message.getBytes( "UTF-8" );
+                    }
+                    else
+                    {
+                        messageBytes = message.getBytes();
                     }
                     
-                    // Writing the bytes one by one was sometimes causing the first byte to be lost.
-                    // Try to work around this problem by creating a buffer and sending the whole lot
-                    // at once.
-                    m_commandBuffer[0] = code;
-                    System.arraycopy( messageBytes, 0, m_commandBuffer, 1, messageBytes.length );
-                    int len = messageBytes.length + 2;
-                    m_commandBuffer[len - 1] = 0;
-
-                    m_backendOS.write( m_commandBuffer, 0, len );
-                    m_backendOS.flush();
+                    if ( ( m_protocolWriteVersion >= PROTOCOL_VERSION_2 ) && ( messageBytes.length > PROTOCOL_MAX_PACKET_LENGTH ) )
+                    {
+                        // The Wrapper would discard the whole packet, so only send as much of the message as it accepts.
+                        int length = PROTOCOL_MAX_PACKET_LENGTH;
+                        if ( ( m_protocolCapabilities & PROTOCOL_CAP_UTF8 ) != 0 )
+                        {
+                            // Do not cut a multi-byte character.
+                            while ( ( length > 0 ) && ( ( messageBytes[length] & 0xc0 ) == 0x80 ) )
+                            {
+                                length--;
+                            }
+                        }
+                        if ( m_debug )
+                        {
+                            m_outDebug.println( getRes().getString( "Truncated packet {0} from {1} to {2} bytes.",
+                                getPacketCodeName( code ), new Integer( messageBytes.length ), new Integer( length ) ) );
+                        }
+                        byte[] truncatedBytes = new byte[length];
+                        System.arraycopy( messageBytes, 0, truncatedBytes, 0, length );
+                        messageBytes = truncatedBytes;
+                    }
                     
-                    sentCommand = true;
+                    if ( m_backendRingOpen
+                        && ( ( ( code >= WRAPPER_MSG_LOG + WRAPPER_LOG_LEVEL_DEBUG ) && ( code <= WRAPPER_MSG_LOG + WRAPPER_LOG_LEVEL_NOTICE ) )
+                            || ( code == WRAPPER_MSG_LOG_BATCH ) )
+                        && nativeRingWrite( code, messageBytes, messageBytes.length ) )
+                    {
+                        // The Wrapper reads everything written to the ring before handling the
+                        //  next backend packet, so if the ring was full and this falls back to
+                        //  the backend, the order is kept.
+                        sentCommand = true;
+                    }
+                    else
+                    {
+                        // It is possible that a logged message is quite large.  Expand the size
+                        // of the command buffer if necessary so that it can be included.  This
+                        //  means that the command buffer will be the size of the largest message.
+                        //  (Leave room for the code and a 5 bytes varint length.)
+                        if ( m_commandBuffer.length < messageBytes.length + 6 )
+                        {
+                            m_commandBuffer = new byte[messageBytes.length + 6];
+                        }
+                        
+                        // Writing the bytes one by one was sometimes causing the first byte to be lost.
+                        // Try to work around this problem by creating a buffer and sending the whole lot
+                        // at once.
+                        m_commandBuffer[0] = code;
+                        int len;
+                        if ( m_protocolWriteVersion >= PROTOCOL_VERSION_2 )
+                        {
+                            // The length is encoded as an unsigned LEB128 varint.
+                            int pos = 1;
+                            int remaining = messageBytes.length;
+                            while ( remaining >= 0x80 )
+                            {
+                                m_commandBuffer[pos++] = (byte)( ( remaining & 0x7f ) | 0x80 );
+                                remaining >>>= 7;
+                            }
+                            m_commandBuffer[pos++] = (byte)remaining;
+                            System.arraycopy( messageBytes, 0, m_commandBuffer, pos, messageBytes.length );
+                            len = pos + messageBytes.length;
+                        }
+                        else
+                        {
+                            System.arraycopy( messageBytes, 0, m_commandBuffer, 1, messageBytes.length );
+                            len = messageBytes.length + 2;
+                            m_commandBuffer[len - 1] = 0;
+                        }
+
+                        m_backendOS.write( m_commandBuffer, 0, len );
+                        m_backendOS.flush();
+                        
+                        sentCommand = true;
+                    }
                 }
                 catch ( IOException e )
                 {
@@ -6232,13 +6538,42 @@ public final class WrapperManager
         }
     }
     
+    /**
+     * Reads the length of a version 2 packet, encoded as an unsigned LEB128 varint.
+     */
+    private static int readPacketLength( DataInputStream is )
+        throws IOException
+    {
+        int value = 0;
+        int shift = 0;
+        byte b;
+        do
+        {
+            if ( shift > 28 )
+            {
+                throw new IOException( getRes().getString( "Invalid packet length received from the Wrapper." ) );
+            }
+            b = is.readByte();
+            value |= ( b & 0x7f ) << shift;
+            shift += 7;
+        }
+        while ( ( b & 0x80 ) != 0 );
+        
+        if ( value < 0 )
+        {
+            throw new IOException( getRes().getString( "Invalid packet length received from the Wrapper." ) );
+        }
+        return value;
+    }
+    
     /**
      * Loop reading packets from the native side of the Wrapper until the 
      *  connection is closed or the WrapperManager class is disposed.
-     *  Each packet consists of a packet code followed by a null terminated
-     *  string up to 256 characters in length.  If the entire packet has not
-     *  yet been received, then it must not be read until the complete packet
-     *  has arived.
+     *  With the version 1 protocol, each packet consists of a packet code
+     *  followed by a null terminated string.  With the version 2 protocol,
+     *  the code is followed by the length of the payload and the payload.
+     *  If the entire packet has not yet been received, then it must not be
+     *  read until the complete packet has arived.
      */
     private static byte[] m_backendReadBuffer = new byte[256];
     private static void handleBackend()
@@ -6279,26 +6614,39 @@ public final class WrapperManager
                     // A Packet code must exist.
                     byte code = is.readByte();
                     
-                    // Always read from the buffer until a null '\0' is encountered.
-                    //  A multi-byte string will never have a 0 as part of another character so this should be safe for all encodings.
-                    byte b;
                     int i = 0;
-                    do
+                    if ( m_protocolReadVersion >= PROTOCOL_VERSION_2 )
                     {
-                        b = is.readByte();
-                        if ( b != 0 )
+                        // The length is known in advance so the payload can be read at once.
+                        i = readPacketLength( is );
+                        if ( i > m_backendReadBuffer.length )
                         {
-                            if ( i >= m_backendReadBuffer.length )
+                            m_backendReadBuffer = new byte[i];
+                        }
+                        is.readFully( m_backendReadBuffer, 0, i );
+                    }
+                    else
+                    {
+                        // Always read from the buffer until a null '\0' is encountered.
+                        //  A multi-byte string will never have a 0 as part of another character so this should be safe for all encodings.
+                        byte b;
+                        do
+                        {
+                            b = is.readByte();
+                            if ( b != 0 )
                             {
-                                byte[] tmp = m_backendReadBuffer;
-                                m_backendReadBuffer = new byte[tmp.length + 256];
-                                System.arraycopy( tmp, 0, m_backendReadBuffer, 0, tmp.length );
+                                if ( i >= m_backendReadBuffer.length )
+                                {
+                                    byte[] tmp = m_backendReadBuffer;
+                                    m_backendReadBuffer = new byte[tmp.length + 256];
+                                    System.arraycopy( tmp, 0, m_backendReadBuffer, 0, tmp.length );
+                                }
+                                m_backendReadBuffer[i] = b;
+                                i++;
                             }
-                            m_backendReadBuffer[i] = b;
-                            i++;
                         }
+                        while ( b != 0 );
                     }
-                    while ( b != 0 );
                     
                     // The message should be a multi-byte UTF-8 string (except on z/OS where the system encoding is used).
                     String msg;
@@ -6588,6 +6936,23 @@ public final class WrapperManager
                             readAppParameters( msg );
                             break;
                             
+                        case WRAPPER_MSG_PROTOCOL:
+                            // The Wrapper acknowledged the negotiated version.  All following packets use that framing.
+                            try
+                            {
+                                int space = msg.indexOf( ' ' );
+                                m_protocolReadVersion = Integer.parseInt( space < 0 ? msg : msg.substring( 0, space ) );
+                                if ( space >= 0 )
+                                {
+                                    m_protocolAcceptedCapabilities = Integer.parseInt( msg.substring( space + 1 ), 16 );
+                                }
+                            }
+                            catch ( NumberFormatException e )
+                            {
+                                m_outError.println( getRes().getString( "Encountered an invalid protocol version from the Wrapper: {0}", msg ) );
+                            }
+                            break;
+                            
                         case WRAPPER_MSG_LOGFILE:
                             m_logFile = new File( msg );
                             WrapperLogFileChangedEvent event = new WrapperLogFileChangedEvent( m_logFile );
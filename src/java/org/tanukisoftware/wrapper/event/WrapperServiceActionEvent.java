@@ -76,6 +76,32 @@ public abstract class WrapperServiceActionEvent
      */
     public static final int SOURCE_CODE_DEADLOCK                = 10;
     
+    /**
+     * Action result of the JVM not responding to a ping in time.
+     *  See the wrapper.ping.timeout.action property.
+     */
+    public static final int SOURCE_CODE_PING_TIMEOUT            = 11;
+    
+    /**
+     * Action result of the JVM exceeding a limit of the resource monitor.
+     *  See the wrapper.java.monitor.rss.action and
+     *  wrapper.java.monitor.cpu.action properties.
+     */
+    public static final int SOURCE_CODE_JVM_MONITOR             = 12;
+    
+    /**
+     * Action result of a pressure trigger of the JVM cgroup.
+     *  See the wrapper.java.cgroup.memory.pressure.action and
+     *  wrapper.java.cgroup.cpu.pressure.action properties.
+     */
+    public static final int SOURCE_CODE_CGROUP_PRESSURE         = 13;
+    
+    /**
+     * Action result of a command received on the control socket.
+     *  See the wrapper.control.socket property.
+     */
+    public static final int SOURCE_CODE_CONTROL_SOCKET          = 14;
+    
     /**
      * Action result of a configured timer being fired.
      *  See the wrapper.timer.&lt;n&gt;.action property.
@@ -125,6 +151,18 @@ public abstract class WrapperServiceActionEvent
         case SOURCE_CODE_DEADLOCK:
             return WrapperManager.getRes().getString( "Deadlock Action" );
             
+        case SOURCE_CODE_PING_TIMEOUT:
+            return WrapperManager.getRes().getString( "Ping Timeout Action" );
+            
+        case SOURCE_CODE_JVM_MONITOR:
+            return WrapperManager.getRes().getString( "JVM Monitor Action" );
+            
+        case SOURCE_CODE_CGROUP_PRESSURE:
+            return WrapperManager.getRes().getString( "Cgroup Pressure Action" );
+            
+        case SOURCE_CODE_CONTROL_SOCKET:
+            return WrapperManager.getRes().getString( "Control Socket Action" );
+            
         case SOURCE_CODE_TIMER:
             return WrapperManager.getRes().getString( "Timer Action" );
             